@@ -15,54 +15,34 @@ limitations under the License.
 
 #include <algorithm>
 #include <chrono>
-#include <fstream>
+#include <deque>
+#include <future>
 #include <ostream>
 #include <sstream>
+#include <thread>
 
 #if defined(_MSC_VER)
 #include <Windows.h>
 #include <io.h>
 #endif
 
+#include "absl/strings/numbers.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "absl/strings/strip.h"
+#include "absl/synchronization/mutex.h"
+#include "azure/core/base64.hpp"
 #include "azure/storage/blobs/blob_container_client.hpp"
 #include "azure/storage/blobs/block_blob_client.hpp"
 #include "tensorflow/c/logging.h"
 #include "tensorflow/c/tf_status.h"
+#include "tensorflow_io/core/filesystems/file_block_cache.h"
 #include "tensorflow_io/core/filesystems/filesystem_plugins.h"
 
 namespace tensorflow {
 namespace io {
 namespace az {
 namespace {
-// TODO: DO NOT use a hardcoded path
-bool GetTmpFilename(std::string* filename) {
-  if (!filename) {
-    // return errors::Internal("'filename' cannot be nullptr.");
-    return false;
-  }
-#ifndef _WIN32
-  char buffer[] = "/tmp/az_blob_filesystem_XXXXXX";
-  int fd = mkstemp(buffer);
-  if (fd < 0) {
-    // return errors::Internal("Failed to create a temporary file.");
-    return false;
-  }
-#else
-  char buffer[] = "/tmp/az_blob_filesystem_XXXXXX";
-  char* ret = _mktemp(buffer);
-  if (ret == nullptr) {
-    // return errors::Internal("Failed to create a temporary file.");
-    return false;
-  }
-#endif
-  *filename = buffer;
-  // return Status::OK();
-  return true;
-}
-
 void ParseURI(const absl::string_view& fname, absl::string_view* scheme,
               absl::string_view* host, absl::string_view* path) {
   size_t scheme_chunk = fname.find("://");
@@ -260,12 +240,190 @@ void ListResources(const std::string& dir, const std::string& delimiter,
   TF_SetStatus(status, TF_OK, "");
 }
 
+// Reads an integer environment variable, or returns the default value.
+int64_t GetEnvInt(const char* name, int64_t default_value) {
+  const char* value = std::getenv(name);
+  int64_t result = 0;
+  if (value != nullptr && absl::SimpleAtoi(value, &result)) {
+    return result;
+  }
+  return default_value;
+}
+
+// The key of a blob in the block cache.
+std::string CacheKey(const std::string& account, const std::string& container,
+                     const std::string& object) {
+  return absl::StrCat(account, "/", container, "/", object);
+}
+
+// Downloads up to `n` bytes at `offset` of the blob, split into
+// `concurrency` parallel range requests when large enough. Reading past the
+// end of the blob is a short read with `TF_OK`.
+int64_t DownloadRange(const std::string& account, const std::string& container,
+                      const std::string& object, uint64_t offset, size_t n,
+                      int32_t concurrency, char* buffer, TF_Status* status) {
+  auto blob_container_client = CreateAzBlobClientWrapper(account, container);
+  auto blob_client = blob_container_client->GetBlobClient(object);
+
+  Azure::Storage::Blobs::DownloadBlobToOptions download_options;
+  download_options.Range = Azure::Core::Http::HttpRange();
+  download_options.Range.Value().Offset = offset;
+  download_options.Range.Value().Length = n;
+  download_options.TransferOptions.Concurrency = std::max(concurrency, 1);
+  try {
+    auto response = blob_client.DownloadTo(reinterpret_cast<uint8_t*>(buffer),
+                                           n, download_options);
+    TF_SetStatus(status, TF_OK, "");
+    return response.Value.ContentRange.Length.Value();
+  } catch (const Azure::Storage::StorageException& e) {
+    if (e.StatusCode ==
+        Azure::Core::Http::HttpStatusCode::RangeNotSatisfiable) {
+      // The offset is at or past the end of the blob
+      TF_SetStatus(status, TF_OK, "");
+      return 0;
+    }
+    const std::string error_message =
+        absl::StrCat("Failed to get contents of az://", account, "/",
+                     container, "/", object, StorageExceptionInfo(e));
+    TF_SetStatus(status, TF_INTERNAL, error_message.c_str());
+    return -1;
+  }
+}
+
+// The state shared by all files of the filesystem.
+//
+// Reads up to the cache size go through an LRU block cache of
+// TF_AZURE_STORAGE_READ_CACHE_BLOCK_SIZE_MB blocks (16 by default) bounded by
+// TF_AZURE_STORAGE_READ_CACHE_MAX_SIZE_MB (0 by default, which disables it).
+// Fetched blocks are also kept on local disk under
+// TF_AZURE_STORAGE_READ_CACHE_DISK_DIR, bounded by
+// TF_AZURE_STORAGE_READ_CACHE_DISK_MAX_SIZE_MB.
+// Sequential reads prefetch the next TF_AZURE_STORAGE_READ_AHEAD_BLOCKS
+// blocks (2 by default) on a few background threads, read-ahead is skipped
+// while their queue is full. Larger reads are downloaded with
+// TF_AZURE_STORAGE_DOWNLOAD_CONCURRENCY parallel range requests (8 by
+// default).
+//
+// Writable files stage blocks of TF_AZURE_STORAGE_UPLOAD_BLOCK_SIZE_MB (8 by
+// default) while data is appended, with up to
+// TF_AZURE_STORAGE_UPLOAD_CONCURRENCY blocks (4 by default) in flight.
+class AzBlobFileSystem {
+ public:
+  AzBlobFileSystem()
+      : read_ahead_blocks_(GetEnvInt("TF_AZURE_STORAGE_READ_AHEAD_BLOCKS", 2)),
+        download_concurrency_(
+            GetEnvInt("TF_AZURE_STORAGE_DOWNLOAD_CONCURRENCY", 8)),
+        upload_block_size_(
+            GetEnvInt("TF_AZURE_STORAGE_UPLOAD_BLOCK_SIZE_MB", 8) * 1024 *
+            1024),
+        upload_concurrency_(
+            GetEnvInt("TF_AZURE_STORAGE_UPLOAD_CONCURRENCY", 4)) {
+    int32_t concurrency = download_concurrency_;
+    cache_.reset(new FileBlockCache(
+        GetEnvInt("TF_AZURE_STORAGE_READ_CACHE_BLOCK_SIZE_MB", 16) * 1024 *
+            1024,
+        GetEnvInt("TF_AZURE_STORAGE_READ_CACHE_MAX_SIZE_MB", 0) * 1024 * 1024,
+        [concurrency](const std::string& key, size_t offset, size_t n,
+                      char* buffer, TF_Status* status) {
+          size_t account_end = key.find('/');
+          size_t container_end = key.find('/', account_end + 1);
+          return DownloadRange(
+              key.substr(0, account_end),
+              key.substr(account_end + 1, container_end - account_end - 1),
+              key.substr(container_end + 1), offset, n, concurrency, buffer,
+              status);
+        },
+        FileBlockCache::DiskOptions::FromEnv("TF_AZURE_STORAGE_READ_CACHE")));
+    if (cache_->IsCacheEnabled() && read_ahead_blocks_ > 0) {
+      for (size_t i = 0; i < kPrefetchThreads; i++) {
+        prefetch_threads_.emplace_back([this]() { RunPrefetcher(); });
+      }
+    }
+  }
+
+  ~AzBlobFileSystem() {
+    // Prefetches hold the cache, stop the threads before it is deleted
+    {
+      absl::MutexLock l(&mu_);
+      stop_prefetch_threads_ = true;
+      prefetch_cond_var_.SignalAll();
+    }
+    for (auto& thread : prefetch_threads_) {
+      thread.join();
+    }
+  }
+
+  FileBlockCache* cache() { return cache_.get(); }
+  size_t read_ahead_blocks() const { return read_ahead_blocks_; }
+  int32_t download_concurrency() const { return download_concurrency_; }
+  size_t upload_block_size() const { return upload_block_size_; }
+  size_t upload_concurrency() const { return upload_concurrency_; }
+
+  // Drops the cached blocks of a blob that is modified or deleted.
+  void Invalidate(const std::string& account, const std::string& container,
+                  const std::string& object) {
+    cache_->RemoveFile(CacheKey(account, container, object));
+  }
+
+  // Queues the blocks at the offsets for prefetching, they are dropped if
+  // the queue is full.
+  void Prefetch(const std::string& key, const std::vector<uint64_t>& offsets) {
+    absl::MutexLock l(&mu_);
+    if (prefetch_threads_.empty() ||
+        prefetch_queue_.size() >= kMaxPrefetchQueueSize) {
+      return;
+    }
+    prefetch_queue_.emplace_back(key, offsets);
+    prefetch_cond_var_.Signal();
+  }
+
+ private:
+  static constexpr size_t kPrefetchThreads = 4;
+  static constexpr size_t kMaxPrefetchQueueSize = 64;
+
+  // Prefetches the queued blocks until the filesystem is deleted.
+  void RunPrefetcher() {
+    while (true) {
+      std::pair<std::string, std::vector<uint64_t>> request;
+      {
+        absl::MutexLock l(&mu_);
+        while (!stop_prefetch_threads_ && prefetch_queue_.empty()) {
+          prefetch_cond_var_.Wait(&mu_);
+        }
+        if (stop_prefetch_threads_) return;
+        request = std::move(prefetch_queue_.front());
+        prefetch_queue_.pop_front();
+      }
+      for (uint64_t offset : request.second) {
+        cache_->Prefetch(request.first, offset);
+      }
+    }
+  }
+
+  const size_t read_ahead_blocks_;
+  const int32_t download_concurrency_;
+  const size_t upload_block_size_;
+  const size_t upload_concurrency_;
+  std::unique_ptr<FileBlockCache> cache_;
+
+  absl::Mutex mu_;
+  absl::CondVar prefetch_cond_var_;
+  std::deque<std::pair<std::string, std::vector<uint64_t>>> prefetch_queue_
+      ABSL_GUARDED_BY(mu_);
+  bool stop_prefetch_threads_ ABSL_GUARDED_BY(mu_) = false;
+  std::vector<std::thread> prefetch_threads_;
+};
+
 class AzBlobRandomAccessFile {
  public:
   AzBlobRandomAccessFile(const std::string& account,
                          const std::string& container,
-                         const std::string& object)
-      : account_(account), container_(container), object_(object) {}
+                         const std::string& object,
+                         AzBlobFileSystem* filesystem)
+      : account_(account),
+        container_(container),
+        object_(object),
+        filesystem_(filesystem) {}
   ~AzBlobRandomAccessFile() {}
   int64_t Read(uint64_t offset, size_t n, char* buffer,
                TF_Status* status) const {
@@ -277,72 +435,95 @@ class AzBlobRandomAccessFile {
       TF_SetStatus(status, TF_OK, "");
       return 0;
     }
-    auto blob_container_client =
-        CreateAzBlobClientWrapper(account_, container_);
-    auto blob_client = blob_container_client->GetBlobClient(object_);
-    int64_t file_size;
-    try {
-      auto blob_property = blob_client.GetProperties();
-      file_size = blob_property.Value.BlobSize;
-    } catch (const Azure::Storage::StorageException& e) {
-      const std::string error_message =
-          absl::StrCat("Failed to get properties of az://", account_, "/",
-                       container_, "/", object_, StorageExceptionInfo(e));
-      TF_SetStatus(status, TF_INTERNAL, error_message.c_str());
-      return 0;
-    }
 
-    size_t bytes_to_read = n;
-    if (offset >= file_size) {
-      bytes_to_read = 0;
-    } else if (offset + n > file_size) {
-      bytes_to_read = file_size - offset;
+    FileBlockCache* cache = filesystem_->cache();
+    int64_t bytes_read;
+    if (cache->IsCacheEnabled() && n <= cache->max_bytes()) {
+      bytes_read = cache->Read(CacheKey(account_, container_, object_), offset,
+                               n, buffer, status);
+    } else {
+      bytes_read =
+          DownloadRange(account_, container_, object_, offset, n,
+                        filesystem_->download_concurrency(), buffer, status);
     }
-
-    if (bytes_to_read > 0) {
-      Azure::Storage::Blobs::DownloadBlobToOptions download_options;
-      download_options.Range = Azure::Core::Http::HttpRange();
-      download_options.Range.Value().Offset = offset;
-      download_options.Range.Value().Length = bytes_to_read;
-
-      try {
-        blob_client.DownloadTo(reinterpret_cast<uint8_t*>(buffer),
-                               bytes_to_read, download_options);
-      } catch (const Azure::Storage::StorageException& e) {
-        const std::string error_message =
-            absl::StrCat("Failed to get contents of az://", account_, "/",
-                         container_, "/", object_, StorageExceptionInfo(e));
-        TF_SetStatus(status, TF_INTERNAL, error_message.c_str());
-        return 0;
-      }
+    if (TF_GetCode(status) != TF_OK && TF_GetCode(status) != TF_OUT_OF_RANGE) {
+      return 0;
     }
 
-    if (bytes_to_read < n) {
+    if (bytes_read < n) {
       TF_SetStatus(status, TF_OUT_OF_RANGE, "EOF reached");
-      return bytes_to_read;
+      return bytes_read;
+    }
+    if (cache->IsCacheEnabled() && n <= cache->max_bytes()) {
+      MaybeReadAhead(offset, offset + bytes_read);
     }
     TF_SetStatus(status, TF_OK, "");
-    return bytes_to_read;
+    return bytes_read;
   }
 
  private:
+  // Prefetches the blocks following a sequential read ending at `end`.
+  // Random reads reset the read-ahead.
+  void MaybeReadAhead(uint64_t offset, uint64_t end) const {
+    const uint64_t block_size = filesystem_->cache()->block_size();
+    std::vector<uint64_t> offsets;
+    {
+      absl::MutexLock l(&mu_);
+      bool sequential = offset == next_offset_;
+      next_offset_ = end;
+      if (!sequential) {
+        prefetched_until_ = 0;
+        return;
+      }
+      uint64_t start = block_size * ((end + block_size - 1) / block_size);
+      uint64_t until = start + filesystem_->read_ahead_blocks() * block_size;
+      for (uint64_t pos = std::max(start, prefetched_until_); pos < until;
+           pos += block_size) {
+        offsets.push_back(pos);
+      }
+      prefetched_until_ = std::max(until, prefetched_until_);
+    }
+    if (!offsets.empty()) {
+      filesystem_->Prefetch(CacheKey(account_, container_, object_), offsets);
+    }
+  }
+
   std::string account_;
   std::string container_;
   std::string object_;
+  AzBlobFileSystem* filesystem_;
+
+  mutable absl::Mutex mu_;
+  mutable uint64_t next_offset_ ABSL_GUARDED_BY(mu_) = 0;
+  mutable uint64_t prefetched_until_ ABSL_GUARDED_BY(mu_) = 0;
 };
 
+// Writes a block blob without a local copy.
+//
+// Appended data is buffered in memory, every full buffer is staged as a block
+// in the background while the next one is filled. At most
+// `upload_concurrency` blocks are in flight, `Append` waits for the oldest
+// one beyond that. `Sync` stages the partial buffer and commits the block
+// list, so the blob holds all data appended so far. A blob that fits in a
+// single block is uploaded with one request instead.
 class AzBlobWritableFile {
  public:
   AzBlobWritableFile(const std::string& account, const std::string& container,
-                     const std::string& object)
+                     const std::string& object, AzBlobFileSystem* filesystem)
       : account_(account),
         container_(container),
         object_(object),
-        sync_needed_(true) {
-    if (GetTmpFilename(&tmp_content_filename_)) {
-      outfile_.open(tmp_content_filename_,
-                    std::ofstream::binary | std::ofstream::app);
-    }
+        filesystem_(filesystem),
+        blob_client_(CreateAzBlobClientWrapper(account, container)
+                         ->GetBlockBlobClient(object)),
+        block_size_(std::max(filesystem->upload_block_size(),
+                             static_cast<size_t>(1))),
+        max_inflight_(std::max(filesystem->upload_concurrency(),
+                               static_cast<size_t>(1))),
+        position_(0),
+        sync_needed_(true),
+        closed_(false) {
+    buffer_.reserve(block_size_);
   }
 
   ~AzBlobWritableFile() {
@@ -352,77 +533,171 @@ class AzBlobWritableFile {
   }
 
   void Append(const char* buffer, size_t n, TF_Status* status) {
-    if (!outfile_.is_open()) {
-      TF_SetStatus(status, TF_FAILED_PRECONDITION,
-                   "The internal temporary file is not writable");
+    if (closed_) {
+      TF_SetStatus(status, TF_FAILED_PRECONDITION, "The file is closed");
       return;
     }
-
-    std::string data(buffer, n);
     sync_needed_ = true;
-    outfile_ << data;
-    if (!outfile_.good()) {
-      TF_SetStatus(status, TF_INTERNAL,
-                   "Could not append to the internal temporary file");
-      return;
+    while (n > 0) {
+      size_t bytes = std::min(n, block_size_ - buffer_.size());
+      buffer_.insert(buffer_.end(), buffer, buffer + bytes);
+      position_ += bytes;
+      buffer += bytes;
+      n -= bytes;
+      if (buffer_.size() == block_size_) {
+        StageBuffer(status);
+        if (TF_GetCode(status) != TF_OK) {
+          return;
+        }
+      }
     }
     TF_SetStatus(status, TF_OK, "");
   }
+
+  int64_t Tell(TF_Status* status) const {
+    TF_SetStatus(status, TF_OK, "");
+    return position_;
+  }
+
   void Sync(TF_Status* status) {
-    if (!outfile_.is_open()) {
-      TF_SetStatus(status, TF_FAILED_PRECONDITION,
-                   "The internal temporary file is not writable");
-      return;
-    }
-    if (!sync_needed_) {
+    if (closed_ || !sync_needed_) {
       TF_SetStatus(status, TF_OK, "");
       return;
     }
-    outfile_.flush();
-    if (!outfile_.good()) {
-      TF_SetStatus(status, TF_INTERNAL,
-                   "Could not write to the internal temporary file");
-      return;
-    }
 
     TF_VLog(1, "WriteFileToAz: az://%s/%s/%s\n", account_.c_str(),
             container_.c_str(), object_.c_str());
 
-    auto blob_container_client =
-        CreateAzBlobClientWrapper(account_, container_);
-    auto blob_client = blob_container_client->GetBlockBlobClient(object_);
-    try {
-      blob_client.UploadFrom(tmp_content_filename_);
-    } catch (const Azure::Storage::StorageException& e) {
-      const std::string error_message =
-          absl::StrCat("Failed to upload to az://", account_, "/", container_,
-                       "/", object_, StorageExceptionInfo(e));
-      TF_SetStatus(status, TF_INTERNAL, error_message.c_str());
-      return;
+    if (block_ids_.empty()) {
+      // Everything fits in the buffer, which is kept in case more data is
+      // appended and committed as blocks later
+      try {
+        blob_client_.UploadFrom(
+            reinterpret_cast<const uint8_t*>(buffer_.data()), buffer_.size());
+      } catch (const Azure::Storage::StorageException& e) {
+        const std::string error_message =
+            absl::StrCat("Failed to upload to az://", account_, "/",
+                         container_, "/", object_, StorageExceptionInfo(e));
+        TF_SetStatus(status, TF_INTERNAL, error_message.c_str());
+        return;
+      }
+    } else {
+      if (!buffer_.empty()) {
+        StageBuffer(status);
+        if (TF_GetCode(status) != TF_OK) {
+          return;
+        }
+      }
+      WaitForBlocks(status);
+      if (TF_GetCode(status) != TF_OK) {
+        return;
+      }
+      try {
+        blob_client_.CommitBlockList(block_ids_);
+      } catch (const Azure::Storage::StorageException& e) {
+        const std::string error_message =
+            absl::StrCat("Failed to commit blocks to az://", account_, "/",
+                         container_, "/", object_, StorageExceptionInfo(e));
+        TF_SetStatus(status, TF_INTERNAL, error_message.c_str());
+        return;
+      }
     }
+    filesystem_->Invalidate(account_, container_, object_);
     sync_needed_ = false;
     TF_SetStatus(status, TF_OK, "");
   }
 
   void Close(TF_Status* status) {
-    if (outfile_.is_open()) {
+    if (!closed_) {
       Sync(status);
       if (TF_GetCode(status) != TF_OK) {
         return;
       }
-      outfile_.close();
-      std::remove(tmp_content_filename_.c_str());
+      closed_ = true;
+      buffer_ = std::vector<char>();
     }
     TF_SetStatus(status, TF_OK, "");
   }
 
  private:
+  // Block ids have to be base64 strings of the same length within a blob.
+  static std::string BlockId(size_t index) {
+    std::string id = std::to_string(index);
+    id.insert(0, 10 - std::min(id.size(), static_cast<size_t>(10)), '0');
+    return Azure::Core::Convert::Base64Encode(
+        std::vector<uint8_t>(id.begin(), id.end()));
+  }
+
+  // Stages the buffered data as the next block in the background.
+  void StageBuffer(TF_Status* status) {
+    while (staging_.size() >= max_inflight_) {
+      WaitForBlock(status);
+      if (TF_GetCode(status) != TF_OK) {
+        return;
+      }
+    }
+    std::string block_id = BlockId(block_ids_.size());
+    block_ids_.push_back(block_id);
+    auto data = std::make_shared<std::vector<char>>(std::move(buffer_));
+    buffer_ = std::vector<char>();
+    buffer_.reserve(block_size_);
+
+    auto blob_client = blob_client_;
+    staging_.push_back(std::async(
+        std::launch::async, [blob_client, block_id, data]() -> std::string {
+          Azure::Core::IO::MemoryBodyStream stream(
+              reinterpret_cast<const uint8_t*>(data->data()), data->size());
+          try {
+            blob_client.StageBlock(block_id, stream);
+          } catch (const Azure::Storage::StorageException& e) {
+            return StorageExceptionInfo(e);
+          }
+          return "";
+        }));
+    TF_SetStatus(status, TF_OK, "");
+  }
+
+  // Waits for the oldest block in flight.
+  void WaitForBlock(TF_Status* status) {
+    std::string error = staging_.front().get();
+    staging_.pop_front();
+    if (!error.empty()) {
+      const std::string error_message =
+          absl::StrCat("Failed to stage a block of az://", account_, "/",
+                       container_, "/", object_, error);
+      TF_SetStatus(status, TF_INTERNAL, error_message.c_str());
+      return;
+    }
+    TF_SetStatus(status, TF_OK, "");
+  }
+
+  // Waits for all blocks in flight and returns the first error.
+  void WaitForBlocks(TF_Status* status) {
+    TF_SetStatus(status, TF_OK, "");
+    TF_Status* block_status = TF_NewStatus();
+    while (!staging_.empty()) {
+      WaitForBlock(block_status);
+      if (TF_GetCode(block_status) != TF_OK && TF_GetCode(status) == TF_OK) {
+        TF_SetStatus(status, TF_GetCode(block_status),
+                     TF_Message(block_status));
+      }
+    }
+    TF_DeleteStatus(block_status);
+  }
+
   std::string account_;
   std::string container_;
   std::string object_;
-  std::string tmp_content_filename_;
-  std::ofstream outfile_;
+  AzBlobFileSystem* filesystem_;
+  Azure::Storage::Blobs::BlockBlobClient blob_client_;
+  const size_t block_size_;
+  const size_t max_inflight_;
+  std::vector<char> buffer_;
+  std::vector<std::string> block_ids_;
+  std::deque<std::future<std::string>> staging_;
+  int64_t position_;
   bool sync_needed_;  // whether there is buffered data that needs to be synced
+  bool closed_;
 };
 
 #if 0
@@ -494,8 +769,8 @@ static void Append(const TF_WritableFile* file, const char* buffer, size_t n,
 }
 
 static int64_t Tell(const TF_WritableFile* file, TF_Status* status) {
-  TF_SetStatus(status, TF_UNIMPLEMENTED, "Stat not implemented");
-  return -1;
+  auto az_file = static_cast<AzBlobWritableFile*>(file->plugin_file);
+  return az_file->Tell(status);
 }
 
 static void Flush(const TF_WritableFile* file, TF_Status* status) {
@@ -531,10 +806,19 @@ uint64_t Length(const TF_ReadOnlyMemoryRegion* region) { return 0; }
 namespace tf_az_filesystem {
 
 static void Init(TF_Filesystem* filesystem, TF_Status* status) {
+  filesystem->plugin_filesystem = new AzBlobFileSystem();
   TF_SetStatus(status, TF_OK, "");
 }
 
-static void Cleanup(TF_Filesystem* filesystem) {}
+static void Cleanup(TF_Filesystem* filesystem) {
+  auto az_filesystem =
+      static_cast<AzBlobFileSystem*>(filesystem->plugin_filesystem);
+  delete az_filesystem;
+}
+
+static AzBlobFileSystem* GetFileSystem(const TF_Filesystem* filesystem) {
+  return static_cast<AzBlobFileSystem*>(filesystem->plugin_filesystem);
+}
 
 static void NewRandomAccessFile(const TF_Filesystem* filesystem,
                                 const char* path, TF_RandomAccessFile* file,
@@ -544,7 +828,8 @@ static void NewRandomAccessFile(const TF_Filesystem* filesystem,
   if (TF_GetCode(status) != TF_OK) {
     return;
   }
-  file->plugin_file = new AzBlobRandomAccessFile(account, container, object);
+  file->plugin_file = new AzBlobRandomAccessFile(account, container, object,
+                                                 GetFileSystem(filesystem));
 
   TF_SetStatus(status, TF_OK, "");
 }
@@ -556,7 +841,9 @@ static void NewWritableFile(const TF_Filesystem* filesystem, const char* path,
   if (TF_GetCode(status) != TF_OK) {
     return;
   }
-  file->plugin_file = new AzBlobWritableFile(account, container, object);
+  GetFileSystem(filesystem)->Invalidate(account, container, object);
+  file->plugin_file = new AzBlobWritableFile(account, container, object,
+                                             GetFileSystem(filesystem));
 
   TF_SetStatus(status, TF_OK, "");
 }
@@ -568,7 +855,9 @@ static void NewAppendableFile(const TF_Filesystem* filesystem, const char* path,
   if (TF_GetCode(status) != TF_OK) {
     return;
   }
-  file->plugin_file = new AzBlobWritableFile(account, container, object);
+  GetFileSystem(filesystem)->Invalidate(account, container, object);
+  file->plugin_file = new AzBlobWritableFile(account, container, object,
+                                             GetFileSystem(filesystem));
 
   TF_SetStatus(status, TF_OK, "");
 }
@@ -620,6 +909,7 @@ static void DeleteFile(const TF_Filesystem* filesystem, const char* path,
   auto blob_container_client = CreateAzBlobClientWrapper(account, container);
 
   auto blob_client = blob_container_client->GetBlobClient(object);
+  GetFileSystem(filesystem)->Invalidate(account, container, object);
 
   try {
     auto response = blob_client.Delete();
@@ -686,6 +976,7 @@ static void DeleteDir(const TF_Filesystem* filesystem, const char* path,
     }
 
     for (const auto& child : children) {
+      GetFileSystem(filesystem)->Invalidate(account, container, child);
       auto child_client = blob_container_client->GetBlobClient(child);
       try {
         child_client.Delete();
@@ -738,6 +1029,8 @@ static void RenameFile(const TF_Filesystem* filesystem, const char* src,
   auto blob_container_client =
       CreateAzBlobClientWrapper(dst_account, dst_container);
   auto blob_client = blob_container_client->GetBlobClient(dst_object);
+  GetFileSystem(filesystem)->Invalidate(dst_account, dst_container, dst_object);
+  GetFileSystem(filesystem)->Invalidate(src_account, src_container, src_object);
 
   try {
     const std::string src_uri =
@@ -795,8 +1088,8 @@ static void CopyFile(const TF_Filesystem* filesystem, const char* src,
   if (TF_GetCode(status) != TF_OK) {
     return;
   }
-  std::unique_ptr<AzBlobRandomAccessFile> src_file(
-      new AzBlobRandomAccessFile(src_account, src_container, src_object));
+  std::unique_ptr<AzBlobRandomAccessFile> src_file(new AzBlobRandomAccessFile(
+      src_account, src_container, src_object, GetFileSystem(filesystem)));
 
   std::string dst_account, dst_container, dst_object;
   ParseAzBlobPath(dst, false, &dst_account, &dst_container, &dst_object,
@@ -804,8 +1097,9 @@ static void CopyFile(const TF_Filesystem* filesystem, const char* src,
   if (TF_GetCode(status) != TF_OK) {
     return;
   }
-  std::unique_ptr<AzBlobWritableFile> dst_file(
-      new AzBlobWritableFile(dst_account, dst_container, dst_object));
+  GetFileSystem(filesystem)->Invalidate(dst_account, dst_container, dst_object);
+  std::unique_ptr<AzBlobWritableFile> dst_file(new AzBlobWritableFile(
+      dst_account, dst_container, dst_object, GetFileSystem(filesystem)));
 
   uint64_t offset = 0;
   std::unique_ptr<char[]> buffer(new char[kCopyFileBufferSize]);
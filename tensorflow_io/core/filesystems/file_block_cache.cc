@@ -0,0 +1,558 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow_io/core/filesystems/file_block_cache.h"
+
+#if defined(_WIN32)
+#include <direct.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "tensorflow/c/logging.h"
+
+namespace tensorflow {
+namespace io {
+namespace {
+
+bool MakeDirectory(const std::string& path) {
+#if defined(_WIN32)
+  return _mkdir(path.c_str()) == 0;
+#else
+  return mkdir(path.c_str(), 0700) == 0;
+#endif
+}
+
+void RemoveDirectory(const std::string& path) {
+#if defined(_WIN32)
+  _rmdir(path.c_str());
+#else
+  rmdir(path.c_str());
+#endif
+}
+
+void RemoveFiles(const std::vector<std::string>& paths) {
+  for (const auto& path : paths) {
+    std::remove(path.c_str());
+  }
+}
+
+constexpr char kDiskDirectoryPrefix[] = "tfio-block-cache-";
+constexpr char kLockFileName[] = "lock";
+
+#if !defined(_WIN32)
+// Removes `directory` along with the files in it.
+void RemoveDirectoryAndFiles(const std::string& directory) {
+  std::vector<std::string> paths;
+  DIR* dir = opendir(directory.c_str());
+  if (dir == nullptr) {
+    return;
+  }
+  while (struct dirent* entry = readdir(dir)) {
+    if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
+      paths.push_back(absl::StrCat(directory, "/", entry->d_name));
+    }
+  }
+  closedir(dir);
+  RemoveFiles(paths);
+  RemoveDirectory(directory);
+}
+
+// Locks `directory` for as long as the returned descriptor is open, or
+// returns -1 on failure. The lock file is only given its name once it is
+// locked, so that the directory is never seen unlocked by another process.
+int LockDirectory(const std::string& directory) {
+  const std::string temp_path =
+      absl::StrCat(directory, "/", kLockFileName, ".tmp");
+  int fd = open(temp_path.c_str(), O_CREAT | O_RDWR | O_CLOEXEC, 0600);
+  if (fd < 0) {
+    return -1;
+  }
+  if (flock(fd, LOCK_EX) != 0 ||
+      rename(temp_path.c_str(),
+             absl::StrCat(directory, "/", kLockFileName).c_str()) != 0) {
+    close(fd);
+    std::remove(temp_path.c_str());
+    return -1;
+  }
+  return fd;
+}
+
+// Removes the directories of caches under `path` that are not locked, as a
+// process that crashed did not get to remove its own directory. The lock of
+// a live cache is held by its process, whichever PID namespace or host (of
+// a file system that supports `flock`) it runs in.
+void RemoveStaleDirectories(const std::string& path) {
+  DIR* dir = opendir(path.c_str());
+  if (dir == nullptr) {
+    return;
+  }
+  std::vector<std::string> candidates;
+  while (struct dirent* entry = readdir(dir)) {
+    if (absl::StartsWith(entry->d_name, kDiskDirectoryPrefix)) {
+      candidates.push_back(absl::StrCat(path, "/", entry->d_name));
+    }
+  }
+  closedir(dir);
+
+  for (const auto& directory : candidates) {
+    // A directory without a lock file is still being created.
+    int fd = open(absl::StrCat(directory, "/", kLockFileName).c_str(),
+                  O_RDWR | O_CLOEXEC);
+    if (fd < 0) {
+      continue;
+    }
+    if (flock(fd, LOCK_EX | LOCK_NB) == 0) {
+      RemoveDirectoryAndFiles(directory);
+      TF_VLog(1, "Removed the stale block cache directory %s\n",
+              directory.c_str());
+    }
+    close(fd);
+  }
+}
+#endif
+
+}  // namespace
+
+FileBlockCache::DiskOptions FileBlockCache::DiskOptions::FromEnv(
+    const std::string& prefix) {
+  DiskOptions options;
+  const char* path = std::getenv((prefix + "_DISK_DIR").c_str());
+  if (path != nullptr) {
+    options.path = path;
+  }
+  const char* max_size = std::getenv((prefix + "_DISK_MAX_SIZE_MB").c_str());
+  size_t value;
+  if (max_size != nullptr && absl::SimpleAtoi(max_size, &value)) {
+    options.max_bytes = value * 1024 * 1024;
+  }
+  return options;
+}
+
+FileBlockCache::FileBlockCache(size_t block_size, size_t max_bytes,
+                               BlockFetcher block_fetcher)
+    : FileBlockCache(block_size, max_bytes, std::move(block_fetcher),
+                     DiskOptions()) {}
+
+FileBlockCache::FileBlockCache(size_t block_size, size_t max_bytes,
+                               BlockFetcher block_fetcher,
+                               DiskOptions disk_options)
+    : block_size_(block_size),
+      max_bytes_(max_bytes),
+      block_fetcher_(std::move(block_fetcher)) {
+  if (!IsCacheEnabled() || disk_options.path.empty() ||
+      disk_options.max_bytes == 0) {
+    return;
+  }
+  // The directory is private to this cache, so that blocks of files which
+  // changed since they were stored can not be picked up by another process.
+  MakeDirectory(disk_options.path);
+#if !defined(_WIN32)
+  RemoveStaleDirectories(disk_options.path);
+#endif
+  std::random_device random;
+  for (int attempt = 0; attempt < 8 && disk_path_.empty(); ++attempt) {
+    std::string path = absl::StrCat(
+        disk_options.path, "/", kDiskDirectoryPrefix,
+        absl::Hex((static_cast<uint64_t>(random()) << 32) | random()));
+    if (MakeDirectory(path)) {
+      disk_path_ = path;
+    }
+  }
+  if (disk_path_.empty()) {
+    TF_Log(TF_WARNING, "Could not create a block cache directory in %s",
+           disk_options.path.c_str());
+    return;
+  }
+#if !defined(_WIN32)
+  disk_lock_fd_ = LockDirectory(disk_path_);
+  if (disk_lock_fd_ < 0) {
+    TF_Log(TF_WARNING, "Could not lock the block cache directory %s",
+           disk_path_.c_str());
+    RemoveDirectory(disk_path_);
+    disk_path_.clear();
+    return;
+  }
+#endif
+  disk_max_bytes_ = disk_options.max_bytes;
+  TF_VLog(1, "Storing up to %llu bytes of cached blocks in %s\n",
+          static_cast<unsigned long long>(disk_max_bytes_),
+          disk_path_.c_str());
+}
+
+FileBlockCache::~FileBlockCache() {
+  if (!IsDiskCacheEnabled()) {
+    return;
+  }
+  std::vector<std::string> paths;
+  {
+    absl::MutexLock l(&disk_mu_);
+    while (!disk_block_map_.empty()) {
+      RemoveDiskBlock(disk_block_map_.begin(), &paths);
+    }
+  }
+  RemoveFiles(paths);
+#if defined(_WIN32)
+  RemoveDirectory(disk_path_);
+#else
+  // The lock is released last, once the directory is gone.
+  RemoveDirectoryAndFiles(disk_path_);
+  close(disk_lock_fd_);
+#endif
+}
+
+std::shared_ptr<FileBlockCache::Block> FileBlockCache::Lookup(const Key& key) {
+  absl::MutexLock l(&mu_);
+  auto entry = block_map_.find(key);
+  if (entry != block_map_.end()) {
+    return entry->second;
+  }
+  auto block = std::make_shared<Block>();
+  lru_list_.push_front(key);
+  block->lru_iterator = lru_list_.begin();
+  block_map_.emplace(key, block);
+  return block;
+}
+
+void FileBlockCache::Trim() {
+  while (!lru_list_.empty() && cache_size_ > max_bytes_) {
+    RemoveBlock(block_map_.find(lru_list_.back()));
+  }
+}
+
+void FileBlockCache::UpdateLRU(const Key& key,
+                               const std::shared_ptr<Block>& block,
+                               bool fetched) {
+  absl::MutexLock l(&mu_);
+  if (block->evicted) {
+    // The block was evicted by another thread, keep it evicted.
+    return;
+  }
+  if (fetched) {
+    block->size = block->data.capacity();
+    cache_size_ += block->size;
+  }
+  if (block->lru_iterator != lru_list_.begin()) {
+    lru_list_.erase(block->lru_iterator);
+    lru_list_.push_front(key);
+    block->lru_iterator = lru_list_.begin();
+  }
+  Trim();
+}
+
+void FileBlockCache::MaybeFetch(const Key& key,
+                                const std::shared_ptr<Block>& block,
+                                TF_Status* status) {
+  bool fetched = false;
+  // Whether the block is already stored on disk
+  bool stored = true;
+  uint64_t removals = 0;
+  {
+    absl::MutexLock l(&block->mu);
+    TF_SetStatus(status, TF_OK, "");
+    while (block->state != FetchState::FINISHED) {
+      if (block->state == FetchState::FETCHING) {
+        block->cond_var.WaitWithTimeout(&block->mu, absl::Minutes(1));
+        continue;
+      }
+      // CREATED, or ERROR of a previous fetch which is retried
+      block->state = FetchState::FETCHING;
+      block->mu.Unlock();
+      if (!ReadFromDisk(key, &block->data)) {
+        if (IsDiskCacheEnabled()) {
+          absl::MutexLock cache_lock(&mu_);
+          removals = removals_;
+          disk_fetches_.insert(removals);
+        }
+        block->data.clear();
+        block->data.resize(block_size_, 0);
+        int64_t bytes = block_fetcher_(key.first, key.second, block_size_,
+                                       block->data.data(), status);
+        if (TF_GetCode(status) == TF_OK) {
+          block->data.resize(bytes);
+          if (static_cast<size_t>(bytes) < block_size_) {
+            // Release the unused part of a short (last) block
+            std::vector<char>(block->data).swap(block->data);
+          }
+          stored = false;
+        } else if (IsDiskCacheEnabled()) {
+          absl::MutexLock cache_lock(&mu_);
+          FinishDiskFetch(key, removals);
+        }
+      }
+      block->mu.Lock();
+      if (TF_GetCode(status) == TF_OK) {
+        block->state = FetchState::FINISHED;
+        fetched = true;
+      } else {
+        block->state = FetchState::ERROR;
+      }
+      block->cond_var.SignalAll();
+      if (!fetched) {
+        return;
+      }
+    }
+  }
+  // Accounted after releasing the block's lock to keep the lock order
+  UpdateLRU(key, block, fetched);
+  if (!stored) {
+    WriteToDisk(key, block->data, removals);
+  }
+}
+
+std::string FileBlockCache::DiskBlockPath(uint64_t id) const {
+  return absl::StrCat(disk_path_, "/", id);
+}
+
+bool FileBlockCache::ReadFromDisk(const Key& key, std::vector<char>* data) {
+  if (!IsDiskCacheEnabled()) {
+    return false;
+  }
+  DiskBlock disk_block;
+  {
+    absl::MutexLock l(&disk_mu_);
+    auto entry = disk_block_map_.find(key);
+    if (entry == disk_block_map_.end()) {
+      return false;
+    }
+    disk_lru_list_.splice(disk_lru_list_.begin(), disk_lru_list_,
+                          entry->second.lru_iterator);
+    disk_block = entry->second;
+  }
+  // The file may be removed meanwhile, which is a miss like any other
+  // failure to read it.
+  std::ifstream file(DiskBlockPath(disk_block.id), std::ios::binary);
+  data->resize(disk_block.size);
+  if (file.read(data->data(), disk_block.size) &&
+      static_cast<size_t>(file.gcount()) == disk_block.size) {
+    TF_VLog(2, "Read block %s@%llu from disk\n", key.first.c_str(),
+            static_cast<unsigned long long>(key.second));
+    return true;
+  }
+  TF_Log(TF_WARNING, "Could not read block %s@%llu from disk",
+         key.first.c_str(), static_cast<unsigned long long>(key.second));
+  std::vector<std::string> paths;
+  {
+    absl::MutexLock l(&disk_mu_);
+    auto entry = disk_block_map_.find(key);
+    if (entry != disk_block_map_.end() && entry->second.id == disk_block.id) {
+      RemoveDiskBlock(entry, &paths);
+    }
+  }
+  RemoveFiles(paths);
+  return false;
+}
+
+bool FileBlockCache::FinishDiskFetch(const Key& key, uint64_t removals) {
+  disk_fetches_.erase(disk_fetches_.find(removals));
+  auto entry = file_removals_.find(key.first);
+  const bool removed =
+      flush_removals_ > removals ||
+      (entry != file_removals_.end() && entry->second > removals);
+  // Removals counted before the oldest fetch in flight can not affect it
+  const uint64_t oldest =
+      disk_fetches_.empty() ? removals_ : *disk_fetches_.begin();
+  for (auto it = file_removals_.begin(); it != file_removals_.end();) {
+    if (it->second <= oldest) {
+      it = file_removals_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  return removed;
+}
+
+void FileBlockCache::WriteToDisk(const Key& key, const std::vector<char>& data,
+                                 uint64_t removals) {
+  if (!IsDiskCacheEnabled()) {
+    return;
+  }
+  uint64_t id = 0;
+  std::string path;
+  if (!data.empty() && data.size() <= disk_max_bytes_) {
+    {
+      absl::MutexLock l(&disk_mu_);
+      id = next_disk_id_++;
+    }
+    path = DiskBlockPath(id);
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.write(data.data(), data.size()) || !file.flush()) {
+      TF_Log(TF_WARNING, "Could not write block %s@%llu to %s",
+             key.first.c_str(), static_cast<unsigned long long>(key.second),
+             path.c_str());
+      file.close();
+      std::remove(path.c_str());
+      path.clear();
+    }
+  }
+  std::vector<std::string> paths;
+  {
+    absl::MutexLock l(&mu_);
+    absl::MutexLock disk_lock(&disk_mu_);
+    const bool removed = FinishDiskFetch(key, removals);
+    if (path.empty()) {
+      // Nothing was written
+    } else if (removed || disk_block_map_.count(key) > 0) {
+      paths.push_back(path);
+    } else {
+      disk_lru_list_.push_front(key);
+      disk_block_map_.emplace(
+          key, DiskBlock{id, data.size(), disk_lru_list_.begin()});
+      disk_cache_size_ += data.size();
+      while (disk_cache_size_ > disk_max_bytes_) {
+        RemoveDiskBlock(disk_block_map_.find(disk_lru_list_.back()), &paths);
+      }
+    }
+  }
+  RemoveFiles(paths);
+}
+
+void FileBlockCache::RemoveDiskBlock(DiskBlockMap::iterator entry,
+                                     std::vector<std::string>* paths) {
+  paths->push_back(DiskBlockPath(entry->second.id));
+  disk_lru_list_.erase(entry->second.lru_iterator);
+  disk_cache_size_ -= entry->second.size;
+  disk_block_map_.erase(entry);
+}
+
+int64_t FileBlockCache::Read(const std::string& filename, size_t offset,
+                             size_t n, char* buffer, TF_Status* status) {
+  if (n == 0) {
+    TF_SetStatus(status, TF_OK, "");
+    return 0;
+  }
+  if (!IsCacheEnabled() || n > max_bytes_) {
+    return block_fetcher_(filename, offset, n, buffer, status);
+  }
+  const size_t start = block_size_ * (offset / block_size_);
+  const size_t finish = offset + n;
+  size_t copied = 0;
+  for (size_t pos = start; pos < finish; pos += block_size_) {
+    Key key = std::make_pair(filename, pos);
+    std::shared_ptr<Block> block = Lookup(key);
+    MaybeFetch(key, block, status);
+    if (TF_GetCode(status) != TF_OK) {
+      return -1;
+    }
+    const std::vector<char>& data = block->data;
+    if (offset + copied >= pos + data.size()) {
+      std::string error_message =
+          absl::StrCat("EOF at offset ", offset, " in file ", filename,
+                       " at position ", pos, " with data size ", data.size());
+      TF_SetStatus(status, TF_OUT_OF_RANGE, error_message.c_str());
+      return copied;
+    }
+    const size_t begin = offset + copied - pos;
+    const size_t end = std::min(data.size(), finish - pos);
+    memcpy(buffer + copied, data.data() + begin, end - begin);
+    copied += end - begin;
+    if (data.size() < block_size_) {
+      // A partial block marks the end of the file
+      break;
+    }
+  }
+  TF_SetStatus(status, TF_OK, "");
+  return copied;
+}
+
+void FileBlockCache::Prefetch(const std::string& filename, size_t offset) {
+  if (!IsCacheEnabled()) {
+    return;
+  }
+  Key key = std::make_pair(filename, block_size_ * (offset / block_size_));
+  std::shared_ptr<Block> block = Lookup(key);
+  {
+    absl::MutexLock l(&block->mu);
+    if (block->state == FetchState::FETCHING ||
+        block->state == FetchState::FINISHED) {
+      return;
+    }
+  }
+  std::unique_ptr<TF_Status, decltype(&TF_DeleteStatus)> status(
+      TF_NewStatus(), TF_DeleteStatus);
+  MaybeFetch(key, block, status.get());
+}
+
+size_t FileBlockCache::CacheSize() const {
+  absl::MutexLock l(&mu_);
+  return cache_size_;
+}
+
+size_t FileBlockCache::DiskCacheSize() const {
+  absl::MutexLock l(&disk_mu_);
+  return disk_cache_size_;
+}
+
+void FileBlockCache::Flush() {
+  std::vector<std::string> paths;
+  {
+    absl::MutexLock l(&mu_);
+    flush_removals_ = ++removals_;
+    while (!block_map_.empty()) {
+      RemoveBlock(block_map_.begin());
+    }
+    absl::MutexLock disk_lock(&disk_mu_);
+    while (!disk_block_map_.empty()) {
+      RemoveDiskBlock(disk_block_map_.begin(), &paths);
+    }
+  }
+  RemoveFiles(paths);
+}
+
+void FileBlockCache::RemoveFile(const std::string& filename) {
+  std::vector<std::string> paths;
+  {
+    absl::MutexLock l(&mu_);
+    removals_++;
+    if (!disk_fetches_.empty()) {
+      file_removals_[filename] = removals_;
+    }
+    auto it = block_map_.lower_bound(std::make_pair(filename, 0));
+    while (it != block_map_.end() && it->first.first == filename) {
+      RemoveBlock(it++);
+    }
+    absl::MutexLock disk_lock(&disk_mu_);
+    auto disk_it = disk_block_map_.lower_bound(std::make_pair(filename, 0));
+    while (disk_it != disk_block_map_.end() &&
+           disk_it->first.first == filename) {
+      RemoveDiskBlock(disk_it++, &paths);
+    }
+  }
+  RemoveFiles(paths);
+}
+
+void FileBlockCache::RemoveBlock(BlockMap::iterator entry) {
+  Block* block = entry->second.get();
+  block->evicted = true;
+  lru_list_.erase(block->lru_iterator);
+  cache_size_ -= block->size;
+  block_map_.erase(entry);
+}
+
+}  // namespace io
+}  // namespace tensorflow
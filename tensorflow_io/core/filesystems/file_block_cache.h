@@ -0,0 +1,239 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_IO_CORE_FILESYSTEMS_FILE_BLOCK_CACHE_H_
+#define TENSORFLOW_IO_CORE_FILESYSTEMS_FILE_BLOCK_CACHE_H_
+
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "tensorflow/c/tf_status.h"
+
+namespace tensorflow {
+namespace io {
+
+/// \brief An LRU block cache of file contents, keyed by {filename, offset}.
+///
+/// The cache is shared by the read-only random access files of a remote
+/// filesystem plugin, so that repeated small reads (e.g. file footers or
+/// headers) are served from memory instead of one request each. Concurrent
+/// reads of the same block wait for a single fetch.
+///
+/// An optional second tier keeps fetched blocks in files on a local disk,
+/// so that blocks evicted from memory (e.g. datasets larger than the memory
+/// cache that are read once per epoch) are read back from disk instead of
+/// being fetched again.
+class FileBlockCache {
+ public:
+  /// The callback executed when a block is not found in the cache. It reads
+  /// up to `buffer_size` bytes at `offset` into `buffer` and returns the bytes
+  /// read. `status` is `TF_OK` as long as the read succeeded, a short read
+  /// marks the end of the file.
+  typedef std::function<int64_t(const std::string& filename, size_t offset,
+                                size_t buffer_size, char* buffer,
+                                TF_Status* status)>
+      BlockFetcher;
+
+  /// The configuration of the disk tier, which is disabled unless both
+  /// `path` and `max_bytes` are set.
+  struct DiskOptions {
+    /// The directory under which the blocks are stored. Each cache creates
+    /// its own sub-directory, which is removed with the cache and locked with
+    /// `flock` until then. Unlocked sub-directories, i.e. left by processes
+    /// that crashed, are removed when a cache is created (not on Windows,
+    /// where they need external cleanup).
+    ///
+    /// A fetched block is written to disk by the reader that fetched it
+    /// before its read returns, which adds the time of writing up to one
+    /// block to a local file to each fetch.
+    std::string path;
+    /// The max bytes of blocks stored on disk.
+    size_t max_bytes = 0;
+
+    /// Reads `<prefix>_DISK_DIR` and `<prefix>_DISK_MAX_SIZE_MB` from the
+    /// environment, e.g. S3_READ_CACHE_DISK_DIR for the "S3_READ_CACHE"
+    /// prefix.
+    static DiskOptions FromEnv(const std::string& prefix);
+  };
+
+  FileBlockCache(size_t block_size, size_t max_bytes,
+                 BlockFetcher block_fetcher);
+
+  /// The disk tier is only used along with the memory tier, i.e. when both
+  /// `block_size` and `max_bytes` are non-zero.
+  FileBlockCache(size_t block_size, size_t max_bytes,
+                 BlockFetcher block_fetcher, DiskOptions disk_options);
+
+  ~FileBlockCache();
+
+  /// Reads `n` bytes of `filename` at `offset` into `buffer` and returns the
+  /// bytes read. `status` is set to the error of the fetcher if a block could
+  /// not be fetched, to `TF_OUT_OF_RANGE` if the file ends before `offset`,
+  /// and to `TF_OK` otherwise. Reads larger than the cache bypass it.
+  int64_t Read(const std::string& filename, size_t offset, size_t n,
+               char* buffer, TF_Status* status) ABSL_LOCKS_EXCLUDED(mu_);
+
+  /// Fetches the block of `filename` containing `offset` unless it is cached
+  /// or being fetched already. Meant to be run in the background ahead of
+  /// sequential reads, a failed fetch is retried by the next `Read`.
+  void Prefetch(const std::string& filename, size_t offset)
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  /// Removes all cached blocks of `filename`.
+  void RemoveFile(const std::string& filename) ABSL_LOCKS_EXCLUDED(mu_);
+
+  /// Removes all cached data.
+  void Flush() ABSL_LOCKS_EXCLUDED(mu_);
+
+  size_t block_size() const { return block_size_; }
+  size_t max_bytes() const { return max_bytes_; }
+
+  /// The current size in bytes of the cached blocks.
+  size_t CacheSize() const ABSL_LOCKS_EXCLUDED(mu_);
+
+  /// The current size in bytes of the blocks stored on disk.
+  size_t DiskCacheSize() const ABSL_LOCKS_EXCLUDED(disk_mu_);
+
+  /// Returns true if the cache is enabled, otherwise every read is passed
+  /// through to the fetcher.
+  bool IsCacheEnabled() const { return block_size_ > 0 && max_bytes_ > 0; }
+
+ private:
+  typedef std::pair<std::string, size_t> Key;
+
+  enum class FetchState {
+    CREATED,
+    FETCHING,
+    FINISHED,
+    ERROR,
+  };
+
+  /// A block of a file. `lru_iterator`, `size` and `evicted` are guarded by
+  /// the cache wide `mu_`, `state` by the block's `mu`. `data` is only
+  /// accessed once the state is FINISHED and never modified afterwards. The
+  /// cache wide `mu_` is never acquired while holding a block's `mu`.
+  struct Block {
+    std::vector<char> data;
+    std::list<Key>::iterator lru_iterator;
+    /// The bytes accounted in the cache size once the block is fetched.
+    size_t size = 0;
+    bool evicted = false;
+    absl::Mutex mu;
+    FetchState state ABSL_GUARDED_BY(mu) = FetchState::CREATED;
+    absl::CondVar cond_var;
+  };
+
+  typedef std::map<Key, std::shared_ptr<Block>> BlockMap;
+
+  /// A block stored in the file `id` of the disk tier's directory.
+  struct DiskBlock {
+    uint64_t id;
+    size_t size;
+    std::list<Key>::iterator lru_iterator;
+  };
+
+  typedef std::map<Key, DiskBlock> DiskBlockMap;
+
+  /// Looks up the block of `key`, inserting an empty one if necessary.
+  std::shared_ptr<Block> Lookup(const Key& key) ABSL_LOCKS_EXCLUDED(mu_);
+
+  /// Fetches the block unless it has been fetched already.
+  void MaybeFetch(const Key& key, const std::shared_ptr<Block>& block,
+                  TF_Status* status) ABSL_LOCKS_EXCLUDED(mu_);
+
+  /// Accounts a fetched block and moves it to the front of the LRU list.
+  void UpdateLRU(const Key& key, const std::shared_ptr<Block>& block,
+                 bool fetched) ABSL_LOCKS_EXCLUDED(mu_);
+
+  /// Evicts least recently used blocks until the cache fits `max_bytes_`.
+  void Trim() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  void RemoveBlock(BlockMap::iterator entry) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  bool IsDiskCacheEnabled() const { return disk_max_bytes_ > 0; }
+
+  std::string DiskBlockPath(uint64_t id) const;
+
+  /// Reads the block of `key` from disk into `data`, returns false if it is
+  /// not stored on disk or can not be read.
+  bool ReadFromDisk(const Key& key, std::vector<char>* data)
+      ABSL_LOCKS_EXCLUDED(disk_mu_);
+
+  /// Ends a fetch started when `removals_` was `removals`, returns true if
+  /// the file of `key` was removed from the cache since, i.e. the fetched
+  /// block may be stale.
+  bool FinishDiskFetch(const Key& key, uint64_t removals)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  /// Stores the fetched block on disk unless its file was removed from the
+  /// cache since `removals` were counted at the start of the fetch, and
+  /// evicts the least recently used blocks from disk until the disk tier
+  /// fits `disk_max_bytes_`. Ends the fetch in any case.
+  void WriteToDisk(const Key& key, const std::vector<char>& data,
+                   uint64_t removals) ABSL_LOCKS_EXCLUDED(mu_, disk_mu_);
+
+  /// Removes the entry from the disk tier, the file is appended to `paths`
+  /// to be deleted once `disk_mu_` is released.
+  void RemoveDiskBlock(DiskBlockMap::iterator entry,
+                       std::vector<std::string>* paths)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(disk_mu_);
+
+  const size_t block_size_;
+  const size_t max_bytes_;
+  const BlockFetcher block_fetcher_;
+
+  mutable absl::Mutex mu_;
+  BlockMap block_map_ ABSL_GUARDED_BY(mu_);
+  /// The front of the list is the most recently used block.
+  std::list<Key> lru_list_ ABSL_GUARDED_BY(mu_);
+  size_t cache_size_ ABSL_GUARDED_BY(mu_) = 0;
+  /// The number of calls to `RemoveFile` and `Flush`, blocks fetched while
+  /// their file is removed may be stale and are not stored on disk.
+  uint64_t removals_ ABSL_GUARDED_BY(mu_) = 0;
+  /// `removals_` at the start of each fetch in flight for the disk tier.
+  std::multiset<uint64_t> disk_fetches_ ABSL_GUARDED_BY(mu_);
+  /// `removals_` at the last removal of each file, kept while a fetch in
+  /// flight started before it.
+  std::map<std::string, uint64_t> file_removals_ ABSL_GUARDED_BY(mu_);
+  /// `removals_` at the last `Flush`.
+  uint64_t flush_removals_ ABSL_GUARDED_BY(mu_) = 0;
+
+  /// The private directory of the disk tier and its max size, which is 0 if
+  /// the disk tier is disabled. `disk_mu_` may be acquired while holding
+  /// `mu_`, but not the other way around. No file is read or written while
+  /// holding either.
+  std::string disk_path_;
+  size_t disk_max_bytes_ = 0;
+  /// The descriptor of the directory's lock file, not used on Windows.
+  int disk_lock_fd_ = -1;
+  mutable absl::Mutex disk_mu_ ABSL_ACQUIRED_AFTER(mu_);
+  DiskBlockMap disk_block_map_ ABSL_GUARDED_BY(disk_mu_);
+  /// The front of the list is the most recently used block.
+  std::list<Key> disk_lru_list_ ABSL_GUARDED_BY(disk_mu_);
+  size_t disk_cache_size_ ABSL_GUARDED_BY(disk_mu_) = 0;
+  uint64_t next_disk_id_ ABSL_GUARDED_BY(disk_mu_) = 0;
+};
+
+}  // namespace io
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_IO_CORE_FILESYSTEMS_FILE_BLOCK_CACHE_H_
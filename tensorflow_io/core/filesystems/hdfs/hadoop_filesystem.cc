@@ -16,23 +16,28 @@ limitations under the License.
 #include <stdlib.h>
 #include <string.h>
 
+#include <chrono>
 #include <functional>
+#include <future>
 #include <iostream>
 #include <map>
 #include <memory>
 #include <sstream>
 #include <string>
+#include <vector>
 #if defined(_MSC_VER)
 #include <Windows.h>
 #else
 #include <dlfcn.h>
 #endif
 
+#include "absl/strings/numbers.h"
 #include "absl/strings/str_cat.h"
 #include "absl/synchronization/mutex.h"
 #include "hdfs/hdfs.h"
 #include "tensorflow/c/logging.h"
 #include "tensorflow/c/tf_status.h"
+#include "tensorflow_io/core/filesystems/file_block_cache.h"
 #include "tensorflow_io/core/filesystems/filesystem_plugins.h"
 
 namespace tensorflow {
@@ -163,6 +168,8 @@ class LibHDFS {
   std::function<hdfsFS(hdfsBuilder*)> hdfsBuilderConnect;
   std::function<hdfsBuilder*()> hdfsNewBuilder;
   std::function<void(hdfsBuilder*, const char*)> hdfsBuilderSetNameNode;
+  std::function<int(hdfsBuilder*, const char*, const char*)>
+      hdfsBuilderConfSetStr;
   std::function<int(const char*, char**)> hdfsConfGetStr;
   std::function<int(hdfsFS, hdfsFile)> hdfsCloseFile;
   std::function<tSize(hdfsFS, hdfsFile, tOffset, void*, tSize)> hdfsPread;
@@ -196,6 +203,7 @@ class LibHDFS {
       BIND_HDFS_FUNC(hdfsBuilderConnect);
       BIND_HDFS_FUNC(hdfsNewBuilder);
       BIND_HDFS_FUNC(hdfsBuilderSetNameNode);
+      BIND_HDFS_FUNC(hdfsBuilderConfSetStr);
       BIND_HDFS_FUNC(hdfsConfGetStr);
       BIND_HDFS_FUNC(hdfsCloseFile);
       BIND_HDFS_FUNC(hdfsPread);
@@ -253,9 +261,28 @@ class LibHDFS {
   void* handle_;
 };
 
+// Reads an environment variable in MB, or returns the default value.
+size_t GetEnvMB(const char* name, size_t default_value) {
+  const char* value = getenv(name);
+  size_t mb = 0;
+  if (value != nullptr && absl::SimpleAtoi(value, &mb)) {
+    return mb * 1024 * 1024;
+  }
+  return default_value;
+}
+
 // SECTION 1. Implementation for `TF_RandomAccessFile`
 // ----------------------------------------------------------------------------
 namespace tf_random_access_file {
+
+// Data read ahead by the background prefetch of a file.
+typedef struct Prefetched {
+  TF_Code code = TF_OK;
+  std::string message;
+  uint64_t offset = 0;
+  std::vector<char> data;
+} Prefetched;
+
 typedef struct HDFSRandomAccessFile {
   std::string path;
   std::string hdfs_path;
@@ -264,14 +291,34 @@ typedef struct HDFSRandomAccessFile {
   absl::Mutex mu;
   hdfsFile handle ABSL_GUARDED_BY(mu);
   bool disable_eof_retried;
+  // The block cache shared by the files of the filesystem, or `nullptr` if it
+  // is disabled.
+  FileBlockCache* file_block_cache;
+  // Size of the read-ahead buffer (HDFS_READ_AHEAD_SIZE_MB, 0 disables it).
+  // With the block cache, sequential reads prefetch this many bytes of blocks
+  // instead.
+  size_t read_ahead_size;
+  // Reads at most `read_ahead_size` are served from `buffer`, which holds the
+  // data at `buffer_offset`. Sequential reads fill the following buffer in
+  // the background.
+  absl::Mutex read_ahead_mu;
+  uint64_t buffer_offset ABSL_GUARDED_BY(read_ahead_mu);
+  std::vector<char> buffer ABSL_GUARDED_BY(read_ahead_mu);
+  uint64_t next_offset ABSL_GUARDED_BY(read_ahead_mu);
+  std::future<Prefetched> prefetch ABSL_GUARDED_BY(read_ahead_mu);
   HDFSRandomAccessFile(std::string path, std::string hdfs_path, hdfsFS fs,
-                       LibHDFS* libhdfs, hdfsFile handle)
+                       LibHDFS* libhdfs, hdfsFile handle,
+                       FileBlockCache* file_block_cache)
       : path(std::move(path)),
         hdfs_path(std::move(hdfs_path)),
         fs(fs),
         libhdfs(libhdfs),
         mu(),
-        handle(handle) {
+        handle(handle),
+        file_block_cache(file_block_cache),
+        read_ahead_size(GetEnvMB("HDFS_READ_AHEAD_SIZE_MB", 0)),
+        buffer_offset(0),
+        next_offset(0) {
     const char* disable_eof_retried_str =
         getenv("HDFS_DISABLE_READ_EOF_RETRIED");
     if (disable_eof_retried_str && disable_eof_retried_str[0] == '1') {
@@ -284,6 +331,11 @@ typedef struct HDFSRandomAccessFile {
 
 void Cleanup(TF_RandomAccessFile* file) {
   auto hdfs_file = static_cast<HDFSRandomAccessFile*>(file->plugin_file);
+  {
+    // The prefetch reads with the handle.
+    absl::MutexLock l(&hdfs_file->read_ahead_mu);
+    if (hdfs_file->prefetch.valid()) hdfs_file->prefetch.wait();
+  }
   {
     absl::MutexLock l(&hdfs_file->mu);
     if (hdfs_file->handle != nullptr) {
@@ -293,9 +345,8 @@ void Cleanup(TF_RandomAccessFile* file) {
   delete hdfs_file;
 }
 
-int64_t Read(const TF_RandomAccessFile* file, uint64_t offset, size_t n,
-             char* buffer, TF_Status* status) {
-  auto hdfs_file = static_cast<HDFSRandomAccessFile*>(file->plugin_file);
+static int64_t ReadHDFS(HDFSRandomAccessFile* hdfs_file, uint64_t offset,
+                        size_t n, char* buffer, TF_Status* status) {
   auto libhdfs = hdfs_file->libhdfs;
   auto fs = hdfs_file->fs;
   auto hdfs_path = hdfs_file->hdfs_path.c_str();
@@ -354,6 +405,125 @@ int64_t Read(const TF_RandomAccessFile* file, uint64_t offset, size_t n,
   return read;
 }
 
+// Reads up to `read_ahead_size` bytes at `offset` in the background.
+static std::future<Prefetched> StartPrefetch(HDFSRandomAccessFile* hdfs_file,
+                                             uint64_t offset) {
+  return std::async(std::launch::async, [hdfs_file, offset]() {
+    Prefetched prefetched;
+    prefetched.offset = offset;
+    prefetched.data.resize(hdfs_file->read_ahead_size);
+    TF_Status* status = TF_NewStatus();
+    int64_t read = ReadHDFS(hdfs_file, offset, prefetched.data.size(),
+                            prefetched.data.data(), status);
+    prefetched.code = TF_GetCode(status);
+    prefetched.message = TF_Message(status);
+    TF_DeleteStatus(status);
+    prefetched.data.resize((std::max)(read, static_cast<int64_t>(0)));
+    return prefetched;
+  });
+}
+
+static int64_t ReadBuffered(HDFSRandomAccessFile* hdfs_file, uint64_t offset,
+                            size_t n, char* buffer, TF_Status* status) {
+  absl::MutexLock l(&hdfs_file->read_ahead_mu);
+  const bool sequential = offset == hdfs_file->next_offset;
+  int64_t read = 0;
+  while (n > 0) {
+    uint64_t buffer_end = hdfs_file->buffer_offset + hdfs_file->buffer.size();
+    if (offset >= hdfs_file->buffer_offset && offset < buffer_end) {
+      size_t bytes = (std::min)(n, static_cast<size_t>(buffer_end - offset));
+      const char* src =
+          hdfs_file->buffer.data() + (offset - hdfs_file->buffer_offset);
+      memcpy(buffer, src, bytes);
+      buffer += bytes;
+      offset += bytes;
+      n -= bytes;
+      read += bytes;
+      continue;
+    }
+    if (hdfs_file->prefetch.valid()) {
+      Prefetched prefetched = hdfs_file->prefetch.get();
+      if (prefetched.code == TF_OK && prefetched.offset == offset) {
+        hdfs_file->buffer_offset = prefetched.offset;
+        hdfs_file->buffer = std::move(prefetched.data);
+        continue;
+      }
+      // Errors, the end of the file, and random reads are left to a
+      // synchronous read, which also retries at the end of the file.
+    }
+    hdfs_file->buffer.resize(hdfs_file->read_ahead_size);
+    int64_t r = ReadHDFS(hdfs_file, offset, hdfs_file->buffer.size(),
+                         hdfs_file->buffer.data(), status);
+    hdfs_file->buffer_offset = offset;
+    hdfs_file->buffer.resize((std::max)(r, static_cast<int64_t>(0)));
+    if (TF_GetCode(status) != TF_OK && TF_GetCode(status) != TF_OUT_OF_RANGE) {
+      return -1;
+    }
+    if (r <= 0) {
+      TF_SetStatus(status, TF_OUT_OF_RANGE, "Read less bytes than requested");
+      break;
+    }
+    TF_SetStatus(status, TF_OK, "");
+  }
+  hdfs_file->next_offset = offset;
+  if (n > 0) return read;
+
+  // Fill the next buffer while the current one is consumed.
+  uint64_t buffer_end = hdfs_file->buffer_offset + hdfs_file->buffer.size();
+  if (sequential && !hdfs_file->prefetch.valid() &&
+      hdfs_file->buffer.size() == hdfs_file->read_ahead_size) {
+    hdfs_file->prefetch = StartPrefetch(hdfs_file, buffer_end);
+  }
+  TF_SetStatus(status, TF_OK, "");
+  return read;
+}
+
+// Prefetches the blocks of `read_ahead_size` bytes following a sequential
+// read into the block cache, one prefetch at a time.
+static void MaybePrefetchBlocks(HDFSRandomAccessFile* hdfs_file,
+                                uint64_t offset, uint64_t end) {
+  absl::MutexLock l(&hdfs_file->read_ahead_mu);
+  const bool sequential = offset == hdfs_file->next_offset;
+  hdfs_file->next_offset = end;
+  if (!sequential || hdfs_file->read_ahead_size == 0) return;
+  if (hdfs_file->prefetch.valid()) {
+    if (hdfs_file->prefetch.wait_for(std::chrono::seconds(0)) !=
+        std::future_status::ready)
+      return;
+    hdfs_file->prefetch.get();
+  }
+  FileBlockCache* cache = hdfs_file->file_block_cache;
+  std::string path = hdfs_file->path;
+  uint64_t until = end + hdfs_file->read_ahead_size;
+  hdfs_file->prefetch =
+      std::async(std::launch::async, [cache, path, end, until]() {
+        for (uint64_t pos = end; pos < until; pos += cache->block_size()) {
+          cache->Prefetch(path, pos);
+        }
+        return Prefetched();
+      });
+}
+
+int64_t Read(const TF_RandomAccessFile* file, uint64_t offset, size_t n,
+             char* buffer, TF_Status* status) {
+  auto hdfs_file = static_cast<HDFSRandomAccessFile*>(file->plugin_file);
+  FileBlockCache* cache = hdfs_file->file_block_cache;
+  if (cache != nullptr && n <= cache->max_bytes()) {
+    int64_t read = cache->Read(hdfs_file->path, offset, n, buffer, status);
+    if (TF_GetCode(status) != TF_OK && TF_GetCode(status) != TF_OUT_OF_RANGE)
+      return -1;
+    if (static_cast<size_t>(read) < n) {
+      TF_SetStatus(status, TF_OUT_OF_RANGE, "Read less bytes than requested");
+      return read;
+    }
+    MaybePrefetchBlocks(hdfs_file, offset, offset + read);
+    return read;
+  }
+  if (cache == nullptr && n > 0 && n < hdfs_file->read_ahead_size)
+    return ReadBuffered(hdfs_file, offset, n, buffer, status);
+  return ReadHDFS(hdfs_file, offset, n, buffer, status);
+}
+
 }  // namespace tf_random_access_file
 
 // SECTION 2. Implementation for `TF_WritableFile`
@@ -468,19 +638,53 @@ typedef struct HadoopFileSystemImplementation {
   absl::Mutex connection_cache_lock;
   std::map<std::string, hdfsFS> connection_cache
       ABSL_GUARDED_BY(connection_cache_lock);
+  // Block cache shared by the random access files, enabled by a non zero
+  // HDFS_READ_CACHE_MAX_SIZE_MB, which keeps fetched blocks on local disk as
+  // well when HDFS_READ_CACHE_DISK_DIR and HDFS_READ_CACHE_DISK_MAX_SIZE_MB
+  // are set. Files are assumed not to be appended to while they are read
+  // through the cache.
+  std::unique_ptr<FileBlockCache> file_block_cache;
   HadoopFileSystemImplementation(TF_Status* status);
   ~HadoopFileSystemImplementation() {
+    // The cache is released before the library it fetches with.
+    file_block_cache.reset(nullptr);
     if (libhdfs != nullptr) {
       delete libhdfs;
     }
   }
 } HadoopFileSystemImplementation;
 
+static int64_t FetchBlock(HadoopFileSystemImplementation* hadoop_file,
+                          const std::string& path, size_t offset, size_t n,
+                          char* buffer, TF_Status* status);
+
 HadoopFileSystemImplementation::HadoopFileSystemImplementation(
     TF_Status* status)
     : libhdfs(new LibHDFS(status)),
       connection_cache_lock(),
-      connection_cache() {}
+      connection_cache(),
+      file_block_cache(nullptr) {
+  size_t block_size =
+      GetEnvMB("HDFS_READ_CACHE_BLOCK_SIZE_MB", 16 * 1024 * 1024);
+  size_t max_size = GetEnvMB("HDFS_READ_CACHE_MAX_SIZE_MB", 0);
+  if (block_size > 0 && max_size > 0) {
+    file_block_cache.reset(new FileBlockCache(
+        block_size, max_size,
+        [this](const std::string& path, size_t offset, size_t n, char* buffer,
+               TF_Status* status) {
+          return FetchBlock(this, path, offset, n, buffer, status);
+        },
+        FileBlockCache::DiskOptions::FromEnv("HDFS_READ_CACHE")));
+  }
+}
+
+// Drops the cached blocks of a file that is modified or removed.
+static void InvalidateCachedFile(HadoopFileSystemImplementation* hadoop_file,
+                                 const std::string& path) {
+  if (hadoop_file->file_block_cache != nullptr) {
+    hadoop_file->file_block_cache->RemoveFile(path);
+  }
+}
 
 typedef struct HadoopFileSystem {
   absl::Mutex mu;
@@ -551,6 +755,23 @@ hdfsFS Connect(tf_hdfs_filesystem::HadoopFileSystemImplementation* hadoop_file,
     hdfsBuilder* builder = libhdfs->hdfsNewBuilder();
     libhdfs->hdfsBuilderSetNameNode(
         builder, namenode.empty() ? nullptr : namenode.c_str());
+    // Hedged reads start a second read from another replica of a block when
+    // the first one is slower than the threshold, and use the faster one.
+    const char* hedged_read_threshold = getenv("HDFS_HEDGED_READ_THRESHOLD_MS");
+    if (hedged_read_threshold != nullptr && hedged_read_threshold[0] != '\0') {
+      const char* hedged_read_threadpool_size =
+          getenv("HDFS_HEDGED_READ_THREADPOOL_SIZE");
+      if (hedged_read_threadpool_size == nullptr ||
+          hedged_read_threadpool_size[0] == '\0') {
+        hedged_read_threadpool_size = "16";
+      }
+      libhdfs->hdfsBuilderConfSetStr(builder,
+                                     "dfs.client.hedged.read.threshold.millis",
+                                     hedged_read_threshold);
+      libhdfs->hdfsBuilderConfSetStr(
+          builder, "dfs.client.hedged.read.threadpool.size",
+          hedged_read_threadpool_size);
+    }
     auto cacheFs = libhdfs->hdfsBuilderConnect(builder);
     if (cacheFs == nullptr) {
       TF_SetStatusFromIOError(status, TF_ABORTED, strerror(errno));
@@ -563,6 +784,50 @@ hdfsFS Connect(tf_hdfs_filesystem::HadoopFileSystemImplementation* hadoop_file,
   return fs;
 }
 
+// Reads a block for the cache with a handle of its own, so that blocks of a
+// file are fetched independently of the handle of any open file.
+static int64_t FetchBlock(HadoopFileSystemImplementation* hadoop_file,
+                          const std::string& path, size_t offset, size_t n,
+                          char* buffer, TF_Status* status) {
+  auto libhdfs = hadoop_file->libhdfs;
+  auto fs = Connect(hadoop_file, path, status);
+  if (TF_GetCode(status) != TF_OK) return -1;
+
+  std::string scheme, namenode, hdfs_path;
+  ParseHadoopPath(path, &scheme, &namenode, &hdfs_path);
+
+  auto handle = libhdfs->hdfsOpenFile(fs, hdfs_path.c_str(), O_RDONLY, 0, 0, 0);
+  if (handle == nullptr) {
+    TF_SetStatusFromIOError(status, errno, path.c_str());
+    return -1;
+  }
+  int64_t read = 0;
+  while (n > 0) {
+    size_t read_n =
+        (std::min)(n, static_cast<size_t>(std::numeric_limits<int>::max() - 2));
+    int64_t r = libhdfs->hdfsPread(fs, handle, static_cast<tOffset>(offset),
+                                   buffer, static_cast<tSize>(read_n));
+    if (r > 0) {
+      buffer += r;
+      n -= r;
+      offset += r;
+      read += r;
+    } else if (r == 0) {
+      // A short read marks the end of the file for the cache.
+      break;
+    } else if (errno == EINTR || errno == EAGAIN) {
+      // hdfsPread may return EINTR too. Just retry.
+    } else {
+      TF_SetStatusFromIOError(status, errno, path.c_str());
+      libhdfs->hdfsCloseFile(fs, handle);
+      return -1;
+    }
+  }
+  libhdfs->hdfsCloseFile(fs, handle);
+  TF_SetStatus(status, TF_OK, "");
+  return read;
+}
+
 void Init(TF_Filesystem* filesystem, TF_Status* status) {
   filesystem->plugin_filesystem = new HadoopFileSystem();
   TF_SetStatus(status, TF_OK, "");
@@ -593,7 +858,8 @@ void NewRandomAccessFile(const TF_Filesystem* filesystem, const char* path,
   if (handle == nullptr) return TF_SetStatusFromIOError(status, errno, path);
 
   file->plugin_file = new tf_random_access_file::HDFSRandomAccessFile(
-      path, hdfs_path, fs, libhdfs, handle);
+      path, hdfs_path, fs, libhdfs, handle,
+      hadoop_file->file_block_cache.get());
   TF_SetStatus(status, TF_OK, "");
 }
 
@@ -609,6 +875,8 @@ void NewWritableFile(const TF_Filesystem* filesystem, const char* path,
   auto fs = Connect(hadoop_file, path, status);
   if (TF_GetCode(status) != TF_OK) return;
 
+  InvalidateCachedFile(hadoop_file, path);
+
   std::string scheme, namenode, hdfs_path;
   ParseHadoopPath(path, &scheme, &namenode, &hdfs_path);
 
@@ -632,6 +900,8 @@ void NewAppendableFile(const TF_Filesystem* filesystem, const char* path,
   auto fs = Connect(hadoop_file, path, status);
   if (TF_GetCode(status) != TF_OK) return;
 
+  InvalidateCachedFile(hadoop_file, path);
+
   std::string scheme, namenode, hdfs_path;
   ParseHadoopPath(path, &scheme, &namenode, &hdfs_path);
 
@@ -763,6 +1033,8 @@ void DeleteFile(const TF_Filesystem* filesystem, const char* path,
   auto fs = Connect(hadoop_file, path, status);
   if (TF_GetCode(status) != TF_OK) return;
 
+  InvalidateCachedFile(hadoop_file, path);
+
   std::string scheme, namenode, hdfs_path;
   ParseHadoopPath(path, &scheme, &namenode, &hdfs_path);
 
@@ -852,6 +1124,9 @@ void RenameFile(const TF_Filesystem* filesystem, const char* src,
   auto fs = Connect(hadoop_file, src, status);
   if (TF_GetCode(status) != TF_OK) return;
 
+  InvalidateCachedFile(hadoop_file, src);
+  InvalidateCachedFile(hadoop_file, dst);
+
   std::string scheme, namenode, hdfs_path_src, hdfs_path_dst;
   ParseHadoopPath(src, &scheme, &namenode, &hdfs_path_src);
   ParseHadoopPath(dst, &scheme, &namenode, &hdfs_path_dst);
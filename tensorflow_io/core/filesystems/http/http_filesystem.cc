@@ -16,14 +16,19 @@ limitations under the License.
 #include <curl/curl.h>
 
 #include <iostream>
+#include <memory>
 #include <string>
+#include <thread>
 #include <unordered_map>
+#include <vector>
 
 #include "absl/strings/ascii.h"
+#include "absl/strings/numbers.h"
 #include "absl/strings/str_cat.h"
 #include "absl/synchronization/mutex.h"
 #include "tensorflow/c/logging.h"
 #include "tensorflow/c/tf_status.h"
+#include "tensorflow_io/core/filesystems/file_block_cache.h"
 #include "tensorflow_io/core/filesystems/filesystem_plugins.h"
 
 namespace tensorflow {
@@ -44,14 +49,78 @@ void CurlInitialize() {
   }
 }
 
+// The maximum number of idle curl handles kept for reuse.
+constexpr size_t kMaxIdleHandles = 32;
+
+// A pool of curl handles shared by all requests of the filesystem.
+// A released handle keeps its open connections, DNS and TLS session caches,
+// so the next request to the same host skips the TCP/TLS handshake.
+class CurlHandlePool {
+ public:
+  CurlHandlePool() {}
+  ~CurlHandlePool() {
+    for (CURL* curl : idle_) {
+      curl_easy_cleanup(curl);
+    }
+  }
+
+  CURL* Acquire() {
+    {
+      absl::MutexLock l(&mu_);
+      if (!idle_.empty()) {
+        CURL* curl = idle_.back();
+        idle_.pop_back();
+        return curl;
+      }
+    }
+    CurlInitialize();
+    return curl_easy_init();
+  }
+
+  void Release(CURL* curl) {
+    // Options are reset, the connection cache is kept
+    curl_easy_reset(curl);
+    {
+      absl::MutexLock l(&mu_);
+      if (idle_.size() < kMaxIdleHandles) {
+        idle_.push_back(curl);
+        return;
+      }
+    }
+    curl_easy_cleanup(curl);
+  }
+
+ private:
+  absl::Mutex mu_;
+  std::vector<CURL*> idle_ ABSL_GUARDED_BY(mu_);
+};
+
 class CurlHttpRequest {
  public:
-  CurlHttpRequest() {}
-  ~CurlHttpRequest() {}
+  explicit CurlHttpRequest(CurlHandlePool* pool = nullptr) : pool_(pool) {}
+  ~CurlHttpRequest() {
+    if (curl_headers_ != nullptr) {
+      curl_slist_free_all(curl_headers_);
+    }
+    if (resolve_list_ != nullptr) {
+      curl_slist_free_all(resolve_list_);
+    }
+    if (curl_ != nullptr) {
+      if (pool_ != nullptr) {
+        pool_->Release(curl_);
+      } else {
+        curl_easy_cleanup(curl_);
+      }
+    }
+  }
 
   void Initialize(TF_Status* status) {
-    CurlInitialize();
-    curl_ = curl_easy_init();
+    if (pool_ != nullptr) {
+      curl_ = pool_->Acquire();
+    } else {
+      CurlInitialize();
+      curl_ = curl_easy_init();
+    }
     if (curl_ == nullptr) {
       TF_SetStatus(status, TF_INTERNAL, "Couldn't initialize a curl session.");
       return;
@@ -88,6 +157,13 @@ class CurlHttpRequest {
       return;
     }
 
+    if ((s = curl_easy_setopt(curl_, CURLOPT_TCP_KEEPALIVE, 1L)) != CURLE_OK) {
+      std::string error_message =
+          absl::StrCat("Unable to set CURLOPT_TCP_KEEPALIVE: ", s);
+      TF_SetStatus(status, TF_INTERNAL, error_message.c_str());
+      return;
+    }
+
     // Do not use signals for timeouts - does not work in multi-threaded
     // programs.
     if ((s = curl_easy_setopt(curl_, CURLOPT_NOSIGNAL, 1L)) != CURLE_OK) {
@@ -391,6 +467,8 @@ class CurlHttpRequest {
   }
 
  private:
+  CurlHandlePool* pool_;
+
   std::vector<char> response_buffer_;
 
   struct DirectResponseState {
@@ -543,9 +621,157 @@ class CurlHttpRequest {
   }
 };
 
+// Reads up to n bytes of the uri at offset with a single range request.
+// A short read is not an error, it marks the end of the file.
+int64_t ReadRange(CurlHandlePool* pool, const std::string& uri,
+                  uint64_t offset, size_t n, char* buffer, TF_Status* status) {
+  CurlHttpRequest request(pool);
+  request.Initialize(status);
+  if (TF_GetCode(status) != TF_OK) {
+    return -1;
+  }
+  request.SetUri(uri, status);
+  if (TF_GetCode(status) != TF_OK) {
+    return -1;
+  }
+  request.SetRange(offset, offset + n - 1, status);
+  if (TF_GetCode(status) != TF_OK) {
+    return -1;
+  }
+  request.SetResultBufferDirect(buffer, n, status);
+  if (TF_GetCode(status) != TF_OK) {
+    return -1;
+  }
+  request.Send(status);
+  if (TF_GetCode(status) != TF_OK) {
+    return -1;
+  }
+  return request.GetResultBufferDirectBytesTransferred();
+}
+
+// Reads the environment variable in MB, or returns the default value.
+size_t GetEnvMB(const char* name, size_t default_value) {
+  const char* value = std::getenv(name);
+  size_t mb = 0;
+  if (value != nullptr && absl::SimpleAtoi(value, &mb)) {
+    return mb * 1024 * 1024;
+  }
+  return default_value;
+}
+
+// The state shared by all files of the filesystem.
+//
+// Reads smaller than the parallel chunk size go through an LRU block cache
+// (HTTP_READ_CACHE_BLOCK_SIZE_MB, HTTP_READ_CACHE_MAX_SIZE_MB). The cache is
+// off by default as cached blocks are not revalidated against the server, so
+// it should only be enabled for urls whose content does not change. Larger
+// reads are split into up to HTTP_READ_PARALLEL_REQUESTS concurrent range
+// requests of HTTP_READ_PARALLEL_CHUNK_SIZE_MB each. Fetched blocks are also
+// kept on local disk under HTTP_READ_CACHE_DISK_DIR, bounded by
+// HTTP_READ_CACHE_DISK_MAX_SIZE_MB.
+class HTTPFilesystem {
+ public:
+  HTTPFilesystem()
+      : parallel_chunk_size_(
+            GetEnvMB("HTTP_READ_PARALLEL_CHUNK_SIZE_MB", 8 * 1024 * 1024)),
+        parallel_requests_(8) {
+    const char* requests = std::getenv("HTTP_READ_PARALLEL_REQUESTS");
+    if (requests != nullptr) {
+      absl::SimpleAtoi(requests, &parallel_requests_);
+    }
+    cache_.reset(new FileBlockCache(
+        GetEnvMB("HTTP_READ_CACHE_BLOCK_SIZE_MB", 4 * 1024 * 1024),
+        GetEnvMB("HTTP_READ_CACHE_MAX_SIZE_MB", 0),
+        [this](const std::string& uri, size_t offset, size_t n, char* buffer,
+               TF_Status* status) {
+          return ReadRange(&pool_, uri, offset, n, buffer, status);
+        },
+        FileBlockCache::DiskOptions::FromEnv("HTTP_READ_CACHE")));
+  }
+
+  CurlHandlePool* pool() { return &pool_; }
+
+  // Reads n bytes at offset, a short read sets TF_OUT_OF_RANGE.
+  int64_t Read(const std::string& uri, uint64_t offset, size_t n,
+               char* buffer, TF_Status* status) {
+    int64_t bytes;
+    if (parallel_requests_ > 1 && parallel_chunk_size_ > 0 &&
+        n >= 2 * parallel_chunk_size_) {
+      bytes = ReadParallel(uri, offset, n, buffer, status);
+    } else if (cache_->IsCacheEnabled()) {
+      bytes = cache_->Read(uri, offset, n, buffer, status);
+    } else {
+      bytes = ReadRange(&pool_, uri, offset, n, buffer, status);
+    }
+    if (TF_GetCode(status) != TF_OK && TF_GetCode(status) != TF_OUT_OF_RANGE) {
+      return 0;
+    }
+    if (bytes < static_cast<int64_t>(n)) {
+      TF_SetStatus(status, TF_OUT_OF_RANGE, "EOF reached");
+      return bytes;
+    }
+    TF_SetStatus(status, TF_OK, "");
+    return bytes;
+  }
+
+ private:
+  // Reads the chunks of [offset, offset + n) with concurrent range requests,
+  // the bytes read end at the first short chunk.
+  int64_t ReadParallel(const std::string& uri, uint64_t offset, size_t n,
+                       char* buffer, TF_Status* status) {
+    const size_t chunks =
+        (n + parallel_chunk_size_ - 1) / parallel_chunk_size_;
+    std::vector<int64_t> bytes(chunks, 0);
+    std::vector<std::unique_ptr<TF_Status, decltype(&TF_DeleteStatus)>>
+        statuses;
+    for (size_t i = 0; i < chunks; i++) {
+      statuses.emplace_back(TF_NewStatus(), TF_DeleteStatus);
+    }
+    auto read_chunks = [&](size_t first) {
+      for (size_t i = first; i < chunks; i += parallel_requests_) {
+        const size_t begin = i * parallel_chunk_size_;
+        const size_t size = std::min(parallel_chunk_size_, n - begin);
+        bytes[i] = ReadRange(&pool_, uri, offset + begin, size, buffer + begin,
+                             statuses[i].get());
+      }
+    };
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < std::min(chunks, parallel_requests_); i++) {
+      threads.emplace_back(read_chunks, i);
+    }
+    read_chunks(0);
+    for (auto& thread : threads) {
+      thread.join();
+    }
+
+    int64_t total = 0;
+    for (size_t i = 0; i < chunks; i++) {
+      if (TF_GetCode(statuses[i].get()) != TF_OK) {
+        TF_SetStatus(status, TF_GetCode(statuses[i].get()),
+                     TF_Message(statuses[i].get()));
+        return -1;
+      }
+      total += bytes[i];
+      const size_t size =
+          std::min(parallel_chunk_size_, n - i * parallel_chunk_size_);
+      if (bytes[i] < static_cast<int64_t>(size)) {
+        break;
+      }
+    }
+    TF_SetStatus(status, TF_OK, "");
+    return total;
+  }
+
+  size_t parallel_chunk_size_;
+  size_t parallel_requests_;
+  CurlHandlePool pool_;
+  std::unique_ptr<FileBlockCache> cache_;
+};
+
 class HTTPRandomAccessFile {
  public:
-  HTTPRandomAccessFile(const std::string& uri) : uri_(uri) {}
+  HTTPRandomAccessFile(HTTPFilesystem* http_fs, const std::string& uri)
+      : http_fs_(http_fs), uri_(uri) {}
   ~HTTPRandomAccessFile() {}
   int64_t Read(uint64_t offset, size_t n, char* buffer,
                TF_Status* status) const {
@@ -555,37 +781,11 @@ class HTTPRandomAccessFile {
       TF_SetStatus(status, TF_OK, "");
       return 0;
     }
-    CurlHttpRequest request;
-    request.Initialize(status);
-    if (TF_GetCode(status) != TF_OK) {
-      return 0;
-    }
-    request.SetUri(uri_, status);
-    if (TF_GetCode(status) != TF_OK) {
-      return 0;
-    }
-    request.SetRange(offset, offset + n - 1, status);
-    if (TF_GetCode(status) != TF_OK) {
-      return 0;
-    }
-    request.SetResultBufferDirect(buffer, n, status);
-    if (TF_GetCode(status) != TF_OK) {
-      return 0;
-    }
-    request.Send(status);
-    if (TF_GetCode(status) != TF_OK) {
-      return 0;
-    }
-    size_t bytes_to_read = request.GetResultBufferDirectBytesTransferred();
-    if (bytes_to_read < n) {
-      TF_SetStatus(status, TF_OUT_OF_RANGE, "EOF reached");
-      return bytes_to_read;
-    }
-    TF_SetStatus(status, TF_OK, "");
-    return bytes_to_read;
+    return http_fs_->Read(uri_, offset, n, buffer, status);
   }
 
  private:
+  HTTPFilesystem* http_fs_;
   std::string uri_;
 };
 
@@ -652,15 +852,20 @@ uint64_t Length(const TF_ReadOnlyMemoryRegion* region) { return 0; }
 namespace tf_http_filesystem {
 
 static void Init(TF_Filesystem* filesystem, TF_Status* status) {
+  filesystem->plugin_filesystem = new HTTPFilesystem();
   TF_SetStatus(status, TF_OK, "");
 }
 
-static void Cleanup(TF_Filesystem* filesystem) {}
+static void Cleanup(TF_Filesystem* filesystem) {
+  auto http_fs = static_cast<HTTPFilesystem*>(filesystem->plugin_filesystem);
+  delete http_fs;
+}
 
 static void NewRandomAccessFile(const TF_Filesystem* filesystem,
                                 const char* path, TF_RandomAccessFile* file,
                                 TF_Status* status) {
-  file->plugin_file = new HTTPRandomAccessFile(path);
+  auto http_fs = static_cast<HTTPFilesystem*>(filesystem->plugin_filesystem);
+  file->plugin_file = new HTTPRandomAccessFile(http_fs, path);
 
   TF_SetStatus(status, TF_OK, "");
 }
@@ -722,7 +927,8 @@ static void CopyFile(const TF_Filesystem* filesystem, const char* src,
 
 static void Stat(const TF_Filesystem* filesystem, const char* path,
                  TF_FileStatistics* stats, TF_Status* status) {
-  CurlHttpRequest request;
+  auto http_fs = static_cast<HTTPFilesystem*>(filesystem->plugin_filesystem);
+  CurlHttpRequest request(http_fs->pool());
   request.Initialize(status);
   if (TF_GetCode(status) != TF_OK) {
     return;
@@ -24,12 +24,17 @@ limitations under the License.
 #include <aws/s3/model/CompletedPart.h>
 #include <aws/s3/model/CopyObjectRequest.h>
 #include <aws/s3/model/CreateMultipartUploadRequest.h>
+#include <aws/s3/model/Delete.h>
 #include <aws/s3/model/DeleteObjectRequest.h>
+#include <aws/s3/model/DeleteObjectsRequest.h>
 #include <aws/s3/model/GetObjectRequest.h>
 #include <aws/s3/model/HeadBucketRequest.h>
 #include <aws/s3/model/HeadObjectRequest.h>
 #include <aws/s3/model/ListObjectsV2Request.h>
+#include <aws/s3/model/ObjectIdentifier.h>
+#include <aws/s3/model/PutObjectRequest.h>
 #include <aws/s3/model/UploadPartCopyRequest.h>
+#include <aws/s3/model/UploadPartRequest.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -49,7 +54,12 @@ namespace s3 {
 constexpr char kS3FileSystemAllocationTag[] = "S3FileSystemAllocation";
 constexpr char kS3ClientAllocationTag[] = "S3ClientAllocation";
 constexpr int64_t kS3TimeoutMsec = 300000;  // 5 min
-constexpr int kS3GetChildrenMaxKeys = 100;
+// The maximum page size of ListObjectsV2 and batch size of DeleteObjects.
+constexpr int kS3GetChildrenMaxKeys = 1000;
+constexpr size_t kS3DeleteObjectsMaxKeys = 1000;
+// Bounds the copies of a rename running on the executor, which leaves
+// threads to the TransferManagers sharing it.
+constexpr size_t kS3MaxParallelCopies = 16;
 
 constexpr char kExecutorTag[] = "TransferManagerExecutorAllocation";
 constexpr int kExecutorPoolSize = 25;
@@ -61,6 +71,13 @@ constexpr size_t kUploadRetries = 3;
 
 constexpr size_t kS3ReadAppendableFileBufferSize = 1024 * 1024;  // 1 MB
 
+// S3 rejects parts smaller than 5 MB, except for the last one.
+constexpr uint64_t kS3MultiPartUploadMinPartSize = 5 * 1024 * 1024;
+constexpr size_t kS3StreamingUploadBuffers = 4;
+
+constexpr size_t kS3ReadCacheBlockSize = 16 * 1024 * 1024;  // 16 MB
+constexpr size_t kS3ReadAheadBlocks = 2;
+
 static inline void TF_SetStatusFromAWSError(
     const Aws::Client::AWSError<Aws::S3::S3Errors>& error, TF_Status* status) {
   auto http_code = error.GetResponseCode();
@@ -185,6 +202,11 @@ static void GetS3Client(tf_s3_filesystem::S3File* s3_file) {
     int temp_value;
     if (absl::SimpleAtoi(getenv("S3_DISABLE_MULTI_PART_DOWNLOAD"), &temp_value))
       s3_file->use_multi_part_download = (temp_value != 1);
+    if (absl::SimpleAtoi(getenv("S3_STREAMING_UPLOAD"), &temp_value))
+      s3_file->use_streaming_upload = (temp_value == 1);
+    if (absl::SimpleAtoi(getenv("S3_STREAMING_UPLOAD_BUFFERS"), &temp_value) &&
+        temp_value > 0)
+      s3_file->streaming_upload_buffers = temp_value;
 
     const char* endpoint = getenv("S3_ENDPOINT");
     if (endpoint) s3_file->s3_client->OverrideEndpoint(endpoint);
@@ -242,8 +264,22 @@ typedef struct S3File {
   std::shared_ptr<Aws::S3::S3Client> s3_client;
   std::shared_ptr<Aws::Transfer::TransferManager> transfer_manager;
   bool use_multi_part_download;
+  // Only set if the filesystem's block cache is enabled.
+  std::shared_ptr<FileBlockCache> file_block_cache;
+  std::shared_ptr<Aws::Utils::Threading::PooledThreadExecutor> executor;
+  size_t read_ahead_blocks;
+  // Sequential access detection for read-ahead.
+  absl::Mutex read_ahead_lock;
+  uint64_t next_offset ABSL_GUARDED_BY(read_ahead_lock) = 0;
+  uint64_t prefetched_until ABSL_GUARDED_BY(read_ahead_lock) = 0;
 } S3File;
 
+// The key of an object in the block cache.
+static std::string CacheKey(const Aws::String& bucket,
+                            const Aws::String& object) {
+  return absl::StrCat(bucket.c_str(), "/", object.c_str());
+}
+
 // AWS Streams destroy the buffer (buf) passed, so creating a new
 // IOStream that retains the buffer so the calling function
 // can control it's lifecycle
@@ -324,15 +360,82 @@ static int64_t ReadS3TransferManager(S3File* s3_file, uint64_t offset, size_t n,
   return read;
 }
 
+static int64_t ReadS3(S3File* s3_file, uint64_t offset, size_t n,
+                      char* buffer, TF_Status* status) {
+  if (s3_file->use_multi_part_download)
+    return ReadS3TransferManager(s3_file, offset, n, buffer, status);
+  else
+    return ReadS3Client(s3_file, offset, n, buffer, status);
+}
+
+// Reads a block for the block cache, the end of the object is a short read
+// with `TF_OK`. Blocks are read with a single GetObject since prefetches run
+// on the executor, which the TransferManager needs for its own parts.
+static int64_t FetchBlock(std::shared_ptr<Aws::S3::S3Client> s3_client,
+                          const std::string& key, size_t offset, size_t n,
+                          char* buffer, TF_Status* status) {
+  size_t separator = key.find('/');
+  S3File s3_file{Aws::String(key.substr(0, separator).c_str()),
+                 Aws::String(key.substr(separator + 1).c_str()), s3_client,
+                 nullptr, false};
+  int64_t read = ReadS3Client(&s3_file, offset, n, buffer, status);
+  if (TF_GetCode(status) == TF_OUT_OF_RANGE) {
+    TF_SetStatus(status, TF_OK, "");
+    return std::max(read, static_cast<int64_t>(0));
+  }
+  return read;
+}
+
+// Prefetches the blocks following a sequential read ending at `end` on the
+// filesystem's executor. Random reads reset the read-ahead.
+static void MaybeReadAhead(S3File* s3_file, uint64_t offset, uint64_t end) {
+  std::shared_ptr<FileBlockCache> cache = s3_file->file_block_cache;
+  const uint64_t block_size = cache->block_size();
+  std::vector<uint64_t> blocks;
+  {
+    absl::MutexLock l(&s3_file->read_ahead_lock);
+    bool sequential = offset == s3_file->next_offset;
+    s3_file->next_offset = end;
+    if (!sequential) {
+      s3_file->prefetched_until = 0;
+      return;
+    }
+    uint64_t start = block_size * ((end + block_size - 1) / block_size);
+    uint64_t until = start + s3_file->read_ahead_blocks * block_size;
+    for (uint64_t pos = std::max(start, s3_file->prefetched_until);
+         pos < until; pos += block_size) {
+      blocks.push_back(pos);
+    }
+    s3_file->prefetched_until = std::max(until, s3_file->prefetched_until);
+  }
+  std::string key = CacheKey(s3_file->bucket, s3_file->object);
+  for (uint64_t pos : blocks) {
+    TF_VLog(2, "Prefetching s3://%s at %llu\n", key.c_str(),
+            static_cast<unsigned long long>(pos));
+    s3_file->executor->Submit(
+        [cache, key, pos]() { cache->Prefetch(key, pos); });
+  }
+}
+
 int64_t Read(const TF_RandomAccessFile* file, uint64_t offset, size_t n,
              char* buffer, TF_Status* status) {
   auto s3_file = static_cast<S3File*>(file->plugin_file);
   TF_VLog(1, "ReadFilefromS3 s3://%s/%s from %u for n: %u\n",
           s3_file->bucket.c_str(), s3_file->object.c_str(), offset, n);
-  if (s3_file->use_multi_part_download)
-    return ReadS3TransferManager(s3_file, offset, n, buffer, status);
-  else
-    return ReadS3Client(s3_file, offset, n, buffer, status);
+  if (s3_file->file_block_cache == nullptr || n == 0 ||
+      n > s3_file->file_block_cache->max_bytes())
+    return ReadS3(s3_file, offset, n, buffer, status);
+
+  int64_t read = s3_file->file_block_cache->Read(
+      CacheKey(s3_file->bucket, s3_file->object), offset, n, buffer, status);
+  if (TF_GetCode(status) != TF_OK && TF_GetCode(status) != TF_OUT_OF_RANGE)
+    return -1;
+  if (read < n) {
+    TF_SetStatus(status, TF_OUT_OF_RANGE, "Read less bytes than requested");
+  } else if (s3_file->read_ahead_blocks > 0) {
+    MaybeReadAhead(s3_file, offset, offset + read);
+  }
+  return read;
 }
 
 }  // namespace tf_random_access_file
@@ -340,6 +443,291 @@ int64_t Read(const TF_RandomAccessFile* file, uint64_t offset, size_t n,
 // SECTION 2. Implementation for `TF_WritableFile`
 // ----------------------------------------------------------------------------
 namespace tf_writable_file {
+
+// A multipart upload fed from a ring of in-memory part buffers.
+//
+// `Append` fills the current part buffer, a full part is uploaded in the
+// background while `Append` continues with the next buffer. At most
+// `max_buffers` buffers exist, `Append` blocks until an uploaded buffer is
+// returned to the ring. The multipart upload is created with the first full
+// part, an object smaller than one part is written with a single PutObject.
+// The object becomes visible on `Close`.
+class StreamingUpload {
+ public:
+  StreamingUpload(const Aws::String& bucket, const Aws::String& object,
+                  std::shared_ptr<Aws::S3::S3Client> s3_client,
+                  uint64_t part_size, size_t max_buffers)
+      : bucket_(bucket),
+        object_(object),
+        s3_client_(s3_client),
+        part_size_(std::max(part_size, kS3MultiPartUploadMinPartSize)),
+        max_buffers_(std::max(max_buffers, static_cast<size_t>(1))),
+        error_(TF_NewStatus(), TF_DeleteStatus) {}
+
+  ~StreamingUpload() {
+    WaitForParts();
+    if (!upload_id_.empty() && !completed_) {
+      TF_Log(TF_WARNING, "Aborting unfinished upload of s3://%s/%s\n",
+             bucket_.c_str(), object_.c_str());
+      Aws::S3::Model::AbortMultipartUploadRequest request;
+      request.WithBucket(bucket_).WithKey(object_).WithUploadId(upload_id_);
+      s3_client_->AbortMultipartUpload(request);
+    }
+  }
+
+  void Append(const char* data, size_t n, TF_Status* status) {
+    while (n > 0) {
+      if (current_ == nullptr) {
+        TakeBuffer(status);
+        if (TF_GetCode(status) != TF_OK) return;
+      }
+      size_t bytes = std::min(n, part_size_ - current_->size());
+      current_->insert(current_->end(), data, data + bytes);
+      position_ += bytes;
+      data += bytes;
+      n -= bytes;
+      if (current_->size() == part_size_) {
+        UploadCurrentPart(status);
+        if (TF_GetCode(status) != TF_OK) return;
+      }
+    }
+    TF_SetStatus(status, TF_OK, "");
+  }
+
+  int64_t Tell() const { return position_; }
+
+  // Waits until the parts in flight are uploaded. The data appended so far is
+  // not visible before `Close`.
+  void Sync(TF_Status* status) {
+    WaitForParts();
+    GetError(status);
+  }
+
+  void Close(TF_Status* status) {
+    if (completed_) return TF_SetStatus(status, TF_OK, "");
+    if (upload_id_.empty()) {
+      PutObject(status);
+      if (TF_GetCode(status) == TF_OK) completed_ = true;
+      return;
+    }
+    if (current_ != nullptr && !current_->empty()) {
+      UploadCurrentPart(status);
+      if (TF_GetCode(status) != TF_OK) return;
+    }
+    WaitForParts();
+    GetError(status);
+    if (TF_GetCode(status) != TF_OK) return;
+
+    Aws::S3::Model::CompletedMultipartUpload completed_multipart_upload;
+    {
+      absl::MutexLock l(&mu_);
+      // Parts have to be added in order.
+      for (const auto& etag : etags_) {
+        Aws::S3::Model::CompletedPart completed_part;
+        completed_part.SetPartNumber(etag.first);
+        completed_part.SetETag(etag.second);
+        completed_multipart_upload.AddParts(completed_part);
+      }
+    }
+    Aws::S3::Model::CompleteMultipartUploadRequest request;
+    request.WithBucket(bucket_)
+        .WithKey(object_)
+        .WithUploadId(upload_id_)
+        .WithMultipartUpload(completed_multipart_upload);
+    auto outcome = s3_client_->CompleteMultipartUpload(request);
+    if (!outcome.IsSuccess())
+      return TF_SetStatusFromAWSError(outcome.GetError(), status);
+    completed_ = true;
+    TF_SetStatus(status, TF_OK, "");
+  }
+
+ private:
+  typedef std::shared_ptr<std::vector<char>> Buffer;
+
+  typedef struct UploadPartContext : public Aws::Client::AsyncCallerContext {
+    StreamingUpload* upload;
+    int part_number;
+    Buffer buffer;
+    // The stream buffer over `buffer` has to outlive the request.
+    std::shared_ptr<Aws::Utils::Stream::PreallocatedStreamBuf> stream_buf;
+    size_t retries;
+  } UploadPartContext;
+
+  // Takes a free buffer of the ring, or allocates one while the ring is not
+  // full.
+  void TakeBuffer(TF_Status* status) {
+    absl::MutexLock l(&mu_);
+    while (free_buffers_.empty() && num_buffers_ >= max_buffers_ &&
+           TF_GetCode(error_.get()) == TF_OK) {
+      cv_.Wait(&mu_);
+    }
+    if (TF_GetCode(error_.get()) != TF_OK) {
+      return TF_SetStatus(status, TF_GetCode(error_.get()),
+                          TF_Message(error_.get()));
+    }
+    if (!free_buffers_.empty()) {
+      current_ = std::move(free_buffers_.back());
+      free_buffers_.pop_back();
+    } else {
+      current_ = std::make_shared<std::vector<char>>();
+      current_->reserve(part_size_);
+      num_buffers_++;
+    }
+    TF_SetStatus(status, TF_OK, "");
+  }
+
+  void UploadCurrentPart(TF_Status* status) {
+    if (upload_id_.empty()) {
+      TF_VLog(1, "Starting streaming upload of s3://%s/%s\n", bucket_.c_str(),
+              object_.c_str());
+      Aws::S3::Model::CreateMultipartUploadRequest request;
+      request.WithBucket(bucket_).WithKey(object_);
+      auto outcome = s3_client_->CreateMultipartUpload(request);
+      if (!outcome.IsSuccess())
+        return TF_SetStatusFromAWSError(outcome.GetError(), status);
+      upload_id_ = outcome.GetResult().GetUploadId();
+    }
+    {
+      absl::MutexLock l(&mu_);
+      num_inflight_++;
+    }
+    // S3 API partNumber starts from 1.
+    SubmitPart(next_part_number_++, std::move(current_), 0);
+    current_ = nullptr;
+    TF_SetStatus(status, TF_OK, "");
+  }
+
+  void SubmitPart(int part_number, Buffer buffer, size_t retries) {
+    auto context = Aws::MakeShared<UploadPartContext>("UploadPartContext");
+    context->upload = this;
+    context->part_number = part_number;
+    context->buffer = buffer;
+    context->stream_buf =
+        Aws::MakeShared<Aws::Utils::Stream::PreallocatedStreamBuf>(
+            "S3StreamBuf", reinterpret_cast<unsigned char*>(buffer->data()),
+            buffer->size());
+    context->retries = retries;
+
+    Aws::S3::Model::UploadPartRequest request;
+    request.WithBucket(bucket_)
+        .WithKey(object_)
+        .WithUploadId(upload_id_)
+        .WithPartNumber(part_number)
+        .WithContentLength(buffer->size());
+    request.SetBody(
+        Aws::MakeShared<tf_random_access_file::TFS3UnderlyingStream>(
+            "S3UploadStream", context->stream_buf.get()));
+
+    auto callback =
+        [](const Aws::S3::S3Client* client,
+           const Aws::S3::Model::UploadPartRequest& request,
+           const Aws::S3::Model::UploadPartOutcome& outcome,
+           const std::shared_ptr<const Aws::Client::AsyncCallerContext>&
+               context) {
+          auto part_context =
+              std::static_pointer_cast<const UploadPartContext>(context);
+          part_context->upload->OnPartUploaded(*part_context, outcome);
+        };
+    s3_client_->UploadPartAsync(request, callback, context);
+  }
+
+  void OnPartUploaded(const UploadPartContext& context,
+                      const Aws::S3::Model::UploadPartOutcome& outcome) {
+    if (!outcome.IsSuccess() && context.retries < kUploadRetries) {
+      TF_VLog(1,
+              "Retrying upload of part %d of s3://%s/%s after failure. "
+              "Current retry count: %zu\n",
+              context.part_number, bucket_.c_str(), object_.c_str(),
+              context.retries + 1);
+      return SubmitPart(context.part_number, context.buffer,
+                        context.retries + 1);
+    }
+    absl::MutexLock l(&mu_);
+    if (outcome.IsSuccess()) {
+      etags_[context.part_number] = outcome.GetResult().GetETag();
+    } else if (TF_GetCode(error_.get()) == TF_OK) {
+      TF_SetStatusFromAWSError(outcome.GetError(), error_.get());
+    }
+    context.buffer->clear();
+    free_buffers_.push_back(context.buffer);
+    num_inflight_--;
+    cv_.SignalAll();
+  }
+
+  void WaitForParts() {
+    absl::MutexLock l(&mu_);
+    while (num_inflight_ > 0) {
+      cv_.Wait(&mu_);
+    }
+  }
+
+  void GetError(TF_Status* status) {
+    absl::MutexLock l(&mu_);
+    TF_SetStatus(status, TF_GetCode(error_.get()), TF_Message(error_.get()));
+  }
+
+  void PutObject(TF_Status* status) {
+    TF_VLog(1, "PutObject s3://%s/%s\n", bucket_.c_str(), object_.c_str());
+    Buffer buffer = current_;
+    if (buffer == nullptr) buffer = std::make_shared<std::vector<char>>();
+    Aws::Utils::Stream::PreallocatedStreamBuf stream_buf(
+        reinterpret_cast<unsigned char*>(buffer->data()), buffer->size());
+    Aws::S3::Model::PutObjectRequest request;
+    request.WithBucket(bucket_).WithKey(object_).WithContentLength(
+        buffer->size());
+    request.SetBody(
+        Aws::MakeShared<tf_random_access_file::TFS3UnderlyingStream>(
+            "S3UploadStream", &stream_buf));
+    auto outcome = s3_client_->PutObject(request);
+    size_t retries = 0;
+    while (!outcome.IsSuccess() && retries++ < kUploadRetries) {
+      stream_buf.pubseekpos(0);
+      outcome = s3_client_->PutObject(request);
+    }
+    if (!outcome.IsSuccess())
+      return TF_SetStatusFromAWSError(outcome.GetError(), status);
+    TF_SetStatus(status, TF_OK, "");
+  }
+
+  const Aws::String bucket_;
+  const Aws::String object_;
+  std::shared_ptr<Aws::S3::S3Client> s3_client_;
+  const size_t part_size_;
+  const size_t max_buffers_;
+
+  // Only accessed by the writer.
+  Aws::String upload_id_;
+  Buffer current_;
+  int next_part_number_ = 1;
+  int64_t position_ = 0;
+  bool completed_ = false;
+
+  absl::Mutex mu_;
+  absl::CondVar cv_;
+  std::vector<Buffer> free_buffers_ ABSL_GUARDED_BY(mu_);
+  size_t num_buffers_ ABSL_GUARDED_BY(mu_) = 0;
+  int num_inflight_ ABSL_GUARDED_BY(mu_) = 0;
+  Aws::Map<int, Aws::String> etags_ ABSL_GUARDED_BY(mu_);
+  // The first error of an uploaded part.
+  std::unique_ptr<TF_Status, decltype(&TF_DeleteStatus)> error_
+      ABSL_GUARDED_BY(mu_);
+};
+
+static std::shared_ptr<Aws::Utils::TempFile> CreateTempFile() {
+  return Aws::MakeShared<Aws::Utils::TempFile>(
+      kS3FileSystemAllocationTag,
+#if defined(_MSC_VER)
+      // On Windows, `Aws::FileSystem::CreateTempFilePath()` return
+      // `C:\Users\username\AppData\Local\Temp\`. Adding template will
+      // cause an error.
+      nullptr,
+#else
+      "/tmp/_s3_filesystem_XXXXXX",
+#endif
+      std::ios_base::binary | std::ios_base::trunc | std::ios_base::in |
+          std::ios_base::out);
+}
+
 typedef struct S3File {
   Aws::String bucket;
   Aws::String object;
@@ -347,26 +735,18 @@ typedef struct S3File {
   std::shared_ptr<Aws::Transfer::TransferManager> transfer_manager;
   bool sync_needed;
   std::shared_ptr<Aws::Utils::TempFile> outfile;
+  // Set instead of `outfile` in streaming upload mode.
+  std::unique_ptr<StreamingUpload> streaming_upload;
   S3File(Aws::String bucket, Aws::String object,
          std::shared_ptr<Aws::S3::S3Client> s3_client,
-         std::shared_ptr<Aws::Transfer::TransferManager> transfer_manager)
+         std::shared_ptr<Aws::Transfer::TransferManager> transfer_manager,
+         StreamingUpload* streaming_upload = nullptr)
       : bucket(bucket),
         object(object),
         s3_client(s3_client),
         transfer_manager(transfer_manager),
-        outfile(Aws::MakeShared<Aws::Utils::TempFile>(
-            kS3FileSystemAllocationTag,
-#if defined(_MSC_VER)
-            // On Windows, `Aws::FileSystem::CreateTempFilePath()` return
-            // `C:\Users\username\AppData\Local\Temp\`. Adding template will
-            // cause an error.
-            nullptr,
-#else
-            "/tmp/_s3_filesystem_XXXXXX",
-#endif
-            std::ios_base::binary | std::ios_base::trunc | std::ios_base::in |
-                std::ios_base::out)) {
-  }
+        outfile(streaming_upload == nullptr ? CreateTempFile() : nullptr),
+        streaming_upload(streaming_upload) {}
 } S3File;
 
 void Cleanup(TF_WritableFile* file) {
@@ -377,6 +757,8 @@ void Cleanup(TF_WritableFile* file) {
 void Append(const TF_WritableFile* file, const char* buffer, size_t n,
             TF_Status* status) {
   auto s3_file = static_cast<S3File*>(file->plugin_file);
+  if (s3_file->streaming_upload)
+    return s3_file->streaming_upload->Append(buffer, n, status);
   if (!s3_file->outfile) {
     TF_SetStatus(status, TF_FAILED_PRECONDITION,
                  "The internal temporary file is not writable.");
@@ -393,6 +775,10 @@ void Append(const TF_WritableFile* file, const char* buffer, size_t n,
 
 int64_t Tell(const TF_WritableFile* file, TF_Status* status) {
   auto s3_file = static_cast<S3File*>(file->plugin_file);
+  if (s3_file->streaming_upload) {
+    TF_SetStatus(status, TF_OK, "");
+    return s3_file->streaming_upload->Tell();
+  }
   auto position = static_cast<int64_t>(s3_file->outfile->tellp());
   if (position == -1)
     TF_SetStatus(status, TF_INTERNAL,
@@ -404,6 +790,8 @@ int64_t Tell(const TF_WritableFile* file, TF_Status* status) {
 
 void Sync(const TF_WritableFile* file, TF_Status* status) {
   auto s3_file = static_cast<S3File*>(file->plugin_file);
+  if (s3_file->streaming_upload)
+    return s3_file->streaming_upload->Sync(status);
   if (!s3_file->outfile) {
     TF_SetStatus(status, TF_FAILED_PRECONDITION,
                  "The internal temporary file is not writable.");
@@ -448,6 +836,8 @@ void Flush(const TF_WritableFile* file, TF_Status* status) {
 
 void Close(const TF_WritableFile* file, TF_Status* status) {
   auto s3_file = static_cast<S3File*>(file->plugin_file);
+  if (s3_file->streaming_upload)
+    return s3_file->streaming_upload->Close(status);
   if (s3_file->outfile) {
     Sync(file, status);
     if (TF_GetCode(status) != TF_OK) return;
@@ -492,7 +882,54 @@ S3File::S3File()
       transfer_managers(),
       multi_part_chunk_sizes(),
       use_multi_part_download(true),
-      initialization_lock() {}
+      use_streaming_upload(false),
+      streaming_upload_buffers(kS3StreamingUploadBuffers),
+      file_block_cache(nullptr),
+      read_cache_block_size(kS3ReadCacheBlockSize),
+      read_cache_max_size(0),
+      read_ahead_blocks(kS3ReadAheadBlocks),
+      initialization_lock() {
+  size_t temp_value;
+  if (absl::SimpleAtoi(getenv("S3_READ_CACHE_BLOCK_SIZE_MB"), &temp_value))
+    read_cache_block_size = temp_value * 1024 * 1024;
+  if (absl::SimpleAtoi(getenv("S3_READ_CACHE_MAX_SIZE_MB"), &temp_value))
+    read_cache_max_size = temp_value * 1024 * 1024;
+  if (absl::SimpleAtoi(getenv("S3_READ_AHEAD_BLOCKS"), &temp_value))
+    read_ahead_blocks = temp_value;
+}
+
+// Returns the block cache, or `nullptr` if it is disabled. Must be called
+// after `GetS3Client`.
+static std::shared_ptr<FileBlockCache> GetFileBlockCache(S3File* s3_file) {
+  absl::MutexLock l(&s3_file->initialization_lock);
+  if (s3_file->read_cache_block_size == 0 || s3_file->read_cache_max_size == 0)
+    return nullptr;
+  if (s3_file->file_block_cache.get() == nullptr) {
+    auto s3_client = s3_file->s3_client;
+    s3_file->file_block_cache = std::make_shared<FileBlockCache>(
+        s3_file->read_cache_block_size, s3_file->read_cache_max_size,
+        [s3_client](const std::string& key, size_t offset, size_t n,
+                    char* buffer, TF_Status* status) {
+          return tf_random_access_file::FetchBlock(s3_client, key, offset, n,
+                                                   buffer, status);
+        },
+        FileBlockCache::DiskOptions::FromEnv("S3_READ_CACHE"));
+  }
+  return s3_file->file_block_cache;
+}
+
+// Drops the cached blocks of an object that is modified or deleted.
+static void InvalidateCachedObject(S3File* s3_file, const Aws::String& bucket,
+                                   const Aws::String& object) {
+  std::shared_ptr<FileBlockCache> cache;
+  {
+    absl::MutexLock l(&s3_file->initialization_lock);
+    cache = s3_file->file_block_cache;
+  }
+  if (cache != nullptr)
+    cache->RemoveFile(tf_random_access_file::CacheKey(bucket, object));
+}
+
 void Init(TF_Filesystem* filesystem, TF_Status* status) {
   filesystem->plugin_filesystem = new S3File();
   TF_SetStatus(status, TF_OK, "");
@@ -512,10 +949,16 @@ void NewRandomAccessFile(const TF_Filesystem* filesystem, const char* path,
   auto s3_file = static_cast<S3File*>(filesystem->plugin_filesystem);
   GetS3Client(s3_file);
   GetTransferManager(Aws::Transfer::TransferDirection::DOWNLOAD, s3_file);
-  file->plugin_file = new tf_random_access_file::S3File(
-      {bucket, object, s3_file->s3_client,
-       s3_file->transfer_managers[Aws::Transfer::TransferDirection::DOWNLOAD],
-       s3_file->use_multi_part_download});
+  GetExecutor(s3_file);
+  file->plugin_file = new tf_random_access_file::S3File{
+      bucket,
+      object,
+      s3_file->s3_client,
+      s3_file->transfer_managers[Aws::Transfer::TransferDirection::DOWNLOAD],
+      s3_file->use_multi_part_download,
+      GetFileBlockCache(s3_file),
+      s3_file->executor,
+      s3_file->read_ahead_blocks};
   TF_SetStatus(status, TF_OK, "");
 }
 
@@ -528,9 +971,19 @@ void NewWritableFile(const TF_Filesystem* filesystem, const char* path,
   auto s3_file = static_cast<S3File*>(filesystem->plugin_filesystem);
   GetS3Client(s3_file);
   GetTransferManager(Aws::Transfer::TransferDirection::UPLOAD, s3_file);
+  InvalidateCachedObject(s3_file, bucket, object);
+  tf_writable_file::StreamingUpload* streaming_upload = nullptr;
+  if (s3_file->use_streaming_upload) {
+    streaming_upload = new tf_writable_file::StreamingUpload(
+        bucket, object, s3_file->s3_client,
+        s3_file
+            ->multi_part_chunk_sizes[Aws::Transfer::TransferDirection::UPLOAD],
+        s3_file->streaming_upload_buffers);
+  }
   file->plugin_file = new tf_writable_file::S3File(
       bucket, object, s3_file->s3_client,
-      s3_file->transfer_managers[Aws::Transfer::TransferDirection::UPLOAD]);
+      s3_file->transfer_managers[Aws::Transfer::TransferDirection::UPLOAD],
+      streaming_upload);
   TF_SetStatus(status, TF_OK, "");
 }
 
@@ -544,6 +997,8 @@ void NewAppendableFile(const TF_Filesystem* filesystem, const char* path,
   GetS3Client(s3_file);
   GetTransferManager(Aws::Transfer::TransferDirection::UPLOAD, s3_file);
 
+  InvalidateCachedObject(s3_file, bucket, object);
+
   // We need to delete `file->plugin_file` in case of errors. We set
   // `file->plugin_file` to `nullptr` in order to avoid segment fault when
   // calling deleter of `unique_ptr`.
@@ -923,25 +1378,16 @@ static void MultiPartCopy(const Aws::String& source,
         complete_multipart_upload_outcome.GetError(), status);
 };
 
-void CopyFile(const TF_Filesystem* filesystem, const char* src, const char* dst,
-              TF_Status* status) {
-  auto file_size = GetFileSize(filesystem, src, status);
-  if (TF_GetCode(status) != TF_OK) return;
-  if (file_size == 0)
-    return TF_SetStatus(status, TF_FAILED_PRECONDITION,
-                        "Source is a directory or empty file");
-
-  Aws::String bucket_src, object_src;
-  ParseS3Path(src, false, &bucket_src, &object_src, status);
-  if (TF_GetCode(status) != TF_OK) return;
+// Copies an object of `file_size` bytes, with a multipart copy if it is
+// larger than the upload chunk size. Requires `GetTransferManager` for
+// uploads.
+static void CopyObject(const Aws::String& bucket_src,
+                       const Aws::String& object_src,
+                       const Aws::String& bucket_dst,
+                       const Aws::String& object_dst, uint64_t file_size,
+                       S3File* s3_file, TF_Status* status) {
   Aws::String copy_src = bucket_src + "/" + object_src;
-
-  Aws::String bucket_dst, object_dst;
-  ParseS3Path(dst, false, &bucket_dst, &object_dst, status);
-  if (TF_GetCode(status) != TF_OK) return;
-
-  auto s3_file = static_cast<S3File*>(filesystem->plugin_filesystem);
-  GetTransferManager(Aws::Transfer::TransferDirection::UPLOAD, s3_file);
+  InvalidateCachedObject(s3_file, bucket_dst, object_dst);
   auto chunk_size =
       s3_file->multi_part_chunk_sizes[Aws::Transfer::TransferDirection::UPLOAD];
   size_t num_parts = 1;
@@ -952,8 +1398,8 @@ void CopyFile(const TF_Filesystem* filesystem, const char* src, const char* dst,
     TF_SetStatus(
         status, TF_UNIMPLEMENTED,
         absl::StrCat("MultiPartCopy with number of parts more than 10000 is "
-                     "not supported. Your object ",
-                     src, " required ", num_parts,
+                     "not supported. Your object s3://",
+                     copy_src.c_str(), " required ", num_parts,
                      " as multi_part_copy_part_size is set to ", chunk_size,
                      ". You can control this part size using the environment "
                      "variable S3_MULTI_PART_COPY_PART_SIZE to increase it.")
@@ -963,6 +1409,129 @@ void CopyFile(const TF_Filesystem* filesystem, const char* src, const char* dst,
                   s3_file, status);
 }
 
+typedef struct ObjectCopy {
+  Aws::String object_src;
+  Aws::String object_dst;
+  uint64_t file_size;
+} ObjectCopy;
+
+// Runs the copies on the executor, at most `kS3MaxParallelCopies` at a time.
+// Stops scheduling copies after the first error, which is returned.
+static void CopyObjects(const Aws::String& bucket_src,
+                        const Aws::String& bucket_dst,
+                        const Aws::Vector<ObjectCopy>& copies, S3File* s3_file,
+                        TF_Status* status) {
+  GetExecutor(s3_file);
+  absl::Mutex mu;
+  absl::CondVar cv;
+  size_t num_inflight = 0;
+  std::unique_ptr<TF_Status, decltype(&TF_DeleteStatus)> copy_status(
+      TF_NewStatus(), TF_DeleteStatus);
+  for (const auto& copy : copies) {
+    {
+      absl::MutexLock l(&mu);
+      while (num_inflight >= kS3MaxParallelCopies) cv.Wait(&mu);
+      if (TF_GetCode(copy_status.get()) != TF_OK) break;
+      num_inflight++;
+    }
+    const ObjectCopy* object_copy = &copy;
+    s3_file->executor->Submit([&, object_copy]() {
+      std::unique_ptr<TF_Status, decltype(&TF_DeleteStatus)> status(
+          TF_NewStatus(), TF_DeleteStatus);
+      CopyObject(bucket_src, object_copy->object_src, bucket_dst,
+                 object_copy->object_dst, object_copy->file_size, s3_file,
+                 status.get());
+      absl::MutexLock l(&mu);
+      if (TF_GetCode(status.get()) != TF_OK &&
+          TF_GetCode(copy_status.get()) == TF_OK)
+        TF_SetStatus(copy_status.get(), TF_GetCode(status.get()),
+                     TF_Message(status.get()));
+      num_inflight--;
+      cv.Signal();
+    });
+  }
+  absl::MutexLock l(&mu);
+  while (num_inflight > 0) cv.Wait(&mu);
+  TF_SetStatus(status, TF_GetCode(copy_status.get()),
+               TF_Message(copy_status.get()));
+}
+
+// Deletes the objects with DeleteObjects, `kS3DeleteObjectsMaxKeys` per
+// request. The objects which could not be deleted are counted in
+// `undeleted_files` and `undeleted_dirs` (directory markers) if not `nullptr`.
+static void DeleteObjects(const Aws::String& bucket,
+                          const Aws::Vector<Aws::String>& objects,
+                          S3File* s3_file, uint64_t* undeleted_files,
+                          uint64_t* undeleted_dirs, TF_Status* status) {
+  TF_SetStatus(status, TF_OK, "");
+  for (size_t begin = 0; begin < objects.size();
+       begin += kS3DeleteObjectsMaxKeys) {
+    size_t end = std::min(objects.size(), begin + kS3DeleteObjectsMaxKeys);
+    TF_VLog(1, "DeleteObjects: %u objects in s3://%s\n", end - begin,
+            bucket.c_str());
+    Aws::S3::Model::Delete delete_objects;
+    for (size_t i = begin; i < end; ++i) {
+      InvalidateCachedObject(s3_file, bucket, objects[i]);
+      delete_objects.AddObjects(
+          Aws::S3::Model::ObjectIdentifier().WithKey(objects[i]));
+    }
+    // Only report the objects that failed.
+    delete_objects.SetQuiet(true);
+    Aws::S3::Model::DeleteObjectsRequest delete_objects_request;
+    delete_objects_request.WithBucket(bucket).WithDelete(delete_objects);
+    auto delete_objects_outcome =
+        s3_file->s3_client->DeleteObjects(delete_objects_request);
+    if (!delete_objects_outcome.IsSuccess()) {
+      for (size_t i = begin; i < end; ++i) {
+        if (objects[i].back() == '/') {
+          if (undeleted_dirs != nullptr) (*undeleted_dirs)++;
+        } else {
+          if (undeleted_files != nullptr) (*undeleted_files)++;
+        }
+      }
+      return TF_SetStatusFromAWSError(delete_objects_outcome.GetError(),
+                                      status);
+    }
+    const auto& errors = delete_objects_outcome.GetResult().GetErrors();
+    for (const auto& error : errors) {
+      if (error.GetKey().back() == '/') {
+        if (undeleted_dirs != nullptr) (*undeleted_dirs)++;
+      } else {
+        if (undeleted_files != nullptr) (*undeleted_files)++;
+      }
+    }
+    if (!errors.empty()) {
+      std::string message = absl::StrCat(
+          "Failed to delete ", errors.size(), " objects, first s3://",
+          bucket.c_str(), "/", errors[0].GetKey().c_str(), ": ",
+          errors[0].GetCode().c_str(), ": ", errors[0].GetMessage().c_str());
+      return TF_SetStatus(status, TF_UNKNOWN, message.c_str());
+    }
+  }
+}
+
+void CopyFile(const TF_Filesystem* filesystem, const char* src, const char* dst,
+              TF_Status* status) {
+  auto file_size = GetFileSize(filesystem, src, status);
+  if (TF_GetCode(status) != TF_OK) return;
+  if (file_size == 0)
+    return TF_SetStatus(status, TF_FAILED_PRECONDITION,
+                        "Source is a directory or empty file");
+
+  Aws::String bucket_src, object_src;
+  ParseS3Path(src, false, &bucket_src, &object_src, status);
+  if (TF_GetCode(status) != TF_OK) return;
+
+  Aws::String bucket_dst, object_dst;
+  ParseS3Path(dst, false, &bucket_dst, &object_dst, status);
+  if (TF_GetCode(status) != TF_OK) return;
+
+  auto s3_file = static_cast<S3File*>(filesystem->plugin_filesystem);
+  GetTransferManager(Aws::Transfer::TransferDirection::UPLOAD, s3_file);
+  CopyObject(bucket_src, object_src, bucket_dst, object_dst, file_size,
+             s3_file, status);
+}
+
 void DeleteFile(const TF_Filesystem* filesystem, const char* path,
                 TF_Status* status) {
   TF_VLog(1, "DeleteFile: %s\n", path);
@@ -971,6 +1540,7 @@ void DeleteFile(const TF_Filesystem* filesystem, const char* path,
   if (TF_GetCode(status) != TF_OK) return;
   auto s3_file = static_cast<S3File*>(filesystem->plugin_filesystem);
   GetS3Client(s3_file);
+  InvalidateCachedObject(s3_file, bucket, object);
 
   Aws::S3::Model::DeleteObjectRequest delete_object_request;
   delete_object_request.WithBucket(bucket).WithKey(object);
@@ -1089,7 +1659,9 @@ void RenameFile(const TF_Filesystem* filesystem, const char* src,
     }
   }
 
-  Aws::S3::Model::DeleteObjectRequest delete_object_request;
+  // The objects of each listed page are copied in parallel, then deleted
+  // with a single request.
+  GetTransferManager(Aws::Transfer::TransferDirection::UPLOAD, s3_file);
   Aws::S3::Model::ListObjectsV2Request list_objects_request;
   list_objects_request.WithBucket(bucket_src)
       .WithPrefix(object_src)
@@ -1105,24 +1677,101 @@ void RenameFile(const TF_Filesystem* filesystem, const char* src,
       return TF_SetStatusFromAWSError(list_objects_outcome.GetError(), status);
 
     list_objects_result = list_objects_outcome.GetResult();
+    Aws::Vector<ObjectCopy> copies;
+    Aws::Vector<Aws::String> objects;
     for (const auto& object : list_objects_result.GetContents()) {
       Aws::String key_src = object.GetKey();
       Aws::String key_dst = key_src;
       key_dst.replace(0, object_src.length(), object_dst);
-      CopyFile(filesystem, ("s3://" + bucket_src + "/" + key_src).c_str(),
-               ("s3://" + bucket_dst + "/" + key_dst).c_str(), status);
+      copies.push_back({key_src, key_dst, (uint64_t)object.GetSize()});
+      objects.push_back(key_src);
+    }
+    CopyObjects(bucket_src, bucket_dst, copies, s3_file, status);
+    if (TF_GetCode(status) != TF_OK) return;
+    DeleteObjects(bucket_src, objects, s3_file, nullptr, nullptr, status);
+    if (TF_GetCode(status) != TF_OK) return;
+
+    list_objects_request.SetContinuationToken(
+        list_objects_result.GetNextContinuationToken());
+  } while (list_objects_result.GetIsTruncated());
+  TF_SetStatus(status, TF_OK, "");
+}
+
+void DeleteRecursively(const TF_Filesystem* filesystem, const char* path,
+                       uint64_t* undeleted_files, uint64_t* undeleted_dirs,
+                       TF_Status* status) {
+  TF_VLog(1, "DeleteRecursively: %s\n", path);
+  if (!undeleted_files || !undeleted_dirs)
+    return TF_SetStatus(
+        status, TF_INTERNAL,
+        "'undeleted_files' and 'undeleted_dirs' cannot be nullptr.");
+  *undeleted_files = 0;
+  *undeleted_dirs = 0;
+  Aws::String bucket, object;
+  ParseS3Path(path, true, &bucket, &object, status);
+  if (TF_GetCode(status) != TF_OK) return;
+  auto s3_file = static_cast<S3File*>(filesystem->plugin_filesystem);
+  GetS3Client(s3_file);
+
+  // The path may name an object as well as the directory of its children
+  bool found = false;
+  if (!object.empty() && object.back() != '/') {
+    Aws::S3::Model::HeadObjectRequest head_object_request;
+    head_object_request.WithBucket(bucket).WithKey(object);
+    head_object_request.SetResponseStreamFactory([]() {
+      return Aws::New<Aws::StringStream>(kS3FileSystemAllocationTag);
+    });
+    auto head_object_outcome =
+        s3_file->s3_client->HeadObject(head_object_request);
+    if (head_object_outcome.IsSuccess()) {
+      DeleteObjects(bucket, {object}, s3_file, undeleted_files,
+                    undeleted_dirs, status);
       if (TF_GetCode(status) != TF_OK) return;
+      found = true;
+    } else {
+      TF_SetStatusFromAWSError(head_object_outcome.GetError(), status);
+      if (TF_GetCode(status) != TF_NOT_FOUND) {
+        *undeleted_files = 1;
+        return;
+      }
+    }
+    object.push_back('/');
+  }
+
+  Aws::S3::Model::ListObjectsV2Request list_objects_request;
+  list_objects_request.WithBucket(bucket).WithPrefix(object).WithMaxKeys(
+      kS3GetChildrenMaxKeys);
+  list_objects_request.SetResponseStreamFactory(
+      []() { return Aws::New<Aws::StringStream>(kS3FileSystemAllocationTag); });
 
-      delete_object_request.WithBucket(bucket_src).WithKey(key_src);
-      auto delete_object_outcome =
-          s3_file->s3_client->DeleteObject(delete_object_request);
-      if (!delete_object_outcome.IsSuccess())
-        return TF_SetStatusFromAWSError(delete_object_outcome.GetError(),
-                                        status);
+  Aws::S3::Model::ListObjectsV2Result list_objects_result;
+  do {
+    auto list_objects_outcome =
+        s3_file->s3_client->ListObjectsV2(list_objects_request);
+    if (!list_objects_outcome.IsSuccess()) {
+      *undeleted_dirs = 1;
+      return TF_SetStatusFromAWSError(list_objects_outcome.GetError(), status);
+    }
+
+    list_objects_result = list_objects_outcome.GetResult();
+    Aws::Vector<Aws::String> objects;
+    for (const auto& object : list_objects_result.GetContents()) {
+      objects.push_back(object.GetKey());
     }
+    found = found || !objects.empty();
+    DeleteObjects(bucket, objects, s3_file, undeleted_files, undeleted_dirs,
+                  status);
+    if (TF_GetCode(status) != TF_OK) return;
+
     list_objects_request.SetContinuationToken(
         list_objects_result.GetNextContinuationToken());
   } while (list_objects_result.GetIsTruncated());
+
+  if (!found && !object.empty()) {
+    *undeleted_dirs = 1;
+    return TF_SetStatus(status, TF_NOT_FOUND,
+                        absl::StrCat(path, " does not exist").c_str());
+  }
   TF_SetStatus(status, TF_OK, "");
 }
 
@@ -1190,6 +1839,56 @@ static char* TranslateName(const TF_Filesystem* filesystem, const char* uri) {
 
 }  // namespace tf_s3_filesystem
 
+static void FlushCaches(const TF_Filesystem* filesystem) {
+  auto s3_file = static_cast<S3File*>(filesystem->plugin_filesystem);
+  absl::MutexLock l(&s3_file->initialization_lock);
+  if (s3_file->file_block_cache != nullptr)
+    s3_file->file_block_cache->Flush();
+}
+
+// Accepts the options of the block cache under the names of their environment
+// variables. The new sizes apply to files opened afterwards.
+static void SetConfiguration(const TF_Filesystem* filesystem,
+                             const TF_Filesystem_Option* options,
+                             int num_options, TF_Status* status) {
+  auto s3_file = static_cast<S3File*>(filesystem->plugin_filesystem);
+  absl::MutexLock l(&s3_file->initialization_lock);
+  for (int i = 0; i < num_options; i++) {
+    if (options[i].value->type_tag != TF_Filesystem_Option_Type_Buffer ||
+        options[i].value->num_values != 1) {
+      return TF_SetStatus(status, TF_INVALID_ARGUMENT,
+                          "SetConfiguration only support single buffer "
+                          "values for s3 ('s3://') file system");
+    }
+    std::string name = options[i].name;
+    std::string value =
+        std::string(options[i].value->values[0].buffer_val.buf,
+                    options[i].value->values[0].buffer_val.buf_length);
+    size_t temp_value;
+    if (!absl::SimpleAtoi(value, &temp_value)) {
+      std::string message =
+          absl::StrCat("Invalid value for ", name, ": ", value);
+      return TF_SetStatus(status, TF_INVALID_ARGUMENT, message.c_str());
+    }
+    if (name == "S3_READ_CACHE_BLOCK_SIZE_MB") {
+      s3_file->read_cache_block_size = temp_value * 1024 * 1024;
+      s3_file->file_block_cache = nullptr;
+    } else if (name == "S3_READ_CACHE_MAX_SIZE_MB") {
+      s3_file->read_cache_max_size = temp_value * 1024 * 1024;
+      s3_file->file_block_cache = nullptr;
+    } else if (name == "S3_READ_AHEAD_BLOCKS") {
+      s3_file->read_ahead_blocks = temp_value;
+    } else {
+      std::string message = absl::StrCat(
+          "SetConfiguration not implemented for s3 ('s3://') file system: "
+          "name = ",
+          name, ", value = ", value);
+      return TF_SetStatus(status, TF_UNIMPLEMENTED, message.c_str());
+    }
+  }
+  TF_SetStatus(status, TF_OK, "");
+}
+
 void ProvideFilesystemSupportFor(TF_FilesystemPluginOps* ops, const char* uri) {
   TF_SetFilesystemVersionMetadata(ops);
   ops->scheme = strdup(uri);
@@ -1231,6 +1930,8 @@ void ProvideFilesystemSupportFor(TF_FilesystemPluginOps* ops, const char* uri) {
       tf_s3_filesystem::RecursivelyCreateDir;
   ops->filesystem_ops->delete_file = tf_s3_filesystem::DeleteFile;
   ops->filesystem_ops->delete_dir = tf_s3_filesystem::DeleteDir;
+  ops->filesystem_ops->delete_recursively =
+      tf_s3_filesystem::DeleteRecursively;
   ops->filesystem_ops->copy_file = tf_s3_filesystem::CopyFile;
   ops->filesystem_ops->rename_file = tf_s3_filesystem::RenameFile;
   ops->filesystem_ops->path_exists = tf_s3_filesystem::PathExists;
@@ -1238,6 +1939,9 @@ void ProvideFilesystemSupportFor(TF_FilesystemPluginOps* ops, const char* uri) {
   ops->filesystem_ops->stat = tf_s3_filesystem::Stat;
   ops->filesystem_ops->get_children = tf_s3_filesystem::GetChildren;
   ops->filesystem_ops->translate_name = tf_s3_filesystem::TranslateName;
+  ops->filesystem_ops->flush_caches = tf_s3_filesystem::FlushCaches;
+  ops->filesystem_ops->set_filesystem_configuration =
+      tf_s3_filesystem::SetConfiguration;
 }
 
 }  // namespace s3
@@ -25,6 +25,7 @@ limitations under the License.
 #include "absl/synchronization/mutex.h"
 #include "tensorflow/c/experimental/filesystem/filesystem_interface.h"
 #include "tensorflow/c/tf_status.h"
+#include "tensorflow_io/core/filesystems/file_block_cache.h"
 
 namespace tensorflow {
 namespace io {
@@ -67,6 +68,20 @@ typedef struct S3File {
   Aws::UnorderedMap<Aws::Transfer::TransferDirection, uint64_t>
       multi_part_chunk_sizes;
   bool use_multi_part_download;
+  // Upload writable files from memory while appending, instead of staging
+  // them in a temporary file (S3_STREAMING_UPLOAD=1).
+  bool use_streaming_upload;
+  size_t streaming_upload_buffers;
+  // Block cache shared by all random access files, created on first use with
+  // the sizes below (S3_READ_CACHE_BLOCK_SIZE_MB, S3_READ_CACHE_MAX_SIZE_MB).
+  // A max size of 0 disables the cache. Fetched blocks are also kept on local
+  // disk under S3_READ_CACHE_DISK_DIR, bounded by
+  // S3_READ_CACHE_DISK_MAX_SIZE_MB.
+  std::shared_ptr<tensorflow::io::FileBlockCache> file_block_cache;
+  size_t read_cache_block_size;
+  size_t read_cache_max_size;
+  // Blocks prefetched ahead of sequential reads (S3_READ_AHEAD_BLOCKS).
+  size_t read_ahead_blocks;
   absl::Mutex initialization_lock;
   S3File();
 } S3File;
@@ -97,6 +112,9 @@ void Stat(const TF_Filesystem* filesystem, const char* path,
           TF_FileStatistics* stats, TF_Status* status);
 void DeleteDir(const TF_Filesystem* filesystem, const char* path,
                TF_Status* status);
+void DeleteRecursively(const TF_Filesystem* filesystem, const char* path,
+                       uint64_t* undeleted_files, uint64_t* undeleted_dirs,
+                       TF_Status* status);
 void CopyFile(const TF_Filesystem* filesystem, const char* src, const char* dst,
               TF_Status* status);
 void RenameFile(const TF_Filesystem* filesystem, const char* src,
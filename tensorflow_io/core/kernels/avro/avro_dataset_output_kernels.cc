@@ -0,0 +1,350 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include <deque>
+
+#include "api/Compiler.hh"
+#include "api/ValidSchema.hh"
+#include "snappy.h"
+#include "tensorflow/core/lib/random/random.h"
+#include "tensorflow/core/lib/strings/stringprintf.h"
+#include "tensorflow_io/core/kernels/output_ops.h"
+#include "zlib.h"
+#include "zstd.h"
+
+namespace tensorflow {
+namespace data {
+namespace {
+
+// Avro object container file, see
+// https://avro.apache.org/docs/1.10.1/spec.html#Object+Container+Files
+static constexpr char kAvroMagic[] = {'O', 'b', 'j', '\x01'};
+static constexpr size_t kAvroSyncSize = 16;
+static constexpr int kZstdCompressionLevel = 3;
+
+// Appends a long in avro binary encoding (zig-zag varint)
+void AppendAvroLong(string* out, int64 value) {
+  uint64 n = (static_cast<uint64>(value) << 1) ^
+             static_cast<uint64>(value >> 63);
+  while (n & ~0x7FULL) {
+    out->push_back(static_cast<char>((n & 0x7F) | 0x80));
+    n >>= 7;
+  }
+  out->push_back(static_cast<char>(n));
+}
+
+// Appends bytes or a string in avro binary encoding
+void AppendAvroBytes(string* out, StringPiece value) {
+  AppendAvroLong(out, value.size());
+  out->append(value.data(), value.size());
+}
+
+Status DeflateCompress(const string& input, string* output) {
+  z_stream stream;
+  memset(&stream, 0x00, sizeof(stream));
+  // Avro uses raw deflate (RFC 1951) without zlib header and checksum
+  if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    return errors::Internal("unable to initialize deflate: ", stream.msg);
+  }
+  output->resize(deflateBound(&stream, input.size()));
+  stream.next_in = (Bytef*)input.data();
+  stream.avail_in = input.size();
+  stream.next_out = (Bytef*)&(*output)[0];
+  stream.avail_out = output->size();
+  int rc = deflate(&stream, Z_FINISH);
+  output->resize(stream.total_out);
+  deflateEnd(&stream);
+  if (rc != Z_STREAM_END) {
+    return errors::Internal("unable to deflate avro block: ", rc);
+  }
+  return Status::OK();
+}
+
+Status SnappyCompress(const string& input, string* output) {
+  snappy::Compress(input.data(), input.size(), output);
+  // Avro appends the big-endian CRC32 of the uncompressed data
+  uLong crc = crc32(0L, Z_NULL, 0);
+  crc = crc32(crc, (const Bytef*)input.data(), input.size());
+  output->push_back(static_cast<char>((crc >> 24) & 0xFF));
+  output->push_back(static_cast<char>((crc >> 16) & 0xFF));
+  output->push_back(static_cast<char>((crc >> 8) & 0xFF));
+  output->push_back(static_cast<char>(crc & 0xFF));
+  return Status::OK();
+}
+
+Status ZstdCompress(const string& input, string* output) {
+  output->resize(ZSTD_compressBound(input.size()));
+  size_t size = ZSTD_compress(&(*output)[0], output->size(), input.data(),
+                              input.size(), kZstdCompressionLevel);
+  if (ZSTD_isError(size)) {
+    return errors::Internal("unable to compress avro block with zstd: ",
+                            ZSTD_getErrorName(size));
+  }
+  output->resize(size);
+  return Status::OK();
+}
+
+// Writes the serialized records of a dataset into avro container files.
+// Records are accumulated into blocks of about block_size bytes, blocks are
+// compressed on a background thread pool and written in order. A new file is
+// started once the current one exceeds file_size bytes (if positive).
+class AvroDatasetOutput {
+ public:
+  explicit AvroDatasetOutput(Env* env) : env_(env) {}
+
+  ~AvroDatasetOutput() {
+    // Wait for scheduled compressions, which reference mu_ and cv_.
+    pool_.reset(nullptr);
+  }
+
+  Status Init(OpKernelContext* ctx) {
+    tstring filename, schema, codec;
+    TF_RETURN_IF_ERROR(
+        ParseScalarArgument<tstring>(ctx, "filename", &filename));
+    TF_RETURN_IF_ERROR(ParseScalarArgument<tstring>(ctx, "schema", &schema));
+    TF_RETURN_IF_ERROR(ParseScalarArgument<tstring>(ctx, "codec", &codec));
+    filename_ = filename;
+    schema_ = schema;
+    codec_ = codec;
+    TF_RETURN_IF_ERROR(
+        ParseScalarArgument<int64>(ctx, "block_size", &block_size_));
+    TF_RETURN_IF_ERROR(
+        ParseScalarArgument<int64>(ctx, "file_size", &file_size_));
+    int64 compression_threads = 0;
+    TF_RETURN_IF_ERROR(ParseScalarArgument<int64>(ctx, "compression_threads",
+                                                  &compression_threads));
+
+    if (codec_ == "null") {
+      compress_ = nullptr;
+    } else if (codec_ == "deflate") {
+      compress_ = DeflateCompress;
+    } else if (codec_ == "snappy") {
+      compress_ = SnappyCompress;
+    } else if (codec_ == "zstandard") {
+      compress_ = ZstdCompress;
+    } else {
+      return errors::InvalidArgument("unsupported avro codec: ", codec_);
+    }
+    if (block_size_ <= 0) {
+      return errors::InvalidArgument("block_size must be positive: ",
+                                     block_size_);
+    }
+
+    avro::ValidSchema avro_schema;
+    std::istringstream ss(schema_);
+    string error;
+    if (!(avro::compileJsonSchema(ss, avro_schema, error))) {
+      return errors::InvalidArgument("Avro schema error: ", error);
+    }
+
+    for (size_t i = 0; i < kAvroSyncSize; i += sizeof(uint64)) {
+      uint64 value = random::New64();
+      memcpy(&sync_[i], &value, sizeof(uint64));
+    }
+
+    if (compress_ != nullptr && compression_threads > 0) {
+      pool_.reset(new thread::ThreadPool(env_, "avro_dataset_output",
+                                         compression_threads));
+      max_pending_ = 2 * compression_threads;
+    }
+    return Status::OK();
+  }
+
+  Status Write(const std::vector<Tensor>& components) {
+    if (components.size() != 1 || components[0].dtype() != DT_STRING) {
+      return errors::InvalidArgument(
+          "expected a dataset of serialized avro records");
+    }
+    // Elements could be a scalar record or a batch of records.
+    auto records = components[0].flat<tstring>();
+    for (int64 i = 0; i < records.size(); i++) {
+      block_.append(records(i).data(), records(i).size());
+      block_count_++;
+      if (static_cast<int64>(block_.size()) >= block_size_) {
+        TF_RETURN_IF_ERROR(FlushBlock());
+      }
+    }
+    return Status::OK();
+  }
+
+  Status Final(OpKernelContext* ctx) {
+    TF_RETURN_IF_ERROR(FlushBlock());
+    while (!pending_.empty()) {
+      TF_RETURN_IF_ERROR(WritePendingBlock());
+    }
+    // An empty dataset still results in a valid (empty) container file.
+    if (filenames_.empty()) {
+      TF_RETURN_IF_ERROR(OpenFile());
+    }
+    TF_RETURN_IF_ERROR(CloseFile());
+
+    Tensor* filenames_tensor;
+    TF_RETURN_IF_ERROR(ctx->allocate_output(
+        0, TensorShape({static_cast<int64>(filenames_.size())}),
+        &filenames_tensor));
+    for (size_t i = 0; i < filenames_.size(); i++) {
+      filenames_tensor->flat<tstring>()(i) = filenames_[i];
+    }
+    return Status::OK();
+  }
+
+ private:
+  // A block handed over for compression, data/status/done are guarded by mu_
+  // until done is set.
+  struct PendingBlock {
+    int64 count;
+    string data;
+    Status status;
+    bool done = false;
+  };
+
+  // Hand over the current block for compression, and write out finished
+  // blocks in order while too many are in flight.
+  Status FlushBlock() {
+    if (block_count_ == 0) {
+      return Status::OK();
+    }
+    std::shared_ptr<PendingBlock> pending(new PendingBlock());
+    pending->count = block_count_;
+    pending->data = std::move(block_);
+    block_.clear();
+    block_count_ = 0;
+
+    if (pool_ == nullptr) {
+      if (compress_ != nullptr) {
+        string compressed;
+        TF_RETURN_IF_ERROR(compress_(pending->data, &compressed));
+        pending->data = std::move(compressed);
+      }
+      return WriteBlock(*pending);
+    }
+
+    pending_.push_back(pending);
+    auto compress = compress_;
+    pool_->Schedule([this, pending, compress]() {
+      string compressed;
+      Status status = compress(pending->data, &compressed);
+      mutex_lock l(mu_);
+      pending->data = std::move(compressed);
+      pending->status = status;
+      pending->done = true;
+      cv_.notify_all();
+    });
+    while (pending_.size() > max_pending_) {
+      TF_RETURN_IF_ERROR(WritePendingBlock());
+    }
+    return Status::OK();
+  }
+
+  // Wait for the oldest pending block to be compressed and write it.
+  Status WritePendingBlock() {
+    std::shared_ptr<PendingBlock> pending = pending_.front();
+    pending_.pop_front();
+    {
+      mutex_lock l(mu_);
+      while (!pending->done) {
+        cv_.wait(l);
+      }
+    }
+    TF_RETURN_IF_ERROR(pending->status);
+    return WriteBlock(*pending);
+  }
+
+  Status WriteBlock(const PendingBlock& block) {
+    if (file_ == nullptr) {
+      TF_RETURN_IF_ERROR(OpenFile());
+    }
+    string header;
+    AppendAvroLong(&header, block.count);
+    AppendAvroLong(&header, block.data.size());
+    TF_RETURN_IF_ERROR(file_->Append(header));
+    TF_RETURN_IF_ERROR(file_->Append(block.data));
+    TF_RETURN_IF_ERROR(file_->Append(StringPiece(sync_, kAvroSyncSize)));
+    file_bytes_ += header.size() + block.data.size() + kAvroSyncSize;
+    if (file_size_ > 0 && file_bytes_ >= file_size_) {
+      TF_RETURN_IF_ERROR(CloseFile());
+    }
+    return Status::OK();
+  }
+
+  // Without rolling the filename is used as is, otherwise an index is
+  // inserted before the extension, e.g., part.avro => part-00000.avro
+  string NextFilename() const {
+    if (file_size_ <= 0) {
+      return filename_;
+    }
+    string index =
+        strings::Printf("-%05d", static_cast<int>(filenames_.size()));
+    size_t extension = filename_.rfind(".avro");
+    if (extension != string::npos && extension + 5 == filename_.size()) {
+      return strings::StrCat(filename_.substr(0, extension), index, ".avro");
+    }
+    return strings::StrCat(filename_, index);
+  }
+
+  Status OpenFile() {
+    string filename = NextFilename();
+    TF_RETURN_IF_ERROR(env_->NewWritableFile(filename, &file_));
+    filenames_.push_back(filename);
+
+    string header(kAvroMagic, sizeof(kAvroMagic));
+    AppendAvroLong(&header, 2);
+    AppendAvroBytes(&header, "avro.schema");
+    AppendAvroBytes(&header, schema_);
+    AppendAvroBytes(&header, "avro.codec");
+    AppendAvroBytes(&header, codec_);
+    AppendAvroLong(&header, 0);
+    header.append(sync_, kAvroSyncSize);
+    TF_RETURN_IF_ERROR(file_->Append(header));
+    file_bytes_ = header.size();
+    return Status::OK();
+  }
+
+  Status CloseFile() {
+    if (file_ == nullptr) {
+      return Status::OK();
+    }
+    Status status = file_->Close();
+    file_.reset(nullptr);
+    return status;
+  }
+
+  Env* env_;
+  string filename_;
+  string schema_;
+  string codec_;
+  int64 block_size_ = 0;
+  int64 file_size_ = 0;
+  std::function<Status(const string&, string*)> compress_;
+  char sync_[kAvroSyncSize];
+
+  std::unique_ptr<WritableFile> file_;
+  int64 file_bytes_ = 0;
+  std::vector<string> filenames_;
+
+  string block_;
+  int64 block_count_ = 0;
+
+  // Blocks in write order, only accessed from the writing thread
+  std::deque<std::shared_ptr<PendingBlock>> pending_;
+  size_t max_pending_ = 0;
+  mutex mu_;
+  condition_variable cv_;
+  std::unique_ptr<thread::ThreadPool> pool_;
+};
+
+REGISTER_KERNEL_BUILDER(Name("IO>AvroDatasetOutput").Device(DEVICE_CPU),
+                        DatasetOutputOp<AvroDatasetOutput>);
+
+}  // namespace
+}  // namespace data
+}  // namespace tensorflow
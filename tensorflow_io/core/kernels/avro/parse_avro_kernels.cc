@@ -80,13 +80,55 @@ struct AvroParserConfig {
 // Container for the
 //    - sparse indices,
 //    - sparse values,
-//    - sparse shapes,
-//    - dense values
+//    - sparse shapes
+// Dense values are written directly into tensors from the DenseAllocator
 struct AvroResult {
   std::vector<Tensor> sparse_indices;
   std::vector<Tensor> sparse_values;
   std::vector<Tensor> sparse_shapes;
-  std::vector<Tensor> dense_values;
+};
+
+// Allocates the output tensor for the dense feature with the given index
+// Allows ParseAvro to write dense values directly into the op's outputs
+using DenseAllocator =
+    std::function<Status(size_t, const TensorShape&, Tensor**)>;
+
+// Holds the value stores of one ParseAvro invocation
+//    - one map of value stores per minibatch,
+//    - the value stores merged across minibatches
+struct AvroValueStores {
+  std::vector<std::map<string, ValueStoreUniquePtr>> minibatches;
+  std::map<string, ValueStoreUniquePtr> merged;
+};
+
+// Pool of value stores that are reused across invocations, so that the
+// storage for values and marks is only allocated once and then recycled
+// Compute may run concurrently, hence each invocation takes its own stores
+class AvroValueStoresPool {
+ public:
+  std::unique_ptr<AvroValueStores> Get() {
+    mutex_lock l(mu_);
+    if (pool_.empty()) {
+      return std::unique_ptr<AvroValueStores>(new AvroValueStores());
+    }
+    std::unique_ptr<AvroValueStores> stores = std::move(pool_.back());
+    pool_.pop_back();
+    return stores;
+  }
+
+  void Return(std::unique_ptr<AvroValueStores> stores) {
+    mutex_lock l(mu_);
+    if (pool_.size() < kMaxPoolSize) {
+      pool_.emplace_back(std::move(stores));
+    }
+  }
+
+ private:
+  // Bounds the memory held by idle stores
+  static constexpr size_t kMaxPoolSize = 4;
+
+  mutex mu_;
+  std::vector<std::unique_ptr<AvroValueStores>> pool_ TF_GUARDED_BY(mu_);
 };
 
 void ParallelFor(const std::function<void(size_t)>& f, size_t n,
@@ -170,7 +212,8 @@ Status ParseAvro(const AvroParserConfig& config,
                  const AvroParserTree& parser_tree,
                  const avro::ValidSchema& reader_schema,
                  const gtl::ArraySlice<tstring>& serialized,
-                 thread::ThreadPool* thread_pool, AvroResult* result) {
+                 thread::ThreadPool* thread_pool, AvroValueStores* stores,
+                 const DenseAllocator& allocate_dense, AvroResult* result) {
   DCHECK(result != nullptr);
   using clock = std::chrono::system_clock;
   using ms = std::chrono::duration<double, std::milli>;
@@ -243,7 +286,12 @@ Status ParseAvro(const AvroParserConfig& config,
 
   // Note, using vector here is thread safe since all operations inside the
   // multi-threaded region for a vector are thread safe
-  std::vector<std::map<string, ValueStoreUniquePtr>> buffers(num_minibatches);
+  // The maps are pooled, grow the pool if this batch needs more minibatches
+  std::vector<std::map<string, ValueStoreUniquePtr>>& buffers =
+      stores->minibatches;
+  if (buffers.size() < num_minibatches) {
+    buffers.resize(num_minibatches);
+  }
 
   std::vector<Status> status_of_minibatch(num_minibatches);
 
@@ -273,18 +321,34 @@ Status ParseAvro(const AvroParserConfig& config,
   result->sparse_indices.reserve(config.sparse.size());
   result->sparse_values.reserve(config.sparse.size());
   result->sparse_shapes.reserve(config.sparse.size());
-  result->dense_values.reserve(config.dense.size());
+
+  // Merges the minibatch stores for a feature into the pooled merged store
+  // A single minibatch is used as is without any merge
+  auto MergeMinibatches = [&](const ValueStore** value_store,
+                              const string& feature_name,
+                              DataType dtype) -> Status {
+    if (num_minibatches == 1) {
+      *value_store = buffers[0][feature_name].get();
+      return Status::OK();
+    }
+    std::vector<ValueStore*> values(num_minibatches);
+    for (size_t i = 0; i < num_minibatches; ++i) {
+      values[i] = buffers[i][feature_name].get();
+      VLOG(5) << "Value " << i << ": " << (*values[i]).ToString(10);
+    }
+    ValueStoreUniquePtr& merged = stores->merged[feature_name];
+    TF_RETURN_IF_ERROR(MergeAs(merged, values, dtype));
+    *value_store = merged.get();
+    return Status::OK();
+  };
 
   auto MergeSparseMinibatches = [&](size_t i_sparse) -> Status {
     const AvroParserConfig::Sparse& sparse = config.sparse[i_sparse];
     const string& feature_name = sparse.feature_name;
 
-    std::vector<ValueStoreUniquePtr> values(buffers.size());
-    for (size_t i = 0; i < buffers.size(); ++i) {
-      values[i] = std::move(buffers[i][feature_name]);
-    }
-    ValueStoreUniquePtr value_store;
-    TF_RETURN_IF_ERROR(MergeAs(value_store, values, sparse.dtype));
+    const ValueStore* value_store;
+    TF_RETURN_IF_ERROR(
+        MergeMinibatches(&value_store, feature_name, sparse.dtype));
 
     VLOG(5) << "Converting sparse feature " << feature_name;
     VLOG(5) << "Contents of value store " << (*value_store).ToString(10);
@@ -329,16 +393,11 @@ Status ParseAvro(const AvroParserConfig& config,
 
     VLOG(5) << "Working on feature: '" << feature_name << "'";
 
-    std::vector<ValueStoreUniquePtr> values(buffers.size());
-    for (size_t i = 0; i < buffers.size(); ++i) {
-      values[i] = std::move(buffers[i][feature_name]);
-      VLOG(5) << "Value " << i << ": " << (*values[i]).ToString(10);
-    }
-
     VLOG(5) << "Merge for dense type: " << DataTypeString(dense.dtype);
 
-    ValueStoreUniquePtr value_store;
-    TF_RETURN_IF_ERROR(MergeAs(value_store, values, dense.dtype));
+    const ValueStore* value_store;
+    TF_RETURN_IF_ERROR(
+        MergeMinibatches(&value_store, feature_name, dense.dtype));
 
     VLOG(5) << "Merged value store: " << value_store->ToString(10);
 
@@ -371,8 +430,9 @@ Status ParseAvro(const AvroParserConfig& config,
     VLOG(5) << "Creating dense tensor for resolved shape: " << resolved_shape
             << " given the user shape " << dense.shape;
 
-    result->dense_values.emplace_back(dense.dtype, resolved_shape);
-    Tensor* dense_tensor = &result->dense_values.back();
+    // Write directly into the preallocated output
+    Tensor* dense_tensor;
+    TF_RETURN_IF_ERROR(allocate_dense(i_dense, resolved_shape, &dense_tensor));
 
     TF_RETURN_IF_ERROR(
         (*value_store).MakeDense(dense_tensor, resolved_shape, default_value));
@@ -488,12 +548,6 @@ class ParseAvroOp : public OpKernel {
     auto serialized_t = serialized->flat<tstring>();
     gtl::ArraySlice<tstring> slice(serialized_t.data(), serialized_t.size());
 
-    AvroResult result;
-    OP_REQUIRES_OK(
-        ctx, ParseAvro(config, parser_tree_, reader_schema_, slice,
-                       ctx->device()->tensorflow_cpu_worker_threads()->workers,
-                       &result));
-
     OpOutputList dense_values;
     OpOutputList sparse_indices;
     OpOutputList sparse_values;
@@ -502,9 +556,21 @@ class ParseAvroOp : public OpKernel {
     OP_REQUIRES_OK(ctx, ctx->output_list("sparse_indices", &sparse_indices));
     OP_REQUIRES_OK(ctx, ctx->output_list("sparse_values", &sparse_values));
     OP_REQUIRES_OK(ctx, ctx->output_list("sparse_shapes", &sparse_shapes));
-    for (size_t d = 0; d < num_dense_; ++d) {
-      dense_values.set(d, result.dense_values[d]);
-    }
+
+    auto allocate_dense = [&dense_values](size_t d, const TensorShape& shape,
+                                          Tensor** tensor) -> Status {
+      return dense_values.allocate(d, shape, tensor);
+    };
+
+    std::unique_ptr<AvroValueStores> stores = stores_pool_.Get();
+    AvroResult result;
+    Status status =
+        ParseAvro(config, parser_tree_, reader_schema_, slice,
+                  ctx->device()->tensorflow_cpu_worker_threads()->workers,
+                  stores.get(), allocate_dense, &result);
+    stores_pool_.Return(std::move(stores));
+    OP_REQUIRES_OK(ctx, status);
+
     for (size_t d = 0; d < num_sparse_; ++d) {
       sparse_indices.set(d, result.sparse_indices[d]);
       sparse_values.set(d, result.sparse_values[d]);
@@ -524,6 +590,7 @@ class ParseAvroOp : public OpKernel {
   size_t num_dense_;
   size_t num_sparse_;
   int64 avro_num_minibatches_;
+  AvroValueStoresPool stores_pool_;
 
  private:
   std::vector<std::pair<string, DataType>> CreateKeysAndTypes() {
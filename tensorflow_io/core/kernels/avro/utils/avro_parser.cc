@@ -11,7 +11,6 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow_io/core/kernels/avro/utils/avro_parser.h"
 
-#include <queue>
 #include <sstream>
 
 namespace tensorflow {
@@ -26,30 +25,28 @@ const std::vector<AvroParserSharedPtr> AvroParser::GetChildren() const {
   return children_;
 }
 
-void AvroParser::ComputeFinalDescendents() {
-  std::queue<AvroParserSharedPtr> current;
-  const std::vector<AvroParserSharedPtr>& children = GetChildren();
-  for (const auto& child : children) {
-    current.push(child);
-  }
-  // Helper variable for children of subsequent nodes
-  while (!current.empty()) {
-    if ((*current.front()).IsTerminal()) {
-      final_descendents_.push_back(current.front());
-    } else {
-      const std::vector<AvroParserSharedPtr>& children =
-          (*current.front()).GetChildren();
-      for (const auto& child : children) {
-        current.push(child);
-      }
-    }
-    current.pop();
+Status AvroParser::CompileChildren(AvroParserProgram* program) const {
+  for (const AvroParserSharedPtr& child : children_) {
+    TF_RETURN_IF_ERROR((*child).Compile(program));
   }
+  return Status::OK();
+}
+
+Status AvroParser::CompileWithChildren(AvroParserProgram* program,
+                                       AvroParserOp op) const {
+  size_t pc = (*program).Emit(std::move(op), GetSupportedTypes());
+  TF_RETURN_IF_ERROR(CompileChildren(program));
+  (*program).Seal(pc);
+  return Status::OK();
 }
 
-const std::vector<AvroParserSharedPtr> AvroParser::GetFinalDescendents() const {
-  // Return the final descendents
-  return final_descendents_;
+Status AvroParser::CompileValue(AvroParserProgram* program,
+                                AvroParserOp::Code code) const {
+  AvroParserOp op;
+  op.code = code;
+  op.name = key_;
+  TF_RETURN_IF_ERROR((*program).GetSlot(key_, &op.slot));
+  return CompileWithChildren(program, std::move(op));
 }
 
 string AvroParser::ChildrenToString(size_t level) const {
@@ -68,89 +65,17 @@ string AvroParser::LevelToString(size_t level) const {
   return ss.str();
 }
 
-// Null will only resolve if
-// -- the null appears in a union with a primitive type -- by construction
-// (otherwise no default)
-// -- the user supplied a scalar default tensor
-// -- the user supplied a type that matches the primitive type
-// For sparse tensors will null entries in their values or indices
-// this will fail which is the correct behavior.
-Status CheckValidDefault(const string& key,
-                         const std::map<string, Tensor>& defaults,
-                         DataType expected) {
-  if (defaults.find(key) == defaults.end()) {
-    return errors::InvalidArgument("For key '", key,
-                                   "' cannot find a default value.");
-  }
-  const Tensor& default_value = defaults.at(key);
-  if (!TensorShapeUtils::IsScalar(default_value.shape())) {
-    return errors::InvalidArgument(
-        "For key '", key,
-        "' expected scalar default but got tensor with shape ",
-        default_value.shape());
-  }
-  if (expected != default_value.dtype()) {
-    return errors::InvalidArgument("For key '", key, "' expected data type ",
-                                   expected, "' but got data type '",
-                                   default_value.dtype(), "'.");
-  }
-  return Status::OK();
-}
-
-// This implementation assumes there is at least one expected type
-string TypeErrorMessage(const std::set<avro::Type>& expected,
-                        avro::Type actual) {
-  string message = "";
-  for (avro::Type t : expected) {
-    message += ", '" + toString(t) + "'";
-  }
-  // Remove 2 for leading comma and blank -- here we assume there is at least
-  // one
-  return "Expected types: " + message.substr(2) + " but got type " +
-         toString(actual) + ".";
-}
-
 BoolValueParser::BoolValueParser(const string& key) : AvroParser(key) {}
-Status BoolValueParser::Parse(std::map<string, ValueStoreUniquePtr>* values,
-                              const avro::GenericDatum& datum,
-                              const std::map<string, Tensor>& defaults) const {
-  bool value;
-  if (datum.type() == avro::AVRO_BOOL) {
-    value = datum.value<bool>();
-  } else if (datum.type() == avro::AVRO_NULL) {
-    TF_RETURN_IF_ERROR(CheckValidDefault(key_, defaults, DT_BOOL));
-    value = defaults.at(key_).flat<bool>()(0);
-  } else {
-    return errors::InvalidArgument(
-        TypeErrorMessage(GetSupportedTypes(), datum.type()));
-  }
-
-  (*reinterpret_cast<BoolValueBuffer*>((*values).at(key_).get())).Add(value);
-  return Status::OK();
+Status BoolValueParser::Compile(AvroParserProgram* program) const {
+  return CompileValue(program, AvroParserOp::kBool);
 }
 string BoolValueParser::ToString(size_t level) const {
   return LevelToString(level) + "|---BoolValue(" + key_ + ")\n";
 }
 
 LongValueParser::LongValueParser(const string& key) : AvroParser(key) {}
-Status LongValueParser::Parse(std::map<string, ValueStoreUniquePtr>* values,
-                              const avro::GenericDatum& datum,
-                              const std::map<string, Tensor>& defaults) const {
-  long value;
-  if (datum.type() == avro::AVRO_LONG) {
-    value = datum.value<long>();
-  } else if (datum.type() == avro::AVRO_NULL) {
-    TF_RETURN_IF_ERROR(CheckValidDefault(key_, defaults, DT_INT64));
-    value = defaults.at(key_).flat<int64>()(0);
-  } else {
-    return errors::InvalidArgument(
-        TypeErrorMessage(GetSupportedTypes(), datum.type()));
-  }
-
-  // Assume the key exists and cast is possible
-  (*reinterpret_cast<LongValueBuffer*>((*values).at(key_).get())).Add(value);
-
-  return Status::OK();
+Status LongValueParser::Compile(AvroParserProgram* program) const {
+  return CompileValue(program, AvroParserOp::kLong);
 }
 
 string LongValueParser::ToString(size_t level) const {
@@ -158,23 +83,8 @@ string LongValueParser::ToString(size_t level) const {
 }
 
 IntValueParser::IntValueParser(const string& key) : AvroParser(key) {}
-Status IntValueParser::Parse(std::map<string, ValueStoreUniquePtr>* values,
-                             const avro::GenericDatum& datum,
-                             const std::map<string, Tensor>& defaults) const {
-  int value;
-  if (datum.type() == avro::AVRO_INT) {
-    value = datum.value<int>();
-  } else if (datum.type() == avro::AVRO_NULL) {
-    TF_RETURN_IF_ERROR(CheckValidDefault(key_, defaults, DT_INT32));
-    value = defaults.at(key_).flat<int32>()(0);
-  } else {
-    return errors::InvalidArgument(
-        TypeErrorMessage(GetSupportedTypes(), datum.type()));
-  }
-  // Assume the key exists and cast is possible
-  (*reinterpret_cast<IntValueBuffer*>((*values).at(key_).get())).Add(value);
-
-  return Status::OK();
+Status IntValueParser::Compile(AvroParserProgram* program) const {
+  return CompileValue(program, AvroParserOp::kInt);
 }
 
 string IntValueParser::ToString(size_t level) const {
@@ -182,24 +92,8 @@ string IntValueParser::ToString(size_t level) const {
 }
 
 DoubleValueParser::DoubleValueParser(const string& key) : AvroParser(key) {}
-Status DoubleValueParser::Parse(
-    std::map<string, ValueStoreUniquePtr>* values,
-    const avro::GenericDatum& datum,
-    const std::map<string, Tensor>& defaults) const {
-  double value;
-  if (datum.type() == avro::AVRO_DOUBLE) {
-    value = datum.value<double>();
-  } else if (datum.type() == avro::AVRO_NULL) {
-    TF_RETURN_IF_ERROR(CheckValidDefault(key_, defaults, DT_DOUBLE));
-    value = defaults.at(key_).flat<double>()(0);
-  } else {
-    return errors::InvalidArgument(
-        TypeErrorMessage(GetSupportedTypes(), datum.type()));
-  }
-  // Assume the key exists and cast is possible
-  (*reinterpret_cast<DoubleValueBuffer*>((*values)[key_].get())).Add(value);
-
-  return Status::OK();
+Status DoubleValueParser::Compile(AvroParserProgram* program) const {
+  return CompileValue(program, AvroParserOp::kDouble);
 }
 
 string DoubleValueParser::ToString(size_t level) const {
@@ -207,23 +101,8 @@ string DoubleValueParser::ToString(size_t level) const {
 }
 
 FloatValueParser::FloatValueParser(const string& key) : AvroParser(key) {}
-Status FloatValueParser::Parse(std::map<string, ValueStoreUniquePtr>* values,
-                               const avro::GenericDatum& datum,
-                               const std::map<string, Tensor>& defaults) const {
-  float value;
-  if (datum.type() == avro::AVRO_FLOAT) {
-    value = datum.value<float>();
-  } else if (datum.type() == avro::AVRO_NULL) {
-    TF_RETURN_IF_ERROR(CheckValidDefault(key_, defaults, DT_FLOAT));
-    value = defaults.at(key_).flat<float>()(0);
-  } else {
-    return errors::InvalidArgument(
-        TypeErrorMessage(GetSupportedTypes(), datum.type()));
-  }
-  // Assume the key exists and cast is possible
-  (*reinterpret_cast<FloatValueBuffer*>((*values)[key_].get())).Add(value);
-
-  return Status::OK();
+Status FloatValueParser::Compile(AvroParserProgram* program) const {
+  return CompileValue(program, AvroParserOp::kFloat);
 }
 
 string FloatValueParser::ToString(size_t level) const {
@@ -233,45 +112,9 @@ string FloatValueParser::ToString(size_t level) const {
 StringBytesEnumFixedValueParser::StringBytesEnumFixedValueParser(
     const string& key)
     : AvroParser(key) {}
-Status StringBytesEnumFixedValueParser::Parse(
-    std::map<string, ValueStoreUniquePtr>* values,
-    const avro::GenericDatum& datum,
-    const std::map<string, Tensor>& defaults) const {
-  string value;
-  switch (datum.type()) {
-    case avro::AVRO_STRING:
-      value = datum.value<string>();
-      break;
-    case avro::AVRO_BYTES: {
-      const std::vector<uint8_t>& v = datum.value<std::vector<uint8_t>>();
-      if (v.size() > 0) {
-        value.resize(v.size());
-        memcpy(&value[0], &v[0], v.size());
-      }
-    } break;
-    case avro::AVRO_ENUM:
-      value = datum.value<avro::GenericEnum>().symbol();
-      break;
-    case avro::AVRO_FIXED: {
-      const std::vector<uint8_t>& v = datum.value<avro::GenericFixed>().value();
-      if (v.size() > 0) {
-        value.resize(v.size());
-        memcpy(&value[0], &v[0], v.size());
-      }
-    } break;
-    case avro::AVRO_NULL:
-      TF_RETURN_IF_ERROR(CheckValidDefault(key_, defaults, DT_STRING));
-      value = defaults.at(key_).flat<tstring>()(0);
-      break;
-    default:
-      return errors::InvalidArgument(
-          TypeErrorMessage(GetSupportedTypes(), datum.type()));
-  }
-  // Assume the key exists and cast is possible
-  (*reinterpret_cast<StringValueBuffer*>((*values)[key_].get()))
-      .AddByRef(value);
-
-  return Status::OK();
+Status StringBytesEnumFixedValueParser::Compile(
+    AvroParserProgram* program) const {
+  return CompileValue(program, AvroParserOp::kString);
 }
 string StringBytesEnumFixedValueParser::ToString(size_t level) const {
   return LevelToString(level) + "|---StringBytesEnumFixedValue(" + key_ + ")\n";
@@ -281,42 +124,10 @@ string StringBytesEnumFixedValueParser::ToString(size_t level) const {
 // Concrete implementations of value parsers
 // ------------------------------------------------------------
 ArrayAllParser::ArrayAllParser() : AvroParser("") {}
-Status ArrayAllParser::Parse(std::map<string, ValueStoreUniquePtr>* values,
-                             const avro::GenericDatum& datum,
-                             const std::map<string, Tensor>& defaults) const {
-  if (datum.type() != avro::AVRO_ARRAY) {
-    return errors::InvalidArgument(
-        TypeErrorMessage(GetSupportedTypes(), datum.type()));
-  }
-
-  std::vector<avro::GenericDatum> data =
-      datum.value<avro::GenericArray>().value();
-
-  const std::vector<AvroParserSharedPtr>& children(GetChildren());
-  const std::vector<AvroParserSharedPtr>& final_descendents(
-      GetFinalDescendents());
-
-  // Add a begin mark to all value buffers under this array
-  for (const AvroParserSharedPtr& value_parser : final_descendents) {
-    // Assumes the key exists in the map
-    (*(*values)[(*value_parser).GetKey()]).BeginMark();
-  }
-
-  // Resolve all the values from the array
-  for (const avro::GenericDatum& d : data) {
-    // For all children
-    for (const AvroParserSharedPtr& child : children) {
-      TF_RETURN_IF_ERROR((*child).Parse(values, d, defaults));
-    }
-  }
-
-  // Add a finish mark to all value buffers under this array
-  for (const AvroParserSharedPtr& value_parser : final_descendents) {
-    // Assumes the key exists in the map
-    (*(*values)[(*value_parser).GetKey()]).FinishMark();
-  }
-
-  return Status::OK();
+Status ArrayAllParser::Compile(AvroParserProgram* program) const {
+  AvroParserOp op;
+  op.code = AvroParserOp::kArrayAll;
+  return CompileWithChildren(program, std::move(op));
 }
 string ArrayAllParser::ToString(size_t level) const {
   std::stringstream ss;
@@ -327,36 +138,11 @@ string ArrayAllParser::ToString(size_t level) const {
 
 ArrayIndexParser::ArrayIndexParser(size_t index)
     : AvroParser(""), index_(index) {}
-Status ArrayIndexParser::Parse(std::map<string, ValueStoreUniquePtr>* values,
-                               const avro::GenericDatum& datum,
-                               const std::map<string, Tensor>& defaults) const {
-  if (datum.type() != avro::AVRO_ARRAY) {
-    return errors::InvalidArgument(
-        TypeErrorMessage(GetSupportedTypes(), datum.type()));
-  }
-
-  // Check for valid index
-  std::vector<avro::GenericDatum> data =
-      datum.value<avro::GenericArray>().value();
-  size_t n_elements = data.size();
-
-  if (index_ > n_elements || index_ < 0) {
-    return errors::InvalidArgument("Invalid index ", index_, ". Range [", 0,
-                                   ", ", n_elements, ").");
-  }
-  // retrieve datum
-  const avro::GenericDatum& d = data[index_];
-
-  const std::vector<AvroParserSharedPtr>& children(GetChildren());
-  const std::vector<AvroParserSharedPtr>& final_descendents(
-      GetFinalDescendents());
-
-  // For all children same datum
-  for (const AvroParserSharedPtr& child : children) {
-    TF_RETURN_IF_ERROR((*child).Parse(values, d, defaults));
-  }
-
-  return Status::OK();
+Status ArrayIndexParser::Compile(AvroParserProgram* program) const {
+  AvroParserOp op;
+  op.code = AvroParserOp::kArrayIndex;
+  op.index = index_;
+  return CompileWithChildren(program, std::move(op));
 }
 string ArrayIndexParser::ToString(size_t level) const {
   std::stringstream ss;
@@ -383,64 +169,22 @@ ArrayFilterParser::ArrayFilterType ArrayFilterParser::ToArrayFilterType(
   return kNoConstant;
 }
 
-Status ArrayFilterParser::Parse(
-    std::map<string, ValueStoreUniquePtr>* values,
-    const avro::GenericDatum& datum,
-    const std::map<string, Tensor>& defaults) const {
-  if (datum.type() != avro::AVRO_ARRAY) {
-    return errors::InvalidArgument(
-        TypeErrorMessage(GetSupportedTypes(), datum.type()));
-  }
-
-  const std::vector<AvroParserSharedPtr>& final_descendents =
-      GetFinalDescendents();
-
-  // Add a begin mark to all value buffers under this array
-  for (const AvroParserSharedPtr& value_parser : final_descendents) {
-    // Assumes the key exists in the map
-    (*(*values)[(*value_parser).GetKey()]).BeginMark();
-  }
-
-  // Check for valid index
-  std::vector<avro::GenericDatum> data =
-      datum.value<avro::GenericArray>().value();
-  size_t n_elements = data.size();
-
-  const std::vector<AvroParserSharedPtr>& children(GetChildren());
-
-  for (size_t i_elements = 0; i_elements < n_elements; ++i_elements) {
-    size_t reverse_index = n_elements - i_elements;
-
-    bool add_value = false;
-
-    if (type_ == kRhsIsConstant) {
-      add_value =
-          (*(*values).at(lhs_)).ValueMatchesAtReverseIndex(rhs_, reverse_index);
-    } else if (type_ == kLhsIsConstant) {
-      add_value =
-          (*(*values).at(rhs_)).ValueMatchesAtReverseIndex(lhs_, reverse_index);
-    } else {
-      add_value =
-          (*(*values).at(lhs_))
-              .ValuesMatchAtReverseIndex(*(*values).at(rhs_), reverse_index);
-    }
-
-    if (add_value) {
-      const avro::GenericDatum& d = data[i_elements];
-      // For all children
-      for (const AvroParserSharedPtr& child : children) {
-        TF_RETURN_IF_ERROR((*child).Parse(values, d, defaults));
-      }
-    }
-  }
-
-  // Add a finish mark to all value buffers under this array
-  for (const AvroParserSharedPtr& value_parser : final_descendents) {
-    // Assumes the key exists in the map
-    (*(*values)[(*value_parser).GetKey()]).FinishMark();
+Status ArrayFilterParser::Compile(AvroParserProgram* program) const {
+  AvroParserOp op;
+  op.code = AvroParserOp::kArrayFilter;
+  // The op always compares the store in slot against either the constant or
+  // the store in rhs_slot
+  if (type_ == kRhsIsConstant) {
+    TF_RETURN_IF_ERROR((*program).GetSlot(lhs_, &op.slot));
+    op.constant = rhs_;
+  } else if (type_ == kLhsIsConstant) {
+    TF_RETURN_IF_ERROR((*program).GetSlot(rhs_, &op.slot));
+    op.constant = lhs_;
+  } else {
+    TF_RETURN_IF_ERROR((*program).GetSlot(lhs_, &op.slot));
+    TF_RETURN_IF_ERROR((*program).GetSlot(rhs_, &op.rhs_slot));
   }
-
-  return Status::OK();
+  return CompileWithChildren(program, std::move(op));
 }
 string ArrayFilterParser::ToString(size_t level) const {
   std::stringstream ss;
@@ -451,37 +195,11 @@ string ArrayFilterParser::ToString(size_t level) const {
 }
 
 MapKeyParser::MapKeyParser(const string& key) : AvroParser(""), key_(key) {}
-Status MapKeyParser::Parse(std::map<string, ValueStoreUniquePtr>* values,
-                           const avro::GenericDatum& datum,
-                           const std::map<string, Tensor>& defaults) const {
-  if (datum.type() != avro::AVRO_MAP) {
-    return errors::InvalidArgument(
-        TypeErrorMessage(GetSupportedTypes(), datum.type()));
-  }
-
-  std::vector<std::pair<std::string, avro::GenericDatum>> data =
-      datum.value<avro::GenericMap>().value();
-  size_t n_elements = data.size();
-
-  // TODO(fraudies): Optimize by caching in a map
-  bool found = false;
-  for (size_t i_elements = 0; i_elements < n_elements && !found; ++i_elements) {
-    const auto& keyValue = data[i_elements];
-    found = keyValue.first == key_;
-    if (found) {
-      // For all children
-      const std::vector<AvroParserSharedPtr>& children(GetChildren());
-      for (const AvroParserSharedPtr& child : children) {
-        TF_RETURN_IF_ERROR((*child).Parse(values, keyValue.second, defaults));
-      }
-    }
-  }
-
-  if (!found) {
-    return errors::InvalidArgument("Unable to find key '", key_, "'.");
-  }
-
-  return Status::OK();
+Status MapKeyParser::Compile(AvroParserProgram* program) const {
+  AvroParserOp op;
+  op.code = AvroParserOp::kMapKey;
+  op.name = key_;
+  return CompileWithChildren(program, std::move(op));
 }
 string MapKeyParser::ToString(size_t level) const {
   std::stringstream ss;
@@ -491,32 +209,11 @@ string MapKeyParser::ToString(size_t level) const {
 }
 
 RecordParser::RecordParser(const string& name) : AvroParser(""), name_(name) {}
-Status RecordParser::Parse(std::map<string, ValueStoreUniquePtr>* values,
-                           const avro::GenericDatum& datum,
-                           const std::map<string, Tensor>& defaults) const {
-  if (datum.type() != avro::AVRO_RECORD) {
-    return errors::InvalidArgument(
-        TypeErrorMessage(GetSupportedTypes(), datum.type()));
-  }
-
-  // Convert to record
-  const avro::GenericRecord& record = datum.value<avro::GenericRecord>();
-
-  // Return error if the field name does not exist
-  if (!record.hasField(name_)) {
-    return errors::InvalidArgument("Unable to find name '", name_, "'.");
-  }
-
-  // Get datum for field
-  const avro::GenericDatum& d = record.field(name_);
-
-  // Parse all children with this datum
-  const std::vector<AvroParserSharedPtr>& children(GetChildren());
-  for (const AvroParserSharedPtr& child : children) {
-    TF_RETURN_IF_ERROR((*child).Parse(values, d, defaults));
-  }
-
-  return Status::OK();
+Status RecordParser::Compile(AvroParserProgram* program) const {
+  AvroParserOp op;
+  op.code = AvroParserOp::kRecord;
+  op.name = name_;
+  return CompileWithChildren(program, std::move(op));
 }
 string RecordParser::ToString(size_t level) const {
   std::stringstream ss;
@@ -528,33 +225,13 @@ string RecordParser::ToString(size_t level) const {
 
 UnionParser::UnionParser(const string& type_name)
     : AvroParser(""), type_name_(type_name) {}
-Status UnionParser::Parse(std::map<string, ValueStoreUniquePtr>* values,
-                          const avro::GenericDatum& datum,
-                          const std::map<string, Tensor>& defaults) const {
-  // Note, in this case we don't know the type
-  // 2nd note, we don't need to resolve the branch, it's done already by the
-  // read datum
-  avro::Type datum_type = datum.type();
-
-  // Find the right child for this type
-  const std::vector<AvroParserSharedPtr>& children(GetChildren());
-  for (const AvroParserSharedPtr& child : children) {
-    const std::set<avro::Type>& supported_types = (*child).GetSupportedTypes();
-    // The child parser supports the data type, could be Null as well
-    if (supported_types.find(datum_type) != supported_types.end()) {
-      VLOG(5) << "For key '" << child->GetKey() << "' parse datum type '"
-              << toString(datum_type) << "'.";
-      TF_RETURN_IF_ERROR((*child).Parse(values, datum, defaults));
-      // For any other type that is part of the branch resolve the null type
-    } else if (supported_types.find(avro::AVRO_NULL) != supported_types.end()) {
-      VLOG(5) << "For key '" << child->GetKey() << "' parse by using default";
-      TF_RETURN_IF_ERROR(
-          (*child).Parse(values, avro::GenericDatum(), defaults));
-    }
-  }
-  // We could not find the right child, log a warning since this datum is lost
-  // LOG(WARN) << "Branch value in data is not consumed";
-  return Status::OK();
+Status UnionParser::Compile(AvroParserProgram* program) const {
+  // The union op resolves the branch per child by the types supported by the
+  // child ops
+  AvroParserOp op;
+  op.code = AvroParserOp::kUnion;
+  op.name = type_name_;
+  return CompileWithChildren(program, std::move(op));
 }
 string UnionParser::ToString(size_t level) const {
   std::stringstream ss;
@@ -565,14 +242,9 @@ string UnionParser::ToString(size_t level) const {
 }
 
 RootParser::RootParser() : AvroParser("") {}
-Status RootParser::Parse(std::map<string, ValueStoreUniquePtr>* values,
-                         const avro::GenericDatum& datum,
-                         const std::map<string, Tensor>& defaults) const {
-  const std::vector<AvroParserSharedPtr>& children(GetChildren());
-  for (const AvroParserSharedPtr& child : children) {
-    TF_RETURN_IF_ERROR((*child).Parse(values, datum, defaults));
-  }
-  return Status::OK();
+Status RootParser::Compile(AvroParserProgram* program) const {
+  // The root has no op, its children are the top level of the program
+  return CompileChildren(program);
 }
 string RootParser::ToString(size_t level) const {
   std::stringstream ss;
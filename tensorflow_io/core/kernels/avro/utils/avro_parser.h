@@ -20,6 +20,7 @@ limitations under the License.
 #include "api/Generic.hh"
 #include "api/Types.hh"
 #include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow_io/core/kernels/avro/utils/avro_parser_program.h"
 #include "tensorflow_io/core/kernels/avro/utils/value_buffer.h"
 
 namespace tensorflow {
@@ -39,15 +40,10 @@ class AvroParser {
   // clean up its memory.
   virtual ~AvroParser() {}
 
-  // This must be called before using parsers for arrays once the entire tree is
-  // constructed
-  void ComputeFinalDescendents();
-
-  // Parse will traverse the sub-tree of this value and fill all values into
-  // `parsed_values` may also read from parsed values if filtering
-  virtual Status Parse(std::map<string, ValueStoreUniquePtr>* parsed_values,
-                       const avro::GenericDatum& datum,
-                       const std::map<string, Tensor>& defaults) const = 0;
+  // Compile will append the ops for the sub-tree of this parser to the
+  // program, value parsers address their value stores by the slot for their
+  // key
+  virtual Status Compile(AvroParserProgram* program) const = 0;
 
   // Add a child to this avro parser
   inline void AddChild(const AvroParserSharedPtr& child) {
@@ -67,8 +63,16 @@ class AvroParser {
   virtual std::set<avro::Type> GetSupportedTypes() const = 0;
 
  protected:
-  // Get the final descendents for this avro parser
-  const std::vector<AvroParserSharedPtr> GetFinalDescendents() const;
+  // Compile all children into the program
+  Status CompileChildren(AvroParserProgram* program) const;
+
+  // Emit the op for this parser, followed by the ops for all children
+  Status CompileWithChildren(AvroParserProgram* program,
+                             AvroParserOp op) const;
+
+  // Emit the value op for this parser, the op addresses the store for key_
+  Status CompileValue(AvroParserProgram* program,
+                      AvroParserOp::Code code) const;
 
   // Convert all children into a string representation
   string ChildrenToString(size_t level) const;
@@ -80,15 +84,8 @@ class AvroParser {
   string key_;
 
  private:
-  // Is this a terminal parser node
-  inline bool IsTerminal() const { return children_.size() == 0; }
-
   // Children for this avro parser
   std::vector<AvroParserSharedPtr> children_;
-
-  // The final descendents of this parser are computed upon first call and then
-  // cached
-  std::vector<AvroParserSharedPtr> final_descendents_;
 };
 
 // Parser for primitive types
@@ -96,9 +93,7 @@ class AvroParser {
 class BoolValueParser : public AvroParser {
  public:
   BoolValueParser(const string& key);
-  Status Parse(std::map<string, ValueStoreUniquePtr>* values,
-               const avro::GenericDatum& datum,
-               const std::map<string, Tensor>& defaults) const override;
+  Status Compile(AvroParserProgram* program) const override;
   virtual string ToString(size_t level = 0) const;
   inline std::set<avro::Type> GetSupportedTypes() const override {
     return {avro::AVRO_BOOL, avro::AVRO_NULL};
@@ -109,9 +104,7 @@ class BoolValueParser : public AvroParser {
 class LongValueParser : public AvroParser {
  public:
   LongValueParser(const string& key);
-  Status Parse(std::map<string, ValueStoreUniquePtr>* values,
-               const avro::GenericDatum& datum,
-               const std::map<string, Tensor>& defaults) const override;
+  Status Compile(AvroParserProgram* program) const override;
   virtual string ToString(size_t level = 0) const;
   inline std::set<avro::Type> GetSupportedTypes() const override {
     return {avro::AVRO_LONG, avro::AVRO_NULL};
@@ -122,9 +115,7 @@ class LongValueParser : public AvroParser {
 class IntValueParser : public AvroParser {
  public:
   IntValueParser(const string& key);
-  Status Parse(std::map<string, ValueStoreUniquePtr>* values,
-               const avro::GenericDatum& datum,
-               const std::map<string, Tensor>& defaults) const override;
+  Status Compile(AvroParserProgram* program) const override;
   virtual string ToString(size_t level = 0) const;
   inline std::set<avro::Type> GetSupportedTypes() const override {
     return {avro::AVRO_INT, avro::AVRO_NULL};
@@ -135,9 +126,7 @@ class IntValueParser : public AvroParser {
 class DoubleValueParser : public AvroParser {
  public:
   DoubleValueParser(const string& key);
-  Status Parse(std::map<string, ValueStoreUniquePtr>* values,
-               const avro::GenericDatum& datum,
-               const std::map<string, Tensor>& defaults) const override;
+  Status Compile(AvroParserProgram* program) const override;
   virtual string ToString(size_t level = 0) const;
   inline std::set<avro::Type> GetSupportedTypes() const override {
     return {avro::AVRO_DOUBLE, avro::AVRO_NULL};
@@ -148,9 +137,7 @@ class DoubleValueParser : public AvroParser {
 class FloatValueParser : public AvroParser {
  public:
   FloatValueParser(const string& key);
-  Status Parse(std::map<string, ValueStoreUniquePtr>* values,
-               const avro::GenericDatum& datum,
-               const std::map<string, Tensor>& defaults) const override;
+  Status Compile(AvroParserProgram* program) const override;
   virtual string ToString(size_t level = 0) const;
   inline std::set<avro::Type> GetSupportedTypes() const override {
     return {avro::AVRO_FLOAT, avro::AVRO_NULL};
@@ -163,9 +150,7 @@ class FloatValueParser : public AvroParser {
 class StringBytesEnumFixedValueParser : public AvroParser {
  public:
   StringBytesEnumFixedValueParser(const string& key);
-  Status Parse(std::map<string, ValueStoreUniquePtr>* values,
-               const avro::GenericDatum& datum,
-               const std::map<string, Tensor>& defaults) const override;
+  Status Compile(AvroParserProgram* program) const override;
   virtual string ToString(size_t level = 0) const;
   inline std::set<avro::Type> GetSupportedTypes() const override {
     return {avro::AVRO_STRING, avro::AVRO_BYTES, avro::AVRO_ENUM,
@@ -177,9 +162,7 @@ class StringBytesEnumFixedValueParser : public AvroParser {
 class ArrayAllParser : public AvroParser {
  public:
   ArrayAllParser();
-  Status Parse(std::map<string, ValueStoreUniquePtr>* values,
-               const avro::GenericDatum& datum,
-               const std::map<string, Tensor>& defaults) const override;
+  Status Compile(AvroParserProgram* program) const override;
   virtual string ToString(size_t level = 0) const;
   inline std::set<avro::Type> GetSupportedTypes() const override {
     return {avro::AVRO_ARRAY};
@@ -190,9 +173,7 @@ class ArrayAllParser : public AvroParser {
 class ArrayIndexParser : public AvroParser {
  public:
   ArrayIndexParser(size_t index);
-  Status Parse(std::map<string, ValueStoreUniquePtr>* values,
-               const avro::GenericDatum& datum,
-               const std::map<string, Tensor>& defaults) const override;
+  Status Compile(AvroParserProgram* program) const override;
   virtual string ToString(size_t level = 0) const;
   inline std::set<avro::Type> GetSupportedTypes() const override {
     return {avro::AVRO_ARRAY};
@@ -208,9 +189,7 @@ class ArrayFilterParser : public AvroParser {
   enum ArrayFilterType { kLhsIsConstant, kRhsIsConstant, kNoConstant };
   ArrayFilterParser(const tstring& lhs, const tstring& rhs,
                     ArrayFilterType type);
-  Status Parse(std::map<string, ValueStoreUniquePtr>* values,
-               const avro::GenericDatum& datum,
-               const std::map<string, Tensor>& defaults) const override;
+  Status Compile(AvroParserProgram* program) const override;
   virtual string ToString(size_t level = 0) const;
   static ArrayFilterType ToArrayFilterType(bool lhs_is_constant,
                                            bool rhs_is_constant);
@@ -228,9 +207,7 @@ class ArrayFilterParser : public AvroParser {
 class MapKeyParser : public AvroParser {
  public:
   MapKeyParser(const string& key);
-  Status Parse(std::map<string, ValueStoreUniquePtr>* values,
-               const avro::GenericDatum& datum,
-               const std::map<string, Tensor>& defaults) const override;
+  Status Compile(AvroParserProgram* program) const override;
   virtual string ToString(size_t level = 0) const;
   inline std::set<avro::Type> GetSupportedTypes() const override {
     return {avro::AVRO_MAP};
@@ -248,9 +225,7 @@ class RecordParser : public AvroParser {
   // check that an attribute with name exists
   // get the the attribute for the name and return it in the vector as single
   // element
-  Status Parse(std::map<string, ValueStoreUniquePtr>* values,
-               const avro::GenericDatum& datum,
-               const std::map<string, Tensor>& defaults) const override;
+  Status Compile(AvroParserProgram* program) const override;
   virtual string ToString(size_t level = 0) const;
   inline std::set<avro::Type> GetSupportedTypes() const override {
     return {avro::AVRO_RECORD};
@@ -264,9 +239,7 @@ class RecordParser : public AvroParser {
 class UnionParser : public AvroParser {
  public:
   UnionParser(const string& type_name);
-  Status Parse(std::map<string, ValueStoreUniquePtr>* values,
-               const avro::GenericDatum& datum,
-               const std::map<string, Tensor>& defaults) const override;
+  Status Compile(AvroParserProgram* program) const override;
   virtual string ToString(size_t level = 0) const;
   inline std::set<avro::Type> GetSupportedTypes() const override {
     return {avro::AVRO_UNION};
@@ -280,9 +253,7 @@ class UnionParser : public AvroParser {
 class RootParser : public AvroParser {
  public:
   RootParser();
-  Status Parse(std::map<string, ValueStoreUniquePtr>* values,
-               const avro::GenericDatum& datum,
-               const std::map<string, Tensor>& defaults) const override;
+  Status Compile(AvroParserProgram* program) const override;
   virtual string ToString(size_t level = 0) const;
   // Note, abuse of unknown symbol
   inline std::set<avro::Type> GetSupportedTypes() const override {
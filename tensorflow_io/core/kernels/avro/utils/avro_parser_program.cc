@@ -0,0 +1,366 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow_io/core/kernels/avro/utils/avro_parser_program.h"
+
+#include <sstream>
+
+#include "tensorflow/core/lib/core/errors.h"
+
+namespace tensorflow {
+namespace data {
+
+namespace {
+
+inline uint64 TypeBit(avro::Type type) {
+  return type < 0 ? 0 : (uint64{1} << type);
+}
+
+inline bool SupportsType(const AvroParserOp& op, avro::Type type) {
+  return (op.types & TypeBit(type)) != 0;
+}
+
+// This implementation assumes there is at least one expected type
+string TypeErrorMessage(uint64 expected, avro::Type actual) {
+  string message = "";
+  for (int t = 0; t < avro::AVRO_NUM_TYPES; ++t) {
+    if (expected & TypeBit(static_cast<avro::Type>(t))) {
+      message += ", '" + toString(static_cast<avro::Type>(t)) + "'";
+    }
+  }
+  // Remove 2 for leading comma and blank -- here we assume there is at least
+  // one
+  return "Expected types: " + message.substr(2) + " but got type " +
+         toString(actual) + ".";
+}
+
+// Null will only resolve if
+// -- the null appears in a union with a primitive type -- by construction
+// (otherwise no default)
+// -- the user supplied a scalar default tensor
+// -- the user supplied a type that matches the primitive type
+// For sparse tensors will null entries in their values or indices
+// this will fail which is the correct behavior.
+Status CheckValidDefault(const string& key, const Tensor* default_value,
+                         DataType expected) {
+  if (default_value == nullptr) {
+    return errors::InvalidArgument("For key '", key,
+                                   "' cannot find a default value.");
+  }
+  if (!TensorShapeUtils::IsScalar(default_value->shape())) {
+    return errors::InvalidArgument(
+        "For key '", key,
+        "' expected scalar default but got tensor with shape ",
+        default_value->shape());
+  }
+  if (expected != default_value->dtype()) {
+    return errors::InvalidArgument("For key '", key, "' expected data type ",
+                                   expected, "' but got data type '",
+                                   default_value->dtype(), "'.");
+  }
+  return Status::OK();
+}
+
+const char* CodeToString(AvroParserOp::Code code) {
+  switch (code) {
+    case AvroParserOp::kBool:
+      return "Bool";
+    case AvroParserOp::kInt:
+      return "Int";
+    case AvroParserOp::kLong:
+      return "Long";
+    case AvroParserOp::kFloat:
+      return "Float";
+    case AvroParserOp::kDouble:
+      return "Double";
+    case AvroParserOp::kString:
+      return "String";
+    case AvroParserOp::kArrayAll:
+      return "ArrayAll";
+    case AvroParserOp::kArrayIndex:
+      return "ArrayIndex";
+    case AvroParserOp::kArrayFilter:
+      return "ArrayFilter";
+    case AvroParserOp::kMapKey:
+      return "MapKey";
+    case AvroParserOp::kRecord:
+      return "Record";
+    case AvroParserOp::kUnion:
+      return "Union";
+  }
+  return "Unknown";
+}
+
+inline bool IsValueCode(AvroParserOp::Code code) {
+  return code <= AvroParserOp::kString;
+}
+
+}  // namespace
+
+AvroParserProgram::AvroParserProgram(const std::vector<string>& keys)
+    : keys_(keys) {
+  for (size_t slot = 0; slot < keys_.size(); ++slot) {
+    key_to_slot_[keys_[slot]] = static_cast<int32>(slot);
+  }
+}
+
+Status AvroParserProgram::GetSlot(const string& key, int32* slot) const {
+  auto key_and_slot = key_to_slot_.find(key);
+  if (key_and_slot == key_to_slot_.end()) {
+    return errors::NotFound("Unable to find key '", key, "'!");
+  }
+  *slot = key_and_slot->second;
+  return Status::OK();
+}
+
+size_t AvroParserProgram::Emit(AvroParserOp op,
+                               const std::set<avro::Type>& types) {
+  for (avro::Type type : types) {
+    op.types |= TypeBit(type);
+  }
+  ops_.push_back(std::move(op));
+  return ops_.size() - 1;
+}
+
+void AvroParserProgram::Seal(size_t pc) {
+  AvroParserOp& op = ops_[pc];
+  op.end = ops_.size();
+  if (op.code == AvroParserOp::kArrayAll ||
+      op.code == AvroParserOp::kArrayFilter) {
+    op.marked_slots.clear();
+    for (size_t i = pc + 1; i < op.end; ++i) {
+      if (IsValueCode(ops_[i].code)) {
+        op.marked_slots.push_back(ops_[i].slot);
+      }
+    }
+  }
+}
+
+Status AvroParserProgram::Execute(const std::vector<ValueStore*>& stores,
+                                  const std::vector<const Tensor*>& defaults,
+                                  const avro::GenericDatum& datum) const {
+  DCHECK_EQ(stores.size(), keys_.size());
+  DCHECK_EQ(defaults.size(), keys_.size());
+  const Frame frame{stores, defaults};
+  return Run(0, ops_.size(), datum, frame);
+}
+
+Status AvroParserProgram::Run(size_t begin, size_t end,
+                              const avro::GenericDatum& datum,
+                              const Frame& frame) const {
+  for (size_t pc = begin; pc < end; pc = ops_[pc].end) {
+    TF_RETURN_IF_ERROR(Step(pc, datum, frame));
+  }
+  return Status::OK();
+}
+
+Status AvroParserProgram::Step(size_t pc, const avro::GenericDatum& datum,
+                               const Frame& frame) const {
+  const AvroParserOp& op = ops_[pc];
+  const avro::Type type = datum.type();
+
+  switch (op.code) {
+    case AvroParserOp::kBool:
+      return AddValue<bool, bool>(op, avro::AVRO_BOOL, datum, frame);
+    case AvroParserOp::kInt:
+      return AddValue<int32, int>(op, avro::AVRO_INT, datum, frame);
+    case AvroParserOp::kLong:
+      return AddValue<int64, long>(op, avro::AVRO_LONG, datum, frame);
+    case AvroParserOp::kFloat:
+      return AddValue<float, float>(op, avro::AVRO_FLOAT, datum, frame);
+    case AvroParserOp::kDouble:
+      return AddValue<double, double>(op, avro::AVRO_DOUBLE, datum, frame);
+    case AvroParserOp::kString:
+      return AddStringValue(op, datum, frame);
+    default:
+      break;
+  }
+
+  // Unions resolve the branch per child, all other structural ops check the
+  // type of the datum itself
+  if (op.code == AvroParserOp::kUnion) {
+    // Note, we don't need to resolve the branch, it's done already by the
+    // read datum
+    for (size_t child = pc + 1; child < op.end; child = ops_[child].end) {
+      const AvroParserOp& child_op = ops_[child];
+      if (SupportsType(child_op, type)) {
+        TF_RETURN_IF_ERROR(Step(child, datum, frame));
+        // For any other type that is part of the branch resolve the null type
+      } else if (SupportsType(child_op, avro::AVRO_NULL)) {
+        static const avro::GenericDatum* null_datum = new avro::GenericDatum();
+        TF_RETURN_IF_ERROR(Step(child, *null_datum, frame));
+      }
+    }
+    return Status::OK();
+  }
+
+  if (!SupportsType(op, type)) {
+    return errors::InvalidArgument(TypeErrorMessage(op.types, type));
+  }
+
+  switch (op.code) {
+    case AvroParserOp::kArrayAll: {
+      const std::vector<avro::GenericDatum>& data =
+          datum.value<avro::GenericArray>().value();
+      BeginMarks(op, frame);
+      for (const avro::GenericDatum& d : data) {
+        TF_RETURN_IF_ERROR(Run(pc + 1, op.end, d, frame));
+      }
+      FinishMarks(op, frame);
+      return Status::OK();
+    }
+    case AvroParserOp::kArrayIndex: {
+      const std::vector<avro::GenericDatum>& data =
+          datum.value<avro::GenericArray>().value();
+      if (op.index >= data.size()) {
+        return errors::InvalidArgument("Invalid index ", op.index, ". Range [",
+                                       0, ", ", data.size(), ").");
+      }
+      return Run(pc + 1, op.end, data[op.index], frame);
+    }
+    case AvroParserOp::kArrayFilter: {
+      const std::vector<avro::GenericDatum>& data =
+          datum.value<avro::GenericArray>().value();
+      const size_t n_elements = data.size();
+      BeginMarks(op, frame);
+      for (size_t i_elements = 0; i_elements < n_elements; ++i_elements) {
+        if (FilterMatches(op, n_elements - i_elements, frame)) {
+          TF_RETURN_IF_ERROR(Run(pc + 1, op.end, data[i_elements], frame));
+        }
+      }
+      FinishMarks(op, frame);
+      return Status::OK();
+    }
+    case AvroParserOp::kMapKey: {
+      const std::vector<std::pair<std::string, avro::GenericDatum>>& data =
+          datum.value<avro::GenericMap>().value();
+      // TODO(fraudies): Optimize by caching in a map
+      for (const auto& key_value : data) {
+        if (key_value.first == op.name) {
+          return Run(pc + 1, op.end, key_value.second, frame);
+        }
+      }
+      return errors::InvalidArgument("Unable to find key '", op.name, "'.");
+    }
+    case AvroParserOp::kRecord: {
+      const avro::GenericRecord& record = datum.value<avro::GenericRecord>();
+      // Return error if the field name does not exist
+      size_t field;
+      if (!record.schema()->nameIndex(op.name, field)) {
+        return errors::InvalidArgument("Unable to find name '", op.name,
+                                       "'.");
+      }
+      return Run(pc + 1, op.end, record.fieldAt(field), frame);
+    }
+    default:
+      return errors::Internal("Unexpected avro parser op ",
+                              CodeToString(op.code));
+  }
+}
+
+template <typename T, typename A>
+Status AvroParserProgram::AddValue(const AvroParserOp& op,
+                                   avro::Type avro_type,
+                                   const avro::GenericDatum& datum,
+                                   const Frame& frame) const {
+  T value;
+  if (datum.type() == avro_type) {
+    value = datum.value<A>();
+  } else if (datum.type() == avro::AVRO_NULL) {
+    const Tensor* default_value = frame.defaults[op.slot];
+    TF_RETURN_IF_ERROR(
+        CheckValidDefault(op.name, default_value, DataTypeToEnum<T>::value));
+    value = default_value->flat<T>()(0);
+  } else {
+    return errors::InvalidArgument(TypeErrorMessage(op.types, datum.type()));
+  }
+  static_cast<ValueBuffer<T>*>(frame.stores[op.slot])->Add(value);
+  return Status::OK();
+}
+
+Status AvroParserProgram::AddStringValue(const AvroParserOp& op,
+                                         const avro::GenericDatum& datum,
+                                         const Frame& frame) const {
+  tstring value;
+  switch (datum.type()) {
+    case avro::AVRO_STRING:
+      value = datum.value<string>();
+      break;
+    case avro::AVRO_BYTES: {
+      const std::vector<uint8_t>& v = datum.value<std::vector<uint8_t>>();
+      value.assign(reinterpret_cast<const char*>(v.data()), v.size());
+    } break;
+    case avro::AVRO_ENUM:
+      value = datum.value<avro::GenericEnum>().symbol();
+      break;
+    case avro::AVRO_FIXED: {
+      const std::vector<uint8_t>& v = datum.value<avro::GenericFixed>().value();
+      value.assign(reinterpret_cast<const char*>(v.data()), v.size());
+    } break;
+    case avro::AVRO_NULL: {
+      const Tensor* default_value = frame.defaults[op.slot];
+      TF_RETURN_IF_ERROR(CheckValidDefault(op.name, default_value, DT_STRING));
+      value = default_value->flat<tstring>()(0);
+    } break;
+    default:
+      return errors::InvalidArgument(TypeErrorMessage(op.types, datum.type()));
+  }
+  static_cast<StringValueBuffer*>(frame.stores[op.slot])->AddByRef(value);
+  return Status::OK();
+}
+
+bool AvroParserProgram::FilterMatches(const AvroParserOp& op,
+                                      size_t reverse_index,
+                                      const Frame& frame) const {
+  const ValueStore& lhs = *frame.stores[op.slot];
+  if (op.rhs_slot < 0) {
+    return lhs.ValueMatchesAtReverseIndex(op.constant, reverse_index);
+  }
+  return lhs.ValuesMatchAtReverseIndex(*frame.stores[op.rhs_slot],
+                                       reverse_index);
+}
+
+void AvroParserProgram::BeginMarks(const AvroParserOp& op,
+                                   const Frame& frame) const {
+  for (int32 slot : op.marked_slots) {
+    frame.stores[slot]->BeginMark();
+  }
+}
+
+void AvroParserProgram::FinishMarks(const AvroParserOp& op,
+                                    const Frame& frame) const {
+  for (int32 slot : op.marked_slots) {
+    frame.stores[slot]->FinishMark();
+  }
+}
+
+string AvroParserProgram::ToString() const {
+  std::stringstream ss;
+  for (size_t pc = 0; pc < ops_.size(); ++pc) {
+    const AvroParserOp& op = ops_[pc];
+    ss << pc << ": " << CodeToString(op.code) << "(" << op.name;
+    if (op.code == AvroParserOp::kArrayIndex) {
+      ss << op.index;
+    } else if (op.code == AvroParserOp::kArrayFilter) {
+      ss << keys_[op.slot] << "="
+         << (op.rhs_slot < 0 ? string(op.constant) : keys_[op.rhs_slot]);
+    }
+    ss << ") end=" << op.end;
+    if (op.slot >= 0 && IsValueCode(op.code)) {
+      ss << " slot=" << op.slot;
+    }
+    ss << std::endl;
+  }
+  return ss.str();
+}
+
+}  // namespace data
+}  // namespace tensorflow
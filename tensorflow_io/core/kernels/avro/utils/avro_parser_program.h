@@ -0,0 +1,155 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_DATA_AVRO_PARSER_PROGRAM_H_
+#define TENSORFLOW_DATA_AVRO_PARSER_PROGRAM_H_
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include "api/Generic.hh"
+#include "api/Types.hh"
+#include "tensorflow_io/core/kernels/avro/utils/value_buffer.h"
+
+namespace tensorflow {
+namespace data {
+
+// A single instruction of a compiled avro parser
+// The ops of a program are stored in pre-order, the children of the op at
+// position pc are the ops in [pc + 1, end)
+struct AvroParserOp {
+  enum Code {
+    // Value ops, these add one value to the store in `slot`
+    kBool,
+    kInt,
+    kLong,
+    kFloat,
+    kDouble,
+    kString,
+    // Structural ops, these select datums for their children
+    kArrayAll,
+    kArrayIndex,
+    kArrayFilter,
+    kMapKey,
+    kRecord,
+    kUnion
+  };
+
+  Code code;
+
+  // Bit mask of the avro types supported by this op, used to resolve unions
+  uint64 types = 0;
+
+  // Position one past the last op of this op's sub-program
+  size_t end = 0;
+
+  // The value store for value ops, the lhs store for filters, -1 otherwise
+  int32 slot = -1;
+
+  // The rhs store for filters, -1 if the rhs is a constant
+  int32 rhs_slot = -1;
+
+  // Slots of all value ops under an array, these receive begin/finish marks
+  std::vector<int32> marked_slots;
+
+  // The user key for value ops, the field name for records, the key for maps,
+  // the branch name for unions
+  string name;
+
+  // The constant for filters that compare against a constant
+  tstring constant;
+
+  // The element index for array index ops
+  size_t index = 0;
+};
+
+// A parser tree compiled into a flat array of ops
+// Value stores are addressed by integer slots that follow the order of the
+// keys the program was created with, which avoids key lookups per datum
+class AvroParserProgram {
+ public:
+  AvroParserProgram() = default;
+
+  // Creates an empty program for the given keys, the position of a key
+  // becomes its slot
+  explicit AvroParserProgram(const std::vector<string>& keys);
+
+  // Get the slot for the key
+  Status GetSlot(const string& key, int32* slot) const;
+
+  // Appends the op to the program and returns its position
+  // The sub-program for the op must be appended before calling `Seal`
+  size_t Emit(AvroParserOp op, const std::set<avro::Type>& types);
+
+  // Ends the sub-program of the op at position pc
+  void Seal(size_t pc);
+
+  // Parses the datum into the stores, indexed by slot
+  // Defaults are indexed by slot as well and may hold nullptr for keys without
+  // default
+  Status Execute(const std::vector<ValueStore*>& stores,
+                 const std::vector<const Tensor*>& defaults,
+                 const avro::GenericDatum& datum) const;
+
+  // Number of slots in this program
+  inline size_t NumSlots() const { return keys_.size(); }
+
+  // Number of ops in this program
+  inline size_t NumOps() const { return ops_.size(); }
+
+  // Convert the program into a human readable string representation
+  string ToString() const;
+
+ private:
+  struct Frame {
+    const std::vector<ValueStore*>& stores;
+    const std::vector<const Tensor*>& defaults;
+  };
+
+  // Runs all sibling ops in [begin, end) on the datum
+  Status Run(size_t begin, size_t end, const avro::GenericDatum& datum,
+             const Frame& frame) const;
+
+  // Runs the op at position pc and its sub-program on the datum
+  Status Step(size_t pc, const avro::GenericDatum& datum,
+              const Frame& frame) const;
+
+  // Adds a primitive value for the value op
+  template <typename T, typename A>
+  Status AddValue(const AvroParserOp& op, avro::Type avro_type,
+                  const avro::GenericDatum& datum, const Frame& frame) const;
+
+  // Adds a string, bytes, enum, or fixed value for the value op
+  Status AddStringValue(const AvroParserOp& op,
+                        const avro::GenericDatum& datum,
+                        const Frame& frame) const;
+
+  // Returns true if the element at the reverse index passes the filter
+  bool FilterMatches(const AvroParserOp& op, size_t reverse_index,
+                     const Frame& frame) const;
+
+  // Add begin/finish marks to all stores under the array op
+  void BeginMarks(const AvroParserOp& op, const Frame& frame) const;
+  void FinishMarks(const AvroParserOp& op, const Frame& frame) const;
+
+  std::vector<AvroParserOp> ops_;
+
+  std::vector<string> keys_;
+
+  // Only used while compiling
+  std::map<string, int32> key_to_slot_;
+};
+
+}  // namespace data
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_DATA_AVRO_PARSER_PROGRAM_H_
@@ -44,14 +44,20 @@ Status AvroParserTree::ParseValues(
     return errors::OutOfRange("eof");
   }
 
-  // new assignment of all buffers
+  // new assignment or reset of all buffers
   TF_RETURN_IF_ERROR(InitializeValueBuffers(key_to_value));
 
+  // Resolve keys to slots once per batch rather than per value
+  std::vector<ValueStore*> stores;
+  std::vector<const Tensor*> slot_defaults;
+  TF_RETURN_IF_ERROR(
+      ResolveSlots(key_to_value, defaults, &stores, &slot_defaults));
+
   // add being marks to all buffers for batch
-  TF_RETURN_IF_ERROR(AddBeginMarks(key_to_value));
+  TF_RETURN_IF_ERROR(AddBeginMarks(stores));
 
   // Parse first value
-  TF_RETURN_IF_ERROR((*root_).Parse(key_to_value, datum, defaults));
+  TF_RETURN_IF_ERROR(program_.Execute(stores, slot_defaults, datum));
   uint64 values_read = 1;
   // Increment before compare because we already read one value
   while (values_read < values_to_parse) {
@@ -61,7 +67,7 @@ Status AvroParserTree::ParseValues(
       return errors::InvalidArgument("Error reading value: ", e.what());
     }
     if (has_value) {
-      TF_RETURN_IF_ERROR((*root_).Parse(key_to_value, datum, defaults));
+      TF_RETURN_IF_ERROR(program_.Execute(stores, slot_defaults, datum));
       values_read++;
     } else {
       break;
@@ -71,7 +77,7 @@ Status AvroParserTree::ParseValues(
   *values_parsed = values_read;
 
   // add end marks to all buffers for batch
-  TF_RETURN_IF_ERROR(AddFinishMarks(key_to_value));
+  TF_RETURN_IF_ERROR(AddFinishMarks(stores));
 
   return Status::OK();
 }
@@ -84,11 +90,17 @@ Status AvroParserTree::ParseValues(
   using clock = std::chrono::system_clock;
   using ms = std::chrono::duration<double, std::milli>;
 
-  // new assignment of all buffers
+  // new assignment or reset of all buffers
   TF_RETURN_IF_ERROR(InitializeValueBuffers(key_to_value));
 
+  // Resolve keys to slots once per batch rather than per value
+  std::vector<ValueStore*> stores;
+  std::vector<const Tensor*> slot_defaults;
+  TF_RETURN_IF_ERROR(
+      ResolveSlots(key_to_value, defaults, &stores, &slot_defaults));
+
   // add being marks to all buffers for batch
-  TF_RETURN_IF_ERROR(AddBeginMarks(key_to_value));
+  TF_RETURN_IF_ERROR(AddBeginMarks(stores));
 
   avro::GenericDatum datum(reader_schema);
 
@@ -101,7 +113,7 @@ Status AvroParserTree::ParseValues(
       break;
     }
     const auto after_read = clock::now();
-    TF_RETURN_IF_ERROR((*root_).Parse(key_to_value, datum, defaults));
+    TF_RETURN_IF_ERROR(program_.Execute(stores, slot_defaults, datum));
     const auto after_parse = clock::now();
     parse_duration += after_parse - after_read;
     read_duration += after_read - before_read;
@@ -112,7 +124,7 @@ Status AvroParserTree::ParseValues(
   VLOG(5) << "PARSER_TIMING: Avro Parse times " << parse_duration.count()
           << " ms ";
   // add end marks to all buffers for batch
-  TF_RETURN_IF_ERROR(AddFinishMarks(key_to_value));
+  TF_RETURN_IF_ERROR(AddFinishMarks(stores));
 
   return Status::OK();
 }
@@ -164,13 +176,14 @@ Status AvroParserTree::Build(AvroParserTree* parser_tree,
                          .Build((*parser_tree).root_.get(),
                                 (*prefix_tree.GetRoot()).GetChildren()));
 
-  // Note, we can initialize only after we built the entire parser tree
-  // Why? Because this will determine the final descendents for each
-  // node in the tree
-  (*parser_tree).Initialize();
-
   VLOG(7) << "Parser tree \n" << (*parser_tree).ToString();
 
+  // Note, we can compile only after we built the entire parser tree
+  // Why? Because array ops mark all value stores in their sub-program
+  TF_RETURN_IF_ERROR((*parser_tree).Compile());
+
+  VLOG(7) << "Parser program \n" << (*parser_tree).program_.ToString();
+
   return Status::OK();
 }
 
@@ -212,19 +225,35 @@ Status AvroParserTree::Build(
   return Status::OK();
 }
 
-void AvroParserTree::Initialize() {
-  // Compute final descendents for each node
-  std::queue<AvroParserSharedPtr> nodes;
-  nodes.push(root_);
-  while (!nodes.empty()) {
-    AvroParserSharedPtr node = nodes.front();
-    nodes.pop();
-    node->ComputeFinalDescendents();
-    const std::vector<AvroParserSharedPtr>& children = node->GetChildren();
-    for (const auto& child : children) {
-      nodes.push(child);
+Status AvroParserTree::Compile() {
+  // The slot of a key is its position in keys_and_types_
+  std::vector<string> keys;
+  keys.reserve(keys_and_types_.size());
+  for (const auto& key_and_type : keys_and_types_) {
+    keys.push_back(key_and_type.first);
+  }
+  program_ = AvroParserProgram(keys);
+  return (*root_).Compile(&program_);
+}
+
+Status AvroParserTree::ResolveSlots(
+    std::map<string, ValueStoreUniquePtr>* key_to_value,
+    const std::map<string, Tensor>& defaults, std::vector<ValueStore*>* stores,
+    std::vector<const Tensor*>* slot_defaults) const {
+  (*stores).resize(keys_and_types_.size());
+  (*slot_defaults).resize(keys_and_types_.size());
+  for (size_t slot = 0; slot < keys_and_types_.size(); ++slot) {
+    const string& key = keys_and_types_[slot].first;
+    auto key_value = (*key_to_value).find(key);
+    if (key_value == (*key_to_value).end()) {
+      return errors::Internal("Missing value buffer for key '", key, "'.");
     }
+    (*stores)[slot] = key_value->second.get();
+    auto key_default = defaults.find(key);
+    (*slot_defaults)[slot] =
+        key_default == defaults.end() ? nullptr : &key_default->second;
   }
+  return Status::OK();
 }
 
 Status AvroParserTree::ValidateUniqueKeys(
@@ -458,18 +487,16 @@ inline bool AvroParserTree::IsBranch(const string& infix) {
                         ":boolean|:int|:long|:float|:double|:bytes|:string");
 }
 
-Status AvroParserTree::AddBeginMarks(
-    std::map<string, ValueStoreUniquePtr>* key_to_value) {
-  for (auto const& key_value : *key_to_value) {
-    (*key_value.second).BeginMark();
+Status AvroParserTree::AddBeginMarks(const std::vector<ValueStore*>& stores) {
+  for (ValueStore* store : stores) {
+    (*store).BeginMark();
   }
   return Status::OK();
 }
 
-Status AvroParserTree::AddFinishMarks(
-    std::map<string, ValueStoreUniquePtr>* key_to_value) {
-  for (auto const& key_value : *key_to_value) {
-    (*key_value.second).FinishMark();
+Status AvroParserTree::AddFinishMarks(const std::vector<ValueStore*>& stores) {
+  for (ValueStore* store : stores) {
+    (*store).FinishMark();
   }
   return Status::OK();
 }
@@ -482,6 +509,16 @@ Status AvroParserTree::InitializeValueBuffers(
     const string& key = key_and_type.first;
     DataType data_type = key_and_type.second;
 
+    // Reuse the storage of a buffer from a previous batch
+    auto key_value = (*key_to_value).find(key);
+    if (key_value != (*key_to_value).end()) {
+      if (key_value->second != nullptr) {
+        (*key_value->second).Clear();
+        continue;
+      }
+      (*key_to_value).erase(key_value);
+    }
+
     switch (data_type) {
       // Fill in the ValueBuffer
       case DT_BOOL:
@@ -65,6 +65,8 @@ class AvroParserTree {
 
   // Parses all values in a batch into the map keyed by the user-defined keys
   // that map to value stores
+  // Value stores already present in the map are cleared and their storage is
+  // reused, which allows callers to pool the map across batches
   Status ParseValues(std::map<string, ValueStoreUniquePtr>* key_to_value,
                      const std::function<bool(avro::GenericDatum&)> read_value,
                      const avro::ValidSchema& reader_schema,
@@ -79,6 +81,9 @@ class AvroParserTree {
   // Returns the root of the parser tree -- exposed for testing
   inline AvroParserSharedPtr getRoot() const { return root_; }
 
+  // Returns the program compiled from the parser tree -- exposed for testing
+  inline const AvroParserProgram& getProgram() const { return program_; }
+
   // Returns a string representation of this parser tree
   // This string representation is human friendly
   // Do not use it to serialize the tree
@@ -96,9 +101,14 @@ class AvroParserTree {
   Status Build(AvroParser* parent,
                const std::vector<PrefixTreeNodeSharedPtr>& children);
 
-  // Initialize will compute the final descendents for each node, called after
-  // build
-  void Initialize();
+  // Compiles the parser tree into a flat program, called after build
+  Status Compile();
+
+  // Collects the value stores and defaults for all keys indexed by slot
+  Status ResolveSlots(std::map<string, ValueStoreUniquePtr>* key_to_value,
+                      const std::map<string, Tensor>& defaults,
+                      std::vector<ValueStore*>* stores,
+                      std::vector<const Tensor*>* slot_defaults) const;
 
   // Creates the value parser for the given infix and user name
   // Note, that this method only creates value parsers for non-primitive avro
@@ -113,6 +123,7 @@ class AvroParserTree {
                                 DataType data_type) const;
 
   // Initializes value buffers for all keys
+  // Buffers that already exist in the map are cleared and reused
   Status InitializeValueBuffers(
       std::map<string, ValueStoreUniquePtr>* key_to_value) const;
 
@@ -130,14 +141,12 @@ class AvroParserTree {
   // Add a begin mark to all value stores
   // This is used to mark the outer-most dimension as begun -- before any
   // element is added
-  static Status AddBeginMarks(
-      std::map<string, ValueStoreUniquePtr>* key_to_value);
+  static Status AddBeginMarks(const std::vector<ValueStore*>& stores);
 
   // Add a finish mark to all value stores
   // This is used to mark the outer-most dimension as finished -- before any
   // element is added
-  static Status AddFinishMarks(
-      std::map<string, ValueStoreUniquePtr>* key_to_value);
+  static Status AddFinishMarks(const std::vector<ValueStore*>& stores);
 
   // Resolve a filter name
   // Handles the inplace notation where we need to add all parent names
@@ -189,6 +198,10 @@ class AvroParserTree {
   // The parser root
   AvroParserSharedPtr root_;
 
+  // The parser tree compiled into ops, value stores are addressed by their
+  // position in keys_and_types_
+  AvroParserProgram program_;
+
   // used to preserve the order in the parse value method, InitValueBuffers
   // before each parse call
   std::vector<std::pair<string, DataType> > keys_and_types_;
@@ -35,6 +35,12 @@ void ShapeBuilder::FinishMark() {
 
 void ShapeBuilder::Increment() { element_counter_++; }
 
+void ShapeBuilder::Clear() {
+  element_info_.clear();
+  element_counter_ = 0;
+  has_begin_ = false;
+}
+
 // Assumes that the value buffer has correct markers
 size_t ShapeBuilder::GetNumberOfDimensions() const {
   size_t num = 0;
@@ -308,31 +314,33 @@ void ShapeBuilder::Merge(const ShapeBuilder& other) {
 }
 
 Status MergeAs(ValueStoreUniquePtr& merged,
-               const std::vector<ValueStoreUniquePtr>& buffers,
-               DataType dtype) {
-  switch (dtype) {
-    case DT_FLOAT:
-      merged.reset(new FloatValueBuffer(buffers));
-      break;
-    case DT_DOUBLE:
-      merged.reset(new DoubleValueBuffer(buffers));
-      break;
-    case DT_INT64:
-      merged.reset(new LongValueBuffer(buffers));
-      break;
-    case DT_INT32:
-      merged.reset(new IntValueBuffer(buffers));
-      break;
-    case DT_BOOL:
-      merged.reset(new BoolValueBuffer(buffers));
-      break;
-    case DT_STRING:
-      merged.reset(new StringValueBuffer(buffers));
-      break;
-    default:
-      return errors::InvalidArgument("Received invalid type: ",
-                                     DataTypeString(dtype));
+               const std::vector<ValueStore*>& buffers, DataType dtype) {
+  if (merged == nullptr) {
+    switch (dtype) {
+      case DT_FLOAT:
+        merged.reset(new FloatValueBuffer());
+        break;
+      case DT_DOUBLE:
+        merged.reset(new DoubleValueBuffer());
+        break;
+      case DT_INT64:
+        merged.reset(new LongValueBuffer());
+        break;
+      case DT_INT32:
+        merged.reset(new IntValueBuffer());
+        break;
+      case DT_BOOL:
+        merged.reset(new BoolValueBuffer());
+        break;
+      case DT_STRING:
+        merged.reset(new StringValueBuffer());
+        break;
+      default:
+        return errors::InvalidArgument("Received invalid type: ",
+                                       DataTypeString(dtype));
+    }
   }
+  (*merged).MergeFrom(buffers);
 
   return Status::OK();
 }
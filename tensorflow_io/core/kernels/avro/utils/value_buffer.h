@@ -91,6 +91,16 @@ class ValueStore {
   // Place a finish mark
   virtual void FinishMark() = 0;
 
+  // Remove all values and marks but keep the allocated storage, so that the
+  // store can be reused for the next batch without reallocation
+  virtual void Clear() = 0;
+
+  // Replace the content of this store by the concatenation of the values and
+  // marks of the given stores, which must have the same type as this store.
+  // Values are moved out of the given stores, which are left in a valid but
+  // unspecified state and should be cleared before reuse
+  virtual void MergeFrom(const std::vector<ValueStore*>& others) = 0;
+
   // Output a human readable string representation with limit number of elements
   virtual string ToString(size_t limit = 10) const = 0;
 };
@@ -112,6 +122,9 @@ class ShapeBuilder {
   // Increment the counter for the elements
   void Increment();
 
+  // Remove all marks but keep the allocated storage
+  void Clear();
+
   // Get the number of dimensions
   size_t GetNumberOfDimensions() const;
 
@@ -174,7 +187,6 @@ template <typename T>
 class ValueBuffer : public ValueStore {
  public:
   ValueBuffer() = default;
-  ValueBuffer(const std::vector<ValueStoreUniquePtr>& others);
 
   virtual ~ValueBuffer() = default;
 
@@ -182,6 +194,13 @@ class ValueBuffer : public ValueStore {
 
   inline void FinishMark() override { shape_builder_.FinishMark(); }
 
+  inline void Clear() override {
+    values_.clear();
+    shape_builder_.Clear();
+  }
+
+  void MergeFrom(const std::vector<ValueStore*>& others) override;
+
   // Add a primitive value (e.g. bool, int) to the buffer by copy
   inline void Add(T value) {
     values_.push_back(value);
@@ -270,8 +289,9 @@ class ValueBuffer : public ValueStore {
     return false;
   }
 
-  // For up to 4 values use inline memory
-  gtl::InlinedVector<T, 4> values_;
+  // Use a plain vector, because clear() keeps its capacity and the buffer is
+  // reused across batches
+  std::vector<T> values_;
 
   // The shape builder for this value buffer
   ShapeBuilder shape_builder_;
@@ -289,8 +309,9 @@ typedef ValueBuffer<tstring> StringValueBuffer;
 
 // Unfortunately, need to provide type information for casting
 // Note, this code has not been designed with merge in scope
+// If merged already holds a value store, then its storage is reused
 Status MergeAs(ValueStoreUniquePtr& merged,
-               const std::vector<ValueStoreUniquePtr>& buffers, DataType dtype);
+               const std::vector<ValueStore*>& buffers, DataType dtype);
 
 // -------------------------------------------------------------------------------------------------
 // copy or move data depending on the data type
@@ -309,24 +330,23 @@ inline void CopyOrMoveBlock(const string* b, const string* e, string* t) {
 // Implementation of the value buffer
 // -------------------------------------------------------------------------------------------------
 template <typename T>
-ValueBuffer<T>::ValueBuffer(const std::vector<ValueStoreUniquePtr>& others) {
+void ValueBuffer<T>::MergeFrom(const std::vector<ValueStore*>& others) {
+  Clear();
+
   // Compute the total number of elements
   size_t n_total = 0;
   for (size_t i = 0; i < others.size(); ++i) {
-    ValueBuffer<T>* buffer = reinterpret_cast<ValueBuffer<T>*>(others[i].get());
+    ValueBuffer<T>* buffer = reinterpret_cast<ValueBuffer<T>*>(others[i]);
     n_total += buffer->values_.size();
   }
-  values_.resize(n_total);
-  VLOG(5) << "Allocate space for " << n_total << " elements in buffer";
+  values_.reserve(n_total);
+  VLOG(5) << "Reserve space for " << n_total << " elements in buffer";
 
-  // Get the target start location
-  auto target = values_.begin();
   for (size_t i = 0; i < others.size(); ++i) {
-    ValueBuffer<T>* buffer = reinterpret_cast<ValueBuffer<T>*>(others[i].get());
-    auto begin = buffer->values_.begin();
-    size_t n_elements = buffer->values_.size();
-    CopyOrMoveBlock(begin, begin + n_elements, target);
-    target += n_elements;
+    ValueBuffer<T>* buffer = reinterpret_cast<ValueBuffer<T>*>(others[i]);
+    values_.insert(values_.end(),
+                   std::make_move_iterator(buffer->values_.begin()),
+                   std::make_move_iterator(buffer->values_.end()));
     shape_builder_.Merge(buffer->shape_builder_);
   }
 }
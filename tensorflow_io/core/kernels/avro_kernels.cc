@@ -19,6 +19,8 @@ limitations under the License.
 #include "api/Stream.hh"
 #include "api/Validator.hh"
 #include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/lib/core/coding.h"
+#include "tensorflow/core/lib/random/random.h"
 #include "tensorflow_io/core/kernels/io_interface.h"
 #include "tensorflow_io/core/kernels/io_stream.h"
 
@@ -56,6 +58,112 @@ class AvroInputStream : public avro::SeekableInputStream {
   uint64 byte_count_ = 0;
 };
 
+// Sidecar sync-marker index for avro container files.
+//
+// Layout (all integers are little-endian fixed64):
+//   magic | file_size | mtime_nsec | num_blocks | {items, offset} * num_blocks
+//
+// The file size and modification time of the avro file are recorded so that
+// a stale index (e.g., file rewritten in place) is detected and rebuilt.
+static const char kAvroIndexMagic[] = "TFIOAVX1";
+static const size_t kAvroIndexMagicSize = 8;
+static const size_t kAvroIndexHeaderSize = kAvroIndexMagicSize + 3 * 8;
+
+// Walk all sync markers of an avro container file and collect the
+// <items, offset> pair of every block.
+Status BuildAvroIndex(SizedRandomAccessFile* file, const uint64 file_size,
+                      avro::DataFileReader<avro::GenericDatum>* reader,
+                      std::vector<std::pair<int64, int64>>* positions) {
+  positions->clear();
+
+  avro::DecoderPtr decoder = avro::binaryDecoder();
+
+  reader->sync(0);
+  int64 offset = reader->previousSync();
+  while (offset < file_size) {
+    StringPiece result;
+    string buffer(16, 0x00);
+    Status status = file->Read(offset, buffer.size(), &result, &buffer[0]);
+    if (!status.ok() && !errors::IsOutOfRange(status)) {
+      return status;
+    }
+    std::unique_ptr<avro::InputStream> in =
+        avro::memoryInputStream((const uint8_t*)result.data(), result.size());
+    decoder->init(*in);
+    long items = decoder->decodeLong();
+
+    positions->emplace_back(
+        std::pair<int64, int64>(static_cast<int64>(items), offset));
+
+    reader->sync(offset);
+    offset = reader->previousSync();
+  }
+  return Status::OK();
+}
+
+Status LoadAvroIndex(Env* env, const string& index_filename,
+                     const uint64 file_size, const int64 mtime_nsec,
+                     std::vector<std::pair<int64, int64>>* positions) {
+  string content;
+  TF_RETURN_IF_ERROR(ReadFileToString(env, index_filename, &content));
+  if (content.size() < kAvroIndexHeaderSize ||
+      memcmp(content.data(), kAvroIndexMagic, kAvroIndexMagicSize) != 0) {
+    return errors::DataLoss("invalid avro index ", index_filename);
+  }
+  const char* p = content.data() + kAvroIndexMagicSize;
+  const uint64 index_file_size = core::DecodeFixed64(p);
+  const int64 index_mtime_nsec = static_cast<int64>(core::DecodeFixed64(p + 8));
+  const uint64 num_blocks = core::DecodeFixed64(p + 16);
+  if (index_file_size != file_size || index_mtime_nsec != mtime_nsec) {
+    return errors::FailedPrecondition("avro index ", index_filename,
+                                      " is stale");
+  }
+  if (content.size() != kAvroIndexHeaderSize + num_blocks * 16) {
+    return errors::DataLoss("truncated avro index ", index_filename);
+  }
+  positions->clear();
+  positions->reserve(num_blocks);
+  p = content.data() + kAvroIndexHeaderSize;
+  for (uint64 i = 0; i < num_blocks; i++, p += 16) {
+    positions->emplace_back(std::pair<int64, int64>(
+        static_cast<int64>(core::DecodeFixed64(p)),
+        static_cast<int64>(core::DecodeFixed64(p + 8))));
+  }
+  return Status::OK();
+}
+
+Status SaveAvroIndex(Env* env, const string& index_filename,
+                     const uint64 file_size, const int64 mtime_nsec,
+                     const std::vector<std::pair<int64, int64>>& positions) {
+  string content(kAvroIndexMagic, kAvroIndexMagicSize);
+  content.reserve(kAvroIndexHeaderSize + positions.size() * 16);
+  core::PutFixed64(&content, file_size);
+  core::PutFixed64(&content, static_cast<uint64>(mtime_nsec));
+  core::PutFixed64(&content, positions.size());
+  for (const auto& position : positions) {
+    core::PutFixed64(&content, static_cast<uint64>(position.first));
+    core::PutFixed64(&content, static_cast<uint64>(position.second));
+  }
+  // Write to a temporary file first so that concurrent readers never observe
+  // a partially written index. The name is unique to the writer (host, pid,
+  // thread, time and a random number) so that concurrent writers of the same
+  // index do not overwrite each other's temporary file.
+  string tmp_filename =
+      strings::StrCat(index_filename, ".", random::New64(), "-");
+  if (!env->CreateUniqueFileName(&tmp_filename, ".tmp")) {
+    return errors::Internal("Failed to create a temporary file for ",
+                            index_filename);
+  }
+  Status status = WriteStringToFile(env, tmp_filename, content);
+  if (status.ok()) {
+    status = env->RenameFile(tmp_filename, index_filename);
+  }
+  if (!status.ok()) {
+    env->DeleteFile(tmp_filename).IgnoreError();
+  }
+  return status;
+}
+
 class ListAvroColumnsOp : public OpKernel {
  public:
   explicit ListAvroColumnsOp(OpKernelConstruction* context)
@@ -294,9 +402,55 @@ class ReadAvroOp : public OpKernel {
   Env* env_ TF_GUARDED_BY(mu_);
 };
 
+class WriteAvroIndexOp : public OpKernel {
+ public:
+  explicit WriteAvroIndexOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    env_ = context->env();
+  }
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& filename_tensor = context->input(0);
+    const string filename = filename_tensor.scalar<tstring>()();
+
+    const Tensor& index_tensor = context->input(1);
+    const string index = index_tensor.scalar<tstring>()();
+
+    FileStatistics stat;
+    OP_REQUIRES_OK(context, env_->Stat(filename, &stat));
+
+    std::unique_ptr<SizedRandomAccessFile> file(
+        new SizedRandomAccessFile(env_, filename, nullptr, 0));
+    uint64 size;
+    OP_REQUIRES_OK(context, file->GetFileSize(&size));
+
+    // The writer schema embedded in the file is sufficient to locate blocks.
+    std::unique_ptr<avro::InputStream> stream(new AvroInputStream(file.get()));
+    std::unique_ptr<avro::DataFileReader<avro::GenericDatum>> reader(
+        new avro::DataFileReader<avro::GenericDatum>(std::move(stream)));
+
+    std::vector<std::pair<int64, int64>> positions;
+    OP_REQUIRES_OK(context,
+                   BuildAvroIndex(file.get(), size, reader.get(), &positions));
+    OP_REQUIRES_OK(context, SaveAvroIndex(env_, index, size, stat.mtime_nsec,
+                                          positions));
+
+    Tensor* blocks_tensor;
+    OP_REQUIRES_OK(
+        context, context->allocate_output(0, TensorShape({}), &blocks_tensor));
+    blocks_tensor->scalar<int64>()() = static_cast<int64>(positions.size());
+  }
+
+ private:
+  mutex mu_;
+  Env* env_ TF_GUARDED_BY(mu_);
+};
+
 REGISTER_KERNEL_BUILDER(Name("IO>ListAvroColumns").Device(DEVICE_CPU),
                         ListAvroColumnsOp);
 REGISTER_KERNEL_BUILDER(Name("IO>ReadAvro").Device(DEVICE_CPU), ReadAvroOp);
+REGISTER_KERNEL_BUILDER(Name("IO>WriteAvroIndex").Device(DEVICE_CPU),
+                        WriteAvroIndexOp);
 
 }  // namespace
 
@@ -317,9 +471,12 @@ class AvroReadable : public IOReadableInterface {
     TF_RETURN_IF_ERROR(file_->GetFileSize(&file_size_));
 
     string schema;
+    string index;
     for (size_t i = 0; i < metadata.size(); i++) {
       if (metadata[i].find("schema: ") == 0) {
         schema = metadata[i].substr(8);
+      } else if (metadata[i].find("index: ") == 0) {
+        index = metadata[i].substr(7);
       }
     }
 
@@ -379,28 +536,37 @@ class AvroReadable : public IOReadableInterface {
     reader_.reset(new avro::DataFileReader<avro::GenericDatum>(
         std::move(reader_stream_), reader_schema_));
 
-    avro::DecoderPtr decoder = avro::binaryDecoder();
+    // An optional sidecar index avoids walking all sync markers, which
+    // otherwise means reading the whole file before the first read.
+    // Index is not applicable for in-memory input.
+    FileStatistics stat;
+    bool use_index = (!index.empty() && memory_size == 0 &&
+                      env_->Stat(filename, &stat).ok());
+    bool index_loaded = false;
+    if (use_index) {
+      Status status = LoadAvroIndex(env_, index, file_size_, stat.mtime_nsec,
+                                    &positions_);
+      index_loaded = status.ok();
+      if (!index_loaded && !errors::IsNotFound(status)) {
+        LOG(WARNING) << "rebuilding avro index " << index << ": " << status;
+      }
+    }
+    if (!index_loaded) {
+      TF_RETURN_IF_ERROR(
+          BuildAvroIndex(file_.get(), file_size_, reader_.get(), &positions_));
+      if (use_index) {
+        Status status = SaveAvroIndex(env_, index, file_size_, stat.mtime_nsec,
+                                      positions_);
+        if (!status.ok()) {
+          LOG(WARNING) << "unable to write avro index " << index << ": "
+                       << status;
+        }
+      }
+    }
 
     int64 total = 0;
-
-    reader_->sync(0);
-    int64 offset = reader_->previousSync();
-    while (offset < file_size_) {
-      StringPiece result;
-      string buffer(16, 0x00);
-      TF_RETURN_IF_ERROR(
-          file_->Read(offset, buffer.size(), &result, &buffer[0]));
-      std::unique_ptr<avro::InputStream> in =
-          avro::memoryInputStream((const uint8_t*)result.data(), result.size());
-      decoder->init(*in);
-      long items = decoder->decodeLong();
-
-      total += static_cast<int64>(items);
-      positions_.emplace_back(
-          std::pair<int64, int64>(static_cast<int64>(items), offset));
-
-      reader_->sync(offset);
-      offset = reader_->previousSync();
+    for (size_t i = 0; i < positions_.size(); i++) {
+      total += positions_[i].first;
     }
 
     for (size_t i = 0; i < columns_.size(); i++) {
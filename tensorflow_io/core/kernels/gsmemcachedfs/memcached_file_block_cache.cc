@@ -15,6 +15,8 @@ limitations under the License.
 
 #include "tensorflow_io/core/kernels/gsmemcachedfs/memcached_file_block_cache.h"
 
+#include <algorithm>
+#include <limits>
 #include <random>
 
 #include "tensorflow/core/lib/gtl/cleanup.h"
@@ -28,6 +30,14 @@ namespace tensorflow {
 // though the queue will be almost empty if the setter thread is doing its job.
 const int64 kMaxMemcachedSetBufferSize = 13421772800;  // 12 GB
 
+// Max number of read streams tracked for prefetching. The least recently
+// continued stream is forgotten to make room for a new one.
+const size_t kMaxReadStreams = 1024;
+
+// Max number of pending prefetch requests, later requests are dropped while
+// the prefetch thread is behind.
+const size_t kMaxPrefetchQueueSize = 64;
+
 namespace block_cache_util {
 
 double GenerateUniformRandomNumber() {
@@ -264,18 +274,15 @@ Status block_set(MemcachedDaoInterface* memcached_dao, const string& key,
                           memcached_dao->MemcachedStrError(rc));
 }
 
-Status read_with_multi_get(
-    const BufferCollator& collator, MemcachedDaoInterface* memcached_dao,
-    const std::vector<string>& keys,
-    std::map<string, MemcachedFileBlockCache::Key>* claim_checks,
-    size_t* total_bytes_transferred,
-    FileBlockCacheStatsInterface* cache_stats) {
-  VLOG(2) << "Key multi-get of " << claim_checks->size() << " claims";
-  const auto before = absl::Now();
-  auto to_claim = claim_checks->size();
-
-  Status mget_status = block_multi_get(memcached_dao, keys);
-  TF_RETURN_IF_ERROR(mget_status);
+// Fetches the keys with a single multi-get and calls `on_result` with the
+// key and value of every block found. Keys missing from memcached are
+// skipped, an error of `on_result` stops the fetch.
+Status multi_get(
+    MemcachedDaoInterface* memcached_dao, const std::vector<string>& keys,
+    FileBlockCacheStatsInterface* cache_stats,
+    const std::function<Status(const string& key, const char* data_begin,
+                               size_t data_size)>& on_result) {
+  TF_RETURN_IF_ERROR(block_multi_get(memcached_dao, keys));
 
   for (int64 i = 0; i < keys.size(); ++i) {
     memcached_return_t fetch_return;
@@ -299,32 +306,45 @@ Status read_with_multi_get(
     const size_t data_size =
         memcached_dao->MemcachedResultLength(&fetch_result);
     const char* data_begin = memcached_dao->MemcachedResultValue(&fetch_result);
-    if (!data_begin) {
-      return errors::Internal("memcached fetch failure: ",
-                              memcached_dao->MemcachedStrError(fetch_return));
-    }
-
     const char* key_value = memcached_result_key_value(&fetch_result);
-    if (!key_value) {
+    if (!data_begin || !key_value) {
       return errors::Internal("memcached fetch failure: ",
                               memcached_dao->MemcachedStrError(fetch_return));
     }
 
-    const string claim_key = key_value;
-    auto claim = claim_checks->find(claim_key);
-    if (claim == claim_checks->end()) {
-      return errors::Internal("Could not find claim for ", claim_key);
-    }
-
-    const size_t pos = claim->second.second;
-    VLOG(2) << "memc fetch of " << claim->first << " -> " << '('
-            << claim->second.first << ", " << claim->second.second << ')';
     StreamzRecordCacheHitBlockSize(data_size, cache_stats);
-
-    claim_checks->erase(claim);
-    collator.splice_buffer(data_begin, data_begin + data_size, pos,
-                           total_bytes_transferred);
+    TF_RETURN_IF_ERROR(on_result(key_value, data_begin, data_size));
   }
+  return Status::OK();
+}
+
+Status read_with_multi_get(
+    const BufferCollator& collator, MemcachedDaoInterface* memcached_dao,
+    const std::vector<string>& keys,
+    std::map<string, MemcachedFileBlockCache::Key>* claim_checks,
+    size_t* total_bytes_transferred,
+    FileBlockCacheStatsInterface* cache_stats) {
+  VLOG(2) << "Key multi-get of " << claim_checks->size() << " claims";
+  const auto before = absl::Now();
+  auto to_claim = claim_checks->size();
+
+  TF_RETURN_IF_ERROR(multi_get(
+      memcached_dao, keys, cache_stats,
+      [&](const string& claim_key, const char* data_begin, size_t data_size) {
+        auto claim = claim_checks->find(claim_key);
+        if (claim == claim_checks->end()) {
+          return errors::Internal("Could not find claim for ", claim_key);
+        }
+
+        const size_t pos = claim->second.second;
+        VLOG(2) << "memc fetch of " << claim->first << " -> " << '('
+                << claim->second.first << ", " << claim->second.second << ')';
+
+        claim_checks->erase(claim);
+        collator.splice_buffer(data_begin, data_begin + data_size, pos,
+                               total_bytes_transferred);
+        return Status::OK();
+      }));
 
   const auto after = absl::Now();
   VLOG(2) << (to_claim - claim_checks->size())
@@ -332,6 +352,29 @@ Status read_with_multi_get(
   return Status::OK();
 }
 
+// Fetches the keys with a single multi-get and adds the blocks found to the
+// local cache. Keys missing from memcached are skipped.
+Status prefetch_with_multi_get(MemcachedDaoInterface* memcached_dao,
+                               const std::vector<string>& keys,
+                               MiniBlockCache* local_cache,
+                               FileBlockCacheStatsInterface* cache_stats) {
+  const auto before = absl::Now();
+  size_t prefetched = 0;
+  TF_RETURN_IF_ERROR(multi_get(
+      memcached_dao, keys, cache_stats,
+      [&](const string& key, const char* data_begin, size_t data_size) {
+        local_cache->Add(key, std::make_shared<const std::vector<char>>(
+                                  data_begin, data_begin + data_size));
+        prefetched++;
+        return Status::OK();
+      }));
+
+  const auto after = absl::Now();
+  VLOG(2) << prefetched << " of " << keys.size() << " blocks prefetched in "
+          << (after - before);
+  return Status::OK();
+}
+
 void cache_cleanup(void* tsd) {
   memcached_st* state = reinterpret_cast<memcached_st*>(tsd);
   std::unique_ptr<MemcachedDaoInterface> memcached_dao;
@@ -346,18 +389,26 @@ void RunMemcachedSetter(MemcachedFileBlockCache* cache) {
   LOG(INFO) << "Memcached setter thread is done.";
 }
 
+void RunMemcachedPrefetcher(MemcachedFileBlockCache* cache) {
+  while (cache->ProcessPrefetchQueue()) {
+  }
+  LOG(INFO) << "Memcached prefetch thread is done.";
+}
+
 MemcachedFileBlockCache::MemcachedFileBlockCache(
     const std::vector<MemcachedDaoInterface*>& memcached_daos,
     size_t block_size, size_t max_bytes, uint64 max_staleness,
-    size_t local_cache_size, const std::vector<string>& servers,
-    const std::vector<string>& options, BlockFetcher block_fetcher, Env* env)
+    size_t local_cache_size, size_t prefetch_blocks,
+    const std::vector<string>& servers, const std::vector<string>& options,
+    BlockFetcher block_fetcher, Env* env)
     : block_size_(block_size),
       max_bytes_(max_bytes),
       use_multi_get_(false),
       block_fetcher_(std::move(block_fetcher)),
       env_(env),
       servers_(servers),
-      options_(options) {
+      options_(options),
+      prefetch_blocks_(prefetch_blocks) {
   VLOG(1) << "Entering MemcachedFileBlockCache::MemcachedFileBlockCache";
 
   if (memcached_daos.size() < 2) {
@@ -402,10 +453,27 @@ MemcachedFileBlockCache::MemcachedFileBlockCache(
   VLOG(1) << "MemcachedFileBlockCache has a local small reads cache of "
           << local_cache_size << " bytes.";
 
+  // Prefetched blocks are kept in the local cache, so prefetching is only
+  // useful along with it.
+  if (configured_ && IsCacheEnabled() && local_cache_->IsEnabled() &&
+      prefetch_blocks_ > 0) {
+    prefetch_thread_.reset(
+        env->StartThread(ThreadOptions(), "memcached_memc_prefetcher",
+                         [this] { RunMemcachedPrefetcher(this); }));
+    VLOG(1) << "MemcachedFileBlockCache prefetches " << prefetch_blocks_
+            << " blocks after sequential reads.";
+  }
+
   VLOG(1) << "Departing MemcachedFileBlockCache::MemcachedFileBlockCache";
 }
 
 MemcachedFileBlockCache::~MemcachedFileBlockCache() {
+  {
+    mutex_lock lock(prefetch_mu_);
+    stop_prefetch_thread_ = true;
+    prefetch_cv_.notify_all();
+  }
+  prefetch_thread_.reset();
   {
     mutex_lock lock(throttler_mu_);
     stop_setter_thread_ = true;
@@ -557,6 +625,15 @@ Status MemcachedFileBlockCache::Read(const string& filename, size_t offset,
 
   string mini_read_key = keys[0];
   bool mini_read = n < block_size_;
+  size_t total_bytes_transferred = 0;
+  // Whether this read marked the mini read block as fetching, in which case
+  // the waiting readers must be released however the read ends.
+  bool fetching = false;
+  auto fetched = gtl::MakeCleanup([&] {
+    if (fetching) {
+      local_cache_->Fetched(mini_read_key);
+    }
+  });
 
   if (mini_read) {
     // Small reads get cached locally since we need to fetch an entire block
@@ -567,17 +644,53 @@ Status MemcachedFileBlockCache::Read(const string& filename, size_t offset,
     int64 offset_in_block = offset - block_offset;
     if (!local_cache_->Peek(mini_read_key)) {
       local_cache_->Fetching(mini_read_key);
+      fetching = true;
     }
     if (local_cache_->Get(mini_read_key, offset_in_block, n, buffer,
                           bytes_transferred)) {
+      MaybePrefetch(filename, offset, offset + *bytes_transferred);
       return Status::OK();
     }
+  } else if (local_cache_->IsEnabled()) {
+    // Serve the blocks already held by the local cache, for instance the
+    // ones prefetched after sequential reads.
+    size_t eof_pos = std::numeric_limits<size_t>::max();
+    for (const auto& memc_key : keys) {
+      MiniBlockCache::Buffer data = local_cache_->Lookup(memc_key);
+      if (data == nullptr) {
+        continue;
+      }
+      auto claim = claim_checks.find(memc_key);
+      const size_t pos = claim->second.second;
+      claim_checks.erase(claim);
+      if (offset >= pos + data->size()) {
+        return errors::OutOfRange("EOF at offset ", offset, " in file ",
+                                  filename, " at position ", pos,
+                                  "with data size ", data->size());
+      }
+      if (!collator.splice_buffer(data->begin(), data->end(), pos,
+                                  &total_bytes_transferred)) {
+        eof_pos = std::min(eof_pos, pos);
+      }
+    }
+    // Blocks past a partial block are beyond the end of the file.
+    for (auto ci = claim_checks.begin(); ci != claim_checks.end();) {
+      if (ci->second.second > eof_pos) {
+        ci = claim_checks.erase(ci);
+      } else {
+        ++ci;
+      }
+    }
+    keys.erase(std::remove_if(keys.begin(), keys.end(),
+                              [&claim_checks](const string& memc_key) {
+                                return claim_checks.count(memc_key) == 0;
+                              }),
+               keys.end());
   }
 
-  size_t total_bytes_transferred = 0;
   bool multi_get = use_multi_get_ && !mini_read;
 
-  if (multi_get) {
+  if (multi_get && !claim_checks.empty()) {
     int64 client_index = 0;
     {
       mutex_lock lock(get_mu_);
@@ -619,7 +732,7 @@ Status MemcachedFileBlockCache::Read(const string& filename, size_t offset,
   }
   for (auto sc = sorted_claims.begin(); sc != sorted_claims.end(); ++sc) {
     size_t pos = sc->first;
-    std::vector<char> data;
+    std::shared_ptr<std::vector<char>> data;
 
     int64 client_index = 0;
     if (!multi_get) {
@@ -643,7 +756,7 @@ Status MemcachedFileBlockCache::Read(const string& filename, size_t offset,
     }
 
     // Copy the relevant portion of the block into the result buffer.
-    if (offset >= pos + data.size()) {
+    if (offset >= pos + data->size()) {
       // The requested offset is at or beyond the end of the file. This can
       // happen if `offset` is not block-aligned, and the read returns the
       // last block in the file, which does not extend all the way out to
@@ -651,16 +764,15 @@ Status MemcachedFileBlockCache::Read(const string& filename, size_t offset,
       *bytes_transferred = total_bytes_transferred;
       return errors::OutOfRange("EOF at offset ", offset, " in file ", filename,
                                 " at position ", pos, "with data size ",
-                                data.size());
+                                data->size());
     }
 
     if (mini_read) {
       // Add the fetched block to the local cache when serving small read.
-      local_cache_->Add(mini_read_key, data.size(), data.data());
-      local_cache_->Fetched(mini_read_key);
+      local_cache_->Add(mini_read_key, data);
     }
 
-    if (!collator.splice_buffer(data.begin(), data.end(), pos,
+    if (!collator.splice_buffer(data->begin(), data->end(), pos,
                                 &total_bytes_transferred)) {
       break;
     }
@@ -672,9 +784,111 @@ Status MemcachedFileBlockCache::Read(const string& filename, size_t offset,
           << (total_bytes_transferred / absl::ToDoubleSeconds(elapsed))
           << " bytes / second";
   *bytes_transferred = total_bytes_transferred;
+  if (total_bytes_transferred == n) {
+    MaybePrefetch(filename, offset, offset + n);
+  }
   return Status::OK();
 }
 
+void MemcachedFileBlockCache::MaybePrefetch(const string& filename,
+                                            size_t offset, size_t end) {
+  if (prefetch_thread_ == nullptr) {
+    return;
+  }
+  mutex_lock lock(prefetch_mu_);
+  auto it = read_stream_map_.find(std::make_pair(filename, offset));
+  const bool sequential = it != read_stream_map_.end() || offset == 0;
+  size_t prefetched_until = 0;
+  if (it != read_stream_map_.end()) {
+    prefetched_until = it->second->prefetched_until;
+    read_streams_.erase(it->second);
+    read_stream_map_.erase(it);
+  }
+  // The stream moves to the end of the read. A random read starts a stream
+  // as well, which prefetches once the next read continues it.
+  const Key next = std::make_pair(filename, end);
+  if (read_stream_map_.count(next) > 0) {
+    // Another reader is at the same offset of the file, its read-ahead
+    // window serves both.
+    return;
+  }
+  if (read_streams_.size() >= kMaxReadStreams) {
+    const ReadStream& oldest = read_streams_.back();
+    read_stream_map_.erase(std::make_pair(oldest.filename, oldest.next_offset));
+    read_streams_.pop_back();
+  }
+  read_streams_.push_front(ReadStream{filename, end, prefetched_until});
+  read_stream_map_.emplace(next, read_streams_.begin());
+  if (!sequential) {
+    return;
+  }
+  ReadStream& stream = read_streams_.front();
+  const size_t end_block = (end + block_size_ - 1) / block_size_;
+  const size_t until = block_size_ * (end_block + prefetch_blocks_);
+  size_t pos = std::max(block_size_ * end_block, stream.prefetched_until);
+  if (pos >= until || prefetch_queue_.size() >= kMaxPrefetchQueueSize) {
+    return;
+  }
+  std::vector<Key> blocks;
+  for (; pos < until; pos += block_size_) {
+    blocks.emplace_back(filename, pos);
+  }
+  stream.prefetched_until = until;
+  prefetch_queue_.push_back(std::move(blocks));
+  prefetch_cv_.notify_one();
+}
+
+bool MemcachedFileBlockCache::ProcessPrefetchQueue() {
+  std::vector<Key> blocks;
+  {
+    mutex_lock lock(prefetch_mu_);
+    while (!stop_prefetch_thread_ && prefetch_queue_.empty()) {
+      prefetch_cv_.wait(lock);
+    }
+    if (stop_prefetch_thread_) {
+      return false;
+    }
+    blocks = std::move(prefetch_queue_.front());
+    prefetch_queue_.pop_front();
+  }
+  PrefetchBlocks(blocks);
+  return true;
+}
+
+void MemcachedFileBlockCache::PrefetchBlocks(const std::vector<Key>& blocks) {
+  std::vector<string> keys;
+  for (const auto& block : blocks) {
+    string memc_key = MakeMemcachedKey(block);
+    if (!local_cache_->Peek(memc_key)) {
+      keys.push_back(std::move(memc_key));
+    }
+  }
+  if (keys.empty()) {
+    return;
+  }
+
+  int64 client_index = 0;
+  {
+    mutex_lock lock(get_mu_);
+    if (client_queue_.empty()) {
+      // Prefetching is opportunistic, leave the clients to the readers.
+      VLOG(2) << "Memcached client pool is oversaturated. Skipping prefetch.";
+      return;
+    }
+    client_index = client_queue_.front();
+    client_queue_.pop_front();
+  }
+
+  Status status = prefetch_with_multi_get(memcached_clients_[client_index],
+                                          keys, local_cache_.get(),
+                                          cache_stats_);
+  VLOG(2) << "memc prefetch of " << keys.size() << " blocks, status "
+          << status;
+
+  mutex_lock lock(get_mu_);
+  client_queue_.push_back(client_index);
+}
+
 string MemcachedFileBlockCache::MakeMemcachedKey(const Key& key) {
   // Determine hash key usable by memcached.  This will need to be a
   // string <= 250 characters.  Using a key which is the offset, a slash,
@@ -697,16 +911,17 @@ string MemcachedFileBlockCache::MakeMemcachedKey(const Key& key) {
   return memc_key;
 }
 
-Status MemcachedFileBlockCache::MaybeFetch(const int64 client_index,
-                                           const Key& key,
-                                           std::vector<char>* data) {
+Status MemcachedFileBlockCache::MaybeFetch(
+    const int64 client_index, const Key& key,
+    std::shared_ptr<std::vector<char>>* data) {
   string memc_key = MakeMemcachedKey(key);
   if (client_index > 0 && client_index < memcached_clients_.size()) {
     // Just want to mention that in prod we will likely not be hitting this line
     // since we will most likely be doing Multi-Get instead of Get due to perf.
     auto before = absl::Now();
+    *data = std::make_shared<std::vector<char>>();
     Status block_get_status = block_get(memcached_clients_[client_index],
-                                        memc_key, data, cache_stats_);
+                                        memc_key, data->get(), cache_stats_);
     auto after = absl::Now();
     VLOG(2) << "memc get: " << memc_key << ", " << (after - before)
             << ", status " << block_get_status;
@@ -716,25 +931,27 @@ Status MemcachedFileBlockCache::MaybeFetch(const int64 client_index,
   }
 
   Status status;
-  size_t bytes_transferred;
-  char* retrieved_value =
-      static_cast<char*>(malloc((block_size_) * sizeof(char)));
+  size_t bytes_transferred = 0;
+  // The block is fetched in place, then shared with the local cache and the
+  // setter queue without further copies.
+  auto block = std::make_shared<std::vector<char>>(block_size_);
   auto before_fetch = absl::Now();
-  status = block_fetcher_(key.first, key.second, block_size_, retrieved_value,
+  status = block_fetcher_(key.first, key.second, block_size_, block->data(),
                           &bytes_transferred);
   auto after_fetch = absl::Now();
   VLOG(2) << "block_fetcher_: " << (after_fetch - before_fetch) << ", status "
           << status << ", bytes_transferred=" << bytes_transferred;
 
-  data->assign(retrieved_value, retrieved_value + bytes_transferred);
-
-  // Any object returned by memcached must be freed by the caller.
-  free(retrieved_value);
+  block->resize(bytes_transferred);
+  if (bytes_transferred < block_size_) {
+    block->shrink_to_fit();
+  }
+  *data = block;
   TF_RETURN_IF_ERROR(status);
 
   if (bytes_transferred > 0) {
     auto before_add = absl::Now();
-    int64 size = AddToCacheBuffer(memc_key, data);
+    int64 size = AddToCacheBuffer(memc_key, block);
     auto after_add = absl::Now();
     VLOG(2) << "Add to memcached queue: memc_key = " << memc_key << ", ("
             << (after_add - before_add) << "), size = " << size;
@@ -745,8 +962,8 @@ Status MemcachedFileBlockCache::MaybeFetch(const int64 client_index,
   return status;
 }
 
-int64 MemcachedFileBlockCache::AddToCacheBuffer(const string& memc_key,
-                                                std::vector<char>* data) {
+int64 MemcachedFileBlockCache::AddToCacheBuffer(
+    const string& memc_key, std::shared_ptr<const std::vector<char>> data) {
   mutex_lock lock(throttler_mu_);
   if (cache_buffer_keys_.size() * block_size_ >= kMaxMemcachedSetBufferSize) {
     LOG(WARNING)
@@ -757,9 +974,7 @@ int64 MemcachedFileBlockCache::AddToCacheBuffer(const string& memc_key,
 
   if (cache_buffer_map_.find(memc_key) == cache_buffer_map_.end()) {
     cache_buffer_keys_.push_back(memc_key);
-    auto page = absl::make_unique<std::vector<char>>();
-    page->assign(data->begin(), data->end());
-    cache_buffer_map_.emplace(memc_key, page.release());
+    cache_buffer_map_.emplace(memc_key, std::move(data));
   }
   return cache_buffer_keys_.size();
 }
@@ -783,8 +998,8 @@ bool MemcachedFileBlockCache::ProcessCacheBuffer() {
     return true;
   }
 
-  std::unique_ptr<std::vector<char>> data(
-      cache_buffer_map_[memc_key].release());
+  std::shared_ptr<const std::vector<char>> data =
+      std::move(cache_buffer_map_[memc_key]);
   throttler_mu_.unlock();
 
   auto before = absl::Now();
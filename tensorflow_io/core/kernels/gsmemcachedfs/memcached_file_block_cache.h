@@ -16,6 +16,7 @@ limitations under the License.
 #ifndef TENSORFLOW_IO_GSMEMCACHEDFS_MEMCACHED_FILE_BLOCK_CACHE_H_
 #define TENSORFLOW_IO_GSMEMCACHEDFS_MEMCACHED_FILE_BLOCK_CACHE_H_
 
+#include <deque>
 #include <functional>
 #include <list>
 #include <map>
@@ -30,39 +31,50 @@ limitations under the License.
 
 namespace tensorflow {
 
+// A small LRU cache of whole blocks. Blocks are held by shared pointers, so a
+// block is never copied when it is added, looked up or evicted while in use.
 class MiniBlockCache {
  public:
+  typedef std::shared_ptr<const std::vector<char>> Buffer;
+
   explicit MiniBlockCache(size_t max_size) : max_size_(max_size) {
     VLOG(1) << "MiniBlockCache max_size = " << max_size_;
   }
 
-  // Add block to the cache.
-  void Add(std::string key, size_t block_size, char* data)
-      ABSL_LOCKS_EXCLUDED(mu_) {
-    if (max_size_ == 0) {
+  // Returns true if blocks are cached at all.
+  bool IsEnabled() const { return max_size_ > 0; }
+
+  // Add block to the cache, evicting the least recently used blocks to make
+  // room for it.
+  void Add(const std::string& key, Buffer data) ABSL_LOCKS_EXCLUDED(mu_) {
+    if (max_size_ == 0 || data == nullptr) {
       return;
     }
     mutex_lock lock(mu_);
     VLOG(3) << "MiniBlockCache Add: key = " << key
-            << ", block_size = " << block_size
-            << ", to current_size = " << keys_fifo_.size();
-    if (!map_.contains(key)) {
-      if (max_size_ < (size_ + block_size) && !keys_fifo_.empty()) {
-        string pop_key = keys_fifo_.front();
-        VLOG(3) << "MiniBlockCache pop key = " << pop_key;
-        size_ -= map_[pop_key]->size();
-        map_.erase(pop_key);
-        keys_fifo_.pop();
-      }
-      keys_fifo_.push(key);
-      map_[key] = absl::make_unique<std::vector<char>>();
+            << ", block_size = " << data->size()
+            << ", to current_size = " << lru_list_.size();
+    auto it = map_.find(key);
+    if (it != map_.end()) {
+      size_ -= it->second.data->size();
+      lru_list_.erase(it->second.lru_iterator);
+      map_.erase(it);
     }
-    map_[key]->assign(data, data + block_size);
-    size_ += map_[key]->size();
+    while (!lru_list_.empty() && max_size_ < size_ + data->size()) {
+      const string& pop_key = lru_list_.back();
+      VLOG(3) << "MiniBlockCache pop key = " << pop_key;
+      auto pop = map_.find(pop_key);
+      size_ -= pop->second.data->size();
+      map_.erase(pop);
+      lru_list_.pop_back();
+    }
+    size_ += data->size();
+    lru_list_.push_front(key);
+    map_[key] = Entry{std::move(data), lru_list_.begin()};
   }
 
   // Peek map to check if the key is contained in it.
-  bool Peek(std::string key) ABSL_LOCKS_EXCLUDED(mu_) {
+  bool Peek(const std::string& key) ABSL_LOCKS_EXCLUDED(mu_) {
     if (max_size_ == 0) {
       return false;
     }
@@ -70,15 +82,26 @@ class MiniBlockCache {
     return map_.contains(key);
   }
 
-  // Get block from cache if it exists.
-  bool Get(std::string key, int64 offset, size_t n, char* buffer,
-           size_t* bytes_copied) ABSL_LOCKS_EXCLUDED(mu_) {
+  // Returns the block and marks it as the most recently used one, or nullptr
+  // if it is not cached.
+  Buffer Lookup(const std::string& key) ABSL_LOCKS_EXCLUDED(mu_) {
     if (max_size_ == 0) {
-      *bytes_copied = 0;
-      return false;
+      return nullptr;
     }
     mutex_lock lock(mu_);
-    if (!map_.contains(key) || offset > map_[key]->size()) {
+    auto it = map_.find(key);
+    if (it == map_.end()) {
+      return nullptr;
+    }
+    lru_list_.splice(lru_list_.begin(), lru_list_, it->second.lru_iterator);
+    return it->second.data;
+  }
+
+  // Get block from cache if it exists.
+  bool Get(const std::string& key, int64 offset, size_t n, char* buffer,
+           size_t* bytes_copied) ABSL_LOCKS_EXCLUDED(mu_) {
+    Buffer data = Lookup(key);
+    if (data == nullptr || offset > data->size()) {
       VLOG(3) << "MiniBlockCache MISS Get: key = " << key
               << ", offset = " << offset << ", n = " << n;
       *bytes_copied = 0;
@@ -88,11 +111,12 @@ class MiniBlockCache {
             << ", offset = " << offset << ", n = " << n;
 
     int64 bytes_to_copy = n;
-    if (offset + n > map_[key]->size()) {
-      bytes_to_copy = map_[key]->size() - offset;
+    if (offset + n > data->size()) {
+      bytes_to_copy = data->size() - offset;
     }
 
-    memcpy(buffer, map_[key]->data() + offset, bytes_to_copy);
+    // The block stays alive while it is copied, even if it is evicted.
+    memcpy(buffer, data->data() + offset, bytes_to_copy);
     *bytes_copied = bytes_to_copy;
     return true;
   }
@@ -118,12 +142,18 @@ class MiniBlockCache {
   }
 
  private:
+  struct Entry {
+    Buffer data;
+    // Position of the key in lru_list_.
+    std::list<string>::iterator lru_iterator;
+  };
+
   const size_t max_size_;
   mutable mutex mu_;
   size_t size_ ABSL_GUARDED_BY(mu_) = 0;
-  std::queue<string> keys_fifo_ ABSL_GUARDED_BY(mu_);
-  absl::flat_hash_map<std::string, std::unique_ptr<std::vector<char>>> map_
-      ABSL_GUARDED_BY(mu_);
+  // Keys from the most to the least recently used block.
+  std::list<string> lru_list_ ABSL_GUARDED_BY(mu_);
+  absl::flat_hash_map<std::string, Entry> map_ ABSL_GUARDED_BY(mu_);
   mutable mutex fetcher_mu_;
   absl::flat_hash_map<std::string, std::shared_ptr<condition_variable>>
       fetching_map_ ABSL_GUARDED_BY(fetcher_mu_);
@@ -237,9 +267,9 @@ class MemcachedFileBlockCache : public FileBlockCache {
   MemcachedFileBlockCache(
       const std::vector<MemcachedDaoInterface*>& memcached_daos,
       size_t block_size, size_t max_bytes, uint64 max_staleness,
-      const size_t local_cache_size, const std::vector<string>& servers,
-      const std::vector<string>& options, BlockFetcher block_fetcher,
-      Env* env = Env::Default());
+      const size_t local_cache_size, const size_t prefetch_blocks,
+      const std::vector<string>& servers, const std::vector<string>& options,
+      BlockFetcher block_fetcher, Env* env = Env::Default());
 
   ~MemcachedFileBlockCache() override;
 
@@ -265,7 +295,8 @@ class MemcachedFileBlockCache : public FileBlockCache {
   Status Read(const string& filename, size_t offset, size_t n, char* buffer,
               size_t* bytes_transferred) override;
 
-  Status MaybeFetch(int64 client_index, const Key& key, std::vector<char>* data)
+  Status MaybeFetch(int64 client_index, const Key& key,
+                    std::shared_ptr<std::vector<char>>* data)
       ABSL_LOCKS_EXCLUDED(mu_);
 
   // Validates the given file signature with the existing file signature in the
@@ -301,11 +332,37 @@ class MemcachedFileBlockCache : public FileBlockCache {
   // should be deactivated.
   bool ProcessCacheBuffer();
 
+  // Method called by the thread in charge of prefetching blocks. Returns
+  // 'false' once the thread should be deactivated.
+  bool ProcessPrefetchQueue();
+
  private:
+  // A stream of sequential reads of a file, i.e. one reader. Streams are
+  // told apart by where their next read starts, so that readers of the same
+  // file at different offsets each keep their own read-ahead window.
+  struct ReadStream {
+    string filename;
+    // Where the next read of the stream starts, the end of its last read.
+    size_t next_offset;
+    // The blocks before this offset are already queued for prefetching.
+    size_t prefetched_until;
+  };
+
   // Reader threads place the blocks they want to set for memcached in a queue.
   // There is a thread that consumes that queue and sends memcached set
   // requests.
-  int64 AddToCacheBuffer(const string& memc_key, std::vector<char>* data);
+  int64 AddToCacheBuffer(const string& memc_key,
+                         std::shared_ptr<const std::vector<char>> data);
+
+  // Queues the `prefetch_blocks_` blocks following [offset, end) of
+  // `filename` for prefetching if the read continues a stream of sequential
+  // reads of the file. A read starting at 0 begins a new stream.
+  void MaybePrefetch(const string& filename, size_t offset, size_t end)
+      ABSL_LOCKS_EXCLUDED(prefetch_mu_);
+
+  // Fetches the blocks that are not in the local cache from memcached with a
+  // single multi-get, and adds the ones found to the local cache.
+  void PrefetchBlocks(const std::vector<Key>& blocks);
 
   // Configures memcached server list and optional behaviors.
   Status ConfigureMemcachedServers(MemcachedDaoInterface* memcached_dao,
@@ -353,8 +410,9 @@ class MemcachedFileBlockCache : public FileBlockCache {
   mutable mutex throttler_mu_;
   // Queue of keys to store in memcached.
   std::deque<string> cache_buffer_keys_ ABSL_GUARDED_BY(throttler_mu_);
-  // Map of keys in the queue to the block data to store.
-  std::map<string, std::unique_ptr<std::vector<char>>> cache_buffer_map_
+  // Map of keys in the queue to the block data to store. The blocks are shared
+  // with the readers and the local cache.
+  std::map<string, std::shared_ptr<const std::vector<char>>> cache_buffer_map_
       ABSL_GUARDED_BY(throttler_mu_);
   // Flags that thread_ should stop sending set requests. This is used during
   // destruction, to avoid destroying the thread and/or its resources while
@@ -362,6 +420,28 @@ class MemcachedFileBlockCache : public FileBlockCache {
   // 'true'.
   bool stop_setter_thread_ ABSL_GUARDED_BY(throttler_mu_) = false;
 
+  // The number of blocks following a sequential read that are prefetched from
+  // memcached into the local cache.
+  const size_t prefetch_blocks_;
+  // Thread in charge of the prefetch requests, only running when prefetching
+  // is enabled.
+  std::unique_ptr<Thread> prefetch_thread_;
+  // Mutex used for the prefetch queue and the read positions.
+  mutable mutex prefetch_mu_;
+  // Signals the prefetch thread that a request is queued or that it should
+  // stop.
+  condition_variable prefetch_cv_;
+  // Blocks to prefetch, one multi-get per entry.
+  std::deque<std::vector<Key>> prefetch_queue_ ABSL_GUARDED_BY(prefetch_mu_);
+  // The recently continued read streams, most recent first, at most
+  // kMaxReadStreams.
+  std::list<ReadStream> read_streams_ ABSL_GUARDED_BY(prefetch_mu_);
+  // The read streams indexed by filename and next offset.
+  std::map<Key, std::list<ReadStream>::iterator> read_stream_map_
+      ABSL_GUARDED_BY(prefetch_mu_);
+  // Flags that prefetch_thread_ should stop.
+  bool stop_prefetch_thread_ ABSL_GUARDED_BY(prefetch_mu_) = false;
+
   // Whether the cache was successfully configured. If this is 'false' then read
   // requests will skip the cache and go to GCS.
   bool configured_ = false;
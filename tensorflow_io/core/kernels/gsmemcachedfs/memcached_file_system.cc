@@ -60,6 +60,10 @@ constexpr char kMaxGrpcAttempts[] = "GCS_BLOCK_FETCHER_GRPC_MAX_ATTEMPTS";
 // to serve subsequent small reads from that block locally.
 // 4GB local cache has shown very good hit-ratio and performance.
 constexpr char kMemcachedLocalCachesize[] = "MEMCACHED_LOCAL_CACHE_SIZE_GB";
+// Number of blocks following a sequential read that are fetched from memcached
+// into the local cache with a single multi-get. Requires the local cache.
+constexpr char kMemcachedPrefetchBlocks[] = "MEMCACHED_PREFETCH_BLOCKS";
+constexpr size_t kDefaultMemcachedPrefetchBlocks = 2;
 
 // How much time to initially wait before retrying a failed grpc.
 constexpr absl::Duration kInitialGrpcRetry = absl::Seconds(1);
@@ -170,10 +174,18 @@ std::unique_ptr<FileBlockCache> MemcachedGcsFileSystem::MakeFileBlockCache(
               << local_cache_size;
     }
 
+    size_t prefetch_blocks = kDefaultMemcachedPrefetchBlocks;
+    if (GetEnvVar(kMemcachedPrefetchBlocks, strings::safe_strtou64, &value)) {
+      prefetch_blocks = value;
+      VLOG(1) << "Distributed cache client prefetches " << prefetch_blocks
+              << " blocks";
+    }
+
     std::unique_ptr<FileBlockCache> file_block_cache(
         new MemcachedFileBlockCache(*memcached_clients_, block_size, max_bytes,
-                                    max_staleness, local_cache_size, servers,
-                                    options, block_fetcher));
+                                    max_staleness, local_cache_size,
+                                    prefetch_blocks, servers, options,
+                                    block_fetcher));
     return file_block_cache;
   }
 
@@ -13,9 +13,14 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <deque>
+#include <unordered_set>
+
+#include "rdkafka.h"
 #include "rdkafkacpp.h"
 #include "tensorflow/core/framework/resource_mgr.h"
 #include "tensorflow/core/framework/resource_op_kernel.h"
+#include "tensorflow_io/core/kernels/kafka_producer.h"
 
 namespace tensorflow {
 namespace io {
@@ -57,10 +62,87 @@ class KafkaEventCb : public RdKafka::EventCb {
   bool run_ TF_GUARDED_BY(mu_) = true;
 };
 
+// Upper bounds for the messages taken from a queue per batch
+static const size_t kMaxBatchMessages = 1024;
+static const size_t kMaxBatchBytes = 32 << 20;
+
+// Messages consumed from a librdkafka queue in batches. The payloads stay in
+// the fetch buffers owned by the messages until they are copied into the
+// output tensors, so every payload is copied exactly once.
+class KafkaMessageBatch {
+ public:
+  KafkaMessageBatch() {}
+  ~KafkaMessageBatch() { Clear(); }
+
+  // Waits up to timeout for the first message, then takes all messages that
+  // are already queued, up to max_messages in total, within the same wakeup.
+  // Error events are returned as messages with err set. The caller owns the
+  // polled messages and must either Add or destroy each of them.
+  static Status Poll(rd_kafka_queue_t* queue, int timeout,
+                     size_t max_messages,
+                     std::vector<rd_kafka_message_t*>* polled) {
+    (*polled).resize(std::max<size_t>(max_messages, 1));
+    ssize_t count =
+        rd_kafka_consume_batch_queue(queue, timeout, (*polled).data(), 1);
+    if (count > 0 && max_messages > 1) {
+      ssize_t more = rd_kafka_consume_batch_queue(
+          queue, 0, (*polled).data() + 1, max_messages - 1);
+      count = (more < 0) ? more : (count + more);
+    }
+    if (count < 0) {
+      (*polled).clear();
+      return errors::Internal("failed to consume batch: ",
+                              rd_kafka_err2str(rd_kafka_last_error()));
+    }
+    (*polled).resize(count);
+    return Status::OK();
+  }
+
+  void Add(rd_kafka_message_t* message) {
+    messages_.push_back(message);
+    bytes_ += message->len + message->key_len;
+  }
+
+  size_t size() const { return messages_.size(); }
+  size_t bytes() const { return bytes_; }
+
+  // Copies payloads and keys into the string tensors, then releases the
+  // messages
+  void MoveTo(Tensor* message_tensor, Tensor* key_tensor) {
+    auto message_flat = message_tensor->flat<tstring>();
+    auto key_flat = key_tensor->flat<tstring>();
+    for (size_t i = 0; i < messages_.size(); i++) {
+      const rd_kafka_message_t* message = messages_[i];
+      message_flat(i).assign(static_cast<const char*>(message->payload),
+                             message->len);
+      if (message->key != nullptr) {
+        key_flat(i).assign(static_cast<const char*>(message->key),
+                           message->key_len);
+      }
+    }
+    Clear();
+  }
+
+  void Clear() {
+    for (rd_kafka_message_t* message : messages_) {
+      rd_kafka_message_destroy(message);
+    }
+    messages_.clear();
+    bytes_ = 0;
+  }
+
+ private:
+  std::vector<rd_kafka_message_t*> messages_;
+  size_t bytes_ = 0;
+};
+
 class KafkaReadableResource : public ResourceBase {
  public:
   KafkaReadableResource(Env* env) : env_(env) {}
   virtual ~KafkaReadableResource() {
+    if (queue_ != nullptr) {
+      rd_kafka_queue_destroy(queue_);
+    }
     if (consumer_.get()) {
       consumer_->unassign();
       consumer_->close();
@@ -161,6 +243,11 @@ class KafkaReadableResource : public ResourceBase {
       return errors::Internal("failed to assign partition: ",
                               RdKafka::err2str(err));
     }
+    next_offset_ = (offset >= 0) ? offset : -1;
+
+    // Only one partition is assigned, so the consumer queue carries the
+    // messages of that partition along with error events and callbacks
+    queue_ = rd_kafka_queue_get_consumer(consumer_->c_ptr());
 
     return Status::OK();
   }
@@ -169,48 +256,31 @@ class KafkaReadableResource : public ResourceBase {
                                    Tensor** key)>
                   allocate_func) {
     mutex_lock l(mu_);
-    int64 total = 1024;
-    std::vector<string> message_value, key_value;
-    message_value.reserve(total);
-    key_value.reserve(total);
-
     LOG(INFO) << "Kafka stream starts with current offset: "
               << subscription_->offset();
-    std::unique_ptr<RdKafka::Message> message;
-    int64 count = 0;
-    while (consumer_.get() != nullptr && count < total) {
+    KafkaMessageBatch batch;
+    std::vector<rd_kafka_message_t*> polled;
+    while (consumer_.get() != nullptr && batch.size() < kMaxBatchMessages &&
+           batch.bytes() < kMaxBatchBytes) {
       if (!kafka_event_cb_.run()) {
         return errors::Internal("failed to consume due to all brokers down");
       }
-      message.reset(consumer_->consume(timeout_));
-      if (message->err() == RdKafka::ERR_NO_ERROR) {
-        // Produce the line as output.
-        message_value.emplace_back(string(
-            static_cast<const char*>(message->payload()), message->len()));
-        key_value.emplace_back(
-            (message->key() != nullptr) ? string(*message->key()) : "");
-        count++;
-        continue;
-      } else if (message->err() == RdKafka::ERR__TRANSPORT) {
-        // Not return error here because consumer will try re-connect.
-        LOG(ERROR) << "Broker transport failure: " << message->errstr();
-      } else if (message->err() == RdKafka::ERR__PARTITION_EOF) {
-        LOG(ERROR) << "EOF Message: " << message->errstr();
+      TF_RETURN_IF_ERROR(batch.Poll(
+          queue_, timeout_, kMaxBatchMessages - batch.size(), &polled));
+      bool eof = false;
+      TF_RETURN_IF_ERROR(ConsumeAll(&polled, &batch, &eof));
+      if (eof) {
+        // The queue holds a reference to the consumer
+        rd_kafka_queue_destroy(queue_);
+        queue_ = nullptr;
         consumer_.reset(nullptr);
-        break;
-      } else if (message->err() != RdKafka::ERR__TIMED_OUT) {
-        LOG(ERROR) << "Failed to consume: " << message->errstr();
-        return errors::Internal("Failed to consume: ", message->errstr());
       }
     }
-    TensorShape shape({static_cast<int64>(message_value.size())});
+    TensorShape shape({static_cast<int64>(batch.size())});
     Tensor* message_tensor;
     Tensor* key_tensor;
     TF_RETURN_IF_ERROR(allocate_func(shape, &message_tensor, &key_tensor));
-    for (size_t i = 0; i < message_value.size(); i++) {
-      message_tensor->flat<tstring>()(i) = message_value[i];
-      key_tensor->flat<tstring>()(i) = key_value[i];
-    }
+    batch.MoveTo(message_tensor, key_tensor);
     return Status::OK();
   }
   Status Read(const int64 start, const int64 stop,
@@ -237,50 +307,37 @@ class KafkaReadableResource : public ResourceBase {
           tail_offset + stop_offset - RdKafka::Consumer::OffsetTail(0);
     }
 
-    std::vector<string> message_value, key_value;
-
-    subscription_->set_offset(start);
-    RdKafka::ErrorCode err = consumer_->seek((*subscription_), timeout_);
-    if (err != RdKafka::ERR_NO_ERROR) {
-      return errors::Internal("failed to seek partition: ",
-                              RdKafka::err2str(err));
+    // Sequential reads continue at the current position without a seek
+    if (start != next_offset_) {
+      subscription_->set_offset(start);
+      RdKafka::ErrorCode err = consumer_->seek((*subscription_), timeout_);
+      if (err != RdKafka::ERR_NO_ERROR) {
+        next_offset_ = -1;
+        return errors::Internal("failed to seek partition: ",
+                                RdKafka::err2str(err));
+      }
+      next_offset_ = start;
     }
-    LOG(INFO) << "Kafka stream starts with current offset: "
-              << subscription_->offset();
-    int64 index = start;
-    std::unique_ptr<RdKafka::Message> message;
-    while (consumer_.get() != nullptr && index + 1 < stop_offset) {
+    LOG(INFO) << "Kafka stream starts with current offset: " << next_offset_;
+    KafkaMessageBatch batch;
+    std::vector<rd_kafka_message_t*> polled;
+    bool eof = false;
+    while (consumer_.get() != nullptr && next_offset_ < stop_offset && !eof) {
       if (!kafka_event_cb_.run()) {
         return errors::Internal("failed to consume due to all brokers down");
       }
-      message.reset(consumer_->consume(timeout_));
-      if (message->err() == RdKafka::ERR_NO_ERROR) {
-        // Produce the line as output.
-        message_value.emplace_back(string(
-            static_cast<const char*>(message->payload()), message->len()));
-        key_value.emplace_back(
-            (message->key() != nullptr) ? string(*message->key()) : "");
-        index = message->offset();
-        continue;
-      } else if (message->err() == RdKafka::ERR__PARTITION_EOF) {
-        LOG(ERROR) << "EOF Message: " << message->errstr();
-        break;
-      } else if (message->err() == RdKafka::ERR__TRANSPORT) {
-        // Not return error here because consumer will try re-connect.
-        LOG(ERROR) << "Broker transport failure: " << message->errstr();
-      } else if (message->err() != RdKafka::ERR__TIMED_OUT) {
-        LOG(ERROR) << "Failed to consume: " << message->errstr();
-        return errors::Internal("Failed to consume: ", message->errstr());
-      }
+      // Never take messages past the stop offset from the queue so that the
+      // position stays at stop_offset for the next sequential read
+      const size_t remaining = static_cast<size_t>(stop_offset - next_offset_);
+      TF_RETURN_IF_ERROR(batch.Poll(
+          queue_, timeout_, std::min(remaining, kMaxBatchMessages), &polled));
+      TF_RETURN_IF_ERROR(ConsumeAll(&polled, &batch, &eof));
     }
-    TensorShape shape({static_cast<int64>(message_value.size())});
+    TensorShape shape({static_cast<int64>(batch.size())});
     Tensor* message_tensor;
     Tensor* key_tensor;
     TF_RETURN_IF_ERROR(allocate_func(shape, &message_tensor, &key_tensor));
-    for (size_t i = 0; i < message_value.size(); i++) {
-      message_tensor->flat<tstring>()(i) = message_value[i];
-      key_tensor->flat<tstring>()(i) = key_value[i];
-    }
+    batch.MoveTo(message_tensor, key_tensor);
     return Status::OK();
   }
   Status Spec(const int64 start, const int64 stop, int64* start_offset,
@@ -324,43 +381,132 @@ class KafkaReadableResource : public ResourceBase {
 
     return Status::OK();
   }
+  // Resolves the timestamps (in milliseconds since epoch) to the earliest
+  // offset whose timestamp is equal or greater, for the partitions of the
+  // topic. Timestamps after the last message resolve to the end offset.
+  Status OffsetsForTimes(const std::vector<int32>& partitions,
+                         const std::vector<int64>& timestamps,
+                         std::vector<int64>* offsets) {
+    mutex_lock l(mu_);
+    if (partitions.size() != timestamps.size()) {
+      return errors::InvalidArgument("partitions and timestamps must have ",
+                                     "the same size: ", partitions.size(),
+                                     " vs. ", timestamps.size());
+    }
+    const string topic = subscription_->topic();
+    (*offsets).assign(partitions.size(), RdKafka::Topic::OFFSET_END);
+    // All partitions are resolved in one request, a partition may only appear
+    // once per request so repeated partitions are sent in follow-up requests
+    std::vector<bool> resolved(partitions.size(), false);
+    size_t remaining = partitions.size();
+    while (remaining > 0) {
+      std::vector<size_t> indices;
+      std::vector<RdKafka::TopicPartition*> request;
+      std::unordered_set<int32> seen;
+      for (size_t i = 0; i < partitions.size(); i++) {
+        if (!resolved[i] && seen.insert(partitions[i]).second) {
+          indices.push_back(i);
+          request.push_back(RdKafka::TopicPartition::create(
+              topic, partitions[i], timestamps[i]));
+        }
+      }
+      Status status;
+      RdKafka::ErrorCode err = consumer_->offsetsForTimes(request, timeout_);
+      if (err != RdKafka::ERR_NO_ERROR) {
+        status = errors::Internal("failed to query offsets for times: ",
+                                  RdKafka::err2str(err));
+      }
+      for (size_t j = 0; j < request.size() && status.ok(); j++) {
+        if (request[j]->err() != RdKafka::ERR_NO_ERROR) {
+          status = errors::Internal("failed to query offset for partition ",
+                                    request[j]->partition(), ": ",
+                                    RdKafka::err2str(request[j]->err()));
+          break;
+        }
+        int64 offset = request[j]->offset();
+        if (offset < 0) {
+          // No message at or after the timestamp
+          int64 low = 0;
+          status = Watermarks(request[j]->partition(), &low, &offset);
+        }
+        (*offsets)[indices[j]] = offset;
+        resolved[indices[j]] = true;
+        remaining--;
+      }
+      RdKafka::TopicPartition::destroy(request);
+      TF_RETURN_IF_ERROR(status);
+    }
+    return Status::OK();
+  }
   string DebugString() const override { return "KafkaBaseResource"; }
 
  protected:
-  Status Tail(int64* tail_offset) {
-    // Resolve tail message
-    int64 saved = subscription_->offset();
-
-    subscription_->set_offset(RdKafka::Consumer::OffsetTail(1));
-    RdKafka::ErrorCode err = consumer_->seek(*subscription_, timeout_);
-    if (err != RdKafka::ERR_NO_ERROR) {
-      return errors::Internal("failed to seek tail -1: ",
-                              RdKafka::err2str(err));
+  // Handles the polled messages in order until the end of the partition is
+  // reached, messages that are not added to the batch are released
+  Status ConsumeAll(std::vector<rd_kafka_message_t*>* polled,
+                    KafkaMessageBatch* batch, bool* eof) {
+    Status status;
+    for (rd_kafka_message_t* message : *polled) {
+      if (status.ok() && !*eof) {
+        status = Consume(message, batch, eof);
+      } else {
+        rd_kafka_message_destroy(message);
+      }
     }
-    std::unique_ptr<RdKafka::Message> message;
-    do {
-      message.reset(consumer_->consume(timeout_));
-    } while (message->err() == RdKafka::ERR__TRANSPORT);
-    if (message->err() != RdKafka::ERR_NO_ERROR) {
-      return errors::Internal("failed to consume tail message: ",
-                              RdKafka::err2str(message->err()));
+    (*polled).clear();
+    return status;
+  }
+  // Handles one polled message, data messages are added to the batch and all
+  // other messages are released
+  Status Consume(rd_kafka_message_t* message, KafkaMessageBatch* batch,
+                 bool* eof) {
+    const RdKafka::ErrorCode err =
+        static_cast<RdKafka::ErrorCode>(message->err);
+    if (err == RdKafka::ERR_NO_ERROR) {
+      next_offset_ = message->offset + 1;
+      (*batch).Add(message);
+      return Status::OK();
     }
-    *tail_offset = message->offset() + 1;
-    LOG(INFO) << "Kafka tail: " << *tail_offset;
-
-    subscription_->set_offset(saved);
-    err = consumer_->seek(*subscription_, timeout_);
+    const string errstr = rd_kafka_message_errstr(message);
+    rd_kafka_message_destroy(message);
+    if (err == RdKafka::ERR__PARTITION_EOF) {
+      LOG(ERROR) << "EOF Message: " << errstr;
+      *eof = true;
+    } else if (err == RdKafka::ERR__TRANSPORT) {
+      // Not return error here because consumer will try re-connect.
+      LOG(ERROR) << "Broker transport failure: " << errstr;
+    } else if (err != RdKafka::ERR__TIMED_OUT) {
+      LOG(ERROR) << "Failed to consume: " << errstr;
+      return errors::Internal("Failed to consume: ", errstr);
+    }
+    return Status::OK();
+  }
+  // Queries the low and high watermark offsets of the partition from the
+  // broker, the high watermark is the offset of the next produced message
+  Status Watermarks(const int32 partition, int64* low, int64* high) {
+    RdKafka::ErrorCode err = consumer_->query_watermark_offsets(
+        subscription_->topic(), partition, low, high, timeout_);
     if (err != RdKafka::ERR_NO_ERROR) {
-      return errors::Internal("failed to seek back saved: ",
+      return errors::Internal("failed to query watermark offsets: ",
                               RdKafka::err2str(err));
     }
-
+    return Status::OK();
+  }
+  Status Tail(int64* tail_offset) {
+    // The watermark query leaves the consumer position untouched
+    int64 low = 0;
+    TF_RETURN_IF_ERROR(
+        Watermarks(subscription_->partition(), &low, tail_offset));
+    LOG(INFO) << "Kafka tail: " << *tail_offset;
     return Status::OK();
   }
   mutable mutex mu_;
   Env* env_ TF_GUARDED_BY(mu_);
   std::unique_ptr<RdKafka::TopicPartition> subscription_ TF_GUARDED_BY(mu_);
   std::unique_ptr<RdKafka::KafkaConsumer> consumer_ TF_GUARDED_BY(mu_);
+  rd_kafka_queue_t* queue_ TF_GUARDED_BY(mu_) = nullptr;
+  // The offset of the next message in the queue, -1 if unknown
+  int64 next_offset_ TF_GUARDED_BY(mu_) = -1;
   KafkaEventCb kafka_event_cb_ = KafkaEventCb();
   static const int timeout_ = 5000;
 };
@@ -521,6 +667,50 @@ class KafkaReadableSpecOp : public OpKernel {
   mutable mutex mu_;
   Env* env_ TF_GUARDED_BY(mu_);
 };
+class KafkaReadableOffsetsForTimesOp : public OpKernel {
+ public:
+  explicit KafkaReadableOffsetsForTimesOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    env_ = context->env();
+  }
+
+  void Compute(OpKernelContext* context) override {
+    KafkaReadableResource* resource;
+    OP_REQUIRES_OK(context,
+                   GetResourceFromContext(context, "input", &resource));
+    core::ScopedUnref unref(resource);
+
+    const Tensor* partitions_tensor;
+    OP_REQUIRES_OK(context, context->input("partitions", &partitions_tensor));
+    std::vector<int32> partitions;
+    for (int64 i = 0; i < partitions_tensor->NumElements(); i++) {
+      partitions.push_back(partitions_tensor->flat<int32>()(i));
+    }
+
+    const Tensor* timestamps_tensor;
+    OP_REQUIRES_OK(context, context->input("timestamps", &timestamps_tensor));
+    std::vector<int64> timestamps;
+    for (int64 i = 0; i < timestamps_tensor->NumElements(); i++) {
+      timestamps.push_back(timestamps_tensor->flat<int64>()(i));
+    }
+
+    std::vector<int64> offsets;
+    OP_REQUIRES_OK(context,
+                   resource->OffsetsForTimes(partitions, timestamps, &offsets));
+
+    Tensor* offsets_tensor = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(0, partitions_tensor->shape(),
+                                            &offsets_tensor));
+    for (size_t i = 0; i < offsets.size(); i++) {
+      offsets_tensor->flat<int64>()(i) = offsets[i];
+    }
+  }
+
+ private:
+  mutable mutex mu_;
+  Env* env_ TF_GUARDED_BY(mu_);
+};
 /*
 class KafkaIterableInitOp : public ResourceOpKernel<KafkaIterableResource> {
  public:
@@ -569,109 +759,42 @@ class KafkaIterableInitOp : public ResourceOpKernel<KafkaIterableResource> {
 class LayerKafkaResource : public ResourceBase {
  public:
   LayerKafkaResource(Env* env) : env_(env) {}
-  ~LayerKafkaResource() { Sync(); }
+  ~LayerKafkaResource() {}
 
   Status Init(const string& topic, const int32 partition,
               const std::vector<string>& metadata) {
-    std::unique_ptr<RdKafka::Conf> conf(
-        RdKafka::Conf::create(RdKafka::Conf::CONF_GLOBAL));
-    std::unique_ptr<RdKafka::Conf> conf_topic(
-        RdKafka::Conf::create(RdKafka::Conf::CONF_TOPIC));
-
-    string errstr;
-    RdKafka::Conf::ConfResult result = RdKafka::Conf::CONF_UNKNOWN;
-
-    for (size_t i = 0; i < metadata.size(); i++) {
-      if (metadata[i].find("conf.topic.") == 0) {
-        std::vector<string> parts = str_util::Split(metadata[i], "=");
-        if (parts.size() != 2) {
-          return errors::InvalidArgument("invalid topic configuration: ",
-                                         metadata[i]);
-        }
-        result = conf_topic->set(parts[0].substr(11), parts[1], errstr);
-        if (result != RdKafka::Conf::CONF_OK) {
-          return errors::Internal("failed to do topic configuration:",
-                                  metadata[i], "error:", errstr);
-        }
-      } else if (metadata[i] != "" &&
-                 metadata[i].find("conf.") == string::npos) {
-        std::vector<string> parts = str_util::Split(metadata[i], "=");
-        if (parts.size() != 2) {
-          return errors::InvalidArgument("invalid global configuration: ",
-                                         metadata[i]);
-        }
-        if ((result = conf->set(parts[0], parts[1], errstr)) !=
-            RdKafka::Conf::CONF_OK) {
-          return errors::Internal("failed to do global configuration: ",
-                                  metadata[i], "error:", errstr);
-        }
-      }
-      LOG(INFO) << "Kafka configuration: " << metadata[i];
-    }
-    if ((result = conf->set("default_topic_conf", conf_topic.get(), errstr)) !=
-        RdKafka::Conf::CONF_OK) {
-      return errors::Internal("failed to set default_topic_conf:", errstr);
-    }
-
-    string bootstrap_servers;
-    if ((result = conf->get("bootstrap.servers", bootstrap_servers)) !=
-        RdKafka::Conf::CONF_OK) {
-      bootstrap_servers = "localhost:9092";
-      if ((result = conf->set("bootstrap.servers", bootstrap_servers,
-                              errstr)) != RdKafka::Conf::CONF_OK) {
-        return errors::Internal("failed to set bootstrap.servers [",
-                                bootstrap_servers, "]:", errstr);
-      }
-      LOG(INFO) << "Kafka default bootstrap server: " << bootstrap_servers;
-    }
-
-    producer_.reset(RdKafka::Producer::create(conf.get(), errstr));
-    if (!(producer_.get() != nullptr)) {
-      return errors::Internal("Failed to create producer:", errstr);
-    }
-
-    topic_.reset(RdKafka::Topic::create(producer_.get(), topic,
-                                        conf_topic.get(), errstr));
-    if (!(topic_.get() != nullptr)) {
-      return errors::Internal("Failed to create topic ", topic, ":", errstr);
-    }
-
-    partition_ = partition;
-    return Status::OK();
+    mutex_lock l(mu_);
+    producer_.reset(new data::KafkaAsyncProducer(env_));
+    return producer_->Init(topic, partition, metadata);
   }
   Status Write(const Tensor& content) {
     mutex_lock l(mu_);
     for (int64 i = 0; i < content.NumElements(); i++) {
-      RdKafka::ErrorCode err = producer_->produce(
-          topic_.get(), partition_, RdKafka::Producer::RK_MSG_COPY,
-          (void*)content.flat<tstring>()(i).data(),
-          content.flat<tstring>()(i).size(), NULL, NULL);
-      if (!(err == RdKafka::ERR_NO_ERROR)) {
-        return errors::Internal("Failed to produce message:",
-                                RdKafka::err2str(err));
-      }
+      const tstring& message = content.flat<tstring>()(i);
+      TF_RETURN_IF_ERROR(producer_->Produce(message.data(), message.size()));
     }
     return Status::OK();
   }
   Status Sync() {
+    mutex_lock l(mu_);
+    if (producer_.get() == nullptr) {
+      return Status::OK();
+    }
+    return producer_->Flush();
+  }
+  void Metrics(int64* delivered, int64* failed, int64* queued) {
+    mutex_lock l(mu_);
+    *delivered = *failed = *queued = 0;
     if (producer_.get() != nullptr) {
-      RdKafka::ErrorCode err = producer_->flush(timeout_);
-      if (!(err == RdKafka::ERR_NO_ERROR)) {
-        return errors::Internal("Failed to flush message:",
-                                RdKafka::err2str(err));
-      }
+      producer_->Metrics(delivered, failed, queued);
     }
-    return Status::OK();
   }
   string DebugString() const override { return "LayerKafkaResource"; }
 
  private:
   mutable mutex mu_;
   Env* env_ TF_GUARDED_BY(mu_);
-  std::unique_ptr<RdKafka::Producer> producer_ TF_GUARDED_BY(mu_);
-  std::unique_ptr<RdKafka::Topic> topic_ TF_GUARDED_BY(mu_);
-  int32 partition_ TF_GUARDED_BY(mu_);
-  static const int timeout_ = 5000;
+  std::unique_ptr<data::KafkaAsyncProducer> producer_ TF_GUARDED_BY(mu_);
 };
 
 class LayerKafkaInitOp : public ResourceOpKernel<LayerKafkaResource> {
@@ -761,14 +884,40 @@ class LayerKafkaSyncOp : public OpKernel {
   Env* env_ TF_GUARDED_BY(mu_);
 };
 
+class LayerKafkaMetricsOp : public OpKernel {
+ public:
+  explicit LayerKafkaMetricsOp(OpKernelConstruction* context)
+      : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    LayerKafkaResource* resource;
+    OP_REQUIRES_OK(context,
+                   GetResourceFromContext(context, "resource", &resource));
+    core::ScopedUnref unref(resource);
+
+    Tensor* metrics_tensor = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(0, TensorShape({3}),
+                                                     &metrics_tensor));
+    auto metrics = metrics_tensor->flat<int64>();
+    resource->Metrics(&metrics(0), &metrics(1), &metrics(2));
+  }
+};
+
 static int64 partition_count = 0;
 static int64 eof_count = 0;
 class KafkaRebalanceCb : public RdKafka::RebalanceCb {
  public:
+  using Listener = std::function<void(
+      RdKafka::ErrorCode, const std::vector<RdKafka::TopicPartition*>&)>;
+
   KafkaRebalanceCb() : run_(true) {}
 
   bool run() { return run_; }
 
+  // The listener is called after partitions are assigned and before
+  // partitions are revoked
+  void set_listener(Listener listener) { listener_ = std::move(listener); }
+
   void rebalance_cb(RdKafka::KafkaConsumer* consumer, RdKafka::ErrorCode err,
                     std::vector<RdKafka::TopicPartition*>& partitions) {
     LOG(ERROR) << "REBALANCE: " << RdKafka::err2str(err);
@@ -802,7 +951,13 @@ class KafkaRebalanceCb : public RdKafka::RebalanceCb {
       LOG(INFO) << "REBALANCE: Assigning partitions";
       consumer->assign(partitions);
       partition_count = (int)partitions.size();
+      if (listener_) {
+        listener_(err, partitions);
+      }
     } else {
+      if (listener_) {
+        listener_(err, partitions);
+      }
       LOG(INFO) << "REBALANCE: Unassigning partitions";
       consumer->unassign();
       partition_count = 0;
@@ -813,12 +968,18 @@ class KafkaRebalanceCb : public RdKafka::RebalanceCb {
  private:
   mutable mutex mu_;
   bool run_ TF_GUARDED_BY(mu_) = true;
+  Listener listener_;
 };
 
 class KafkaGroupReadableResource : public ResourceBase {
  public:
   KafkaGroupReadableResource(Env* env) : env_(env) {}
   virtual ~KafkaGroupReadableResource() {
+    // Fetchers hold partition queues that reference the consumer
+    RemoveFetchers(nullptr);
+    if (queue_ != nullptr) {
+      rd_kafka_queue_destroy(queue_);
+    }
     if (consumer_.get()) {
       consumer_->unassign();
       consumer_->close();
@@ -827,8 +988,11 @@ class KafkaGroupReadableResource : public ResourceBase {
   }
 
   virtual Status Init(const std::vector<std::string>& topics,
-                      const std::vector<std::string>& metadata) {
+                      const std::vector<std::string>& metadata,
+                      const bool parallel, const string& merge) {
     mutex_lock l(mu_);
+    parallel_ = parallel;
+    round_robin_ = (merge == "round_robin");
 
     std::unique_ptr<RdKafka::Conf> conf(
         RdKafka::Conf::create(RdKafka::Conf::CONF_GLOBAL));
@@ -930,6 +1094,32 @@ class KafkaGroupReadableResource : public ResourceBase {
       return errors::Internal("failed to set event_cb:", errstr);
     }
 
+    if (parallel_) {
+      // Offsets are stored once messages are handed out by Next rather than
+      // when a fetcher takes them, so that messages buffered for revoked
+      // partitions are consumed again by the new owner
+      string auto_offset_store;
+      if ((result = conf->get("enable.auto.offset.store",
+                              auto_offset_store)) != RdKafka::Conf::CONF_OK ||
+          auto_offset_store != "false") {
+        if ((result = conf->set("enable.auto.offset.store", "false",
+                                errstr)) != RdKafka::Conf::CONF_OK) {
+          return errors::Internal("failed to set enable.auto.offset.store:",
+                                  errstr);
+        }
+        store_offsets_ = true;
+      }
+      kafka_rebalance_cb_.set_listener(
+          [this](RdKafka::ErrorCode err,
+                 const std::vector<RdKafka::TopicPartition*>& partitions) {
+            if (err == RdKafka::ERR__ASSIGN_PARTITIONS) {
+              AddFetchers(partitions);
+            } else {
+              RemoveFetchers(&partitions);
+            }
+          });
+    }
+
     if ((result = conf->set("rebalance_cb", &kafka_rebalance_cb_, errstr)) !=
         RdKafka::Conf::CONF_OK) {
       return errors::Internal("failed to set rebalance_cb:", errstr);
@@ -950,6 +1140,10 @@ class KafkaGroupReadableResource : public ResourceBase {
                               RdKafka::err2str(err));
     }
 
+    // Messages of all assigned partitions, rebalances and error events are
+    // served from the consumer queue
+    queue_ = rd_kafka_queue_get_consumer(consumer_->c_ptr());
+
     return Status::OK();
   }
   Status Next(const int64 index, const int64 message_poll_timeout,
@@ -960,52 +1154,66 @@ class KafkaGroupReadableResource : public ResourceBase {
     mutex_lock l(mu_);
 
     // Initialize necessary variables
-    int64 num_messages = 0;
     max_stream_timeout_polls_ = stream_timeout / message_poll_timeout;
 
-    // Allocate memory for message_value and key_value vectors
-    std::vector<string> message_value, key_value;
-    message_value.reserve(batch_num_messages_);
-    key_value.reserve(batch_num_messages_);
-
-    std::unique_ptr<RdKafka::Message> message;
-    while (consumer_.get() != nullptr && num_messages < batch_num_messages_) {
+    KafkaMessageBatch batch;
+    if (parallel_) {
+      TF_RETURN_IF_ERROR(NextParallel(message_poll_timeout, &batch));
+    }
+    std::vector<rd_kafka_message_t*> polled;
+    bool stop = false;
+    while (!parallel_ && consumer_.get() != nullptr && !stop &&
+           batch.size() < static_cast<size_t>(batch_num_messages_) &&
+           batch.bytes() < kMaxBatchBytes) {
       if (!kafka_event_cb_.run()) {
         return errors::Internal(
             "failed to consume messages due to broker issue");
       }
-      message.reset(consumer_->consume(message_poll_timeout));
-      if (message->err() == RdKafka::ERR_NO_ERROR) {
-        // Produce the line as output.
-        message_value.emplace_back(string(
-            static_cast<const char*>(message->payload()), message->len()));
-        key_value.emplace_back(
-            (message->key() != nullptr) ? string(*message->key()) : "");
-        num_messages++;
-        // Once a message has been successfully retrieved, the
-        // `stream_timeout_polls_` is reset to 0. This allows the dataset
-        // to wait for the entire `stream_timeout` duration when a data
-        // slump occurs in the future.
-        stream_timeout_polls_ = 0;
-      } else if (message->err() == RdKafka::ERR__TRANSPORT) {
-        // Not returning an error here as the consumer will try to re-connect.
-        LOG(ERROR) << "Broker transport failure: " << message->errstr();
-
-      } else if (message->err() == RdKafka::ERR__PARTITION_EOF) {
-        if (++eof_count == partition_count) {
-          LOG(INFO) << "EOF reached for all " << partition_count
-                    << " partition(s)";
-          break;
-        }
-      } else if (message->err() == RdKafka::ERR__TIMED_OUT) {
-        LOG(ERROR) << message->errstr();
+      TF_RETURN_IF_ERROR(batch.Poll(queue_, message_poll_timeout,
+                                    batch_num_messages_ - batch.size(),
+                                    &polled));
+      if (polled.empty()) {
+        LOG(ERROR) << RdKafka::err2str(RdKafka::ERR__TIMED_OUT);
         stream_timeout_polls_++;
         break;
       }
+      // Data messages that arrive after the end of all partitions are kept,
+      // their offsets have already been stored by the consumer
+      for (rd_kafka_message_t* message : polled) {
+        const RdKafka::ErrorCode err =
+            static_cast<RdKafka::ErrorCode>(message->err);
+        if (err == RdKafka::ERR_NO_ERROR) {
+          batch.Add(message);
+          // Once a message has been successfully retrieved, the
+          // `stream_timeout_polls_` is reset to 0. This allows the dataset
+          // to wait for the entire `stream_timeout` duration when a data
+          // slump occurs in the future.
+          stream_timeout_polls_ = 0;
+          continue;
+        }
+        if (err == RdKafka::ERR__TRANSPORT) {
+          // Not returning an error here as the consumer will try to
+          // re-connect.
+          LOG(ERROR) << "Broker transport failure: "
+                     << rd_kafka_message_errstr(message);
+        } else if (err == RdKafka::ERR__PARTITION_EOF) {
+          if (++eof_count == partition_count) {
+            LOG(INFO) << "EOF reached for all " << partition_count
+                      << " partition(s)";
+            stop = true;
+          }
+        } else if (err == RdKafka::ERR__TIMED_OUT) {
+          LOG(ERROR) << rd_kafka_message_errstr(message);
+          stream_timeout_polls_++;
+          stop = true;
+        }
+        rd_kafka_message_destroy(message);
+      }
+      polled.clear();
     }
 
     // Prepare the outputs
-    TensorShape shape({static_cast<int64>(message_value.size())});
+    TensorShape shape({static_cast<int64>(batch.size())});
     Tensor* message_tensor;
     Tensor* key_tensor;
     Tensor* continue_fetch_tensor;
@@ -1017,25 +1225,348 @@ class KafkaGroupReadableResource : public ResourceBase {
     } else {
       continue_fetch_tensor->scalar<int64>()() = 0;
     }
-    for (size_t i = 0; i < message_value.size(); i++) {
-      message_tensor->flat<tstring>()(i) = message_value[i];
-      key_tensor->flat<tstring>()(i) = key_value[i];
-    }
+    batch.MoveTo(message_tensor, key_tensor);
 
     return Status::OK();
   }
 
   string DebugString() const override { return "KafkaBaseResource"; }
 
+ private:
+  // A fetcher drains the queue of one assigned partition on its own thread
+  struct PartitionFetcher {
+    string topic;
+    int32 partition;
+    rd_kafka_queue_t* queue = nullptr;
+    std::unique_ptr<Thread> thread;
+    // The fields below are guarded by buffer_mu_
+    std::deque<rd_kafka_message_t*> buffered;
+    size_t num_buffered = 0;
+    int64 next_offset = -1;
+    bool eof = false;
+    bool stop = false;
+  };
+
+  // Upper bound of the dynamic batch size as a multiple of
+  // batch.num.messages
+  static const int64 kMaxBatchScale = 8;
+  // Time a fetcher waits for messages before it checks for stop
+  static const int kFetchTimeout = 100;
+  // Time Next waits for fetchers before it serves the consumer queue again
+  static const int64 kServeIntervalMicros = 100000;
+
+  // The batch grows with the lag of the assigned partitions, up to
+  // kMaxBatchScale * batch.num.messages, to catch up at full throughput and
+  // falls back to batch.num.messages once the consumer is caught up
+  size_t DynamicBatchSize() TF_EXCLUSIVE_LOCKS_REQUIRED(buffer_mu_) {
+    int64 lag = 0;
+    for (const auto& fetcher : fetchers_) {
+      int64 low = 0, high = 0;
+      if (fetcher->next_offset >= 0 &&
+          rd_kafka_get_watermark_offsets(
+              consumer_->c_ptr(), fetcher->topic.c_str(), fetcher->partition,
+              &low, &high) == RD_KAFKA_RESP_ERR_NO_ERROR) {
+        lag += std::max<int64>(high - fetcher->next_offset, 0);
+      }
+    }
+    const int64 base = batch_num_messages_;
+    return static_cast<size_t>(
+        std::min(std::max(lag, base), base * kMaxBatchScale));
+  }
+
+  // Moves buffered messages into the batch, either in arrival order or one
+  // message per partition in turn
+  void TakeBuffered(KafkaMessageBatch* batch, size_t target)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(buffer_mu_) {
+    bool taken = true;
+    while (taken && (*batch).size() < target &&
+           (*batch).bytes() < kMaxBatchBytes) {
+      taken = false;
+      if (!round_robin_) {
+        if (!arrived_.empty()) {
+          PartitionFetcher* fetcher = arrived_.front().first;
+          rd_kafka_message_t* message = arrived_.front().second;
+          arrived_.pop_front();
+          fetcher->num_buffered--;
+          Take(fetcher, message, batch);
+          taken = true;
+        }
+        continue;
+      }
+      for (const auto& fetcher : fetchers_) {
+        if ((*batch).size() >= target) {
+          break;
+        }
+        if (!fetcher->buffered.empty()) {
+          rd_kafka_message_t* message = fetcher->buffered.front();
+          fetcher->buffered.pop_front();
+          fetcher->num_buffered--;
+          Take(fetcher.get(), message, batch);
+          taken = true;
+        }
+      }
+    }
+    room_cv_.notify_all();
+  }
+
+  void Take(PartitionFetcher* fetcher, rd_kafka_message_t* message,
+            KafkaMessageBatch* batch) {
+    if (fetcher != nullptr) {
+      fetcher->next_offset = message->offset + 1;
+    }
+    if (store_offsets_) {
+      rd_kafka_offset_store(message->rkt, message->partition,
+                            message->offset);
+    }
+    (*batch).Add(message);
+  }
+
+  // Serves rebalances and error events from the consumer queue. Messages of
+  // a partition may reach the consumer queue before its fetcher stops the
+  // forwarding, those are added to the batch directly.
+  Status ServeConsumerQueue(KafkaMessageBatch* batch) {
+    std::vector<rd_kafka_message_t*> polled;
+    TF_RETURN_IF_ERROR(
+        KafkaMessageBatch::Poll(queue_, 0, kMaxBatchMessages, &polled));
+    for (rd_kafka_message_t* message : polled) {
+      const RdKafka::ErrorCode err =
+          static_cast<RdKafka::ErrorCode>(message->err);
+      if (err == RdKafka::ERR_NO_ERROR) {
+        mutex_lock l(buffer_mu_);
+        PartitionFetcher* fetcher =
+            FindFetcher(rd_kafka_topic_name(message->rkt), message->partition);
+        if (fetcher != nullptr) {
+          rd_kafka_queue_forward(fetcher->queue, nullptr);
+        }
+        Take(fetcher, message, batch);
+        continue;
+      }
+      if (err == RdKafka::ERR__TRANSPORT) {
+        // Not returning an error here as the consumer will try to re-connect.
+        LOG(ERROR) << "Broker transport failure: "
+                   << rd_kafka_message_errstr(message);
+      } else if (err != RdKafka::ERR__PARTITION_EOF &&
+                 err != RdKafka::ERR__TIMED_OUT) {
+        LOG(ERROR) << "Failed to consume: " << rd_kafka_message_errstr(message);
+      }
+      rd_kafka_message_destroy(message);
+    }
+    return Status::OK();
+  }
+
+  Status NextParallel(const int64 message_poll_timeout,
+                      KafkaMessageBatch* batch) {
+    const uint64 deadline = env_->NowMicros() + message_poll_timeout * 1000;
+    bool timed_out = false;
+    while (true) {
+      TF_RETURN_IF_ERROR(ServeConsumerQueue(batch));
+      if (!kafka_event_cb_.run()) {
+        return errors::Internal(
+            "failed to consume messages due to broker issue");
+      }
+      mutex_lock l(buffer_mu_);
+      const size_t target = DynamicBatchSize();
+      TakeBuffered(batch, target);
+      if ((*batch).size() >= target || (*batch).bytes() >= kMaxBatchBytes) {
+        break;
+      }
+      bool eof = !fetchers_.empty();
+      for (const auto& fetcher : fetchers_) {
+        eof = eof && fetcher->eof && fetcher->num_buffered == 0;
+      }
+      if (eof) {
+        LOG(INFO) << "EOF reached for all " << fetchers_.size()
+                  << " partition(s)";
+        break;
+      }
+      const uint64 now = env_->NowMicros();
+      if (now >= deadline) {
+        timed_out = true;
+        break;
+      }
+      buffer_cv_.wait_for(l, std::chrono::microseconds(std::min<uint64>(
+                                 deadline - now, kServeIntervalMicros)));
+    }
+    if ((*batch).size() > 0) {
+      // Once a message has been successfully retrieved, the
+      // `stream_timeout_polls_` is reset to 0.
+      stream_timeout_polls_ = 0;
+    }
+    if (timed_out) {
+      LOG(ERROR) << RdKafka::err2str(RdKafka::ERR__TIMED_OUT);
+      stream_timeout_polls_++;
+    }
+    return Status::OK();
+  }
+
+  void Fetch(PartitionFetcher* fetcher) {
+    std::vector<rd_kafka_message_t*> polled;
+    // Bound the messages buffered per partition
+    const size_t max_buffered =
+        2 * kMaxBatchScale * static_cast<size_t>(batch_num_messages_);
+    while (true) {
+      {
+        mutex_lock l(buffer_mu_);
+        while (!fetcher->stop && fetcher->num_buffered >= max_buffered) {
+          room_cv_.wait(l);
+        }
+        if (fetcher->stop) {
+          return;
+        }
+      }
+      Status status = KafkaMessageBatch::Poll(fetcher->queue, kFetchTimeout,
+                                              kMaxBatchMessages, &polled);
+      if (!status.ok()) {
+        LOG(ERROR) << "Failed to fetch " << fetcher->topic << "["
+                   << fetcher->partition << "]: " << status;
+        continue;
+      }
+      if (polled.empty()) {
+        continue;
+      }
+      mutex_lock l(buffer_mu_);
+      for (rd_kafka_message_t* message : polled) {
+        const RdKafka::ErrorCode err =
+            static_cast<RdKafka::ErrorCode>(message->err);
+        if (err == RdKafka::ERR_NO_ERROR && !fetcher->stop) {
+          if (round_robin_) {
+            fetcher->buffered.push_back(message);
+          } else {
+            arrived_.emplace_back(fetcher, message);
+          }
+          fetcher->num_buffered++;
+          fetcher->eof = false;
+          continue;
+        }
+        if (err == RdKafka::ERR__PARTITION_EOF) {
+          fetcher->eof = true;
+        } else if (err == RdKafka::ERR__TRANSPORT) {
+          // Not returning an error here as the consumer will try to
+          // re-connect.
+          LOG(ERROR) << "Broker transport failure: "
+                     << rd_kafka_message_errstr(message);
+        } else if (err != RdKafka::ERR_NO_ERROR) {
+          LOG(ERROR) << "Failed to fetch: " << rd_kafka_message_errstr(message);
+        }
+        rd_kafka_message_destroy(message);
+      }
+      polled.clear();
+      buffer_cv_.notify_all();
+    }
+  }
+
+  PartitionFetcher* FindFetcher(const string& topic, int32 partition)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(buffer_mu_) {
+    for (const auto& fetcher : fetchers_) {
+      if (fetcher->partition == partition && fetcher->topic == topic) {
+        return fetcher.get();
+      }
+    }
+    return nullptr;
+  }
+
+  // Starts a fetcher for every newly assigned partition
+  void AddFetchers(const std::vector<RdKafka::TopicPartition*>& partitions) {
+    mutex_lock l(buffer_mu_);
+    for (const RdKafka::TopicPartition* partition : partitions) {
+      if (FindFetcher(partition->topic(), partition->partition()) != nullptr) {
+        continue;
+      }
+      std::unique_ptr<PartitionFetcher> fetcher(new PartitionFetcher());
+      fetcher->topic = partition->topic();
+      fetcher->partition = partition->partition();
+      fetcher->queue = rd_kafka_queue_get_partition(
+          consumer_->c_ptr(), fetcher->topic.c_str(), fetcher->partition);
+      if (fetcher->queue == nullptr) {
+        LOG(ERROR) << "Failed to get queue for " << fetcher->topic << "["
+                   << fetcher->partition << "]";
+        continue;
+      }
+      // Stop forwarding the messages of this partition to the consumer queue
+      rd_kafka_queue_forward(fetcher->queue, nullptr);
+      PartitionFetcher* raw = fetcher.get();
+      fetcher->thread.reset(env_->StartThread(
+          ThreadOptions(), "kafka_partition_fetcher",
+          [this, raw]() { Fetch(raw); }));
+      LOG(INFO) << "Started fetcher for " << fetcher->topic << "["
+                << fetcher->partition << "]";
+      fetchers_.push_back(std::move(fetcher));
+    }
+  }
+
+  // Stops the fetchers of the revoked partitions, or of all partitions if
+  // partitions is nullptr, and drops the messages they buffered
+  void RemoveFetchers(const std::vector<RdKafka::TopicPartition*>* partitions) {
+    std::vector<std::unique_ptr<PartitionFetcher>> removed;
+    {
+      mutex_lock l(buffer_mu_);
+      auto revoked = [partitions](const PartitionFetcher& fetcher) {
+        if (partitions == nullptr) {
+          return true;
+        }
+        for (const RdKafka::TopicPartition* partition : *partitions) {
+          if (partition->partition() == fetcher.partition &&
+              partition->topic() == fetcher.topic) {
+            return true;
+          }
+        }
+        return false;
+      };
+      for (auto it = fetchers_.begin(); it != fetchers_.end();) {
+        if (revoked(**it)) {
+          (*it)->stop = true;
+          removed.push_back(std::move(*it));
+          it = fetchers_.erase(it);
+        } else {
+          ++it;
+        }
+      }
+      for (auto it = arrived_.begin(); it != arrived_.end();) {
+        if (it->first->stop) {
+          rd_kafka_message_destroy(it->second);
+          it = arrived_.erase(it);
+        } else {
+          ++it;
+        }
+      }
+      room_cv_.notify_all();
+    }
+    // Threads are joined without the lock, fetchers need it to exit
+    for (auto& fetcher : removed) {
+      fetcher->thread.reset(nullptr);
+      for (rd_kafka_message_t* message : fetcher->buffered) {
+        rd_kafka_message_destroy(message);
+      }
+      rd_kafka_queue_destroy(fetcher->queue);
+      LOG(INFO) << "Stopped fetcher for " << fetcher->topic << "["
+                << fetcher->partition << "]";
+    }
+  }
+
+ public:
   mutable mutex mu_;
   Env* env_ TF_GUARDED_BY(mu_);
   // std::unique_ptr<RdKafka::TopicPartition> subscription_ TF_GUARDED_BY(mu_);
   std::unique_ptr<RdKafka::KafkaConsumer> consumer_ TF_GUARDED_BY(mu_);
+  rd_kafka_queue_t* queue_ TF_GUARDED_BY(mu_) = nullptr;
   KafkaEventCb kafka_event_cb_ = KafkaEventCb();
   KafkaRebalanceCb kafka_rebalance_cb_ = KafkaRebalanceCb();
   int max_stream_timeout_polls_ = -1;
   int stream_timeout_polls_ = -1;
   int batch_num_messages_ = 1024;
+
+  // Parallel consumption with one fetcher per assigned partition
+  bool parallel_ = false;
+  bool round_robin_ = false;
+  bool store_offsets_ = false;
+  mutex buffer_mu_;
+  condition_variable buffer_cv_;
+  condition_variable room_cv_;
+  std::vector<std::unique_ptr<PartitionFetcher>> fetchers_
+      TF_GUARDED_BY(buffer_mu_);
+  // Messages of all fetchers in arrival order, unless merging round-robin
+  std::deque<std::pair<PartitionFetcher*, rd_kafka_message_t*>> arrived_
+      TF_GUARDED_BY(buffer_mu_);
 };
 
 class KafkaGroupReadableInitOp
@@ -1044,6 +1575,8 @@ class KafkaGroupReadableInitOp
   explicit KafkaGroupReadableInitOp(OpKernelConstruction* context)
       : ResourceOpKernel<KafkaGroupReadableResource>(context) {
     env_ = context->env();
+    OP_REQUIRES_OK(context, context->GetAttr("parallel", &parallel_));
+    OP_REQUIRES_OK(context, context->GetAttr("merge", &merge_));
   }
 
  private:
@@ -1064,7 +1597,8 @@ class KafkaGroupReadableInitOp
       metadata.push_back(metadata_tensor->flat<tstring>()(i));
     }
 
-    OP_REQUIRES_OK(context, resource_->Init(topics, metadata));
+    OP_REQUIRES_OK(context,
+                   resource_->Init(topics, metadata, parallel_, merge_));
   }
   Status CreateResource(KafkaGroupReadableResource** resource)
       TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) override {
@@ -1075,6 +1609,8 @@ class KafkaGroupReadableInitOp
  private:
   mutable mutex mu_;
   Env* env_ TF_GUARDED_BY(mu_);
+  bool parallel_;
+  string merge_;
 };
 
 class KafkaGroupReadableNextOp : public OpKernel {
@@ -1132,12 +1668,17 @@ REGISTER_KERNEL_BUILDER(Name("IO>KafkaReadableRead").Device(DEVICE_CPU),
                         KafkaReadableReadOp);
 REGISTER_KERNEL_BUILDER(Name("IO>KafkaReadableSpec").Device(DEVICE_CPU),
                         KafkaReadableSpecOp);
+REGISTER_KERNEL_BUILDER(
+    Name("IO>KafkaReadableOffsetsForTimes").Device(DEVICE_CPU),
+    KafkaReadableOffsetsForTimesOp);
 REGISTER_KERNEL_BUILDER(Name("IO>LayerKafkaInit").Device(DEVICE_CPU),
                         LayerKafkaInitOp);
 REGISTER_KERNEL_BUILDER(Name("IO>LayerKafkaCall").Device(DEVICE_CPU),
                         LayerKafkaCallOp);
 REGISTER_KERNEL_BUILDER(Name("IO>LayerKafkaSync").Device(DEVICE_CPU),
                         LayerKafkaSyncOp);
+REGISTER_KERNEL_BUILDER(Name("IO>LayerKafkaMetrics").Device(DEVICE_CPU),
+                        LayerKafkaMetricsOp);
 REGISTER_KERNEL_BUILDER(Name("IO>KafkaGroupReadableInit").Device(DEVICE_CPU),
                         KafkaGroupReadableInitOp);
 REGISTER_KERNEL_BUILDER(Name("IO>KafkaGroupReadableNext").Device(DEVICE_CPU),
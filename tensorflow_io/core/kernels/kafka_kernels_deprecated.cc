@@ -21,12 +21,16 @@ limitations under the License.
 #include "api/Generic.hh"
 #include "api/Stream.hh"
 #include "api/Validator.hh"
+#include "rapidjson/document.h"
 #include "rdkafkacpp.h"
 #include "tensorflow/core/framework/dataset.h"
 #include "tensorflow/core/framework/resource_mgr.h"
 #include "tensorflow/core/framework/resource_op_kernel.h"
+#include "tensorflow/core/platform/cloud/curl_http_request.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/work_sharder.h"
 #include "tensorflow_io/core/kernels/io_interface.h"
+#include "tensorflow_io/core/kernels/kafka_producer.h"
 #include "tensorflow_io/core/kernels/sequence_ops.h"
 
 namespace tensorflow {
@@ -537,18 +541,54 @@ class KafkaDatasetOp : public DatasetOpKernel {
   };
 };
 
+// A producer shared by all WriteKafka calls with the same servers and
+// configuration. Calls flush the queue unless they opt out with sync=false,
+// in which case messages are delivered asynchronously, delivery errors are
+// reported by the next call, and the queue is flushed by the next sync call
+// or when the resource is destroyed.
+class KafkaProducerResource : public ResourceBase {
+ public:
+  explicit KafkaProducerResource(Env* env) : producer_(env) {}
+
+  Status Init(const string& servers, const std::vector<string>& config) {
+    std::vector<string> metadata;
+    metadata.push_back(strings::StrCat("bootstrap.servers=", servers));
+    metadata.insert(metadata.end(), config.begin(), config.end());
+    return producer_.Init(metadata);
+  }
+
+  // Enqueues all messages of the tensor without waiting for delivery
+  Status Produce(const string& topic, int32 partition,
+                 const Tensor& messages) {
+    const auto& flat = messages.flat<tstring>();
+    for (int64 i = 0; i < flat.size(); i++) {
+      TF_RETURN_IF_ERROR(producer_.Produce(topic, partition, flat(i).data(),
+                                           flat(i).size()));
+    }
+    return Status::OK();
+  }
+
+  // Waits until all enqueued messages are delivered
+  Status Flush() { return producer_.Flush(); }
+
+  string DebugString() const override { return "KafkaProducerResource"; }
+
+ private:
+  KafkaAsyncProducer producer_;
+};
+
 class WriteKafkaOp : public OpKernel {
  public:
-  using OpKernel::OpKernel;
+  explicit WriteKafkaOp(OpKernelConstruction* context) : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("config", &config_));
+    OP_REQUIRES_OK(context, context->GetAttr("sync", &sync_));
+  }
+
   void Compute(OpKernelContext* context) override {
     const Tensor* message_tensor;
     const Tensor* topic_tensor;
     const Tensor* servers_tensor;
     OP_REQUIRES_OK(context, context->input("message", &message_tensor));
-    OP_REQUIRES(context, TensorShapeUtils::IsScalar(message_tensor->shape()),
-                errors::InvalidArgument(
-                    "Message tensor must be scalar, but had shape: ",
-                    message_tensor->shape().DebugString()));
     OP_REQUIRES_OK(context, context->input("topic", &topic_tensor));
     OP_REQUIRES(
         context, TensorShapeUtils::IsScalar(topic_tensor->shape()),
@@ -560,7 +600,6 @@ class WriteKafkaOp : public OpKernel {
                     "Servers tensor must be scalar, but had shape: ",
                     servers_tensor->shape().DebugString()));
 
-    const string& message = message_tensor->scalar<tstring>()();
     const string& topic_string = topic_tensor->scalar<tstring>()();
     std::vector<string> parts = str_util::Split(topic_string, ":");
     OP_REQUIRES(context, (parts.size() >= 1),
@@ -576,78 +615,58 @@ class WriteKafkaOp : public OpKernel {
 
     const string& servers = servers_tensor->scalar<tstring>()();
 
-    std::unique_ptr<RdKafka::Conf> conf(
-        RdKafka::Conf::create(RdKafka::Conf::CONF_GLOBAL));
-    std::unique_ptr<RdKafka::Conf> topic_conf(
-        RdKafka::Conf::create(RdKafka::Conf::CONF_TOPIC));
-
-    std::string errstr;
-
-    RdKafka::Conf::ConfResult result =
-        conf->set("default_topic_conf", topic_conf.get(), errstr);
-    OP_REQUIRES(context, (result == RdKafka::Conf::CONF_OK),
-                errors::Internal("Failed to set default_topic_conf:", errstr));
-
-    result = conf->set("bootstrap.servers", servers, errstr);
-    OP_REQUIRES(context, (result == RdKafka::Conf::CONF_OK),
-                errors::Internal("Failed to set bootstrap.servers ", servers,
-                                 ":", errstr));
-
-    std::unique_ptr<RdKafka::Producer> producer(
-        RdKafka::Producer::create(conf.get(), errstr));
-    OP_REQUIRES(context, producer.get() != nullptr,
-                errors::Internal("Failed to create producer:", errstr));
-
-    std::unique_ptr<RdKafka::Topic> topic(RdKafka::Topic::create(
-        producer.get(), topic_str, topic_conf.get(), errstr));
-    OP_REQUIRES(
-        context, topic.get() != nullptr,
-        errors::Internal("Failed to create topic ", topic_str, ":", errstr));
-
-    RdKafka::ErrorCode err = producer->produce(
-        topic.get(), partition, RdKafka::Producer::RK_MSG_COPY,
-        const_cast<char*>(message.c_str()), message.size(), NULL, NULL);
-    OP_REQUIRES(
-        context, (err == RdKafka::ERR_NO_ERROR),
-        errors::Internal("Failed to produce message:", RdKafka::err2str(err)));
+    // Producers are shared by servers and configuration
+    ResourceMgr* mgr = context->resource_manager();
+    KafkaProducerResource* producer;
+    OP_REQUIRES_OK(
+        context,
+        mgr->LookupOrCreate<KafkaProducerResource>(
+            mgr->default_container(),
+            strings::StrCat("KafkaProducer:", servers, ":",
+                            str_util::Join(config_, ",")),
+            &producer, [&](KafkaProducerResource** resource) -> Status {
+              KafkaProducerResource* created =
+                  new KafkaProducerResource(context->env());
+              Status status = created->Init(servers, config_);
+              if (!status.ok()) {
+                created->Unref();
+                return status;
+              }
+              *resource = created;
+              return Status::OK();
+            }));
+    core::ScopedUnref unref(producer);
 
-    err = producer->flush(timeout_);
-    OP_REQUIRES(
-        context, (err == RdKafka::ERR_NO_ERROR),
-        errors::Internal("Failed to flush message:", RdKafka::err2str(err)));
+    OP_REQUIRES_OK(context,
+                   producer->Produce(topic_str, partition, *message_tensor));
+    if (sync_) {
+      OP_REQUIRES_OK(context, producer->Flush());
+    }
     context->set_output(0, context->input(0));
   }
 
  private:
-  static const int timeout_ = 5000;
+  std::vector<string> config_;
+  bool sync_;
 };
 
 class KafkaOutputSequence : public OutputSequence {
  public:
   KafkaOutputSequence(Env* env) : OutputSequence(env) {}
 
-  virtual ~KafkaOutputSequence() override { Flush(); }
+  virtual ~KafkaOutputSequence() override {}
   virtual Status Flush() override {
+    mutex_lock l(mu_);
     if (producer_.get() != nullptr) {
-      RdKafka::ErrorCode err = producer_->flush(timeout_);
-      if (!(err == RdKafka::ERR_NO_ERROR)) {
-        return errors::Internal("Failed to flush message:",
-                                RdKafka::err2str(err));
-      }
+      return producer_->Flush();
     }
     return Status::OK();
   }
   virtual Status Output() override {
     if (fifo_.front().get() != nullptr) {
       while (fifo_.size() != 0 && fifo_.front().get() != nullptr) {
-        RdKafka::ErrorCode err = producer_->produce(
-            topic_.get(), partition_, RdKafka::Producer::RK_MSG_COPY,
-            const_cast<char*>(fifo_.front().get()->c_str()),
-            fifo_.front().get()->size(), NULL, NULL);
-        if (!(err == RdKafka::ERR_NO_ERROR)) {
-          return errors::Internal("Failed to produce message:",
-                                  RdKafka::err2str(err));
-        }
+        TF_RETURN_IF_ERROR(producer_->Produce(fifo_.front().get()->c_str(),
+                                              fifo_.front().get()->size()));
 
         fifo_.pop_front();
         base_++;
@@ -660,82 +679,20 @@ class KafkaOutputSequence : public OutputSequence {
   }
   Status Initialize(const string& topic_str, int32 partition,
                     const std::vector<string>& metadata) {
-    partition_ = partition;
-
-    std::unique_ptr<RdKafka::Conf> conf(
-        RdKafka::Conf::create(RdKafka::Conf::CONF_GLOBAL));
-    std::unique_ptr<RdKafka::Conf> conf_topic(
-        RdKafka::Conf::create(RdKafka::Conf::CONF_TOPIC));
-
-    string errstr;
-    RdKafka::Conf::ConfResult result = RdKafka::Conf::CONF_UNKNOWN;
-
-    for (size_t i = 0; i < metadata.size(); i++) {
-      if (metadata[i].find("conf.topic.") == 0) {
-        std::vector<string> parts = str_util::Split(metadata[i], "=");
-        if (parts.size() != 2) {
-          return errors::InvalidArgument("invalid topic configuration: ",
-                                         metadata[i]);
-        }
-        result = conf_topic->set(parts[0].substr(11), parts[1], errstr);
-        if (result != RdKafka::Conf::CONF_OK) {
-          return errors::Internal("failed to do topic configuration:",
-                                  metadata[i], "error:", errstr);
-        }
-      } else if (metadata[i] != "" &&
-                 metadata[i].find("conf.") == string::npos) {
-        std::vector<string> parts = str_util::Split(metadata[i], "=");
-        if (parts.size() != 2) {
-          return errors::InvalidArgument("invalid global configuration: ",
-                                         metadata[i]);
-        }
-        if ((result = conf->set(parts[0], parts[1], errstr)) !=
-            RdKafka::Conf::CONF_OK) {
-          return errors::Internal("failed to do global configuration: ",
-                                  metadata[i], "error:", errstr);
-        }
-      }
-      LOG(INFO) << "Kafka configuration: " << metadata[i];
-    }
-    if ((result = conf->set("default_topic_conf", conf_topic.get(), errstr)) !=
-        RdKafka::Conf::CONF_OK) {
-      return errors::Internal("failed to set default_topic_conf:", errstr);
-    }
-
-    // producer.properties:
-    //   bootstrap.servers=localhost:9092
-    string bootstrap_servers;
-    if ((result = conf->get("bootstrap.servers", bootstrap_servers)) !=
-        RdKafka::Conf::CONF_OK) {
-      bootstrap_servers = "localhost:9092";
-      if ((result = conf->set("bootstrap.servers", bootstrap_servers,
-                              errstr)) != RdKafka::Conf::CONF_OK) {
-        return errors::Internal("failed to set bootstrap.servers [",
-                                bootstrap_servers, "]:", errstr);
-      }
-      LOG(INFO) << "Kafka default bootstrap server: " << bootstrap_servers;
-    }
-
-    producer_.reset(RdKafka::Producer::create(conf.get(), errstr));
-    if (!(producer_.get() != nullptr)) {
-      return errors::Internal("Failed to create producer:", errstr);
-    }
-
-    topic_.reset(RdKafka::Topic::create(producer_.get(), topic_str,
-                                        conf_topic.get(), errstr));
-    if (!(topic_.get() != nullptr)) {
-      return errors::Internal("Failed to create topic ", topic_str, ":",
-                              errstr);
+    mutex_lock l(mu_);
+    producer_.reset(new KafkaAsyncProducer(env_));
+    return producer_->Init(topic_str, partition, metadata);
+  }
+  void Metrics(int64* delivered, int64* failed, int64* queued) {
+    mutex_lock l(mu_);
+    *delivered = *failed = *queued = 0;
+    if (producer_.get() != nullptr) {
+      producer_->Metrics(delivered, failed, queued);
     }
-
-    return Status::OK();
   }
 
  private:
-  int32 partition_ TF_GUARDED_BY(mu_);
-  std::unique_ptr<RdKafka::Producer> producer_ TF_GUARDED_BY(mu_);
-  std::unique_ptr<RdKafka::Topic> topic_ TF_GUARDED_BY(mu_);
-  static const int timeout_ = 5000;
+  std::unique_ptr<KafkaAsyncProducer> producer_ TF_GUARDED_BY(mu_);
 };
 
 class KafkaOutputSequenceOp : public OutputSequenceOp<KafkaOutputSequence> {
@@ -780,6 +737,23 @@ class KafkaOutputSequenceOp : public OutputSequenceOp<KafkaOutputSequence> {
   }
 };
 
+class KafkaOutputSequenceMetricsOp : public OpKernel {
+ public:
+  using OpKernel::OpKernel;
+  void Compute(OpKernelContext* context) override {
+    KafkaOutputSequence* sequence;
+    OP_REQUIRES_OK(context, LookupResource(context, HandleFromInput(context, 0),
+                                           &sequence));
+    core::ScopedUnref unref(sequence);
+
+    Tensor* metrics_tensor = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(0, TensorShape({3}),
+                                                     &metrics_tensor));
+    auto metrics = metrics_tensor->flat<int64>();
+    sequence->Metrics(&metrics(0), &metrics(1), &metrics(2));
+  }
+};
+
 class KafkaEventCb : public RdKafka::EventCb {
  public:
   KafkaEventCb() : run_(true) {}
@@ -817,6 +791,90 @@ class KafkaEventCb : public RdKafka::EventCb {
   bool run_ TF_GUARDED_BY(mu_) = true;
 };
 
+// Stores the value of a decoded avro record field at index of the output
+Status DecodeAvroField(const avro::GenericDatum& field, const DataType dtype,
+                       const int64 index, Tensor* value) {
+  switch (field.type()) {
+    case avro::AVRO_NULL:
+      switch (dtype) {
+        case DT_BOOL:
+          value->flat<bool>()(index) = false;
+          break;
+        case DT_INT32:
+          value->flat<int32>()(index) = 0;
+          break;
+        case DT_INT64:
+          value->flat<int64>()(index) = 0;
+          break;
+        case DT_FLOAT:
+          value->flat<float>()(index) = 0.0;
+          break;
+        case DT_DOUBLE:
+          value->flat<double>()(index) = 0.0;
+          break;
+        case DT_STRING:
+          value->flat<tstring>()(index) = "";
+          break;
+        default:
+          return errors::InvalidArgument(
+              "unsupported data type against AVRO_NULL: ", field.type());
+      }
+      break;
+    case avro::AVRO_BOOL:
+      value->flat<bool>()(index) = field.value<bool>();
+      break;
+    case avro::AVRO_INT:
+      value->flat<int32>()(index) = field.value<int32_t>();
+      break;
+    case avro::AVRO_LONG:
+      value->flat<int64>()(index) = field.value<int64_t>();
+      break;
+    case avro::AVRO_FLOAT:
+      value->flat<float>()(index) = field.value<float>();
+      break;
+    case avro::AVRO_DOUBLE:
+      value->flat<double>()(index) = field.value<double>();
+      break;
+    case avro::AVRO_STRING: {
+      // make a concrete explicit copy as otherwise avro may override the
+      // underlying buffer.
+      const string& field_value = field.value<string>();
+      string v;
+      if (field_value.size() > 0) {
+        v.resize(field_value.size());
+        memcpy(&v[0], &field_value[0], field_value.size());
+      }
+      value->flat<tstring>()(index) = v;
+    } break;
+    case avro::AVRO_BYTES: {
+      const std::vector<uint8_t>& field_value =
+          field.value<std::vector<uint8_t>>();
+      string v;
+      if (field_value.size() > 0) {
+        v.resize(field_value.size());
+        memcpy(&v[0], &field_value[0], field_value.size());
+      }
+      value->flat<tstring>()(index) = std::move(v);
+    } break;
+    case avro::AVRO_FIXED: {
+      const std::vector<uint8_t>& field_value =
+          field.value<avro::GenericFixed>().value();
+      string v;
+      if (field_value.size() > 0) {
+        v.resize(field_value.size());
+        memcpy(&v[0], &field_value[0], field_value.size());
+      }
+      value->flat<tstring>()(index) = std::move(v);
+    } break;
+    case avro::AVRO_ENUM:
+      value->flat<tstring>()(index) = field.value<avro::GenericEnum>().symbol();
+      break;
+    default:
+      return errors::InvalidArgument("unsupported data type: ", field.type());
+  }
+  return Status::OK();
+}
+
 class DecodeAvroResource : public ResourceBase {
  public:
   DecodeAvroResource(Env* env) : env_(env) {}
@@ -894,90 +952,10 @@ class DecodeAvroOp : public OpKernel {
       avro::decode(*d, datum);
       const avro::GenericRecord& record = datum.value<avro::GenericRecord>();
       for (int i = 0; i < resource->avro_schema().root()->names(); i++) {
-        const avro::GenericDatum& field = record.fieldAt(i);
-        switch (field.type()) {
-          case avro::AVRO_NULL:
-            switch (context->expected_output_dtype(i)) {
-              case DT_BOOL:
-                value[i]->flat<bool>()(entry_index) = false;
-                break;
-              case DT_INT32:
-                value[i]->flat<int32>()(entry_index) = 0;
-                break;
-              case DT_INT64:
-                value[i]->flat<int64>()(entry_index) = 0;
-                break;
-              case DT_FLOAT:
-                value[i]->flat<float>()(entry_index) = 0.0;
-                break;
-              case DT_DOUBLE:
-                value[i]->flat<double>()(entry_index) = 0.0;
-                break;
-              case DT_STRING:
-                value[i]->flat<tstring>()(entry_index) = "";
-                break;
-              default:
-                OP_REQUIRES(context, false,
-                            errors::InvalidArgument(
-                                "unsupported data type against AVRO_NULL: ",
-                                field.type()));
-            }
-            break;
-          case avro::AVRO_BOOL:
-            value[i]->flat<bool>()(entry_index) = field.value<bool>();
-            break;
-          case avro::AVRO_INT:
-            value[i]->flat<int32>()(entry_index) = field.value<int32_t>();
-            break;
-          case avro::AVRO_LONG:
-            value[i]->flat<int64>()(entry_index) = field.value<int64_t>();
-            break;
-          case avro::AVRO_FLOAT:
-            value[i]->flat<float>()(entry_index) = field.value<float>();
-            break;
-          case avro::AVRO_DOUBLE:
-            value[i]->flat<double>()(entry_index) = field.value<double>();
-            break;
-          case avro::AVRO_STRING: {
-            // make a concrete explicit copy as otherwise avro may override the
-            // underlying buffer.
-            const string& field_value = field.value<string>();
-            string v;
-            if (field_value.size() > 0) {
-              v.resize(field_value.size());
-              memcpy(&v[0], &field_value[0], field_value.size());
-            }
-            value[i]->flat<tstring>()(entry_index) = v;
-          } break;
-          case avro::AVRO_BYTES: {
-            const std::vector<uint8_t>& field_value =
-                field.value<std::vector<uint8_t>>();
-            string v;
-            if (field_value.size() > 0) {
-              v.resize(field_value.size());
-              memcpy(&v[0], &field_value[0], field_value.size());
-            }
-            value[i]->flat<tstring>()(entry_index) = std::move(v);
-          } break;
-          case avro::AVRO_FIXED: {
-            const std::vector<uint8_t>& field_value =
-                field.value<avro::GenericFixed>().value();
-            string v;
-            if (field_value.size() > 0) {
-              v.resize(field_value.size());
-              memcpy(&v[0], &field_value[0], field_value.size());
-            }
-            value[i]->flat<tstring>()(entry_index) = std::move(v);
-          } break;
-          case avro::AVRO_ENUM:
-            value[i]->flat<tstring>()(entry_index) =
-                field.value<avro::GenericEnum>().symbol();
-            break;
-          default:
-            OP_REQUIRES(context, false,
-                        errors::InvalidArgument("unsupported data type: ",
-                                                field.type()));
-        }
+        OP_REQUIRES_OK(context,
+                       DecodeAvroField(record.fieldAt(i),
+                                       context->expected_output_dtype(i),
+                                       entry_index, value[i]));
       }
     }
   }
@@ -1116,6 +1094,277 @@ class DecodeAvroInitOp : public ResourceOpKernel<DecodeAvroResource> {
   Env* env_ TF_GUARDED_BY(mu_);
 };
 
+// Resolves schema ids of the Confluent wire format to writer schemas
+class SchemaRegistryClient {
+ public:
+  virtual ~SchemaRegistryClient() {}
+
+  // Fetches the JSON schema registered under the id
+  virtual Status GetSchema(const int32 id, string* schema) = 0;
+};
+
+// Client for the REST API of a Confluent compatible schema registry
+class HttpSchemaRegistryClient : public SchemaRegistryClient {
+ public:
+  HttpSchemaRegistryClient(
+      const string& url, const std::vector<std::pair<string, string>>& headers)
+      : url_(url), headers_(headers) {
+    while (!url_.empty() && url_.back() == '/') {
+      url_.pop_back();
+    }
+  }
+
+  Status GetSchema(const int32 id, string* schema) override {
+    std::unique_ptr<HttpRequest> request(http_request_factory_.Create());
+    request->SetUri(strings::StrCat(url_, "/schemas/ids/", id));
+    for (const auto& header : headers_) {
+      request->AddHeader(header.first, header.second);
+    }
+    std::vector<char> response;
+    request->SetResultBuffer(&response);
+    TF_RETURN_IF_ERROR(request->Send());
+
+    rapidjson::Document response_json;
+    response_json.Parse(response.data(), response.size());
+    if (response_json.HasParseError() || !response_json.IsObject() ||
+        !response_json.HasMember("schema") ||
+        !response_json["schema"].IsString()) {
+      return errors::InvalidArgument("invalid schema registry response for id ",
+                                     id);
+    }
+    *schema = response_json["schema"].GetString();
+    return Status::OK();
+  }
+
+ private:
+  string url_;
+  std::vector<std::pair<string, string>> headers_;
+  CurlHttpRequest::Factory http_request_factory_;
+};
+
+// Caches the writer schemas of a schema registry, each id is fetched and
+// compiled only once as registered schemas are immutable
+class KafkaSchemaRegistryResource : public ResourceBase {
+ public:
+  KafkaSchemaRegistryResource(Env* env) : env_(env) {}
+  ~KafkaSchemaRegistryResource() {}
+
+  Status Init(const string& url, const std::vector<string>& metadata) {
+    mutex_lock lock(mu_);
+    // Metadata entries are HTTP headers in Name=Value format
+    std::vector<std::pair<string, string>> headers;
+    for (const string& entry : metadata) {
+      size_t pos = entry.find('=');
+      if (pos == string::npos) {
+        return errors::InvalidArgument("invalid header configuration: ",
+                                       entry);
+      }
+      headers.emplace_back(entry.substr(0, pos), entry.substr(pos + 1));
+    }
+    client_.reset(new HttpSchemaRegistryClient(url, headers));
+    return Status::OK();
+  }
+
+  // The registry is queried without holding the lock, so that a miss does
+  // not block the decoders of other ids. Concurrent misses of the same id
+  // may fetch it more than once, the first compiled schema is kept.
+  Status Lookup(const int32 id,
+                std::shared_ptr<const avro::ValidSchema>* avro_schema) {
+    std::shared_ptr<SchemaRegistryClient> client;
+    {
+      mutex_lock lock(mu_);
+      auto lookup = cache_.find(id);
+      if (lookup != cache_.end()) {
+        *avro_schema = lookup->second;
+        return Status::OK();
+      }
+      client = client_;
+    }
+    if (client == nullptr) {
+      return errors::FailedPrecondition("schema registry is not initialized");
+    }
+    string schema;
+    TF_RETURN_IF_ERROR(client->GetSchema(id, &schema));
+    std::shared_ptr<avro::ValidSchema> compiled(new avro::ValidSchema());
+    std::istringstream ss(schema);
+    string error;
+    if (!(avro::compileJsonSchema(ss, *compiled, error))) {
+      return errors::InvalidArgument("Avro schema error for id ", id, ": ",
+                                     error);
+    }
+    mutex_lock lock(mu_);
+    *avro_schema = cache_.emplace(id, std::move(compiled)).first->second;
+    return Status::OK();
+  }
+
+  string DebugString() const override { return "KafkaSchemaRegistryResource"; }
+
+ private:
+  mutable mutex mu_;
+  Env* env_ TF_GUARDED_BY(mu_);
+  std::shared_ptr<SchemaRegistryClient> client_ TF_GUARDED_BY(mu_);
+  std::unordered_map<int32, std::shared_ptr<const avro::ValidSchema>> cache_
+      TF_GUARDED_BY(mu_);
+};
+
+class KafkaSchemaRegistryInitOp
+    : public ResourceOpKernel<KafkaSchemaRegistryResource> {
+ public:
+  explicit KafkaSchemaRegistryInitOp(OpKernelConstruction* context)
+      : ResourceOpKernel<KafkaSchemaRegistryResource>(context) {
+    env_ = context->env();
+  }
+
+ private:
+  void Compute(OpKernelContext* context) override {
+    ResourceOpKernel<KafkaSchemaRegistryResource>::Compute(context);
+
+    const Tensor* url_tensor;
+    OP_REQUIRES_OK(context, context->input("url", &url_tensor));
+    const string& url = url_tensor->scalar<tstring>()();
+
+    const Tensor* metadata_tensor;
+    OP_REQUIRES_OK(context, context->input("metadata", &metadata_tensor));
+    std::vector<string> metadata;
+    for (int64 i = 0; i < metadata_tensor->NumElements(); i++) {
+      metadata.push_back(metadata_tensor->flat<tstring>()(i));
+    }
+
+    OP_REQUIRES_OK(context, resource_->Init(url, metadata));
+  }
+  Status CreateResource(KafkaSchemaRegistryResource** resource)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) override {
+    *resource = new KafkaSchemaRegistryResource(env_);
+    return Status::OK();
+  }
+
+ private:
+  mutable mutex mu_;
+  Env* env_ TF_GUARDED_BY(mu_);
+};
+
+// Size of the Confluent wire format header: a zero magic byte followed by
+// the big endian schema id
+static const size_t kWireHeaderSize = 5;
+
+// Rough cost (in cycles) of decoding one avro message, used to decide how to
+// shard a batch across the cpu worker threads
+static const int64 kAvroMessageCost = 10000;
+
+// Decodes avro messages in the Confluent wire format, each message is read
+// with the writer schema registered under its id and resolved against the
+// reader schema given as attr
+class KafkaDecodeAvroWireOp : public OpKernel {
+ public:
+  explicit KafkaDecodeAvroWireOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    string schema;
+    OP_REQUIRES_OK(context, context->GetAttr("schema", &schema));
+    std::istringstream ss(schema);
+    string error;
+    OP_REQUIRES(context, (avro::compileJsonSchema(ss, reader_schema_, error)),
+                errors::Unimplemented("Avro schema error: ", error));
+    OP_REQUIRES(context, reader_schema_.root()->type() == avro::AVRO_RECORD,
+                errors::InvalidArgument("reader schema must be a record"));
+    OP_REQUIRES(context,
+                static_cast<int>(reader_schema_.root()->names()) ==
+                    context->num_outputs(),
+                errors::InvalidArgument(
+                    "number of dtypes (", context->num_outputs(),
+                    ") does not match the fields of the reader schema (",
+                    reader_schema_.root()->names(), ")"));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor* input_tensor;
+    OP_REQUIRES_OK(context, context->input("input", &input_tensor));
+    const int64 num_messages = input_tensor->NumElements();
+
+    KafkaSchemaRegistryResource* resource;
+    OP_REQUIRES_OK(context,
+                   GetResourceFromContext(context, "registry", &resource));
+    core::ScopedUnref unref(resource);
+
+    std::vector<Tensor*> value;
+    for (int i = 0; i < context->num_outputs(); i++) {
+      Tensor* value_tensor = nullptr;
+      OP_REQUIRES_OK(context, context->allocate_output(
+                                  i, input_tensor->shape(), &value_tensor));
+      value.push_back(value_tensor);
+    }
+
+    // Parse the headers and resolve all distinct schema ids before decoding,
+    // so that registry lookups stay out of the parallel section
+    std::vector<int32> ids(num_messages);
+    std::unordered_map<int32, std::shared_ptr<const avro::ValidSchema>>
+        writer_schemas;
+    for (int64 i = 0; i < num_messages; i++) {
+      const tstring& entry = input_tensor->flat<tstring>()(i);
+      OP_REQUIRES(context,
+                  entry.size() >= kWireHeaderSize && entry.data()[0] == 0,
+                  errors::InvalidArgument(
+                      "message ", i, " is not in the avro wire format"));
+      const uint8* header = reinterpret_cast<const uint8*>(entry.data());
+      ids[i] = static_cast<int32>((static_cast<uint32>(header[1]) << 24) |
+                                  (static_cast<uint32>(header[2]) << 16) |
+                                  (static_cast<uint32>(header[3]) << 8) |
+                                  static_cast<uint32>(header[4]));
+      if (writer_schemas.find(ids[i]) == writer_schemas.end()) {
+        OP_REQUIRES_OK(context,
+                       resource->Lookup(ids[i], &writer_schemas[ids[i]]));
+      }
+    }
+
+    // Each shard compiles one resolving decoder per writer schema and reuses
+    // it, along with one datum, for all of its messages
+    mutex status_mu;
+    Status status;
+    auto process_shard = [&](int64 start, int64 limit) {
+      avro::GenericDatum datum(reader_schema_);
+      std::unordered_map<int32, avro::DecoderPtr> decoders;
+      for (int64 entry_index = start; entry_index < limit; entry_index++) {
+        const tstring& entry = input_tensor->flat<tstring>()(entry_index);
+        std::unique_ptr<avro::InputStream> in = avro::memoryInputStream(
+            reinterpret_cast<const uint8_t*>(entry.data()) + kWireHeaderSize,
+            entry.size() - kWireHeaderSize);
+        Status s;
+        try {
+          avro::DecoderPtr& d = decoders[ids[entry_index]];
+          if (d == nullptr) {
+            d = avro::resolvingDecoder(*writer_schemas[ids[entry_index]],
+                                       reader_schema_, avro::binaryDecoder());
+          }
+          d->init(*in);
+          avro::decode(*d, datum);
+          const avro::GenericRecord& record =
+              datum.value<avro::GenericRecord>();
+          for (size_t i = 0; i < value.size() && s.ok(); i++) {
+            s = DecodeAvroField(record.fieldAt(i),
+                                context->expected_output_dtype(i),
+                                entry_index, value[i]);
+          }
+        } catch (avro::Exception& e) {
+          s = errors::InvalidArgument("unable to decode avro message at ",
+                                      entry_index, " with schema id ",
+                                      ids[entry_index], ": ", e.what());
+        }
+        if (!s.ok()) {
+          mutex_lock l(status_mu);
+          status.Update(s);
+          return;
+        }
+      }
+    };
+    auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers, num_messages,
+          kAvroMessageCost, process_shard);
+    OP_REQUIRES_OK(context, status);
+  }
+
+ private:
+  avro::ValidSchema reader_schema_;
+};
+
 REGISTER_KERNEL_BUILDER(Name("IO>KafkaDataset").Device(DEVICE_CPU),
                         KafkaDatasetOp);
 
@@ -1128,6 +1377,9 @@ REGISTER_KERNEL_BUILDER(
     OutputSequenceSetItemOp<KafkaOutputSequence>);
 REGISTER_KERNEL_BUILDER(Name("IO>KafkaOutputSequenceFlush").Device(DEVICE_CPU),
                         OutputSequenceFlushOp<KafkaOutputSequence>);
+REGISTER_KERNEL_BUILDER(
+    Name("IO>KafkaOutputSequenceMetrics").Device(DEVICE_CPU),
+    KafkaOutputSequenceMetricsOp);
 
 REGISTER_KERNEL_BUILDER(Name("IO>KafkaDecodeAvro").Device(DEVICE_CPU),
                         DecodeAvroOp);
@@ -1135,6 +1387,10 @@ REGISTER_KERNEL_BUILDER(Name("IO>KafkaEncodeAvro").Device(DEVICE_CPU),
                         EncodeAvroOp);
 REGISTER_KERNEL_BUILDER(Name("IO>KafkaDecodeAvroInit").Device(DEVICE_CPU),
                         DecodeAvroInitOp);
+REGISTER_KERNEL_BUILDER(Name("IO>KafkaSchemaRegistryInit").Device(DEVICE_CPU),
+                        KafkaSchemaRegistryInitOp);
+REGISTER_KERNEL_BUILDER(Name("IO>KafkaDecodeAvroWire").Device(DEVICE_CPU),
+                        KafkaDecodeAvroWireOp);
 
 }  // namespace data
 }  // namespace tensorflow
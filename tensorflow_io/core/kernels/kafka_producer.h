@@ -0,0 +1,304 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_IO_CORE_KERNELS_KAFKA_PRODUCER_H_
+#define TENSORFLOW_IO_CORE_KERNELS_KAFKA_PRODUCER_H_
+
+#include <unordered_map>
+
+#include "rdkafkacpp.h"
+#include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mutex.h"
+
+namespace tensorflow {
+namespace data {
+
+// A producer that never waits for delivery on produce, either to the topic
+// and partition given to Init or to any topic given to Produce.
+//
+// Delivery reports are served on a dedicated poll thread. The bytes of
+// messages that are queued but not yet delivered are bounded, produce blocks
+// once the bound is reached until deliveries make room. The first delivery
+// error is reported by the next call to Produce or Flush.
+//
+// Besides the librdkafka configuration (e.g. linger.ms, batch.size or
+// compression.codec), the metadata may hold:
+//   conf.topic.<key>=<value>         topic configuration
+//   conf.max.inflight.bytes=<bytes>  bound of undelivered bytes, 64MB default
+//   conf.flush.timeout.ms=<ms>       timeout of Flush, 5000 default, -1 waits
+//                                    until all messages are delivered
+class KafkaAsyncProducer : public RdKafka::DeliveryReportCb {
+ public:
+  explicit KafkaAsyncProducer(Env* env) : env_(env) {}
+
+  ~KafkaAsyncProducer() override {
+    if (producer_.get() != nullptr) {
+      Status status = Flush();
+      if (!status.ok()) {
+        LOG(ERROR) << "Failed to flush messages: " << status;
+      }
+    }
+    {
+      mutex_lock l(mu_);
+      stop_ = true;
+    }
+    // Joins the poll thread before the producer is released
+    poll_thread_.reset(nullptr);
+  }
+
+  Status Init(const string& topic, const int32 partition,
+              const std::vector<string>& metadata) {
+    TF_RETURN_IF_ERROR(Init(metadata));
+    partition_ = partition;
+    return GetTopic(topic, &topic_);
+  }
+
+  // Creates the producer without a default topic, messages are produced to
+  // the topic and partition of each call
+  Status Init(const std::vector<string>& metadata) {
+    std::unique_ptr<RdKafka::Conf> conf(
+        RdKafka::Conf::create(RdKafka::Conf::CONF_GLOBAL));
+    conf_topic_.reset(RdKafka::Conf::create(RdKafka::Conf::CONF_TOPIC));
+
+    string errstr;
+    RdKafka::Conf::ConfResult result = RdKafka::Conf::CONF_UNKNOWN;
+
+    for (size_t i = 0; i < metadata.size(); i++) {
+      if (metadata[i].find("conf.topic.") == 0) {
+        std::vector<string> parts = str_util::Split(metadata[i], "=");
+        if (parts.size() != 2) {
+          return errors::InvalidArgument("invalid topic configuration: ",
+                                         metadata[i]);
+        }
+        result = conf_topic_->set(parts[0].substr(11), parts[1], errstr);
+        if (result != RdKafka::Conf::CONF_OK) {
+          return errors::Internal("failed to do topic configuration:",
+                                  metadata[i], "error:", errstr);
+        }
+      } else if (metadata[i].find("conf.max.inflight.bytes=") == 0) {
+        if (!strings::safe_strto64(metadata[i].substr(24),
+                                   &max_inflight_bytes_) ||
+            max_inflight_bytes_ <= 0) {
+          return errors::InvalidArgument("invalid configuration: ",
+                                         metadata[i]);
+        }
+      } else if (metadata[i].find("conf.flush.timeout.ms=") == 0) {
+        if (!strings::safe_strto64(metadata[i].substr(22), &flush_timeout_)) {
+          return errors::InvalidArgument("invalid configuration: ",
+                                         metadata[i]);
+        }
+      } else if (metadata[i] != "" &&
+                 metadata[i].find("conf.") == string::npos) {
+        std::vector<string> parts = str_util::Split(metadata[i], "=");
+        if (parts.size() != 2) {
+          return errors::InvalidArgument("invalid global configuration: ",
+                                         metadata[i]);
+        }
+        if ((result = conf->set(parts[0], parts[1], errstr)) !=
+            RdKafka::Conf::CONF_OK) {
+          return errors::Internal("failed to do global configuration: ",
+                                  metadata[i], "error:", errstr);
+        }
+      }
+      LOG(INFO) << "Kafka configuration: " << metadata[i];
+    }
+    if ((result = conf->set("default_topic_conf", conf_topic_.get(),
+                            errstr)) != RdKafka::Conf::CONF_OK) {
+      return errors::Internal("failed to set default_topic_conf:", errstr);
+    }
+    if ((result = conf->set("dr_cb", this, errstr)) !=
+        RdKafka::Conf::CONF_OK) {
+      return errors::Internal("failed to set dr_cb:", errstr);
+    }
+
+    // producer.properties:
+    //   bootstrap.servers=localhost:9092
+    string bootstrap_servers;
+    if ((result = conf->get("bootstrap.servers", bootstrap_servers)) !=
+        RdKafka::Conf::CONF_OK) {
+      bootstrap_servers = "localhost:9092";
+      if ((result = conf->set("bootstrap.servers", bootstrap_servers,
+                              errstr)) != RdKafka::Conf::CONF_OK) {
+        return errors::Internal("failed to set bootstrap.servers [",
+                                bootstrap_servers, "]:", errstr);
+      }
+      LOG(INFO) << "Kafka default bootstrap server: " << bootstrap_servers;
+    }
+
+    producer_.reset(RdKafka::Producer::create(conf.get(), errstr));
+    if (producer_.get() == nullptr) {
+      return errors::Internal("Failed to create producer:", errstr);
+    }
+
+    poll_thread_.reset(env_->StartThread(
+        ThreadOptions(), "kafka_producer_poll", [this]() { PollLoop(); }));
+    return Status::OK();
+  }
+
+  // Enqueues one message to the topic and partition given to Init
+  Status Produce(const char* data, const size_t size) {
+    return Produce(topic_, partition_, data, size);
+  }
+
+  // Enqueues one message to `topic`, which is created on first use
+  Status Produce(const string& topic, const int32 partition, const char* data,
+                 const size_t size) {
+    RdKafka::Topic* kafka_topic;
+    TF_RETURN_IF_ERROR(GetTopic(topic, &kafka_topic));
+    return Produce(kafka_topic, partition, data, size);
+  }
+
+  // Waits until all queued messages are delivered, or the flush timeout
+  Status Flush() {
+    RdKafka::ErrorCode err = producer_->flush(static_cast<int>(flush_timeout_));
+    if (err != RdKafka::ERR_NO_ERROR) {
+      return errors::Internal("Failed to flush message:",
+                              RdKafka::err2str(err));
+    }
+    return TakeStatus();
+  }
+
+  // Number of delivered, failed and queued (not yet delivered) messages
+  void Metrics(int64* delivered, int64* failed, int64* queued) {
+    mutex_lock l(mu_);
+    *delivered = delivered_;
+    *failed = failed_;
+    *queued = queued_;
+  }
+
+  void dr_cb(RdKafka::Message& message) override {
+    mutex_lock l(mu_);
+    inflight_bytes_ -= message.len();
+    queued_--;
+    if (message.err() == RdKafka::ERR_NO_ERROR) {
+      delivered_++;
+    } else {
+      failed_++;
+      // Keep the first error until it is reported
+      if (status_.ok()) {
+        status_ = errors::Internal("Failed to deliver message:",
+                                   message.errstr());
+      }
+    }
+    room_cv_.notify_all();
+  }
+
+ private:
+  // Interval at which the poll thread checks for stop
+  static const int kPollTimeout = 100;
+
+  void PollLoop() {
+    while (true) {
+      {
+        mutex_lock l(mu_);
+        if (stop_) {
+          return;
+        }
+      }
+      producer_->poll(kPollTimeout);
+    }
+  }
+
+  // Enqueues one message, blocks only while the undelivered bytes exceed the
+  // bound or the local queue of librdkafka is full
+  Status Produce(RdKafka::Topic* topic, const int32 partition,
+                 const char* data, const size_t size) {
+    {
+      mutex_lock l(mu_);
+      // A single message larger than the bound is still accepted once
+      // everything before it has been delivered
+      while (inflight_bytes_ > 0 &&
+             inflight_bytes_ + static_cast<int64>(size) > max_inflight_bytes_) {
+        room_cv_.wait(l);
+      }
+      inflight_bytes_ += size;
+      queued_++;
+    }
+    RdKafka::ErrorCode err;
+    while ((err = producer_->produce(
+                topic, partition, RdKafka::Producer::RK_MSG_COPY,
+                const_cast<char*>(data), size, NULL, NULL)) ==
+           RdKafka::ERR__QUEUE_FULL) {
+      // The poll thread serves delivery reports which makes room
+      mutex_lock l(mu_);
+      room_cv_.wait_for(l, std::chrono::milliseconds(kPollTimeout));
+    }
+    if (err != RdKafka::ERR_NO_ERROR) {
+      mutex_lock l(mu_);
+      inflight_bytes_ -= size;
+      queued_--;
+      failed_++;
+      room_cv_.notify_all();
+      return errors::Internal("Failed to produce message:",
+                              RdKafka::err2str(err));
+    }
+    return TakeStatus();
+  }
+
+  Status GetTopic(const string& topic, RdKafka::Topic** kafka_topic) {
+    mutex_lock l(topics_mu_);
+    auto lookup = topics_.find(topic);
+    if (lookup == topics_.end()) {
+      string errstr;
+      std::unique_ptr<RdKafka::Topic> created(RdKafka::Topic::create(
+          producer_.get(), topic, conf_topic_.get(), errstr));
+      if (created.get() == nullptr) {
+        return errors::Internal("Failed to create topic ", topic, ":",
+                                errstr);
+      }
+      lookup = topics_.emplace(topic, std::move(created)).first;
+    }
+    *kafka_topic = lookup->second.get();
+    return Status::OK();
+  }
+
+  Status TakeStatus() {
+    mutex_lock l(mu_);
+    Status status = status_;
+    status_ = Status::OK();
+    return status;
+  }
+
+  Env* env_;
+  // The topic given to Init, owned by topics_
+  RdKafka::Topic* topic_ = nullptr;
+  int32 partition_ = 0;
+  int64 max_inflight_bytes_ = 64 << 20;
+  int64 flush_timeout_ = 5000;
+  std::unique_ptr<RdKafka::Conf> conf_topic_;
+  std::unique_ptr<RdKafka::Producer> producer_;
+  // Declared after the producer so that the topics are released first
+  mutex topics_mu_;
+  std::unordered_map<string, std::unique_ptr<RdKafka::Topic>> topics_
+      TF_GUARDED_BY(topics_mu_);
+  std::unique_ptr<Thread> poll_thread_;
+
+  mutex mu_;
+  condition_variable room_cv_;
+  bool stop_ TF_GUARDED_BY(mu_) = false;
+  int64 inflight_bytes_ TF_GUARDED_BY(mu_) = 0;
+  int64 delivered_ TF_GUARDED_BY(mu_) = 0;
+  int64 failed_ TF_GUARDED_BY(mu_) = 0;
+  int64 queued_ TF_GUARDED_BY(mu_) = 0;
+  Status status_ TF_GUARDED_BY(mu_);
+};
+
+}  // namespace data
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_IO_CORE_KERNELS_KAFKA_PRODUCER_H_
@@ -21,6 +21,7 @@ limitations under the License.
 #include <aws/core/utils/crypto/Hash.h>
 #include <aws/core/utils/crypto/HashResult.h>
 #include <aws/kinesis/KinesisClient.h>
+#include <aws/kinesis/KinesisErrors.h>
 #include <aws/kinesis/model/DescribeStreamRequest.h>
 #include <aws/kinesis/model/GetRecordsRequest.h>
 #include <aws/kinesis/model/GetShardIteratorRequest.h>
@@ -31,6 +32,9 @@ limitations under the License.
 
 #include "tensorflow/core/framework/resource_mgr.h"
 #include "tensorflow/core/framework/resource_op_kernel.h"
+#include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/platform/blocking_counter.h"
+#include "tensorflow/core/platform/threadpool.h"
 
 namespace tensorflow {
 namespace data {
@@ -253,6 +257,15 @@ void ShutdownClient(Aws::Kinesis::KinesisClient* client) {
   }
 }
 
+// Maximum number of records a single GetRecords call may return
+static const int64 kMaxGetRecordsLimit = 10000;
+// Kinesis allows 5 GetRecords calls per second per shard
+static const int64 kGetRecordsIntervalMicros = 200000;
+// Additional delay once the throughput of a shard has been exceeded
+static const int64 kThroughputBackoffMicros = 1000000;
+// Upper bound of the threads fetching shards in parallel
+static const int kMaxShardThreads = 16;
+
 class KinesisReadableResource : public ResourceBase {
  public:
   KinesisReadableResource(Env* env)
@@ -264,73 +277,105 @@ class KinesisReadableResource : public ResourceBase {
 
     stream_ = input;
     shard_ = "";
+    bool parallel = false;
     for (size_t i = 0; i < metadata.size(); i++) {
+      std::vector<string> parts = str_util::Split(metadata[i], "=");
       if (metadata[i].find("shard=") == 0) {
-        std::vector<string> parts = str_util::Split(metadata[i], "=");
         if (parts.size() != 2) {
           return errors::InvalidArgument("invalid configuration: ",
                                          metadata[i]);
         }
         shard_ = parts[1];
+      } else if (metadata[i].find("parallel=") == 0) {
+        if (parts.size() != 2) {
+          return errors::InvalidArgument("invalid configuration: ",
+                                         metadata[i]);
+        }
+        parallel = (parts[1] == "true");
+      } else if (metadata[i].find("limit=") == 0) {
+        if (parts.size() != 2 || !strings::safe_strto64(parts[1], &limit_) ||
+            limit_ <= 0 || limit_ > kMaxGetRecordsLimit) {
+          return errors::InvalidArgument("invalid configuration: ",
+                                         metadata[i]);
+        }
       }
     }
 
     AwsInitAPI();
     client_.reset(new Aws::Kinesis::KinesisClient(GetDefaultClientConfig()));
 
-    Aws::Kinesis::Model::DescribeStreamRequest request;
-    auto outcome =
-        client_->DescribeStream(request.WithStreamName(stream_.c_str()));
-    if (!outcome.IsSuccess()) {
-      return errors::Unknown(outcome.GetError().GetExceptionName(), ": ",
-                             outcome.GetError().GetMessage());
-    }
-    Aws::String shard;
-    Aws::String sequence;
-    if (shard_ == "") {
-      if (outcome.GetResult().GetStreamDescription().GetShards().size() != 1) {
+    // Shards are listed in pages
+    Aws::Vector<Aws::Kinesis::Model::Shard> shards;
+    Aws::String exclusive_start;
+    do {
+      Aws::Kinesis::Model::DescribeStreamRequest request;
+      request.WithStreamName(stream_.c_str());
+      if (!exclusive_start.empty()) {
+        request.WithExclusiveStartShardId(exclusive_start);
+      }
+      auto outcome = client_->DescribeStream(request);
+      if (!outcome.IsSuccess()) {
+        return errors::Unknown(outcome.GetError().GetExceptionName(), ": ",
+                               outcome.GetError().GetMessage());
+      }
+      const auto& description = outcome.GetResult().GetStreamDescription();
+      shards.insert(shards.end(), description.GetShards().begin(),
+                    description.GetShards().end());
+      exclusive_start = description.GetHasMoreShards() && !shards.empty()
+                            ? shards.back().GetShardId()
+                            : "";
+    } while (!exclusive_start.empty());
+
+    std::vector<const Aws::Kinesis::Model::Shard*> selected;
+    if (parallel) {
+      for (const auto& entry : shards) {
+        selected.push_back(&entry);
+      }
+    } else if (shard_ == "") {
+      if (shards.size() != 1) {
         return errors::InvalidArgument(
             "shard has to be provided unless the stream only have one "
             "shard, there are ",
-            outcome.GetResult().GetStreamDescription().GetShards().size(),
-            " shards in stream ", stream_);
+            shards.size(), " shards in stream ", stream_);
       }
-      shard = outcome.GetResult()
-                  .GetStreamDescription()
-                  .GetShards()[0]
-                  .GetShardId();
-      sequence = outcome.GetResult()
-                     .GetStreamDescription()
-                     .GetShards()[0]
-                     .GetSequenceNumberRange()
-                     .GetStartingSequenceNumber();
+      selected.push_back(&shards[0]);
     } else {
-      for (const auto& entry :
-           outcome.GetResult().GetStreamDescription().GetShards()) {
+      for (const auto& entry : shards) {
         if (entry.GetShardId() == shard_.c_str()) {
-          shard = entry.GetShardId();
-          sequence = entry.GetSequenceNumberRange().GetStartingSequenceNumber();
+          selected.push_back(&entry);
           break;
         }
       }
-      if (shard == "") {
+      if (selected.empty()) {
         return errors::InvalidArgument("no shard ", shard_, " in stream ",
                                        stream_);
       }
     }
 
-    Aws::Kinesis::Model::GetShardIteratorRequest iterator_request;
-    auto iterator_outcome = client_->GetShardIterator(
-        iterator_request.WithStreamName(stream_.c_str())
-            .WithShardId(shard)
-            .WithShardIteratorType(
-                Aws::Kinesis::Model::ShardIteratorType::AT_SEQUENCE_NUMBER)
-            .WithStartingSequenceNumber(sequence));
-    if (!iterator_outcome.IsSuccess()) {
-      return errors::Unknown(iterator_outcome.GetError().GetExceptionName(),
-                             ": ", iterator_outcome.GetError().GetMessage());
+    readers_.clear();
+    for (const Aws::Kinesis::Model::Shard* entry : selected) {
+      Aws::Kinesis::Model::GetShardIteratorRequest iterator_request;
+      auto iterator_outcome = client_->GetShardIterator(
+          iterator_request.WithStreamName(stream_.c_str())
+              .WithShardId(entry->GetShardId())
+              .WithShardIteratorType(
+                  Aws::Kinesis::Model::ShardIteratorType::AT_SEQUENCE_NUMBER)
+              .WithStartingSequenceNumber(entry->GetSequenceNumberRange()
+                                              .GetStartingSequenceNumber()));
+      if (!iterator_outcome.IsSuccess()) {
+        return errors::Unknown(iterator_outcome.GetError().GetExceptionName(),
+                               ": ", iterator_outcome.GetError().GetMessage());
+      }
+      std::unique_ptr<ShardReader> reader(new ShardReader());
+      reader->shard = entry->GetShardId();
+      reader->iterator = iterator_outcome.GetResult().GetShardIterator();
+      readers_.push_back(std::move(reader));
+    }
+    if (readers_.size() > 1) {
+      pool_.reset(new thread::ThreadPool(
+          env_, "kinesis_shards",
+          std::min(static_cast<int>(readers_.size()), kMaxShardThreads)));
     }
-    iterator_ = iterator_outcome.GetResult().GetShardIterator();
     return Status::OK();
   }
   Status Read(
@@ -339,53 +384,66 @@ class KinesisReadableResource : public ResourceBase {
                            Tensor** sequence_tensor)>
           allocate_func) {
     mutex_lock l(mu_);
-    do {
-      Aws::Kinesis::Model::GetRecordsRequest request;
-      auto outcome = client_->GetRecords(
-          request.WithShardIterator(iterator_).WithLimit(1));
-      if (!outcome.IsSuccess()) {
-        return errors::Unknown(outcome.GetError().GetExceptionName(), ": ",
-                               outcome.GetError().GetMessage());
+    int64 count = 0;
+    while (true) {
+      // Fetch every shard whose local buffer has been drained
+      std::vector<ShardReader*> pending;
+      bool open = false;
+      for (const auto& reader : readers_) {
+        count += reader->records.size();
+        open = open || !reader->iterator.empty();
+        if (reader->records.empty() && !reader->iterator.empty()) {
+          pending.push_back(reader.get());
+        }
       }
-      if (outcome.GetResult().GetRecords().size() == 0) {
-        // TODO: break if option provided, as no records were returned then
-        // nothing is available at the moment.
-
-        // Otherwise continue the loop after a period of time.
-        env_->SleepForMicroseconds(interval_);
-        continue;
+      if (count > 0 || !open) {
+        // All shards are closed once no iterator is left
+        break;
+      }
+      std::vector<Status> status(pending.size());
+      if (pending.size() == 1) {
+        status[0] = Fetch(pending[0]);
+      } else {
+        BlockingCounter counter(pending.size());
+        for (size_t i = 0; i < pending.size(); i++) {
+          pool_->Schedule([this, &pending, &status, &counter, i]() {
+            status[i] = Fetch(pending[i]);
+            counter.DecrementCount();
+          });
+        }
+        counter.Wait();
+      }
+      for (const auto& s : status) {
+        TF_RETURN_IF_ERROR(s);
       }
-      if (outcome.GetResult().GetRecords().size() != 1) {
-        return errors::Unknown("invalid number of records ",
-                               outcome.GetResult().GetRecords().size(),
-                               " returned");
+    }
+
+    Tensor* timestamp_tensor;
+    Tensor* data_tensor;
+    Tensor* partition_tensor;
+    Tensor* sequence_tensor;
+    TF_RETURN_IF_ERROR(allocate_func(TensorShape({count}), &timestamp_tensor,
+                                     &data_tensor, &partition_tensor,
+                                     &sequence_tensor));
+    int64 index = 0;
+    for (const auto& reader : readers_) {
+      for (const auto& record : reader->records) {
+        const auto& data = record.GetData();
+        const auto& partition = record.GetPartitionKey();
+        const auto& sequence = record.GetSequenceNumber();
+        timestamp_tensor->flat<int64>()(index) =
+            record.GetApproximateArrivalTimestamp().Millis();
+        data_tensor->flat<tstring>()(index) =
+            string(reinterpret_cast<const char*>(data.GetUnderlyingData()),
+                   data.GetLength());
+        partition_tensor->flat<tstring>()(index) =
+            string(partition.c_str(), partition.size());
+        sequence_tensor->flat<tstring>()(index) =
+            string(sequence.c_str(), sequence.size());
+        index++;
       }
-      iterator_ = outcome.GetResult().GetNextShardIterator();
-
-      Tensor* timestamp_tensor;
-      Tensor* data_tensor;
-      Tensor* partition_tensor;
-      Tensor* sequence_tensor;
-      TF_RETURN_IF_ERROR(allocate_func(TensorShape({1}), &timestamp_tensor,
-                                       &data_tensor, &partition_tensor,
-                                       &sequence_tensor));
-      const auto& timestamp =
-          outcome.GetResult().GetRecords()[0].GetApproximateArrivalTimestamp();
-      const auto& data = outcome.GetResult().GetRecords()[0].GetData();
-      const auto& partition =
-          outcome.GetResult().GetRecords()[0].GetPartitionKey();
-      const auto& sequence =
-          outcome.GetResult().GetRecords()[0].GetSequenceNumber();
-      timestamp_tensor->flat<int64>()(0) = timestamp.Millis();
-      data_tensor->flat<tstring>()(0) =
-          string(reinterpret_cast<const char*>(data.GetUnderlyingData()),
-                 data.GetLength());
-      partition_tensor->flat<tstring>()(0) =
-          string(partition.c_str(), partition.size());
-      sequence_tensor->flat<tstring>()(0) =
-          string(sequence.c_str(), sequence.size());
-      return Status::OK();
-    } while (true);
+      reader->records.clear();
+    }
     return Status::OK();
   }
   string DebugString() const override {
@@ -394,14 +452,60 @@ class KinesisReadableResource : public ResourceBase {
   }
 
  protected:
+  // Reads one shard with its own iterator into a local buffer
+  struct ShardReader {
+    Aws::String shard;
+    // Empty once the shard has been closed and fully read
+    Aws::String iterator;
+    Aws::Vector<Aws::Kinesis::Model::Record> records;
+    // Earliest time of the next GetRecords call on this shard
+    uint64 next_call_micros = 0;
+  };
+
+  // Fetches up to limit_ records of the shard, honouring the per-shard limit
+  // of GetRecords calls. No records are returned while the shard is idle.
+  Status Fetch(ShardReader* reader) {
+    const uint64 now = env_->NowMicros();
+    if (now < reader->next_call_micros) {
+      env_->SleepForMicroseconds(reader->next_call_micros - now);
+    }
+    reader->next_call_micros = env_->NowMicros() + kGetRecordsIntervalMicros;
+
+    Aws::Kinesis::Model::GetRecordsRequest request;
+    auto outcome = client_->GetRecords(
+        request.WithShardIterator(reader->iterator).WithLimit(limit_));
+    if (!outcome.IsSuccess()) {
+      if (outcome.GetError().GetErrorType() ==
+          Aws::Kinesis::KinesisErrors::PROVISIONED_THROUGHPUT_EXCEEDED) {
+        LOG(WARNING) << "Throughput exceeded on shard " << reader->shard;
+        reader->next_call_micros += kThroughputBackoffMicros;
+        return Status::OK();
+      }
+      return errors::Unknown(outcome.GetError().GetExceptionName(), ": ",
+                             outcome.GetError().GetMessage());
+    }
+    reader->records = outcome.GetResult().GetRecords();
+    reader->iterator = outcome.GetResult().GetNextShardIterator();
+    if (reader->records.empty() && !reader->iterator.empty() &&
+        outcome.GetResult().GetMillisBehindLatest() == 0) {
+      // Nothing is available at the moment, wait before polling again
+      const uint64 idle_micros = env_->NowMicros() + interval_;
+      reader->next_call_micros =
+          std::max(reader->next_call_micros, idle_micros);
+    }
+    return Status::OK();
+  }
+
   mutable mutex mu_;
   Env* env_ TF_GUARDED_BY(mu_);
   string stream_ TF_GUARDED_BY(mu_);
   string shard_ TF_GUARDED_BY(mu_);
-  Aws::String iterator_ TF_GUARDED_BY(mu_);
+  std::vector<std::unique_ptr<ShardReader>> readers_ TF_GUARDED_BY(mu_);
+  std::unique_ptr<thread::ThreadPool> pool_ TF_GUARDED_BY(mu_);
   std::unique_ptr<Aws::Kinesis::KinesisClient, decltype(&ShutdownClient)>
       client_ TF_GUARDED_BY(mu_);
   int64 interval_ TF_GUARDED_BY(mu_);
+  int64 limit_ TF_GUARDED_BY(mu_) = kMaxGetRecordsLimit;
 };
 
 class KinesisReadableInitOp : public ResourceOpKernel<KinesisReadableResource> {
@@ -12,6 +12,9 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
+#ifndef TENSORFLOW_IO_CORE_KERNELS_OUTPUT_OPS_H_
+#define TENSORFLOW_IO_CORE_KERNELS_OUTPUT_OPS_H_
+
 #include "tensorflow/core/framework/dataset.h"
 #include "tensorflow/core/framework/function_handle_cache.h"
 #include "tensorflow/core/framework/op_kernel.h"
@@ -22,23 +25,24 @@ limitations under the License.
 namespace tensorflow {
 namespace data {
 
+// Writes all elements of a dataset with T, which implements
+//   explicit T(Env* env);
+//   Status Init(OpKernelContext* ctx);  // parse the inputs, open the output
+//   Status Write(const std::vector<Tensor>& components);  // one element
+//   Status Final(OpKernelContext* ctx);  // flush, close and set the outputs
 template <typename T>
 class DatasetOutputOp : public AsyncOpKernel {
  public:
   explicit DatasetOutputOp<T>(OpKernelConstruction* ctx)
       : AsyncOpKernel(ctx),
-        background_worker_(ctx->env(), "text_dataset_output") {}
+        background_worker_(ctx->env(), "dataset_output") {}
 
   void ComputeAsync(OpKernelContext* ctx, DoneCallback done) override {
     // The call to `iterator->GetNext()` may block and depend on an inter-op
     // thread pool thread, so we issue the call using a background thread.
     background_worker_.Schedule([this, ctx, done]() {
-      string filename;
-      OP_REQUIRES_OK_ASYNC(
-          ctx, ParseScalarArgument<string>(ctx, "filename", &filename), done);
-      std::unique_ptr<WritableFile> file;
-      OP_REQUIRES_OK_ASYNC(ctx, ctx->env()->NewWritableFile(filename, &file),
-                           done);
+      std::unique_ptr<T> output(new T(ctx->env()));
+      OP_REQUIRES_OK_ASYNC(ctx, output->Init(ctx), done);
 
       DatasetBase* dataset;
       OP_REQUIRES_OK_ASYNC(
@@ -52,25 +56,23 @@ class DatasetOutputOp : public AsyncOpKernel {
 
       OP_REQUIRES_OK_ASYNC(
           ctx,
-          dataset->MakeIterator(&iter_ctx, "TextDatasetOutputOpIterator",
+          dataset->MakeIterator(&iter_ctx, "DatasetOutputOpIterator",
                                 &iterator),
           done);
       std::vector<Tensor> components;
       components.reserve(dataset->output_dtypes().size());
       bool end_of_sequence;
-      std::unique_ptr<T> output;
       do {
         OP_REQUIRES_OK_ASYNC(
             ctx, iterator->GetNext(&iter_ctx, &components, &end_of_sequence),
             done);
 
         if (!end_of_sequence) {
-          OP_REQUIRES_OK_ASYNC(ctx, output.get()->Write(file.get(), components),
-                               done);
+          OP_REQUIRES_OK_ASYNC(ctx, output->Write(components), done);
         }
         components.clear();
       } while (!end_of_sequence);
-      OP_REQUIRES_OK_ASYNC(ctx, output.get()->Final(file.get()), done);
+      OP_REQUIRES_OK_ASYNC(ctx, output->Final(ctx), done);
       done();
     });
   }
@@ -81,3 +83,5 @@ class DatasetOutputOp : public AsyncOpKernel {
 
 }  // namespace data
 }  // namespace tensorflow
+
+#endif  // TENSORFLOW_IO_CORE_KERNELS_OUTPUT_OPS_H_
@@ -14,6 +14,8 @@ limitations under the License.
 ==============================================================================*/
 
 #include <grpc++/grpc++.h>
+
+#include <deque>
 // Inclusion of googleapi related grpc headers, e.g., pubsub.grpc.pb.h
 // will cause Windows build failures due to the conflict of `OPTIONAL`
 // definition. The following is needed for Windows.
@@ -33,13 +35,40 @@ namespace {
 using google::pubsub::v1::AcknowledgeRequest;
 using google::pubsub::v1::PullRequest;
 using google::pubsub::v1::PullResponse;
+using google::pubsub::v1::StreamingPullRequest;
+using google::pubsub::v1::StreamingPullResponse;
 using google::pubsub::v1::Subscriber;
 using grpc::ClientContext;
 
+// Interval at which acks and ack deadline extensions are sent
+constexpr int64 kAckIntervalMillis = 100;
+
+// The range of ack deadlines accepted by Pub/Sub
+constexpr int64 kMinAckDeadlineSeconds = 10;
+constexpr int64 kMaxAckDeadlineSeconds = 600;
+
 class PubSubReadableResource : public ResourceBase {
  public:
   PubSubReadableResource(Env* env) : env_(env) {}
-  ~PubSubReadableResource() {}
+  ~PubSubReadableResource() {
+    {
+      mutex_lock l(queue_mu_);
+      stop_ = true;
+      ack_cv_.notify_all();
+    }
+    // The ack thread sends the remaining acks before it exits, the stream is
+    // cancelled afterwards
+    ack_thread_.reset(nullptr);
+    {
+      mutex_lock l(queue_mu_);
+      stop_pull_ = true;
+      room_cv_.notify_all();
+    }
+    if (stream_context_.get() != nullptr) {
+      stream_context_->TryCancel();
+    }
+    pull_thread_.reset(nullptr);
+  }
 
   Status Init(const string& input, const std::vector<string>& metadata) {
     mutex_lock l(mu_);
@@ -47,6 +76,7 @@ class PubSubReadableResource : public ResourceBase {
     endpoint_ = "";
     subscription_ = input;
     timeout_ = 10 * 1000;
+    bool streaming = false;
     for (size_t i = 0; i < metadata.size(); i++) {
       if (metadata[i].find("endpoint=") == 0) {
         std::vector<string> parts = str_util::Split(metadata[i], "=");
@@ -61,6 +91,34 @@ class PubSubReadableResource : public ResourceBase {
           return errors::InvalidArgument("invalid configuration: ",
                                          metadata[i]);
         }
+      } else if (metadata[i].find("streaming=") == 0) {
+        streaming = (metadata[i] == "streaming=true");
+      } else if (metadata[i].find("max_outstanding_messages=") == 0 ||
+                 metadata[i].find("max_outstanding_bytes=") == 0 ||
+                 metadata[i].find("ack_deadline=") == 0 ||
+                 metadata[i].find("batch=") == 0) {
+        std::vector<string> parts = str_util::Split(metadata[i], "=");
+        int64 value = 0;
+        if (parts.size() != 2 || !strings::safe_strto64(parts[1], &value) ||
+            value <= 0) {
+          return errors::InvalidArgument("invalid configuration: ",
+                                         metadata[i]);
+        }
+        if (parts[0] == "max_outstanding_messages") {
+          max_outstanding_messages_ = value;
+        } else if (parts[0] == "max_outstanding_bytes") {
+          max_outstanding_bytes_ = value;
+        } else if (parts[0] == "ack_deadline") {
+          if (value < kMinAckDeadlineSeconds ||
+              value > kMaxAckDeadlineSeconds) {
+            return errors::InvalidArgument(
+                "ack_deadline must be between ", kMinAckDeadlineSeconds,
+                " and ", kMaxAckDeadlineSeconds, " seconds: ", metadata[i]);
+          }
+          ack_deadline_ = value;
+        } else {
+          batch_ = value;
+        }
       }
     }
     string endpoint = endpoint_;
@@ -74,12 +132,32 @@ class PubSubReadableResource : public ResourceBase {
     }
     stub_ = Subscriber::NewStub(grpc::CreateChannel(endpoint, creds));
 
+    if (streaming) {
+      stream_context_.reset(new ClientContext());
+      stream_ = stub_->StreamingPull(stream_context_.get());
+      StreamingPullRequest request;
+      request.set_subscription(subscription_);
+      request.set_stream_ack_deadline_seconds(ack_deadline_);
+      if (!stream_->Write(request)) {
+        grpc::Status status = stream_->Finish();
+        stream_.reset(nullptr);
+        return errors::Internal("Failed to open streaming pull: ",
+                                status.error_message());
+      }
+      pull_thread_.reset(env_->StartThread(ThreadOptions(), "pubsub_pull",
+                                           [this]() { PullLoop(); }));
+      ack_thread_.reset(env_->StartThread(ThreadOptions(), "pubsub_ack",
+                                          [this]() { AckLoop(); }));
+    }
     return Status::OK();
   }
   Status Read(std::function<Status(const TensorShape& shape, Tensor** id_tensor,
                                    Tensor** data_tensor, Tensor** time_tensor)>
                   allocate_func) {
     mutex_lock l(mu_);
+    if (stream_.get() != nullptr) {
+      return ReadStream(allocate_func);
+    }
     if (stub_.get() == nullptr) {
       return errors::OutOfRange("EOF reached");
     }
@@ -142,6 +220,150 @@ class PubSubReadableResource : public ResourceBase {
   }
 
  protected:
+  struct ReceivedMessage {
+    string id;
+    string data;
+    int64 time;
+    string ack_id;
+    // Time of the last lease of the message, either receipt or extension
+    uint64 lease_micros;
+  };
+
+  // Drains up to batch_ messages of the local queue, waiting up to timeout_
+  // for the first one. The drained messages are acked by the ack thread.
+  Status ReadStream(
+      std::function<Status(const TensorShape& shape, Tensor** id_tensor,
+                           Tensor** data_tensor, Tensor** time_tensor)>
+          allocate_func) TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    mutex_lock l(queue_mu_);
+    const uint64 deadline = env_->NowMicros() + timeout_ * 1000;
+    while (queue_.empty() && stream_status_.ok()) {
+      if (timeout_ <= 0) {
+        queue_cv_.wait(l);
+        continue;
+      }
+      const uint64 now = env_->NowMicros();
+      if (now >= deadline) {
+        break;
+      }
+      queue_cv_.wait_for(l, std::chrono::microseconds(deadline - now));
+    }
+    if (queue_.empty() && !stream_status_.ok()) {
+      return stream_status_;
+    }
+
+    const int64 count = std::min(static_cast<int64>(queue_.size()), batch_);
+    Tensor* id_tensor;
+    Tensor* data_tensor;
+    Tensor* time_tensor;
+    TF_RETURN_IF_ERROR(allocate_func(TensorShape({count}), &id_tensor,
+                                     &data_tensor, &time_tensor));
+    for (int64 i = 0; i < count; i++) {
+      ReceivedMessage& message = queue_.front();
+      id_tensor->flat<tstring>()(i) = std::move(message.id);
+      time_tensor->flat<int64>()(i) = message.time;
+      queue_bytes_ -= message.data.size();
+      data_tensor->flat<tstring>()(i) = std::move(message.data);
+      pending_acks_.emplace_back(std::move(message.ack_id));
+      queue_.pop_front();
+    }
+    room_cv_.notify_all();
+    return Status::OK();
+  }
+
+  // Receives from the streaming pull into the local queue, the stream is not
+  // read while the queue holds max_outstanding_messages messages or
+  // max_outstanding_bytes bytes so that gRPC flow control holds back the
+  // server. The stream is finished on the way out, whether it failed or was
+  // stopped.
+  void PullLoop() {
+    bool stopped = false;
+    while (!stopped) {
+      {
+        mutex_lock l(queue_mu_);
+        while (!stop_pull_ &&
+               (static_cast<int64>(queue_.size()) >=
+                    max_outstanding_messages_ ||
+                queue_bytes_ >= max_outstanding_bytes_)) {
+          room_cv_.wait(l);
+        }
+        stopped = stop_pull_;
+      }
+      if (stopped) {
+        // Finish waits for the server otherwise
+        stream_context_->TryCancel();
+        break;
+      }
+      StreamingPullResponse response;
+      if (!stream_->Read(&response)) {
+        break;
+      }
+      const uint64 now = env_->NowMicros();
+      mutex_lock l(queue_mu_);
+      for (const auto& received : response.received_messages()) {
+        const auto& message = received.message();
+        queue_bytes_ += message.data().size();
+        queue_.push_back(ReceivedMessage{
+            message.message_id(), message.data(),
+            message.publish_time().seconds() * 1000 +
+                message.publish_time().nanos() / 1000000,
+            received.ack_id(), now});
+      }
+      queue_cv_.notify_all();
+    }
+
+    mutex_lock write_lock(write_mu_);
+    finished_ = true;
+    grpc::Status status = stream_->Finish();
+    mutex_lock l(queue_mu_);
+    if (!stop_) {
+      stream_status_ =
+          errors::Internal("Streaming pull failed: ", status.error_message());
+    }
+    queue_cv_.notify_all();
+  }
+
+  // Sends acks of drained messages and extends the ack deadline of queued
+  // messages, both batched into one request per interval
+  void AckLoop() {
+    const uint64 extend_micros = ack_deadline_ * 1000000 / 2;
+    bool stop = false;
+    while (!stop) {
+      StreamingPullRequest request;
+      {
+        mutex_lock l(queue_mu_);
+        if (!stop_) {
+          ack_cv_.wait_for(l, std::chrono::milliseconds(kAckIntervalMillis));
+        }
+        stop = stop_;
+        for (auto& ack_id : pending_acks_) {
+          request.add_ack_ids(std::move(ack_id));
+        }
+        pending_acks_.clear();
+        const uint64 now = env_->NowMicros();
+        for (auto& message : queue_) {
+          if (now - message.lease_micros >= extend_micros) {
+            request.add_modify_deadline_ack_ids(message.ack_id);
+            request.add_modify_deadline_seconds(ack_deadline_);
+            message.lease_micros = now;
+          }
+        }
+      }
+      if (request.ack_ids_size() == 0 &&
+          request.modify_deadline_ack_ids_size() == 0) {
+        continue;
+      }
+      mutex_lock write_lock(write_mu_);
+      if (finished_) {
+        return;
+      }
+      if (!stream_->Write(request)) {
+        LOG(WARNING) << "Failed to send " << request.ack_ids_size()
+                     << " acks on subscription " << subscription_;
+      }
+    }
+  }
+
   mutable mutex mu_;
   Env* env_ TF_GUARDED_BY(mu_);
   string subscription_ TF_GUARDED_BY(mu_);
@@ -151,6 +373,34 @@ class PubSubReadableResource : public ResourceBase {
   string message_id_ TF_GUARDED_BY(mu_);
   string message_data_ TF_GUARDED_BY(mu_);
   int64 message_time_ TF_GUARDED_BY(mu_);
+
+  // Streaming pull, the stream is read by the pull thread and written by the
+  // ack thread
+  int64 max_outstanding_messages_ = 1000;
+  int64 max_outstanding_bytes_ = 100 << 20;
+  int64 ack_deadline_ = 60;
+  int64 batch_ = 1000;
+  std::unique_ptr<ClientContext> stream_context_;
+  std::unique_ptr<
+      grpc::ClientReaderWriter<StreamingPullRequest, StreamingPullResponse>>
+      stream_;
+  std::unique_ptr<Thread> pull_thread_;
+  std::unique_ptr<Thread> ack_thread_;
+
+  mutex write_mu_;
+  bool finished_ TF_GUARDED_BY(write_mu_) = false;
+
+  mutex queue_mu_;
+  condition_variable queue_cv_;
+  condition_variable room_cv_;
+  condition_variable ack_cv_;
+  bool stop_ TF_GUARDED_BY(queue_mu_) = false;
+  // Set once the ack thread is done, stops the pull thread
+  bool stop_pull_ TF_GUARDED_BY(queue_mu_) = false;
+  std::deque<ReceivedMessage> queue_ TF_GUARDED_BY(queue_mu_);
+  int64 queue_bytes_ TF_GUARDED_BY(queue_mu_) = 0;
+  std::vector<string> pending_acks_ TF_GUARDED_BY(queue_mu_);
+  Status stream_status_ TF_GUARDED_BY(queue_mu_);
 };
 
 class PubSubReadableInitOp : public ResourceOpKernel<PubSubReadableResource> {
@@ -16,6 +16,8 @@ limitations under the License.
 #include "pulsar/Client.h"
 #include "tensorflow/core/framework/resource_mgr.h"
 #include "tensorflow/core/framework/resource_op_kernel.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow_io/core/kernels/pulsar_kernel.h"
 
 namespace tensorflow {
 namespace io {
@@ -36,31 +38,78 @@ class PulsarResourceBase : public ResourceBase {
   mutable mutex mu_;
   std::unique_ptr<pulsar::Client> client_ TF_GUARDED_BY(mu_);
 
-  void Init(const std::string& service_url) TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
-    client_.reset(new pulsar::Client(service_url));
+  void Init(const std::string& service_url,
+            const pulsar::ClientConfiguration& conf)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    client_.reset(new pulsar::Client(service_url, conf));
   }
 };
 
+// Upper bound of the I/O threads receiving from multiple topics concurrently
+constexpr int kMaxIOThreads = 8;
+
 class PulsarReadableResource final : public PulsarResourceBase {
  public:
-  Status Init(const std::string& service_url, const std::string& topic,
-              const std::string& subscription, int64 ack_grouping_time) {
+  // Messages are received in batches of at most max_num_messages messages
+  // and max_num_bytes bytes. Multiple topics and the partitions of
+  // partitioned topics are consumed concurrently by one consumer.
+  Status Init(const std::string& service_url,
+              const std::vector<std::string>& topics,
+              const std::string& subscription, int64 ack_grouping_time,
+              int64 max_num_messages, int64 max_num_bytes) {
     mutex_lock l(mu_);
-    PulsarResourceBase::Init(service_url);
+    if (topics.empty()) {
+      return errors::InvalidArgument("no topic to subscribe");
+    }
+    if (max_num_messages <= 0 || max_num_bytes <= 0) {
+      return errors::InvalidArgument(
+          "invalid batch size, max_num_messages: ", max_num_messages,
+          " max_num_bytes: ", max_num_bytes);
+    }
+    max_num_messages_ = max_num_messages;
+    max_num_bytes_ = max_num_bytes;
+
+    pulsar::ClientConfiguration client_conf;
+    client_conf.setIOThreads(
+        std::min(static_cast<int>(topics.size()), kMaxIOThreads));
+    PulsarResourceBase::Init(service_url, client_conf);
+
+    // Cumulative acknowledgment is only supported by a consumer of a single
+    // non-partitioned topic
+    cumulative_ack_ = false;
+    if (topics.size() == 1) {
+      std::vector<std::string> partitions;
+      auto result = client_->getPartitionsForTopic(topics[0], partitions);
+      if (result != pulsar::ResultOk) {
+        return errors::Internal("failed to get partitions of ", topics[0],
+                                " error: ", pulsar::strResult(result));
+      }
+      cumulative_ack_ = (partitions.size() <= 1);
+    }
 
     pulsar::ConsumerConfiguration conf;
     conf.setConsumerType(pulsar::ConsumerFailover);
     conf.setSubscriptionInitialPosition(pulsar::InitialPositionEarliest);
     conf.setAckGroupingTimeMs(ack_grouping_time);
+    // The prefetch queue has to hold at least one full batch
+    const int64 queue_size = std::min(max_num_messages_, int64{kint32max});
+    if (queue_size > conf.getReceiverQueueSize()) {
+      conf.setReceiverQueueSize(static_cast<int>(queue_size));
+    }
 
-    auto result = client_->subscribe(topic, subscription, conf, consumer_);
+    auto result =
+        (topics.size() == 1)
+            ? client_->subscribe(topics[0], subscription, conf, consumer_)
+            : client_->subscribe(topics, subscription, conf, consumer_);
     if (result != pulsar::ResultOk) {
-      return errors::Internal("failed to subscribe ", topic,
+      return errors::Internal("failed to subscribe ",
+                              str_util::Join(topics, ","),
                               " subscription: ", subscription,
                               " error: ", pulsar::strResult(result));
     }
 
-    LOG(INFO) << "Subscribing to the pulsar topic: " << topic
+    LOG(INFO) << "Subscribing to the pulsar topics: "
+              << str_util::Join(topics, ",")
               << " with subscription: " << subscription;
     return Status::OK();
   }
@@ -71,37 +120,10 @@ class PulsarReadableResource final : public PulsarResourceBase {
                   allocate_func) {
     mutex_lock l(mu_);
 
-    constexpr size_t max_num_messages = 1024;
-    std::vector<std::string> values;
-    std::vector<std::string> keys;
-    values.reserve(max_num_messages);
-    keys.reserve(max_num_messages);
-
-    int32 elapsed_time = 0;
-    int num_messages = 0;
-    while (elapsed_time < timeout && num_messages < max_num_messages) {
-      pulsar::Message message;
-      auto result = consumer_.receive(message, poll_timeout);
-      if (result == pulsar::ResultOk) {
-        keys.emplace_back(message.hasPartitionKey() ? message.getPartitionKey()
-                                                    : "");
-        values.emplace_back(message.getDataAsString());
-        num_messages++;
-        elapsed_time = 0;  // reset the current timeout
-        consumer_.acknowledgeAsync(message, [&](pulsar::Result result) {
-          if (result != pulsar::ResultOk) {
-            LOG(ERROR) << "Failed to acknowledge " << message.getMessageId();
-          }
-        });
-      } else if (result == pulsar::ResultTimeout) {
-        elapsed_time += poll_timeout;
-      } else {
-        return errors::Internal("failed to receive messages, error: ",
-                                pulsar::strResult(result));
-      }
-    }
+    std::vector<pulsar::Message> messages;
+    TF_RETURN_IF_ERROR(BatchReceive(timeout, poll_timeout, &messages));
 
-    TensorShape shape({static_cast<int32>(values.size())});
+    TensorShape shape({static_cast<int64>(messages.size())});
     Tensor* value_tensor;
     Tensor* key_tensor;
     Tensor* continue_fetch_tensor;
@@ -110,19 +132,82 @@ class PulsarReadableResource final : public PulsarResourceBase {
 
     // If no messages were received when timeout exceeded, we treat it as a
     // failure and don't continue receiving messages.
-    continue_fetch_tensor->scalar<int64>()() = (values.empty() ? 0 : 1);
-    for (size_t i = 0; i < values.size(); i++) {
-      value_tensor->flat<tstring>()(i) = values[i];
-      key_tensor->flat<tstring>()(i) = keys[i];
+    continue_fetch_tensor->scalar<int64>()() = (messages.empty() ? 0 : 1);
+    auto values = value_tensor->flat<tstring>();
+    auto keys = key_tensor->flat<tstring>();
+    for (size_t i = 0; i < messages.size(); i++) {
+      values(i).assign(static_cast<const char*>(messages[i].getData()),
+                       messages[i].getLength());
+      if (messages[i].hasPartitionKey()) {
+        keys(i) = messages[i].getPartitionKey();
+      }
     }
 
+    Acknowledge(messages);
     return Status::OK();
   }
 
   std::string DebugString() const override { return "PulsarReadableResource"; }
 
  private:
+  // Waits up to timeout for the first message, then takes the messages that
+  // are already prefetched without waiting until the batch is full
+  Status BatchReceive(const int32 timeout, const int32 poll_timeout,
+                      std::vector<pulsar::Message>* messages)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    int64 num_bytes = 0;
+    int32 elapsed_time = 0;
+    while (static_cast<int64>(messages->size()) < max_num_messages_ &&
+           num_bytes < max_num_bytes_) {
+      const int32 wait = messages->empty() ? poll_timeout : 0;
+      pulsar::Message message;
+      auto result = consumer_.receive(message, wait);
+      if (result == pulsar::ResultOk) {
+        num_bytes += message.getLength();
+        messages->emplace_back(std::move(message));
+      } else if (result == pulsar::ResultTimeout) {
+        if (!messages->empty()) {
+          break;
+        }
+        elapsed_time += poll_timeout;
+        if (elapsed_time >= timeout) {
+          break;
+        }
+      } else {
+        return errors::Internal("failed to receive messages, error: ",
+                                pulsar::strResult(result));
+      }
+    }
+    return Status::OK();
+  }
+
+  // Acknowledges the whole batch with one cumulative acknowledgment if
+  // possible, otherwise each message is acknowledged and the acks are
+  // grouped by the consumer
+  void Acknowledge(const std::vector<pulsar::Message>& messages)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    if (messages.empty()) {
+      return;
+    }
+    auto callback = [](pulsar::Result result) {
+      if (result != pulsar::ResultOk) {
+        LOG(ERROR) << "Failed to acknowledge messages: "
+                   << pulsar::strResult(result);
+      }
+    };
+    if (cumulative_ack_) {
+      consumer_.acknowledgeCumulativeAsync(messages.back(), callback);
+      return;
+    }
+    for (const auto& message : messages) {
+      consumer_.acknowledgeAsync(message, callback);
+    }
+  }
+
   pulsar::Consumer consumer_;
+  int64 max_num_messages_ TF_GUARDED_BY(mu_) = 1024;
+  int64 max_num_bytes_ TF_GUARDED_BY(mu_) = 10 << 20;
+  bool cumulative_ack_ TF_GUARDED_BY(mu_) = false;
 };
 
 class PulsarReadableInitOp : public ResourceOpKernel<PulsarReadableResource> {
@@ -141,7 +226,10 @@ class PulsarReadableInitOp : public ResourceOpKernel<PulsarReadableResource> {
 
     const Tensor* topic_tensor;
     OP_REQUIRES_OK(context, context->input("topic", &topic_tensor));
-    const std::string topic = topic_tensor->flat<tstring>()(0);
+    std::vector<std::string> topics;
+    for (int64 i = 0; i < topic_tensor->NumElements(); i++) {
+      topics.emplace_back(topic_tensor->flat<tstring>()(i));
+    }
 
     const Tensor* subscription_tensor;
     OP_REQUIRES_OK(context,
@@ -153,8 +241,20 @@ class PulsarReadableInitOp : public ResourceOpKernel<PulsarReadableResource> {
                                            &ack_grouping_time_tensor));
     const int64 ack_grouping_time = ack_grouping_time_tensor->scalar<int64>()();
 
-    OP_REQUIRES_OK(context, resource_->Init(service_url, topic, subscription,
-                                            ack_grouping_time));
+    const Tensor* max_num_messages_tensor;
+    OP_REQUIRES_OK(context, context->input("max_num_messages",
+                                           &max_num_messages_tensor));
+    const int64 max_num_messages = max_num_messages_tensor->scalar<int64>()();
+
+    const Tensor* max_num_bytes_tensor;
+    OP_REQUIRES_OK(context,
+                   context->input("max_num_bytes", &max_num_bytes_tensor));
+    const int64 max_num_bytes = max_num_bytes_tensor->scalar<int64>()();
+
+    OP_REQUIRES_OK(context,
+                   resource_->Init(service_url, topics, subscription,
+                                   ack_grouping_time, max_num_messages,
+                                   max_num_bytes));
   }
 
   Status CreateResource(PulsarReadableResource** resource)
@@ -207,14 +307,44 @@ class PulsarReadableNextOp : public OpKernel {
 
 class PulsarWritableResource final : public PulsarResourceBase {
  public:
-  Status Init(const std::string& service_url, const std::string& topic) {
+  PulsarWritableResource(Env* env)
+      : env_(env), state_(std::make_shared<SendState>()) {}
+
+  ~PulsarWritableResource() override {
+    mutex_lock l(mu_);
+    if (client_.get()) {
+      // Pending messages are completed before the client is closed
+      producer_.flush();
+      producer_.close();
+    }
+  }
+
+  // Messages are batched by the producer, a batch is published once it
+  // holds batching_max_messages messages or batching_max_bytes bytes, or
+  // after batching_max_delay milliseconds. Writes block once
+  // max_pending_messages messages wait for their receipt.
+  Status Init(const std::string& service_url, const std::string& topic,
+              int64 batching_max_messages, int64 batching_max_bytes,
+              int64 batching_max_delay, const std::string& compression,
+              int64 max_pending_messages) {
     mutex_lock l(mu_);
-    PulsarResourceBase::Init(service_url);
+    PulsarResourceBase::Init(service_url, pulsar::ClientConfiguration());
     index_ = 0;
 
     pulsar::ProducerConfiguration conf;
     conf.setPartitionsRoutingMode(
         pulsar::ProducerConfiguration::RoundRobinDistribution);
+    conf.setBatchingEnabled(batching_max_messages > 1);
+    if (batching_max_messages > 1) {
+      conf.setBatchingMaxMessages(batching_max_messages);
+      conf.setBatchingMaxAllowedSizeInBytes(batching_max_bytes);
+      conf.setBatchingMaxPublishDelayMs(batching_max_delay);
+    }
+    pulsar::CompressionType compression_type;
+    TF_RETURN_IF_ERROR(ParseCompression(compression, &compression_type));
+    conf.setCompressionType(compression_type);
+    conf.setMaxPendingMessages(max_pending_messages);
+    conf.setBlockIfQueueFull(true);
 
     auto result = client_->createProducer(topic, conf, producer_);
     if (result != pulsar::ResultOk) {
@@ -228,26 +358,44 @@ class PulsarWritableResource final : public PulsarResourceBase {
 
   Status WriteAsync(const std::string& value, const std::string& key) {
     mutex_lock l(mu_);
-    pulsar::MessageBuilder builder;
-    if (!key.empty()) {
-      builder.setPartitionKey(key);
+    Send(value.data(), value.size(), key);
+    return TakeStatus();
+  }
+
+  // Sends all values (with keys, if not empty) in one call, the stats of the
+  // messages completed since the previous call are returned as sent, failed,
+  // pending messages, pending bytes, mean and max latency in microseconds.
+  Status WriteBatch(const Tensor& values, const Tensor& keys,
+                    std::function<Status(Tensor** stats)> allocate_func) {
+    mutex_lock l(mu_);
+    if (keys.NumElements() != 0 && keys.NumElements() != values.NumElements()) {
+      return errors::InvalidArgument("number of keys ", keys.NumElements(),
+                                     " does not match number of values ",
+                                     values.NumElements());
     }
-    auto send_async_result = pulsar::ResultOk;
-    producer_.sendAsync(
-        builder.setContent(value).build(),
-        [index = index_, &send_async_result](pulsar::Result result,
-                                             const pulsar::MessageId& id) {
-          if (result != pulsar::ResultOk) {
-            LOG(ERROR) << "failed to send message-" << index << ": " << result;
-          }
-          send_async_result = result;
-        });
-    // sendAsync may fail immediately caused by queue is full
-    if (send_async_result != pulsar::ResultOk) {
-      return errors::Internal("sendAsync failed for index: ", index_,
-                              " error: ", pulsar::strResult(send_async_result));
+    for (int64 i = 0; i < values.NumElements(); i++) {
+      const tstring& value = values.flat<tstring>()(i);
+      Send(value.data(), value.size(),
+           keys.NumElements() != 0 ? std::string(keys.flat<tstring>()(i))
+                                   : std::string());
     }
-    index_++;
+    TF_RETURN_IF_ERROR(TakeStatus());
+
+    Tensor* stats_tensor;
+    TF_RETURN_IF_ERROR(allocate_func(&stats_tensor));
+    auto stats = stats_tensor->flat<int64>();
+    mutex_lock state_lock(state_->mu);
+    const int64 completed = state_->sent + state_->failed;
+    stats(0) = state_->sent;
+    stats(1) = state_->failed;
+    stats(2) = state_->pending_messages;
+    stats(3) = state_->pending_bytes;
+    stats(4) = completed > 0 ? state_->total_latency / completed : 0;
+    stats(5) = state_->max_latency;
+    state_->sent = 0;
+    state_->failed = 0;
+    state_->total_latency = 0;
+    state_->max_latency = 0;
     return Status::OK();
   }
 
@@ -257,12 +405,91 @@ class PulsarWritableResource final : public PulsarResourceBase {
     if (result != pulsar::ResultOk) {
       return errors::Internal("failed to flush: ", pulsar::strResult(result));
     }
-    return Status::OK();
+    return TakeStatus();
   }
 
   std::string DebugString() const override { return "PulsarWritableResource"; }
 
  private:
+  // Shared with the send callbacks, which may run after the resource is gone
+  struct SendState {
+    mutex mu;
+    int64 pending_messages TF_GUARDED_BY(mu) = 0;
+    int64 pending_bytes TF_GUARDED_BY(mu) = 0;
+    int64 sent TF_GUARDED_BY(mu) = 0;
+    int64 failed TF_GUARDED_BY(mu) = 0;
+    int64 total_latency TF_GUARDED_BY(mu) = 0;
+    int64 max_latency TF_GUARDED_BY(mu) = 0;
+    // The first send error, reported by the next write or flush
+    Status status TF_GUARDED_BY(mu);
+  };
+
+  static Status ParseCompression(const std::string& compression,
+                                 pulsar::CompressionType* type) {
+    if (compression == "" || compression == "none") {
+      *type = pulsar::CompressionNone;
+    } else if (compression == "lz4") {
+      *type = pulsar::CompressionLZ4;
+    } else if (compression == "zlib") {
+      *type = pulsar::CompressionZLib;
+    } else if (compression == "zstd") {
+      *type = pulsar::CompressionZSTD;
+    } else if (compression == "snappy") {
+      *type = pulsar::CompressionSNAPPY;
+    } else {
+      return errors::InvalidArgument("unsupported compression: ", compression);
+    }
+    return Status::OK();
+  }
+
+  // Blocks only while max_pending_messages messages are pending
+  void Send(const char* data, size_t size, const std::string& key)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    pulsar::MessageBuilder builder;
+    if (!key.empty()) {
+      builder.setPartitionKey(key);
+    }
+    {
+      mutex_lock l(state_->mu);
+      state_->pending_messages++;
+      state_->pending_bytes += size;
+    }
+    const int64 bytes = size;
+    const uint64 start = env_->NowMicros();
+    producer_.sendAsync(
+        builder.setContent(data, size).build(),
+        [index = index_, bytes, start, env = env_, state = state_](
+            pulsar::Result result, const pulsar::MessageId& id) {
+          const int64 latency = env->NowMicros() - start;
+          mutex_lock l(state->mu);
+          state->pending_messages--;
+          state->pending_bytes -= bytes;
+          if (result != pulsar::ResultOk) {
+            LOG(ERROR) << "failed to send message-" << index << ": " << result;
+            state->failed++;
+            if (state->status.ok()) {
+              state->status =
+                  errors::Internal("sendAsync failed for index: ", index,
+                                   " error: ", pulsar::strResult(result));
+            }
+            return;
+          }
+          state->sent++;
+          state->total_latency += latency;
+          state->max_latency = std::max(state->max_latency, latency);
+        });
+    index_++;
+  }
+
+  Status TakeStatus() {
+    mutex_lock l(state_->mu);
+    Status status = state_->status;
+    state_->status = Status::OK();
+    return status;
+  }
+
+  Env* env_;
+  std::shared_ptr<SendState> state_;
   pulsar::Producer producer_;
   unsigned long index_;
 };
@@ -270,7 +497,9 @@ class PulsarWritableResource final : public PulsarResourceBase {
 class PulsarWritableInitOp : public ResourceOpKernel<PulsarWritableResource> {
  public:
   explicit PulsarWritableInitOp(OpKernelConstruction* context)
-      : ResourceOpKernel<PulsarWritableResource>(context) {}
+      : ResourceOpKernel<PulsarWritableResource>(context) {
+    env_ = context->env();
+  }
 
  private:
   void Compute(OpKernelContext* context) override {
@@ -284,17 +513,49 @@ class PulsarWritableInitOp : public ResourceOpKernel<PulsarWritableResource> {
     OP_REQUIRES_OK(context, context->input("topic", &topic_tensor));
     const std::string topic = topic_tensor->flat<tstring>()(0);
 
-    OP_REQUIRES_OK(context, resource_->Init(service_url, topic));
+    const Tensor* batching_max_messages_tensor;
+    OP_REQUIRES_OK(context, context->input("batching_max_messages",
+                                           &batching_max_messages_tensor));
+    const int64 batching_max_messages =
+        batching_max_messages_tensor->scalar<int64>()();
+
+    const Tensor* batching_max_bytes_tensor;
+    OP_REQUIRES_OK(context, context->input("batching_max_bytes",
+                                           &batching_max_bytes_tensor));
+    const int64 batching_max_bytes =
+        batching_max_bytes_tensor->scalar<int64>()();
+
+    const Tensor* batching_max_delay_tensor;
+    OP_REQUIRES_OK(context, context->input("batching_max_delay",
+                                           &batching_max_delay_tensor));
+    const int64 batching_max_delay =
+        batching_max_delay_tensor->scalar<int64>()();
+
+    const Tensor* compression_tensor;
+    OP_REQUIRES_OK(context, context->input("compression", &compression_tensor));
+    const std::string compression = compression_tensor->flat<tstring>()(0);
+
+    const Tensor* max_pending_messages_tensor;
+    OP_REQUIRES_OK(context, context->input("max_pending_messages",
+                                           &max_pending_messages_tensor));
+    const int64 max_pending_messages =
+        max_pending_messages_tensor->scalar<int64>()();
+
+    OP_REQUIRES_OK(context,
+                   resource_->Init(service_url, topic, batching_max_messages,
+                                   batching_max_bytes, batching_max_delay,
+                                   compression, max_pending_messages));
   }
 
   Status CreateResource(PulsarWritableResource** resource)
       TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) override {
-    *resource = new PulsarWritableResource();
+    *resource = new PulsarWritableResource(env_);
     return Status::OK();
   }
 
  private:
   mutable mutex mu_;
+  Env* env_;
 };
 
 class PulsarWritableWriteOp : public OpKernel {
@@ -322,6 +583,34 @@ class PulsarWritableWriteOp : public OpKernel {
   }
 };
 
+class PulsarWritableWriteBatchOp : public OpKernel {
+ public:
+  explicit PulsarWritableWriteBatchOp(OpKernelConstruction* context)
+      : OpKernel(context) {}
+
+ private:
+  void Compute(OpKernelContext* context) override {
+    PulsarWritableResource* resource;
+
+    OP_REQUIRES_OK(context,
+                   GetResourceFromContext(context, "input", &resource));
+    core::ScopedUnref unref(resource);
+
+    const Tensor* value_tensor;
+    OP_REQUIRES_OK(context, context->input("value", &value_tensor));
+
+    const Tensor* key_tensor;
+    OP_REQUIRES_OK(context, context->input("key", &key_tensor));
+
+    OP_REQUIRES_OK(context,
+                   resource->WriteBatch(
+                       *value_tensor, *key_tensor, [&](Tensor** stats) {
+                         return context->allocate_output(
+                             0, TensorShape({kNumWriteStats}), stats);
+                       }));
+  }
+};
+
 class PulsarWritableFlushOp : public OpKernel {
  public:
   explicit PulsarWritableFlushOp(OpKernelConstruction* context)
@@ -347,6 +636,8 @@ REGISTER_KERNEL_BUILDER(Name("IO>PulsarWritableInit").Device(DEVICE_CPU),
                         PulsarWritableInitOp);
 REGISTER_KERNEL_BUILDER(Name("IO>PulsarWritableWrite").Device(DEVICE_CPU),
                         PulsarWritableWriteOp);
+REGISTER_KERNEL_BUILDER(Name("IO>PulsarWritableWriteBatch").Device(DEVICE_CPU),
+                        PulsarWritableWriteBatchOp);
 REGISTER_KERNEL_BUILDER(Name("IO>PulsarWritableFlush").Device(DEVICE_CPU),
                         PulsarWritableFlushOp);
 
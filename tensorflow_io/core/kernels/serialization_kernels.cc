@@ -21,11 +21,81 @@ limitations under the License.
 #include "rapidjson/document.h"
 #include "rapidjson/pointer.h"
 #include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 namespace data {
 namespace {
 
+// Rough cost (in cycles) of decoding or encoding one avro record, used to
+// decide how to shard a batch across the cpu worker threads.
+static const int64 kAvroRecordCost = 10000;
+
+// Compiled avro schemas keyed by their JSON string, as compiling the schema
+// costs much more than processing a single record and the schema input
+// usually stays the same across invocations.
+class AvroSchemaCache {
+ public:
+  Status Get(const string& schema,
+             std::shared_ptr<const avro::ValidSchema>* avro_schema) {
+    mutex_lock l(mu_);
+    auto lookup = cache_.find(schema);
+    if (lookup != cache_.end()) {
+      *avro_schema = lookup->second;
+      return Status::OK();
+    }
+    std::shared_ptr<avro::ValidSchema> compiled(new avro::ValidSchema());
+    std::istringstream ss(schema);
+    string error;
+    if (!avro::compileJsonSchema(ss, *compiled, error)) {
+      return errors::Unimplemented("Avro schema error: ", error);
+    }
+    if (cache_.size() >= kMaxCachedSchemas) {
+      cache_.clear();
+    }
+    cache_[schema] = compiled;
+    *avro_schema = compiled;
+    return Status::OK();
+  }
+
+ private:
+  static constexpr size_t kMaxCachedSchemas = 16;
+
+  mutex mu_;
+  std::unordered_map<string, std::shared_ptr<const avro::ValidSchema>> cache_
+      TF_GUARDED_BY(mu_);
+};
+
+// An avro output stream over a growable string buffer. The buffer is kept
+// between records so that encoding a batch does not allocate per record.
+class AvroStringOutputStream : public avro::OutputStream {
+ public:
+  AvroStringOutputStream() : size_(0) {}
+  virtual ~AvroStringOutputStream() {}
+
+  bool next(uint8_t** data, size_t* len) override {
+    if (size_ == buffer_.size()) {
+      buffer_.resize(buffer_.size() + kChunkSize);
+    }
+    *data = reinterpret_cast<uint8_t*>(&buffer_[size_]);
+    *len = buffer_.size() - size_;
+    size_ = buffer_.size();
+    return true;
+  }
+  void backup(size_t len) override { size_ -= len; }
+  uint64_t byteCount() const override { return size_; }
+  void flush() override {}
+
+  void Reset() { size_ = 0; }
+  StringPiece data() const { return StringPiece(buffer_.data(), size_); }
+
+ private:
+  static constexpr size_t kChunkSize = 4096;
+
+  string buffer_;
+  size_t size_;
+};
+
 class DecodeJSONOp : public OpKernel {
  public:
   explicit DecodeJSONOp(OpKernelConstruction* context) : OpKernel(context) {
@@ -167,7 +237,6 @@ class DecodeAvroOp : public OpKernel {
   }
 
   void Compute(OpKernelContext* context) override {
-    // TODO: support batch (1-D) input
     const Tensor* input_tensor;
     OP_REQUIRES_OK(context, context->input("input", &input_tensor));
 
@@ -191,27 +260,42 @@ class DecodeAvroOp : public OpKernel {
                                                        &value_tensor));
       values[names_tensor->flat<tstring>()(i)] = value_tensor;
     }
-    avro::ValidSchema avro_schema;
-    std::istringstream ss(schema);
-    string error;
-    OP_REQUIRES(context, (avro::compileJsonSchema(ss, avro_schema, error)),
-                errors::Unimplemented("Avro schema error: ", error));
-
-    for (int64 entry_index = 0; entry_index < context->input(0).NumElements();
-         entry_index++) {
-      avro::GenericDatum datum(avro_schema);
-      const string& entry = input_tensor->flat<tstring>()(entry_index);
-      std::unique_ptr<avro::InputStream> in =
-          avro::memoryInputStream((const uint8_t*)entry.data(), entry.size());
-
+    std::shared_ptr<const avro::ValidSchema> avro_schema;
+    OP_REQUIRES_OK(context, schema_cache_.Get(schema, &avro_schema));
+
+    // Each shard reuses one decoder and one datum for all of its records.
+    mutex status_mu;
+    Status status;
+    auto process_shard = [&](int64 start, int64 limit) {
+      avro::GenericDatum datum(*avro_schema);
       avro::DecoderPtr d = avro::binaryDecoder();
-      d->init(*in);
-      avro::decode(*d, datum);
-      OP_REQUIRES_OK(context, ProcessEntry(entry_index, values, "", datum));
-    }
+      for (int64 entry_index = start; entry_index < limit; entry_index++) {
+        const tstring& entry = input_tensor->flat<tstring>()(entry_index);
+        std::unique_ptr<avro::InputStream> in =
+            avro::memoryInputStream((const uint8_t*)entry.data(), entry.size());
+        Status s;
+        try {
+          d->init(*in);
+          avro::decode(*d, datum);
+          s = ProcessEntry(entry_index, values, "", datum);
+        } catch (avro::Exception& e) {
+          s = errors::InvalidArgument("unable to decode avro record at ",
+                                      entry_index, ": ", e.what());
+        }
+        if (!s.ok()) {
+          mutex_lock l(status_mu);
+          status.Update(s);
+          return;
+        }
+      }
+    };
+    auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers,
+          input_tensor->NumElements(), kAvroRecordCost, process_shard);
+    OP_REQUIRES_OK(context, status);
   }
   Status ProcessEntry(const int64 index,
-                      std::unordered_map<string, Tensor*>& values,
+                      const std::unordered_map<string, Tensor*>& values,
                       const string& name, const avro::GenericDatum& datum) {
     switch (datum.type()) {
       case avro::AVRO_BOOL:
@@ -237,7 +321,7 @@ class DecodeAvroOp : public OpKernel {
   }
 
   Status ProcessRecord(const int64 index,
-                       std::unordered_map<string, Tensor*>& values,
+                       const std::unordered_map<string, Tensor*>& values,
                        const string& name, const avro::GenericDatum& datum) {
     const avro::GenericRecord& record = datum.value<avro::GenericRecord>();
     for (size_t i = 0; i < record.fieldCount(); i++) {
@@ -248,7 +332,7 @@ class DecodeAvroOp : public OpKernel {
     return Status::OK();
   }
   Status ProcessPrimitive(const int64 index,
-                          std::unordered_map<string, Tensor*>& values,
+                          const std::unordered_map<string, Tensor*>& values,
                           const string& name, const avro::GenericDatum& datum) {
     std::unordered_map<string, Tensor*>::const_iterator lookup =
         values.find(name);
@@ -311,7 +395,7 @@ class DecodeAvroOp : public OpKernel {
     return Status::OK();
   }
   Status ProcessNull(const int64 index,
-                     std::unordered_map<string, Tensor*>& values,
+                     const std::unordered_map<string, Tensor*>& values,
                      const string& name, const avro::GenericDatum& datum) {
     std::unordered_map<string, Tensor*>::const_iterator lookup =
         values.find(name);
@@ -349,6 +433,7 @@ class DecodeAvroOp : public OpKernel {
   mutable mutex mu_;
   Env* env_ TF_GUARDED_BY(mu_);
   std::vector<TensorShape> shapes_ TF_GUARDED_BY(mu_);
+  AvroSchemaCache schema_cache_;
 };
 
 class EncodeAvroOp : public OpKernel {
@@ -388,29 +473,48 @@ class EncodeAvroOp : public OpKernel {
     OP_REQUIRES_OK(context, context->input("schema", &schema_tensor));
     const string& schema = schema_tensor->scalar<tstring>()();
 
-    avro::ValidSchema avro_schema;
-    std::istringstream ss(schema);
-    string error;
-    OP_REQUIRES(context, (avro::compileJsonSchema(ss, avro_schema, error)),
-                errors::Unimplemented("Avro schema error: ", error));
+    std::shared_ptr<const avro::ValidSchema> avro_schema;
+    OP_REQUIRES_OK(context, schema_cache_.Get(schema, &avro_schema));
 
     Tensor* value_tensor = nullptr;
     OP_REQUIRES_OK(context, context->allocate_output(
                                 0, context->input(0).shape(), &value_tensor));
-    for (int64 entry_index = 0; entry_index < context->input(0).NumElements();
-         entry_index++) {
-      std::ostringstream ss;
-      std::unique_ptr<avro::OutputStream> o = avro::ostreamOutputStream(ss);
-
-      avro::GenericDatum datum(avro_schema);
-      OP_REQUIRES_OK(context, ProcessEntry(entry_index, values, "", datum));
 
+    // Each shard reuses one encoder, one output buffer and one datum for all
+    // of its records.
+    mutex status_mu;
+    Status status;
+    auto process_shard = [&](int64 start, int64 limit) {
+      avro::GenericDatum datum(*avro_schema);
       avro::EncoderPtr e = avro::binaryEncoder();
-      e->init(*o);
-      avro::encode(*e, datum);
-      o->flush();
-      value_tensor->flat<tstring>()(entry_index) = ss.str();
-    }
+      AvroStringOutputStream o;
+      for (int64 entry_index = start; entry_index < limit; entry_index++) {
+        Status s = ProcessEntry(entry_index, values, "", datum);
+        if (s.ok()) {
+          try {
+            o.Reset();
+            e->init(o);
+            avro::encode(*e, datum);
+            e->flush();
+            StringPiece encoded = o.data();
+            value_tensor->flat<tstring>()(entry_index).assign(encoded.data(),
+                                                              encoded.size());
+          } catch (avro::Exception& ex) {
+            s = errors::InvalidArgument("unable to encode avro record at ",
+                                        entry_index, ": ", ex.what());
+          }
+        }
+        if (!s.ok()) {
+          mutex_lock l(status_mu);
+          status.Update(s);
+          return;
+        }
+      }
+    };
+    auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers,
+          context->input(0).NumElements(), kAvroRecordCost, process_shard);
+    OP_REQUIRES_OK(context, status);
   }
 
   Status ProcessEntry(const int64 index,
@@ -515,6 +619,7 @@ class EncodeAvroOp : public OpKernel {
  private:
   mutable mutex mu_;
   Env* env_ TF_GUARDED_BY(mu_);
+  AvroSchemaCache schema_cache_;
 };
 
 REGISTER_KERNEL_BUILDER(Name("IO>DecodeJSON").Device(DEVICE_CPU), DecodeJSONOp);
@@ -246,6 +246,25 @@ REGISTER_OP("IO>AvroDataset")
       return shape_inference::ScalarShape(c);
     });
 
+REGISTER_OP("IO>AvroDatasetOutput")
+    .Input("dataset: variant")
+    .Input("filename: string")
+    .Input("schema: string")
+    .Input("codec: string")
+    .Input("block_size: int64")
+    .Input("file_size: int64")
+    .Input("compression_threads: int64")
+    .Output("filenames: string")
+    .SetIsStateful()
+    .SetShapeFn([](shape_inference::InferenceContext* c) {
+      shape_inference::ShapeHandle unused;
+      for (int i = 1; i < 7; i++) {
+        TF_RETURN_IF_ERROR(c->WithRank(c->input(i), 0, &unused));
+      }
+      c->set_output(0, c->MakeShape({c->UnknownDim()}));
+      return Status::OK();
+    });
+
 REGISTER_OP("IO>ListAvroColumns")
     .Input("filename: string")
     .Input("schema: string")
@@ -272,6 +291,15 @@ REGISTER_OP("IO>ReadAvro")
       return Status::OK();
     });
 
+REGISTER_OP("IO>WriteAvroIndex")
+    .Input("filename: string")
+    .Input("index: string")
+    .Output("blocks: int64")
+    .SetShapeFn([](shape_inference::InferenceContext* c) {
+      c->set_output(0, c->Scalar());
+      return Status::OK();
+    });
+
 REGISTER_OP("IO>AvroReadableInit")
     .Input("input: string")
     .Input("metadata: string")
@@ -69,6 +69,18 @@ REGISTER_OP("IO>KafkaReadableSpec")
       return Status::OK();
     });
 
+REGISTER_OP("IO>KafkaReadableOffsetsForTimes")
+    .Input("input: resource")
+    .Input("partitions: int32")
+    .Input("timestamps: int64")
+    .Output("offsets: int64")
+    .SetShapeFn([](shape_inference::InferenceContext* c) {
+      shape_inference::ShapeHandle shape;
+      TF_RETURN_IF_ERROR(c->Merge(c->input(1), c->input(2), &shape));
+      c->set_output(0, shape);
+      return Status::OK();
+    });
+
 REGISTER_OP("IO>KafkaIterableInit")
     .Input("topic: string")
     .Input("partition: int32")
@@ -103,10 +115,21 @@ REGISTER_OP("IO>LayerKafkaSync")
     .Input("resource: resource")
     .SetShapeFn(shape_inference::ScalarShape);
 
+REGISTER_OP("IO>LayerKafkaMetrics")
+    .Input("resource: resource")
+    .Output("metrics: int64")
+    .SetIsStateful()
+    .SetShapeFn([](shape_inference::InferenceContext* c) {
+      c->set_output(0, c->Vector(3));
+      return Status::OK();
+    });
+
 REGISTER_OP("IO>KafkaGroupReadableInit")
     .Input("topics: string")
     .Input("metadata: string")
     .Output("resource: resource")
+    .Attr("parallel: bool = false")
+    .Attr("merge: {'arrival', 'round_robin'} = 'arrival'")
     .Attr("container: string = ''")
     .Attr("shared_name: string = ''")
     .SetShapeFn([](shape_inference::InferenceContext* c) {
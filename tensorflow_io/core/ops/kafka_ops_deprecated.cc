@@ -57,14 +57,29 @@ REGISTER_OP("IO>WriteKafka")
     .Input("topic: string")
     .Input("servers: string")
     .Output("content: string")
+    .Attr("config: list(string) = []")
+    .Attr("sync: bool = true")
+    .SetIsStateful()
     .SetShapeFn([](shape_inference::InferenceContext* c) {
       shape_inference::ShapeHandle unused;
-      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &unused));
       TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 0, &unused));
       TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 0, &unused));
-      c->set_output(0, c->Scalar());
+      c->set_output(0, c->input(0));
       return Status::OK();
-    });
+    })
+    .Doc(R"doc(
+Writes all messages of a string tensor to a Kafka topic.
+
+message: A `tf.string` tensor of any shape, each element is one message.
+topic: The topic in the format of topic:partition.
+servers: A list of bootstrap servers.
+config: Configuration properties in [Key=Value] format, topic properties
+  are prefixed with 'conf.topic.'. Calls with the same servers and config
+  share one producer.
+sync: If True (the default), wait until all pending messages are delivered
+  and report delivery errors. If False, messages are delivered in the
+  background and delivery errors are reported by a later call.
+)doc");
 
 REGISTER_OP("IO>KafkaEncodeAvro")
     .Input("input: dtype")
@@ -99,6 +114,30 @@ REGISTER_OP("IO>KafkaDecodeAvro")
       return Status::OK();
     });
 
+REGISTER_OP("IO>KafkaSchemaRegistryInit")
+    .Input("url: string")
+    .Input("metadata: string")
+    .Output("resource: resource")
+    .Attr("container: string = ''")
+    .Attr("shared_name: string = ''")
+    .SetShapeFn([](shape_inference::InferenceContext* c) {
+      c->set_output(0, c->Scalar());
+      return Status::OK();
+    });
+
+REGISTER_OP("IO>KafkaDecodeAvroWire")
+    .Input("input: string")
+    .Input("registry: resource")
+    .Output("value: dtype")
+    .Attr("schema: string")
+    .Attr("dtype: list({bool,float,double,int32,int64,string})")
+    .SetShapeFn([](shape_inference::InferenceContext* c) {
+      for (int64 i = 0; i < c->num_outputs(); i++) {
+        c->set_output(i, c->input(0));
+      }
+      return Status::OK();
+    });
+
 REGISTER_OP("IO>KafkaOutputSequence")
     .Input("topic: string")
     .Input("metadata: string")
@@ -126,4 +165,13 @@ REGISTER_OP("IO>KafkaOutputSequenceFlush")
     .SetIsStateful()
     .SetShapeFn(shape_inference::ScalarShape);
 
+REGISTER_OP("IO>KafkaOutputSequenceMetrics")
+    .Input("sequence: resource")
+    .Output("metrics: int64")
+    .SetIsStateful()
+    .SetShapeFn([](shape_inference::InferenceContext* c) {
+      c->set_output(0, c->Vector(3));
+      return Status::OK();
+    });
+
 }  // namespace tensorflow
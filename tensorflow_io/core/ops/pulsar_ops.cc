@@ -16,6 +16,7 @@ limitations under the License.
 #include "tensorflow/core/framework/common_shape_fns.h"
 #include "tensorflow/core/framework/op.h"
 #include "tensorflow/core/framework/shape_inference.h"
+#include "tensorflow_io/core/kernels/pulsar_kernel.h"
 
 namespace tensorflow {
 namespace io {
@@ -26,6 +27,8 @@ REGISTER_OP("IO>PulsarReadableInit")
     .Input("topic: string")
     .Input("subscription: string")
     .Input("ack_grouping_time: int64")
+    .Input("max_num_messages: int64")
+    .Input("max_num_bytes: int64")
     .Output("resource: resource")
     .Attr("container: string = ''")
     .Attr("shared_name: string = ''")
@@ -51,6 +54,11 @@ REGISTER_OP("IO>PulsarReadableNext")
 REGISTER_OP("IO>PulsarWritableInit")
     .Input("service_url: string")
     .Input("topic: string")
+    .Input("batching_max_messages: int64")
+    .Input("batching_max_bytes: int64")
+    .Input("batching_max_delay: int64")
+    .Input("compression: string")
+    .Input("max_pending_messages: int64")
     .Output("resource: resource")
     .Attr("container: string = ''")
     .Attr("shared_name: string = ''")
@@ -64,6 +72,16 @@ REGISTER_OP("IO>PulsarWritableWrite")
     .Input("value: string")
     .Input("key: string");
 
+REGISTER_OP("IO>PulsarWritableWriteBatch")
+    .Input("input: resource")
+    .Input("value: string")
+    .Input("key: string")
+    .Output("stats: int64")
+    .SetShapeFn([](shape_inference::InferenceContext* c) {
+      c->set_output(0, c->MakeShape({kNumWriteStats}));
+      return Status::OK();
+    });
+
 REGISTER_OP("IO>PulsarWritableFlush").Input("input: resource");
 
 }  // namespace
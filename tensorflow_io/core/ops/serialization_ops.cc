@@ -44,9 +44,9 @@ REGISTER_OP("IO>DecodeAvro")
     .Attr("shapes: list(shape)")
     .Attr("dtypes: list(type)")
     .SetShapeFn([](shape_inference::InferenceContext* c) {
-      // TODO: support batch (1-D) input
-      shape_inference::ShapeHandle unused;
-      TF_RETURN_IF_ERROR(c->WithRankAtMost(c->input(0), 0, &unused));
+      // Input is a scalar or a batch (1-D) of records
+      shape_inference::ShapeHandle input;
+      TF_RETURN_IF_ERROR(c->WithRankAtMost(c->input(0), 1, &input));
       std::vector<TensorShape> shapes;
       TF_RETURN_IF_ERROR(c->GetAttr("shapes", &shapes));
       if (shapes.size() != c->num_outputs()) {
@@ -58,6 +58,7 @@ REGISTER_OP("IO>DecodeAvro")
         shape_inference::ShapeHandle shape;
         TF_RETURN_IF_ERROR(
             c->MakeShapeFromPartialTensorShape(shapes[i], &shape));
+        TF_RETURN_IF_ERROR(c->Concatenate(input, shape, &shape));
         c->set_output(static_cast<int64>(i), shape);
       }
       return Status::OK();
@@ -18,6 +18,14 @@ from tensorflow_io.python.experimental.avro_record_dataset_ops import (  # pylin
     AvroRecordDataset,
 )
 
+from tensorflow_io.python.experimental.avro_dataset_output_ops import (  # pylint: disable=unused-import
+    write_avro_dataset,
+)
+
+from tensorflow_io.python.experimental.avro_index_ops import (  # pylint: disable=unused-import
+    write_avro_index,
+)
+
 from tensorflow_io.python.experimental.make_avro_record_dataset import (  # pylint: disable=unused-import
     make_avro_record_dataset,
 )
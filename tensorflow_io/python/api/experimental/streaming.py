@@ -26,3 +26,6 @@ from tensorflow_io.python.experimental.pulsar_dataset_ops import (  # pylint: di
 from tensorflow_io.python.experimental.pulsar_writer_ops import (  # pylint: disable=unused-import
     PulsarWriter,
 )
+from tensorflow_io.python.experimental.kafka_schema_registry_ops import (  # pylint: disable=unused-import
+    KafkaSchemaRegistry,
+)
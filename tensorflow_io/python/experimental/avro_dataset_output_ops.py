@@ -0,0 +1,66 @@
+# Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""avro_dataset_output_ops"""
+
+import tensorflow as tf
+from tensorflow_io.python.ops import core_ops
+
+_DEFAULT_BLOCK_SIZE_BYTES = 64 * 1024  # 64 KB
+_DEFAULT_COMPRESSION_THREADS = 4
+
+
+def write_avro_dataset(
+    dataset,
+    filename,
+    schema,
+    codec="null",
+    block_size=_DEFAULT_BLOCK_SIZE_BYTES,
+    file_size=0,
+    compression_threads=_DEFAULT_COMPRESSION_THREADS,
+    name=None,
+):
+    """Writes serialized avro records of a dataset into avro container files.
+
+    The records, e.g., produced by `tfio.experimental.serialization.encode_avro`
+    or read with `AvroRecordDataset`, are grouped into blocks that are
+    compressed on a background thread pool.
+
+    Args:
+      dataset: A `tf.data.Dataset` of scalar or 1-D `tf.string` elements, each
+        being one serialized avro record (without container framing).
+      filename: A string, the filename of the avro file to write.
+      schema: A string, the avro schema of the records.
+      codec: A string, one of `null`, `deflate`, `snappy` or `zstandard`.
+      block_size: The uncompressed size in bytes of a block.
+      file_size: If positive, a new file is started once the current file
+        exceeds this size in bytes. Files are then named with an index, e.g.,
+        `part.avro` becomes `part-00000.avro`, `part-00001.avro`, ...
+      compression_threads: The number of threads to compress blocks with,
+        0 compresses on the writing thread.
+      name: A name for the operation (optional).
+
+    Returns:
+      A 1-D `tf.string` tensor with the filenames written.
+    """
+    return core_ops.io_avro_dataset_output(
+        dataset._variant_tensor,  # pylint: disable=protected-access
+        filename=filename,
+        schema=schema,
+        codec=codec,
+        block_size=block_size,
+        file_size=file_size,
+        compression_threads=compression_threads,
+        name=name,
+    )
@@ -0,0 +1,37 @@
+# Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""avro_index_ops"""
+
+from tensorflow_io.python.ops import core_ops
+
+
+def write_avro_index(filename, index, name=None):
+    """Writes the sync-marker index of an avro container file.
+
+    The index holds the offset and the record count of every block, together
+    with the size and modification time of the file. Passing it as the
+    `index` argument of `IOTensor.from_avro` or `IODataset.from_avro` avoids
+    scanning the whole file for sync markers on open. An index that no longer
+    matches the file is rebuilt on open.
+
+    Args:
+      filename: A string, the filename of the avro file.
+      index: A string, the filename of the index to write.
+      name: A name for the operation (optional).
+
+    Returns:
+      A scalar `tf.int64` tensor with the number of blocks in the index.
+    """
+    return core_ops.io_write_avro_index(filename, index, name=name)
@@ -100,19 +100,22 @@ class IODataset(io_dataset.IODataset):
             return image_dataset_ops.TIFFIODataset(filename, internal=True)
 
     @classmethod
-    def from_kinesis(cls, stream, shard="", **kwargs):
+    def from_kinesis(cls, stream, shard="", parallel_shards=False, **kwargs):
         """Creates an `IODataset` from a Kinesis stream.
 
         Args:
           stream: A string, the stream name.
           shard: A string, the shard of kinesis.
+          parallel_shards: If True, read all shards of the stream in parallel.
           name: A name prefix for the IODataset (optional).
 
         Returns:
           A `IODataset`.
         """
         with tf.name_scope(kwargs.get("name", "IOFromKinesis")):
-            return kinesis_dataset_ops.KinesisIODataset(stream, shard, internal=True)
+            return kinesis_dataset_ops.KinesisIODataset(
+                stream, shard, parallel_shards=parallel_shards, internal=True
+            )
 
     @classmethod
     def from_numpy(cls, a, **kwargs):
@@ -306,13 +309,20 @@ class StreamIODataset(tf.data.Dataset):
             )
 
     @classmethod
-    def from_pubsub(cls, subscription, endpoint=None, timeout=10000, **kwargs):
+    def from_pubsub(
+        cls, subscription, endpoint=None, timeout=10000, streaming=False, **kwargs
+    ):
         """Creates an `StreamIODataset` from a pubsub endpoint.
 
         Args:
           subscription: A string, the subscription of the pubsub messages.
           endpoint: A string, the address of pubsub endpoint.
           timeout: An integer, the timeout of the pubsub pull.
+          streaming: A boolean, receive with a streaming pull in the background.
+          max_outstanding_messages: An integer, the maximum number of messages
+            buffered locally in streaming mode (optional).
+          max_outstanding_bytes: An integer, the maximum number of bytes
+            buffered locally in streaming mode (optional).
           name: A name prefix for the IODataset (optional).
 
         Returns:
@@ -320,7 +330,15 @@ class StreamIODataset(tf.data.Dataset):
         """
         with tf.name_scope(kwargs.get("name", "IOFromPubSub")):
             return pubsub_dataset_ops.PubSubStreamIODataset(
-                subscription, endpoint=endpoint, timeout=timeout, internal=True
+                subscription,
+                endpoint=endpoint,
+                timeout=timeout,
+                streaming=streaming,
+                max_outstanding_messages=kwargs.get("max_outstanding_messages", 1000),
+                max_outstanding_bytes=kwargs.get(
+                    "max_outstanding_bytes", 100 * 1024 * 1024
+                ),
+                internal=True,
             )
 
     @classmethod
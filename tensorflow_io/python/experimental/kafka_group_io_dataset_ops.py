@@ -108,6 +108,19 @@ class KafkaGroupIODataset(tf.data.Dataset):
     value comes in, where we can set the value to a very high timeout
     (i.e, block indefinitely) and keep on polling for new messages at
     `message_poll_timeout` intervals.
+
+    Topics with many partitions can be consumed with one fetcher thread per
+    assigned partition by setting `parallel_partitions=True`. The fetchers are
+    started and stopped as the consumer group rebalances, and the messages of
+    all partitions are merged either in arrival order or round-robin:
+
+    >>> dataset = tfio.experimental.streaming.KafkaGroupIODataset(
+                        topics=["topic1"],
+                        group_id="cg",
+                        servers="localhost:9092",
+                        parallel_partitions=True,
+                        partition_merge="round_robin",
+                    )
     """
 
     def __init__(
@@ -118,6 +131,8 @@ class KafkaGroupIODataset(tf.data.Dataset):
         stream_timeout=0,
         message_poll_timeout=10000,
         configuration=None,
+        parallel_partitions=False,
+        partition_merge="arrival",
         internal=True,
     ):
         """
@@ -145,6 +160,13 @@ class KafkaGroupIODataset(tf.data.Dataset):
               prefixed with `conf.topic.`. Examples include
               ["conf.topic.auto.offset.reset=earliest"]
             Reference: https://github.com/edenhill/librdkafka/blob/master/CONFIGURATION.md
+          parallel_partitions: An optional flag to fetch the messages of every
+            assigned partition on a separate thread. The batch size grows with
+            the lag of the assigned partitions up to 8 times `batch.num.messages`.
+            Default: False
+          partition_merge: The order in which the messages of the partitions
+            are merged when `parallel_partitions` is set, either "arrival" or
+            "round_robin". Default: "arrival"
           internal: Whether the dataset is being created from within the named scope.
             Default: True
         """
@@ -170,7 +192,10 @@ class KafkaGroupIODataset(tf.data.Dataset):
             if servers is not None:
                 metadata.append("bootstrap.servers=%s" % servers)
             resource = core_ops.io_kafka_group_readable_init(
-                topics=topics, metadata=metadata
+                topics=topics,
+                metadata=metadata,
+                parallel=parallel_partitions,
+                merge=partition_merge,
             )
 
             self._resource = resource
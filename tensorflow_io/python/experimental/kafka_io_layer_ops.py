@@ -25,7 +25,16 @@ class KafkaIOLayer(tf.keras.layers.Layer):
     # KafkaIOLayer
     # =============================================================================
     def __init__(self, topic, partition, servers, configurations):
-        """Obtain a Kafka IO layer to be used with tf.keras."""
+        """Obtain a Kafka IO layer to be used with tf.keras.
+
+        Messages are produced asynchronously, delivery reports are served in
+        the background. Producer batching is controlled through the
+        librdkafka configuration, e.g. `linger.ms`, `batch.size` and
+        `compression.codec`. In addition `conf.max.inflight.bytes` bounds the
+        bytes of undelivered messages (calls block once it is reached) and
+        `conf.flush.timeout.ms` sets the timeout of `sync` (-1 to wait until
+        all messages are delivered).
+        """
         metadata = list(configurations or [])
         if servers is not None:
             metadata.append("bootstrap.servers=%s" % servers)
@@ -35,6 +44,10 @@ class KafkaIOLayer(tf.keras.layers.Layer):
     def sync(self):
         core_ops.io_layer_kafka_sync(self._resource)
 
+    def metrics(self):
+        """Returns the number of delivered, failed and queued messages."""
+        return core_ops.io_layer_kafka_metrics(self._resource)
+
     def call(self, inputs):  # pylint: disable=arguments-differ
         content = tf.reshape(inputs, [tf.shape(inputs)[0], -1])
         if inputs.dtype != tf.string:
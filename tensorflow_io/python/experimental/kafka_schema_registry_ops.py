@@ -0,0 +1,78 @@
+# Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""KafkaSchemaRegistry"""
+
+import tensorflow as tf
+from tensorflow_io.python.ops import core_ops
+
+
+class KafkaSchemaRegistry:
+    """A client of a Confluent compatible schema registry.
+
+    The writer schemas are fetched from the registry on first use and cached
+    in-process, so that each schema id is only requested once.
+
+    >>> import tensorflow_io as tfio
+    >>> registry = tfio.experimental.streaming.KafkaSchemaRegistry(
+                        url="http://localhost:8081"
+                    )
+    >>> dataset = tfio.experimental.streaming.KafkaGroupIODataset(
+                        topics=["topic1"],
+                        group_id="cg",
+                        servers="localhost:9092",
+                    )
+    >>> dataset = dataset.batch(64).map(
+            lambda message, key: registry.decode_avro(
+                message, schema=schema, dtype=[tf.string, tf.int64]
+            )
+        )
+    """
+
+    def __init__(self, url, configuration=None):
+        """Creates a `KafkaSchemaRegistry`.
+
+        Args:
+          url: The base url of the schema registry.
+            For example: `http://localhost:8081`.
+          configuration: An optional list of HTTP headers sent with every
+            request, in [Name=Value] format.
+            For example: ["Authorization=Basic dXNlcjpwYXNz"]
+        """
+        with tf.name_scope("KafkaSchemaRegistry"):
+            self._resource = core_ops.io_kafka_schema_registry_init(
+                url, metadata=list(configuration or [])
+            )
+
+    def decode_avro(self, data, schema, dtype, name=None):
+        """Decode avro messages in the Confluent wire format.
+
+        Every message starts with a zero magic byte and the 4-byte big endian
+        id of its writer schema. The messages are decoded with their writer
+        schema and resolved against the reader `schema`, so that a batch may
+        mix messages of different schema versions.
+
+        Args:
+          data: A `tf.string` tensor of messages.
+          schema: The reader schema, an avro record in JSON format.
+          dtype: A list of dtypes, one for each field of the reader schema.
+          name: A name for the operation (optional).
+
+        Returns:
+          A list of tensors with the same shape as `data`, one for each
+          field of the reader schema.
+        """
+        return core_ops.io_kafka_decode_avro_wire(
+            data, self._resource, schema=schema, dtype=dtype, name=name
+        )
@@ -45,20 +45,34 @@ class KinesisIODataset(tf.data.Dataset):
     is `True`, then `KinesisIODataset` will keep retrying to retrieve data
     from the stream. If `read_indefinitely` is `False`, an `OutOfRangeError`
     is returned immediately instead.
+
+    Records are fetched in batches of up to `limit` records per GetRecords
+    call. With `parallel_shards=True` all shards of the stream are fetched
+    concurrently; records of one shard keep their order while records of
+    different shards interleave. Each shard is polled at most 5 times per
+    second to stay within the Kinesis throughput limits.
     """
 
-    def __init__(self, stream, shard="", internal=False):
+    def __init__(
+        self, stream, shard="", parallel_shards=False, limit=10000, internal=False
+    ):
         """Create a KinesisIODataset.
 
         Args:
           stream: A `tf.string` tensor containing the name of the stream.
           shard: A `tf.string` tensor containing the id of the shard.
+          parallel_shards: If True, read all shards of the stream in parallel,
+            `shard` is ignored.
+          limit: The maximum number of records per GetRecords call.
         """
         with tf.name_scope("KinesisIODataset"):
             assert internal
 
             metadata = []
             metadata.append("shard=%s" % shard)
+            metadata.append("limit=%d" % limit)
+            if parallel_shards:
+                metadata.append("parallel=true")
             resource = core_ops.io_kinesis_readable_init(stream, metadata)
 
             self._resource = resource
@@ -21,8 +21,23 @@ from tensorflow_io.python.ops import core_ops
 class PubSubStreamIODataset(tf.data.Dataset):
     """PubSubStreamGraphIODataset"""
 
-    def __init__(self, subscription, endpoint=None, timeout=10000, internal=True):
-        """PubSubStreamIODataset."""
+    def __init__(
+        self,
+        subscription,
+        endpoint=None,
+        timeout=10000,
+        streaming=False,
+        max_outstanding_messages=1000,
+        max_outstanding_bytes=100 * 1024 * 1024,
+        internal=True,
+    ):
+        """PubSubStreamIODataset.
+
+        With `streaming=True` messages are received on a streaming pull kept
+        open in the background, up to `max_outstanding_messages` messages and
+        `max_outstanding_bytes` bytes are buffered locally. Otherwise each
+        read issues one unary pull.
+        """
         with tf.name_scope("PubSubStreamIODataset"):
             assert internal
 
@@ -30,6 +45,12 @@ class PubSubStreamIODataset(tf.data.Dataset):
             if endpoint is not None:
                 metadata.append("endpoint=%s" % endpoint)
             metadata.append("timeout=%d" % timeout)
+            if streaming:
+                metadata.append("streaming=true")
+                metadata.append(
+                    "max_outstanding_messages=%d" % max_outstanding_messages
+                )
+                metadata.append("max_outstanding_bytes=%d" % max_outstanding_bytes)
             resource = core_ops.io_pub_sub_readable_init(subscription, metadata)
 
             self._resource = resource
@@ -29,13 +29,17 @@ class PulsarIODataset(tf.data.Dataset):
         timeout,
         ack_grouping_time=-1,
         poll_timeout=100,
+        max_num_messages=1024,
+        max_num_bytes=10 * 1024 * 1024,
     ):
         """Creates a `PulsarIODataset` from pulsar server with a subscription
 
         Args:
           service_url: A `tf.string` tensor containing the service url of pulsar broker.
             For example: "pulsar://localhost:6650".
-          topic: A `tf.string` tensor containing the topic name.
+          topic: A `tf.string` tensor containing the topic name, or a list of topic
+            names. Multiple topics and the partitions of a partitioned topic are
+            consumed concurrently, the order is only kept within a partition.
           subscription: A `tf.string` tensor containing the subscription name.
           ack_grouping_time: A `tf.int64` tensor containing the ack grouping time.
             If it's non-negative, each time a message was received, the consumer would add it to
@@ -51,6 +55,11 @@ class PulsarIODataset(tf.data.Dataset):
             message was received, it would try again until `timeout` exceeds.
             `poll_timeout` must be positive and not larger than `timeout`.
             Default: 100
+          max_num_messages: The maximum number of messages received in one batch.
+            Default: 1024
+          max_num_bytes: The maximum number of bytes received in one batch, a batch
+            is closed once this size is reached.
+            Default: 10MB
         """
         with tf.name_scope("PulsarIODataset"):
             if timeout <= 0:
@@ -68,8 +77,23 @@ class PulsarIODataset(tf.data.Dataset):
                     )
                 )
 
+            if max_num_messages <= 0:
+                raise ValueError(
+                    f"Invalid max_num_messages value: {max_num_messages}, must be > 0"
+                )
+
+            if max_num_bytes <= 0:
+                raise ValueError(
+                    f"Invalid max_num_bytes value: {max_num_bytes}, must be > 0"
+                )
+
             resource = core_ops.io_pulsar_readable_init(
-                service_url, topic, subscription, ack_grouping_time
+                service_url,
+                topic,
+                subscription,
+                ack_grouping_time,
+                max_num_messages,
+                max_num_bytes,
             )
             self._resource = resource
             dataset = tf.data.experimental.Counter()
@@ -21,16 +21,44 @@ from tensorflow_io.python.ops import core_ops
 class PulsarWriter:
     """PulsarWriter"""
 
-    def __init__(self, service_url, topic):
+    def __init__(
+        self,
+        service_url,
+        topic,
+        batching_max_messages=1000,
+        batching_max_bytes=128 * 1024,
+        batching_max_delay=10,
+        compression="none",
+        max_pending_messages=10000,
+    ):
         """Creates a `PulsarWriter` for writing messages to a pulsar topic
 
         Args:
           service_url: A `tf.string` tensor containing the service url of pulsar broker.
             For example: "pulsar://localhost:6650".
           topic: A `tf.string` tensor containing the topic name.
+          batching_max_messages: The maximum number of messages in one batch
+            published by the producer, batching is disabled if it is not
+            larger than 1. Default: 1000
+          batching_max_bytes: The maximum size in bytes of one batch.
+            Default: 128KB
+          batching_max_delay: The maximum delay in milliseconds before a batch
+            is published. Default: 10
+          compression: The compression of batches, one of "none", "lz4",
+            "zlib", "zstd" and "snappy". Default: "none"
+          max_pending_messages: The maximum number of messages waiting for their
+            receipt, writes block once it is reached. Default: 10000
         """
         with tf.name_scope("PulsarWriter"):
-            resource = core_ops.io_pulsar_writable_init(service_url, topic)
+            resource = core_ops.io_pulsar_writable_init(
+                service_url,
+                topic,
+                batching_max_messages,
+                batching_max_bytes,
+                batching_max_delay,
+                compression,
+                max_pending_messages,
+            )
             self._resource = resource
 
     def write(self, value, key=""):
@@ -43,6 +71,24 @@ class PulsarWriter:
         """
         return core_ops.io_pulsar_writable_write(self._resource, value, key)
 
+    def write_batch(self, value, key=None):
+        """Write all messages of a tensor to pulsar topic asynchronously
+
+        Args:
+          value: A 1-D `tf.string` tensor containing the values of messages
+          key: An optional 1-D `tf.string` tensor containing the keys of messages,
+            with the same size as `value`.
+
+        Returns:
+          A `tf.int64` tensor of shape [6] with the number of sent and failed
+            messages, the number of pending messages and bytes, and the mean and
+            max send latency in microseconds. Sent, failed and latencies cover the
+            messages completed since the previous `write_batch`.
+        """
+        if key is None:
+            key = tf.constant([], tf.string)
+        return core_ops.io_pulsar_writable_write_batch(self._resource, value, key)
+
     def flush(self):
         """Flush the queued messages, it will wait async write operations completed."""
         return core_ops.io_pulsar_writable_flush(self._resource)
@@ -130,14 +130,14 @@ def decode_avro(data, schema, name=None):
     Decode Avro string into Tensors.
 
     Args:
-        data: A String Tensor. The Avro strings to decode.
+        data: A String Tensor. The Avro strings to decode, either a scalar
+          or a batch (1-D) of records.
         schema: A string of the Avro schema.
         name: A name for the operation (optional).
 
     Returns:
         A structured Tensors.
     """
-    # TODO: Use resource to reuse schema initialization
     specs = process_entry(
         json.loads(schema.decode() if isinstance(schema, bytes) else schema), ""
     )
@@ -163,7 +163,6 @@ def encode_avro(data, schema, name=None):
     Returns:
         An Avro-encoded string Tensor.
     """
-    # TODO: Use resource to reuse schema initialization
     specs = process_entry(
         json.loads(schema.decode() if isinstance(schema, bytes) else schema), ""
     )
@@ -43,7 +43,7 @@ class _AvroIODatasetFunction:
 class AvroIODataset(tf.compat.v2.data.Dataset):
     """AvroIODataset"""
 
-    def __init__(self, filename, schema, columns=None, internal=True):
+    def __init__(self, filename, schema, columns=None, index=None, internal=True):
         """AvroIODataset."""
         if not internal:
             raise ValueError(
@@ -55,6 +55,8 @@ class AvroIODataset(tf.compat.v2.data.Dataset):
             capacity = 4096
 
             metadata = ["schema: %s" % schema]
+            if index is not None:
+                metadata.append("index: %s" % index)
             resource, columns_v = core_ops.io_avro_readable_init(
                 filename,
                 metadata=metadata,
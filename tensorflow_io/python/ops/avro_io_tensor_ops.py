@@ -27,9 +27,11 @@ class AvroIOTensor(io_tensor_ops._TableIOTensor):  # pylint: disable=protected-a
     # =============================================================================
     # Constructor (private)
     # =============================================================================
-    def __init__(self, filename, schema, internal=False):
+    def __init__(self, filename, schema, index=None, internal=False):
         with tf.name_scope("AvroIOTensor") as scope:
             metadata = ["schema: %s" % schema]
+            if index is not None:
+                metadata.append("index: %s" % index)
             resource, columns = core_ops.io_avro_readable_init(
                 filename,
                 metadata=metadata,
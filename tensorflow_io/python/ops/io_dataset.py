@@ -126,6 +126,8 @@ class IODataset(io_dataset_ops._IODataset):  # pylint: disable=protected-access
         stop=-1,
         servers=None,
         configuration=None,
+        start_time=None,
+        stop_time=None,
         **kwargs
     ):
         """Creates an `IODataset` from kafka server with an offset range.
@@ -148,6 +150,12 @@ class IODataset(io_dataset_ops._IODataset):  # pylint: disable=protected-access
               prefixed with `conf.topic.`. Examples include
               ["conf.topic.auto.offset.reset=earliest"]
             Reference: https://github.com/edenhill/librdkafka/blob/master/CONFIGURATION.md
+          start_time: An optional timestamp in milliseconds since epoch, the
+            dataset starts at the first message at or after this time and
+            `start` is ignored.
+          stop_time: An optional timestamp in milliseconds since epoch, the
+            dataset stops before the first message at or after this time and
+            `stop` is ignored.
           name: A name prefix for the IODataset (optional).
 
         Returns:
@@ -162,6 +170,8 @@ class IODataset(io_dataset_ops._IODataset):  # pylint: disable=protected-access
                 stop=stop,
                 servers=servers,
                 configuration=configuration,
+                start_time=start_time,
+                stop_time=stop_time,
                 internal=True,
             )
 
@@ -211,6 +221,9 @@ class IODataset(io_dataset_ops._IODataset):  # pylint: disable=protected-access
           filename: A string, the filename of a avro file.
           schema: A string, the schema of a avro file.
           columns: A list of column names within avro file.
+          index: A string, the filename of a sidecar sync-marker index
+            (optional). The index is created on first open if missing or
+            stale, and reused on subsequent opens.
           name: A name prefix for the IOTensor (optional).
 
         Returns:
@@ -219,7 +232,11 @@ class IODataset(io_dataset_ops._IODataset):  # pylint: disable=protected-access
         """
         with tf.name_scope(kwargs.get("name", "IOFromAvro")):
             return avro_dataset_ops.AvroIODataset(
-                filename, schema, columns=columns, internal=True
+                filename,
+                schema,
+                columns=columns,
+                index=kwargs.get("index", None),
+                internal=True,
             )
 
     @classmethod
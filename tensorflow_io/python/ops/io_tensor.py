@@ -399,6 +399,9 @@ class IOTensor(io_tensor_ops._IOTensor):  # pylint: disable=protected-access
         Args:
           filename: A string, the filename of an avro file.
           schema: A string, the schema of an avro file.
+          index: A string, the filename of a sidecar sync-marker index
+            (optional). The index is created on first open if missing or
+            stale, and reused on subsequent opens.
           name: A name prefix for the IOTensor (optional).
 
         Returns:
@@ -22,7 +22,16 @@ class KafkaIODataset(tf.data.Dataset):
     """KafkaIODataset"""
 
     def __init__(
-        self, topic, partition, start, stop, servers, configuration, internal=True
+        self,
+        topic,
+        partition,
+        start,
+        stop,
+        servers,
+        configuration,
+        start_time=None,
+        stop_time=None,
+        internal=True,
     ):
         """Creates a `KafkaIODataset` from kafka server with an offset range.
 
@@ -43,6 +52,12 @@ class KafkaIODataset(tf.data.Dataset):
               prefixed with `conf.topic.`. Examples include
               ["conf.topic.auto.offset.reset=earliest"]
             Reference: https://github.com/edenhill/librdkafka/blob/master/CONFIGURATION.md
+          start_time: An optional `tf.int64` timestamp in milliseconds since
+            epoch. If set, `start` is replaced by the offset of the first
+            message at or after this time.
+          stop_time: An optional `tf.int64` timestamp in milliseconds since
+            epoch. If set, `stop` is replaced by the offset of the first
+            message at or after this time.
           internal: Whether the dataset is being created from within the named scope.
             Default: True
         """
@@ -55,6 +70,20 @@ class KafkaIODataset(tf.data.Dataset):
             resource = core_ops.io_kafka_readable_init(
                 topic, partition, offset=0, metadata=metadata
             )
+            # Both timestamps are resolved with one op. Kafka accepts a single
+            # timestamp per partition in an offsets query, so the two bounds
+            # of the partition take two round trips.
+            timestamps = [t for t in (start_time, stop_time) if t is not None]
+            if timestamps:
+                offsets = core_ops.io_kafka_readable_offsets_for_times(
+                    resource,
+                    partitions=[partition] * len(timestamps),
+                    timestamps=timestamps,
+                )
+                if start_time is not None:
+                    start = offsets[0]
+                if stop_time is not None:
+                    stop = offsets[-1]
             start, stop = core_ops.io_kafka_readable_spec(resource, start, stop)
 
             self._resource = resource
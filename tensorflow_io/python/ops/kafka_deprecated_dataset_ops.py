@@ -162,7 +162,12 @@ class KafkaOutputSequence:
                             eg. ["enable.auto.commit=false",
                                 "heartbeat.interval.ms=2000"],
                             please refer to 'Global configuration properties'
-                            in librdkafka doc.
+                            in librdkafka doc. Messages are produced
+                            asynchronously, producer batching is controlled
+                            by e.g. `linger.ms`, `batch.size` and
+                            `compression.codec`. `conf.max.inflight.bytes`
+                            bounds the bytes of undelivered messages and
+                            `conf.flush.timeout.ms` sets the timeout of flush.
         """
         self._topic = topic
         metadata = list(configuration or [])
@@ -186,20 +191,41 @@ class KafkaOutputSequence:
         """Flush the `KafkaOutputSequence`."""
         core_ops.io_kafka_output_sequence_flush(self._resource)
 
+    def metrics(self):
+        """Returns the number of delivered, failed and queued messages."""
+        return core_ops.io_kafka_output_sequence_metrics(self._resource)
+
 
-def write_kafka(message, topic, servers="localhost", name=None):
+def write_kafka(
+    message, topic, servers="localhost", configuration=None, sync=True, name=None
+):
     """Write messages to the kafka topic
 
+    Calls with the same servers and configuration share one producer. By
+    default a call waits until all pending messages of the producer are
+    delivered. Pass `sync=False` to deliver messages asynchronously, in which
+    case delivery errors are reported by a later call.
+
     Args:
         message: The `tf.string` tensor containing the message
-            to be written into the topic.
+            to be written into the topic. Every element of a non-scalar
+            tensor is written as a separate message.
         topic: A `tf.string` tensor containing one subscription,
             in the format of topic:partition.
         servers: A list of bootstrap servers.
+        configuration: A list of `Key=Value` producer configuration
+            properties, topic properties are prefixed with `conf.topic.`.
+        sync: If True (the default), flush all pending messages before
+            returning. If False, return once the messages are queued.
         name: A name for the operation (optional).
     Returns:
-        A `Tensor` of type `string`. 0-D.
+        A `Tensor` of type `string` with the same shape as `message`.
     """
     return core_ops.io_write_kafka(
-        message=message, topic=topic, servers=servers, name=name
+        message=message,
+        topic=topic,
+        servers=servers,
+        config=configuration or [],
+        sync=sync,
+        name=name,
     )
@@ -16,6 +16,9 @@ limitations under the License.
 #include <stdlib.h>
 #include <string.h>
 
+#include <atomic>
+#include <future>
+
 #include "absl/strings/numbers.h"
 #include "absl/strings/str_cat.h"
 #include "absl/types/variant.h"
@@ -48,6 +51,10 @@ constexpr size_t kDefaultMaxCacheSize = 0;
 // will be evicted on the next read.
 constexpr char kMaxStaleness[] = "GCS_READ_CACHE_MAX_STALENESS";
 constexpr uint64_t kDefaultMaxStaleness = 0;
+// The environment variable that overrides the number of blocks prefetched into
+// the cache after a sequential read of a file, 0 disables prefetching.
+constexpr char kReadAheadBlocks[] = "GCS_READ_CACHE_READ_AHEAD_BLOCKS";
+constexpr size_t kDefaultReadAheadBlocks = 1;
 
 constexpr char kStatCacheMaxAge[] = "GCS_STAT_CACHE_MAX_AGE";
 constexpr uint64_t kStatCacheDefaultMaxAge = 5;
@@ -65,6 +72,19 @@ constexpr char kAppendMode[] = "GCS_APPEND_MODE";
 // objects.
 constexpr char kComposeAppend[] = "compose";
 
+// The environment variable that sets the size (in MB) from which the data of a
+// writable file is uploaded in parallel, as temporary component objects that
+// are composed into the object and deleted. 0, the default, disables parallel
+// composite uploads. Can also be changed with `SetConfiguration`.
+constexpr char kParallelUploadThreshold[] = "GCS_PARALLEL_UPLOAD_THRESHOLD_MB";
+constexpr uint64_t kDefaultParallelUploadThreshold = 0;
+// The environment variable that overrides the number of components of a
+// parallel composite upload.
+constexpr char kParallelUploadParts[] = "GCS_PARALLEL_UPLOAD_PARTS";
+constexpr size_t kDefaultParallelUploadParts = 8;
+// A compose request takes at most 32 source objects.
+constexpr size_t kMaxComposeSources = 32;
+
 // We can cast `google::cloud::StatusCode` to `TF_Code` because they have the
 // same integer values. See
 // https://github.com/googleapis/google-cloud-cpp/blob/6c09cbfa0160bc046e5509b4dd2ab4b872648b4a/google/cloud/status.h#L32-L52
@@ -209,18 +229,124 @@ typedef struct GCSWritableFile {
   // `offset` tells us how many bytes of this file are already uploaded to
   // server. If `offset == -1`, we always upload the entire temporary file.
   int64_t offset;
+  // Temporary files of at least `parallel_upload_threshold` bytes are uploaded
+  // as `parallel_upload_parts` components, 0 disables parallel uploads.
+  uint64_t parallel_upload_threshold;
+  size_t parallel_upload_parts;
 } GCSWritableFile;
 
+// Deletes the temporary component objects of a parallel upload. Failures are
+// only logged, the components do not affect the uploaded object.
+static void DeleteComponents(const std::string& bucket,
+                             const std::vector<std::string>& components,
+                             gcs::Client* gcs_client) {
+  std::vector<std::future<google::cloud::Status>> deletes;
+  for (const auto& component : components) {
+    deletes.emplace_back(
+        std::async(std::launch::async, [gcs_client, &bucket, &component]() {
+          return gcs_client->DeleteObject(bucket, component);
+        }));
+  }
+  for (size_t i = 0; i < deletes.size(); ++i) {
+    auto delete_status = deletes[i].get();
+    if (!delete_status.ok() &&
+        delete_status.code() != google::cloud::StatusCode::kNotFound) {
+      TF_VLog(1, "Could not delete temporary object gs://%s/%s: %s",
+              bucket.c_str(), components[i].c_str(),
+              delete_status.message().c_str());
+    }
+  }
+}
+
+// Uploads the `size` bytes of `file_name` as `num_parts` temporary component
+// objects in parallel. The names of all components, including the ones that
+// failed, are appended to `components` so that the caller can delete them.
+static void UploadComponents(const std::string& file_name, uint64_t size,
+                             const std::string& bucket, size_t num_parts,
+                             gcs::Client* gcs_client,
+                             std::vector<std::string>* components,
+                             TF_Status* status) {
+  const std::string prefix =
+      gcs::CreateRandomPrefixName("tf_writable_file_gcs") + "_";
+  uint64_t part_size = (size + num_parts - 1) / num_parts;
+  components->reserve(components->size() + num_parts);
+  std::vector<std::future<google::cloud::Status>> uploads;
+  for (uint64_t offset = 0; offset < size; offset += part_size) {
+    components->emplace_back(absl::StrCat(prefix, uploads.size()));
+    const std::string& component = components->back();
+    uint64_t length = (std::min)(part_size, size - offset);
+    TF_VLog(3, "UploadComponent: gs://%s/%s bytes [%u, %u)", bucket.c_str(),
+            component.c_str(), offset, offset + length);
+    uploads.emplace_back(std::async(
+        std::launch::async,
+        [gcs_client, &file_name, &bucket, component, offset, length]() {
+          auto metadata = gcs_client->UploadFile(
+              file_name, bucket, component, gcs::UploadFromOffset(offset),
+              gcs::UploadLimit(length), gcs::Fields(""));
+          return metadata.status();
+        }));
+  }
+  TF_SetStatus(status, TF_OK, "");
+  for (auto& upload : uploads) {
+    auto upload_status = upload.get();
+    if (!upload_status.ok() && TF_GetCode(status) == TF_OK) {
+      TF_SetStatusFromGCSStatus(upload_status, status);
+    }
+  }
+}
+
+// Uploads the temporary file as components in parallel and composes them,
+// after `object` if it is not empty, into `destination`.
+static google::cloud::StatusOr<gcs::ObjectMetadata> ParallelCompositeUpload(
+    const std::string& file_name, uint64_t size, const std::string& bucket,
+    const std::string& object, const std::string& destination,
+    size_t num_parts, gcs::Client* gcs_client, TF_Status* status) {
+  std::vector<std::string> components;
+  UploadComponents(file_name, size, bucket, num_parts, gcs_client, &components,
+                   status);
+  google::cloud::StatusOr<gcs::ObjectMetadata> metadata;
+  if (TF_GetCode(status) == TF_OK) {
+    std::vector<gcs::ComposeSourceObject> source_objects;
+    if (!object.empty()) source_objects.push_back({object, {}, {}});
+    for (const auto& component : components) {
+      source_objects.push_back({component, {}, {}});
+    }
+    TF_VLog(3, "ComposeObject: %u components to gs://%s/%s",
+            components.size(), bucket.c_str(), destination.c_str());
+    metadata = gcs_client->ComposeObject(bucket, source_objects, destination,
+                                         gcs::Fields("size"));
+  }
+  DeleteComponents(bucket, components, gcs_client);
+  return metadata;
+}
+
 static void SyncImpl(const std::string& bucket, const std::string& object,
                      int64_t* offset, TempFile* outfile,
-                     gcs::Client* gcs_client, TF_Status* status) {
+                     gcs::Client* gcs_client,
+                     uint64_t parallel_upload_threshold,
+                     size_t parallel_upload_parts, TF_Status* status) {
   outfile->flush();
+  // The size of the data that is not uploaded yet.
+  int64_t size = static_cast<int64_t>(outfile->tellp());
+  bool parallel_upload = parallel_upload_threshold > 0 &&
+                         parallel_upload_parts > 1 && size > 0 &&
+                         static_cast<uint64_t>(size) >=
+                             parallel_upload_threshold;
   // `*offset == 0` means this file does not exist on the server.
   if (*offset == -1 || *offset == 0) {
-    // UploadFile will automatically switch to resumable upload based on Client
-    // configuration.
-    auto metadata = gcs_client->UploadFile(outfile->getName(), bucket, object,
-                                           gcs::Fields("size"));
+    google::cloud::StatusOr<gcs::ObjectMetadata> metadata;
+    if (parallel_upload) {
+      metadata = ParallelCompositeUpload(
+          outfile->getName(), size, bucket, "", object,
+          (std::min)(parallel_upload_parts, kMaxComposeSources), gcs_client,
+          status);
+      if (TF_GetCode(status) != TF_OK) return;
+    } else {
+      // UploadFile will automatically switch to resumable upload based on
+      // Client configuration.
+      metadata = gcs_client->UploadFile(outfile->getName(), bucket, object,
+                                        gcs::Fields("size"));
+    }
     if (!metadata) {
       TF_SetStatusFromGCSStatus(metadata.status(), status);
       return;
@@ -236,6 +362,25 @@ static void SyncImpl(const std::string& bucket, const std::string& object,
     outfile->clear();
     outfile->seekp(0, std::ios::end);
     TF_SetStatus(status, TF_OK, "");
+  } else if (parallel_upload) {
+    // The existing object is the first source of the compose request.
+    auto metadata = ParallelCompositeUpload(
+        outfile->getName(), size, bucket, object, object,
+        (std::min)(parallel_upload_parts, kMaxComposeSources - 1), gcs_client,
+        status);
+    if (TF_GetCode(status) != TF_OK) return;
+    if (!metadata) {
+      TF_SetStatusFromGCSStatus(metadata.status(), status);
+      return;
+    }
+    // We truncate the data that are already uploaded.
+    if (!outfile->truncate()) {
+      TF_SetStatus(status, TF_INTERNAL,
+                   "Could not truncate internal temporary file.");
+      return;
+    }
+    *offset = static_cast<int64_t>(metadata->size());
+    TF_SetStatus(status, TF_OK, "");
   } else {
     std::string temporary_object =
         gcs::CreateRandomPrefixName("tf_writable_file_gcs");
@@ -320,7 +465,9 @@ void Flush(const TF_WritableFile* file, TF_Status* status) {
       return;
     }
     SyncImpl(gcs_file->bucket, gcs_file->object, &gcs_file->offset,
-             &gcs_file->outfile, gcs_file->gcs_client, status);
+             &gcs_file->outfile, gcs_file->gcs_client,
+             gcs_file->parallel_upload_threshold,
+             gcs_file->parallel_upload_parts, status);
     TF_VLog(3, "Flush finished: gs://%s/%s", gcs_file->bucket.c_str(),
             gcs_file->object.c_str());
     if (TF_GetCode(status) != TF_OK) return;
@@ -392,6 +539,9 @@ typedef struct GCSFileSystemImplementation {
   uint64_t block_size;  // Reads smaller than block_size will trigger a read
                         // of block_size.
   std::unique_ptr<ExpiringLRUCache<GcsFileSystemStat>> stat_cache;
+  // The parallel composite upload settings of new writable files.
+  std::atomic<uint64_t> parallel_upload_threshold;
+  std::atomic<size_t> parallel_upload_parts;
   GCSFileSystemImplementation(google::cloud::storage::Client&& gcs_client);
   // This constructor is used for testing purpose only.
   GCSFileSystemImplementation(google::cloud::storage::Client&& gcs_client,
@@ -485,7 +635,10 @@ static int64_t LoadBufferFromGCS(
 // https://github.com/googleapis/google-cloud-cpp/issues/4482 is done.
 GCSFileSystemImplementation::GCSFileSystemImplementation(
     google::cloud::storage::Client&& gcs_client)
-    : gcs_client(gcs_client), block_cache_lock() {
+    : gcs_client(gcs_client),
+      block_cache_lock(),
+      parallel_upload_threshold(kDefaultParallelUploadThreshold),
+      parallel_upload_parts(kDefaultParallelUploadParts) {
   const char* append_mode = std::getenv(kAppendMode);
   compose = (append_mode != nullptr) && (!strcmp(kComposeAppend, append_mode));
 
@@ -493,9 +646,10 @@ GCSFileSystemImplementation::GCSFileSystemImplementation(
   block_size = kDefaultBlockSize;
   size_t max_bytes = kDefaultMaxCacheSize;
   uint64_t max_staleness = kDefaultMaxStaleness;
+  size_t read_ahead_blocks = kDefaultReadAheadBlocks;
 
-  // Apply the overrides for the block size (MB), max bytes (MB), and max
-  // staleness (seconds) if provided.
+  // Apply the overrides for the block size (MB), max bytes (MB), max
+  // staleness (seconds) and read-ahead (blocks) if provided.
   if (absl::SimpleAtoi(std::getenv(kBlockSize), &value)) {
     block_size = value * 1024 * 1024;
   }
@@ -505,8 +659,13 @@ GCSFileSystemImplementation::GCSFileSystemImplementation(
   if (absl::SimpleAtoi(std::getenv(kMaxStaleness), &value)) {
     max_staleness = value;
   }
-  TF_VLog(1, "GCS cache max size = %u ; block size = %u ; max staleness = %u",
-          max_bytes, block_size, max_staleness);
+  if (absl::SimpleAtoi(std::getenv(kReadAheadBlocks), &value)) {
+    read_ahead_blocks = static_cast<size_t>(value);
+  }
+  TF_VLog(1,
+          "GCS cache max size = %u ; block size = %u ; max staleness = %u ; "
+          "read ahead blocks = %u",
+          max_bytes, block_size, max_staleness, read_ahead_blocks);
 
   file_block_cache = std::make_unique<RamFileBlockCache>(
       block_size, max_bytes, max_staleness,
@@ -514,7 +673,8 @@ GCSFileSystemImplementation::GCSFileSystemImplementation(
              char* buffer, TF_Status* status) {
         return LoadBufferFromGCS(filename, offset, buffer_size, buffer, this,
                                  status);
-      });
+      },
+      read_ahead_blocks);
 
   uint64_t stat_cache_max_age = kStatCacheDefaultMaxAge;
   size_t stat_cache_max_entries = kStatCacheDefaultMaxEntries;
@@ -526,6 +686,13 @@ GCSFileSystemImplementation::GCSFileSystemImplementation(
   }
   stat_cache = std::make_unique<ExpiringLRUCache<GcsFileSystemStat>>(
       stat_cache_max_age, stat_cache_max_entries);
+
+  if (absl::SimpleAtoi(std::getenv(kParallelUploadThreshold), &value)) {
+    parallel_upload_threshold = value * 1024 * 1024;
+  }
+  if (absl::SimpleAtoi(std::getenv(kParallelUploadParts), &value)) {
+    parallel_upload_parts = static_cast<size_t>(value);
+  }
 }
 
 GCSFileSystemImplementation::GCSFileSystemImplementation(
@@ -535,7 +702,9 @@ GCSFileSystemImplementation::GCSFileSystemImplementation(
     : gcs_client(gcs_client),
       compose(compose),
       block_cache_lock(),
-      block_size(block_size) {
+      block_size(block_size),
+      parallel_upload_threshold(kDefaultParallelUploadThreshold),
+      parallel_upload_parts(kDefaultParallelUploadParts) {
   file_block_cache = std::make_unique<RamFileBlockCache>(
       block_size, max_bytes, max_staleness,
       [this](const std::string& filename, size_t offset, size_t buffer_size,
@@ -648,7 +817,8 @@ void NewWritableFile(const TF_Filesystem* filesystem, const char* path,
   file->plugin_file = new tf_writable_file::GCSWritableFile(
       {std::move(bucket), std::move(object), &gcs_file->gcs_client,
        TempFile(temp_file_name, std::ios::binary | std::ios::out), true,
-       (gcs_file->compose ? 0 : -1)});
+       (gcs_file->compose ? 0 : -1), gcs_file->parallel_upload_threshold,
+       gcs_file->parallel_upload_parts});
   TF_VLog(3, "GcsWritableFile: %s", path);
   TF_SetStatus(status, TF_OK, "");
 }
@@ -677,7 +847,8 @@ void NewAppendableFile(const TF_Filesystem* filesystem, const char* path,
     file->plugin_file = new tf_writable_file::GCSWritableFile(
         {std::move(bucket), std::move(object), &gcs_file->gcs_client,
          TempFile(temp_file_name, std::ios::binary | std::ios::app), sync_need,
-         -1});
+         -1, gcs_file->parallel_upload_threshold,
+         gcs_file->parallel_upload_parts});
   } else {
     // If compose is true, we do not download anything.
     // Instead we only check if this file exists on server or not.
@@ -688,12 +859,15 @@ void NewAppendableFile(const TF_Filesystem* filesystem, const char* path,
       file->plugin_file = new tf_writable_file::GCSWritableFile(
           {std::move(bucket), std::move(object), &gcs_file->gcs_client,
            TempFile(temp_file_name, std::ios::binary | std::ios::trunc), false,
-           static_cast<int64_t>(metadata->size())});
+           static_cast<int64_t>(metadata->size()),
+           gcs_file->parallel_upload_threshold,
+           gcs_file->parallel_upload_parts});
     } else if (TF_GetCode(status) == TF_NOT_FOUND) {
       file->plugin_file = new tf_writable_file::GCSWritableFile(
           {std::move(bucket), std::move(object), &gcs_file->gcs_client,
            TempFile(temp_file_name, std::ios::binary | std::ios::trunc), true,
-           0});
+           0, gcs_file->parallel_upload_threshold,
+           gcs_file->parallel_upload_parts});
     } else {
       return;
     }
@@ -1230,6 +1404,11 @@ static void FlushCaches(const TF_Filesystem* filesystem) {
       static_cast<GCSFileSystem*>(filesystem->plugin_filesystem)->ptr.get();
   if (gcs_file != nullptr) {
     absl::ReaderMutexLock l(&gcs_file->block_cache_lock);
+    auto stats = gcs_file->file_block_cache->GetStats();
+    TF_VLog(1,
+            "GCS file block cache: %u hits, %u misses, %u evictions, %u "
+            "prefetches.",
+            stats.hits, stats.misses, stats.evictions, stats.prefetches);
     gcs_file->file_block_cache->Flush();
     gcs_file->stat_cache->Clear();
   }
@@ -1255,6 +1434,26 @@ static void SetConfiguration(const TF_Filesystem* filesystem,
     std::string value =
         std::string(options[i].value->values[0].buffer_val.buf,
                     options[i].value->values[0].buffer_val.buf_length);
+    if (name == kParallelUploadThreshold || name == kParallelUploadParts) {
+      uint64_t number;
+      if (!absl::SimpleAtoi(value, &number)) {
+        std::string message =
+            absl::StrCat("SetConfiguration expects a number for ", name,
+                         " in gcs ('gs://') file system, got: ", value);
+        TF_SetStatus(status, TF_INVALID_ARGUMENT, message.c_str());
+        return;
+      }
+      auto gcs_file =
+          static_cast<GCSFileSystem*>(filesystem->plugin_filesystem)
+              ->Load(status);
+      if (TF_GetCode(status) != TF_OK) return;
+      if (name == kParallelUploadThreshold) {
+        gcs_file->parallel_upload_threshold = number * 1024 * 1024;
+      } else {
+        gcs_file->parallel_upload_parts = static_cast<size_t>(number);
+      }
+      continue;
+    }
     std::string message = absl::StrCat(
         "SetConfiguration not implemented for gcs ('gs://') file system: name "
         "= ",
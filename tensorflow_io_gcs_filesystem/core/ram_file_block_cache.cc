@@ -14,7 +14,9 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow_io_gcs_filesystem/core/ram_file_block_cache.h"
 
+#include <algorithm>
 #include <cstring>
+#include <limits>
 #include <memory>
 #include <sstream>
 #include <utility>
@@ -28,6 +30,84 @@ namespace gs {
 
 namespace tf_gcs_filesystem {
 
+RamFileBlockCache::RamFileBlockCache(size_t block_size, size_t max_bytes,
+                                     uint64_t max_staleness,
+                                     BlockFetcher block_fetcher,
+                                     size_t read_ahead_blocks,
+                                     std::function<uint64_t()> timer_seconds)
+    : block_size_(block_size),
+      max_bytes_(max_bytes),
+      max_staleness_(max_staleness),
+      block_fetcher_(block_fetcher),
+      read_ahead_blocks_(read_ahead_blocks),
+      timer_seconds_(timer_seconds),
+      pruning_thread_(nullptr,
+                      [](TF_Thread* thread) { TF_JoinThread(thread); }) {
+  // Every shard must hold a few blocks, or the cache would evict blocks that
+  // would fit in a single shard.
+  size_t num_shards = 1;
+  if (IsCacheEnabled()) {
+    num_shards = std::min(kMaxShards,
+                          max_bytes_ / (block_size_ * kMinBlocksPerShard));
+    num_shards = std::max(num_shards, static_cast<size_t>(1));
+  }
+  for (size_t i = 0; i < num_shards; ++i) {
+    shards_.emplace_back(new Shard());
+  }
+  shard_max_bytes_ = max_bytes_ / num_shards;
+
+  TF_ThreadOptions thread_options;
+  TF_DefaultThreadOptions(&thread_options);
+  if (max_staleness_ > 0) {
+    pruning_thread_.reset(
+        TF_StartThread(&thread_options, "TF_prune_FBC", PruneThread, this));
+  }
+  if (IsCacheEnabled() && read_ahead_blocks_ > 0) {
+    for (size_t i = 0; i < kPrefetchThreads; ++i) {
+      prefetch_threads_.emplace_back(
+          TF_StartThread(&thread_options, "TF_prefetch_FBC", PrefetchThread,
+                         this),
+          [](TF_Thread* thread) { TF_JoinThread(thread); });
+    }
+  }
+  TF_VLog(1,
+          "GCS file block cache is %s with %u shards, reading ahead %u "
+          "blocks.\n",
+          (IsCacheEnabled() ? "enabled" : "disabled"), num_shards,
+          read_ahead_blocks_);
+}
+
+RamFileBlockCache::~RamFileBlockCache() {
+  if (pruning_thread_) {
+    stop_pruning_thread_.Notify();
+    // Destroying pruning_thread_ will block until Prune() receives the above
+    // notification and returns.
+    pruning_thread_.reset();
+  }
+  {
+    absl::MutexLock l(&prefetch_mu_);
+    stop_prefetch_threads_ = true;
+    prefetch_cond_var_.SignalAll();
+  }
+  // Destroying the threads blocks until the running prefetches return.
+  prefetch_threads_.clear();
+  if (IsCacheEnabled()) {
+    Stats stats = GetStats();
+    TF_VLog(1,
+            "GCS file block cache: %u hits, %u misses, %u evictions, %u "
+            "prefetches.\n",
+            stats.hits, stats.misses, stats.evictions, stats.prefetches);
+  }
+}
+
+RamFileBlockCache::Shard* RamFileBlockCache::GetShard(const Key& key) const {
+  if (shards_.size() == 1) return shards_[0].get();
+  size_t hash = std::hash<std::string>()(key.first);
+  hash ^= std::hash<size_t>()(key.second / block_size_) + 0x9e3779b9 +
+          (hash << 6) + (hash >> 2);
+  return shards_[hash % shards_.size()].get();
+}
+
 bool RamFileBlockCache::BlockNotStale(const std::shared_ptr<Block>& block) {
   absl::MutexLock l(&block->mu);
   if (block->state != FetchState::FINISHED) {
@@ -39,87 +119,108 @@ bool RamFileBlockCache::BlockNotStale(const std::shared_ptr<Block>& block) {
 
 std::shared_ptr<RamFileBlockCache::Block> RamFileBlockCache::Lookup(
     const Key& key) {
-  absl::MutexLock lock(&mu_);
-  auto entry = block_map_.find(key);
-  if (entry != block_map_.end()) {
-    if (BlockNotStale(entry->second)) {
-      return entry->second;
-    } else {
-      // Remove the stale block and continue.
-      RemoveFile_Locked(key.first);
+  Shard* shard = GetShard(key);
+  while (true) {
+    {
+      absl::MutexLock lock(&shard->mu);
+      auto entry = shard->block_map.find(key);
+      if (entry == shard->block_map.end()) {
+        // Insert a new empty block, setting the bookkeeping to sentinel values
+        // in order to update them as appropriate.
+        auto new_entry = std::make_shared<Block>();
+        shard->lru_list.push_front(key);
+        shard->lra_list.push_front(key);
+        new_entry->lru_iterator = shard->lru_list.begin();
+        new_entry->lra_iterator = shard->lra_list.begin();
+        new_entry->timestamp = timer_seconds_();
+        shard->block_map.emplace(std::make_pair(key, new_entry));
+        return new_entry;
+      }
+      if (BlockNotStale(entry->second)) {
+        return entry->second;
+      }
     }
+    // Remove the stale file from all shards and continue.
+    RemoveFile(key.first);
   }
+}
 
-  // Insert a new empty block, setting the bookkeeping to sentinel values
-  // in order to update them as appropriate.
-  auto new_entry = std::make_shared<Block>();
-  lru_list_.push_front(key);
-  lra_list_.push_front(key);
-  new_entry->lru_iterator = lru_list_.begin();
-  new_entry->lra_iterator = lra_list_.begin();
-  new_entry->timestamp = timer_seconds_();
-  block_map_.emplace(std::make_pair(key, new_entry));
-  return new_entry;
+// Remove blocks from the shard until we do not exceed its maximum size.
+void RamFileBlockCache::Trim(Shard* shard) {
+  while (!shard->lru_list.empty() && shard->cache_size > shard_max_bytes_) {
+    RemoveBlock(shard, shard->block_map.find(shard->lru_list.back()));
+    evictions_++;
+  }
 }
 
-// Remove blocks from the cache until we do not exceed our maximum size.
-void RamFileBlockCache::Trim() {
-  while (!lru_list_.empty() && cache_size_ > max_bytes_) {
-    RemoveBlock(block_map_.find(lru_list_.back()));
+bool RamFileBlockCache::HasLaterBlock(const Key& key) const {
+  Key fmax = std::make_pair(key.first, std::numeric_limits<size_t>::max());
+  for (const auto& shard : shards_) {
+    absl::MutexLock lock(&shard->mu);
+    auto fcmp = shard->block_map.upper_bound(fmax);
+    while (fcmp != shard->block_map.begin() && key < (--fcmp)->first) {
+      // Only fetched blocks with data count, a prefetch may be fetching an
+      // empty block past the end of the file.
+      absl::MutexLock l(&fcmp->second->mu);
+      if (fcmp->second->state == FetchState::FINISHED &&
+          !fcmp->second->data.empty()) {
+        return true;
+      }
+    }
   }
+  return false;
 }
 
 /// Move the block to the front of the LRU list if it isn't already there.
 void RamFileBlockCache::UpdateLRU(const Key& key,
                                   const std::shared_ptr<Block>& block,
                                   TF_Status* status) {
-  absl::MutexLock lock(&mu_);
+  // Check for inconsistent state. If there is a block later in the same file
+  // in the cache, and our current block is not block size, this likely means
+  // we have inconsistent state within the cache. Note: it's possible some
+  // incomplete reads may still go undetected. The later blocks may be in any
+  // shard, so this is checked before locking the shard of the block.
+  if (block->data.size() < block_size_ && HasLaterBlock(key)) {
+    return TF_SetStatus(status, TF_INTERNAL,
+                        "Block cache contents are inconsistent.");
+  }
+
+  Shard* shard = GetShard(key);
+  absl::MutexLock lock(&shard->mu);
   if (block->timestamp == 0) {
     // The block was evicted from another thread. Allow it to remain evicted.
     return TF_SetStatus(status, TF_OK, "");
   }
-  if (block->lru_iterator != lru_list_.begin()) {
-    lru_list_.erase(block->lru_iterator);
-    lru_list_.push_front(key);
-    block->lru_iterator = lru_list_.begin();
+  if (block->lru_iterator != shard->lru_list.begin()) {
+    shard->lru_list.erase(block->lru_iterator);
+    shard->lru_list.push_front(key);
+    block->lru_iterator = shard->lru_list.begin();
   }
 
-  // Check for inconsistent state. If there is a block later in the same file
-  // in the cache, and our current block is not block size, this likely means
-  // we have inconsistent state within the cache. Note: it's possible some
-  // incomplete reads may still go undetected.
-  if (block->data.size() < block_size_) {
-    Key fmax = std::make_pair(key.first, std::numeric_limits<size_t>::max());
-    auto fcmp = block_map_.upper_bound(fmax);
-    if (fcmp != block_map_.begin() && key < (--fcmp)->first) {
-      return TF_SetStatus(status, TF_INTERNAL,
-                          "Block cache contents are inconsistent.");
-    }
-  }
-
-  Trim();
+  Trim(shard);
 
   return TF_SetStatus(status, TF_OK, "");
 }
 
 void RamFileBlockCache::MaybeFetch(const Key& key,
                                    const std::shared_ptr<Block>& block,
-                                   TF_Status* status) {
-  bool downloaded_block = false;
-  auto reconcile_state = MakeCleanup([this, &downloaded_block, &key, &block] {
-    // Perform this action in a cleanup callback to avoid locking mu_ after
-    // locking block->mu.
-    if (downloaded_block) {
-      absl::MutexLock l(&mu_);
+                                   bool* downloaded_block, TF_Status* status) {
+  *downloaded_block = false;
+  auto reconcile_state = MakeCleanup([this, downloaded_block, &key, &block] {
+    // Perform this action in a cleanup callback to avoid locking the shard's
+    // mu after locking block->mu.
+    if (*downloaded_block) {
+      Shard* shard = GetShard(key);
+      absl::MutexLock l(&shard->mu);
       // Do not update state if the block is already to be evicted.
       if (block->timestamp != 0) {
         // Use capacity() instead of size() to account for all  memory
         // used by the cache.
-        cache_size_ += block->data.capacity();
+        shard->cache_size += block->data.capacity();
         // Put to beginning of LRA list.
-        lra_list_.erase(block->lra_iterator);
-        lra_list_.push_front(key);
-        block->lra_iterator = lra_list_.begin();
+        shard->lra_list.erase(block->lra_iterator);
+        shard->lra_list.push_front(key);
+        block->lra_iterator = shard->lra_list.begin();
         block->timestamp = timer_seconds_();
       }
     }
@@ -146,7 +247,7 @@ void RamFileBlockCache::MaybeFetch(const Key& key,
           // Shrink the data capacity to the actual size used.
           // NOLINTNEXTLINE: shrink_to_fit() may not shrink the capacity.
           std::vector<char>(block->data).swap(block->data);
-          downloaded_block = true;
+          *downloaded_block = true;
           block->state = FetchState::FINISHED;
         } else {
           block->state = FetchState::ERROR;
@@ -187,6 +288,7 @@ int64_t RamFileBlockCache::Read(const std::string& filename, size_t offset,
     finish += block_size_;
   }
   size_t total_bytes_transferred = 0;
+  bool reached_eof = false;
   // Now iterate through the blocks, reading them one at a time.
   for (size_t pos = start; pos < finish; pos += block_size_) {
     Key key = std::make_pair(filename, pos);
@@ -197,8 +299,14 @@ int64_t RamFileBlockCache::Read(const std::string& filename, size_t offset,
       std::cerr << "No block for key " << key.first << "@" << key.second;
       abort();
     }
-    MaybeFetch(key, block, status);
+    bool downloaded_block;
+    MaybeFetch(key, block, &downloaded_block, status);
     if (TF_GetCode(status) != TF_OK) return -1;
+    if (downloaded_block) {
+      misses_++;
+    } else {
+      hits_++;
+    }
     UpdateLRU(key, block, status);
     if (TF_GetCode(status) != TF_OK) return -1;
     // Copy the relevant portion of the block into the result buffer.
@@ -230,23 +338,96 @@ int64_t RamFileBlockCache::Read(const std::string& filename, size_t offset,
     }
     if (data.size() < block_size_) {
       // The block was a partial block and thus signals EOF at its upper bound.
+      reached_eof = true;
       break;
     }
   }
+  if (read_ahead_blocks_ > 0 && !reached_eof) {
+    MaybeReadAhead(filename, offset, offset + n);
+  }
   TF_SetStatus(status, TF_OK, "");
   return total_bytes_transferred;
 }
 
+void RamFileBlockCache::MaybeReadAhead(const std::string& filename,
+                                       size_t offset, size_t end) {
+  absl::MutexLock l(&prefetch_mu_);
+  auto it = read_positions_.find(filename);
+  if (it == read_positions_.end()) {
+    if (read_positions_.size() >= kMaxPrefetchFiles) {
+      read_positions_.clear();
+    }
+    read_positions_[filename].next_offset = end;
+    return;
+  }
+  ReadPosition& position = it->second;
+  const bool sequential = offset == position.next_offset;
+  position.next_offset = end;
+  if (!sequential) {
+    // Restart the read-ahead window once the reader seeks elsewhere.
+    position.prefetched_until = 0;
+    return;
+  }
+  size_t first = block_size_ * ((end + block_size_ - 1) / block_size_);
+  size_t until = first + read_ahead_blocks_ * block_size_;
+  first = std::max(first, position.prefetched_until);
+  if (first >= until) return;
+  prefetch_queue_.push_back({filename, first, (until - first) / block_size_});
+  position.prefetched_until = until;
+  prefetch_cond_var_.Signal();
+}
+
+void RamFileBlockCache::Prefetch() {
+  while (true) {
+    PrefetchRequest request;
+    {
+      absl::MutexLock l(&prefetch_mu_);
+      while (!stop_prefetch_threads_ && prefetch_queue_.empty()) {
+        prefetch_cond_var_.Wait(&prefetch_mu_);
+      }
+      if (stop_prefetch_threads_) return;
+      request = std::move(prefetch_queue_.front());
+      prefetch_queue_.pop_front();
+    }
+    PrefetchBlocks(request);
+  }
+}
+
+void RamFileBlockCache::PrefetchBlocks(const PrefetchRequest& request) {
+  TF_Status* status = TF_NewStatus();
+  auto status_cleanup = MakeCleanup([status] { TF_DeleteStatus(status); });
+  for (size_t i = 0; i < request.num_blocks; ++i) {
+    {
+      absl::MutexLock l(&prefetch_mu_);
+      if (stop_prefetch_threads_) return;
+    }
+    Key key = std::make_pair(request.filename,
+                             request.offset + i * block_size_);
+    std::shared_ptr<Block> block = Lookup(key);
+    bool downloaded_block;
+    MaybeFetch(key, block, &downloaded_block, status);
+    if (TF_GetCode(status) != TF_OK) return;
+    if (downloaded_block) {
+      prefetches_++;
+      UpdateLRU(key, block, status);
+      if (TF_GetCode(status) != TF_OK) return;
+    }
+    // Blocks past the end of the file are never fetched, as a later block
+    // would make the partial last block look inconsistent.
+    if (block->data.size() < block_size_) return;
+  }
+}
+
 bool RamFileBlockCache::ValidateAndUpdateFileSignature(
     const std::string& filename, int64_t file_signature) {
-  absl::MutexLock lock(&mu_);
+  absl::MutexLock lock(&signature_mu_);
   auto it = file_signature_map_.find(filename);
   if (it != file_signature_map_.end()) {
     if (it->second == file_signature) {
       return true;
     }
     // Remove the file from cache if the signatures don't match.
-    RemoveFile_Locked(filename);
+    RemoveFile(filename);
     it->second = file_signature;
     return false;
   }
@@ -255,59 +436,85 @@ bool RamFileBlockCache::ValidateAndUpdateFileSignature(
 }
 
 size_t RamFileBlockCache::CacheSize() const {
-  absl::MutexLock lock(&mu_);
-  return cache_size_;
+  size_t cache_size = 0;
+  for (const auto& shard : shards_) {
+    absl::MutexLock lock(&shard->mu);
+    cache_size += shard->cache_size;
+  }
+  return cache_size;
+}
+
+RamFileBlockCache::Stats RamFileBlockCache::GetStats() const {
+  return Stats{hits_.load(), misses_.load(), evictions_.load(),
+               prefetches_.load()};
 }
 
 void RamFileBlockCache::Prune() {
   while (!stop_pruning_thread_.WaitForNotificationWithTimeout(
       absl::Microseconds(1000000))) {
-    absl::MutexLock lock(&mu_);
     uint64_t now = timer_seconds_();
-    while (!lra_list_.empty()) {
-      auto it = block_map_.find(lra_list_.back());
-      if (now - it->second->timestamp <= max_staleness_) {
-        // The oldest block is not yet expired. Come back later.
-        break;
+    std::vector<std::string> expired_files;
+    for (const auto& shard : shards_) {
+      absl::MutexLock lock(&shard->mu);
+      while (!shard->lra_list.empty()) {
+        auto it = shard->block_map.find(shard->lra_list.back());
+        if (now - it->second->timestamp <= max_staleness_) {
+          // The oldest block is not yet expired. Come back later.
+          break;
+        }
+        // We need to make a copy of the filename here, since it could
+        // otherwise be used within RemoveFile_Locked after `it` is deleted.
+        expired_files.emplace_back(it->first.first);
+        RemoveFile_Locked(shard.get(), expired_files.back());
       }
-      // We need to make a copy of the filename here, since it could otherwise
-      // be used within RemoveFile_Locked after `it` is deleted.
-      RemoveFile_Locked(std::string(it->first.first));
+    }
+    // The other blocks of the expired files may be in any shard.
+    for (const auto& filename : expired_files) {
+      RemoveFile(filename);
     }
   }
 }
 
 void RamFileBlockCache::Flush() {
-  absl::MutexLock lock(&mu_);
-  block_map_.clear();
-  lru_list_.clear();
-  lra_list_.clear();
-  cache_size_ = 0;
+  for (const auto& shard : shards_) {
+    absl::MutexLock lock(&shard->mu);
+    shard->block_map.clear();
+    shard->lru_list.clear();
+    shard->lra_list.clear();
+    shard->cache_size = 0;
+  }
+  absl::MutexLock l(&prefetch_mu_);
+  read_positions_.clear();
 }
 
 void RamFileBlockCache::RemoveFile(const std::string& filename) {
-  absl::MutexLock lock(&mu_);
-  RemoveFile_Locked(filename);
+  for (const auto& shard : shards_) {
+    absl::MutexLock lock(&shard->mu);
+    RemoveFile_Locked(shard.get(), filename);
+  }
+  absl::MutexLock l(&prefetch_mu_);
+  read_positions_.erase(filename);
 }
 
-void RamFileBlockCache::RemoveFile_Locked(const std::string& filename) {
+void RamFileBlockCache::RemoveFile_Locked(Shard* shard,
+                                          const std::string& filename) {
   Key begin = std::make_pair(filename, 0);
-  auto it = block_map_.lower_bound(begin);
-  while (it != block_map_.end() && it->first.first == filename) {
+  auto it = shard->block_map.lower_bound(begin);
+  while (it != shard->block_map.end() && it->first.first == filename) {
     auto next = std::next(it);
-    RemoveBlock(it);
+    RemoveBlock(shard, it);
     it = next;
   }
 }
 
-void RamFileBlockCache::RemoveBlock(BlockMap::iterator entry) {
+void RamFileBlockCache::RemoveBlock(Shard* shard, BlockMap::iterator entry) {
   // This signals that the block is removed, and should not be inadvertently
   // reinserted into the cache in UpdateLRU.
   entry->second->timestamp = 0;
-  lru_list_.erase(entry->second->lru_iterator);
-  lra_list_.erase(entry->second->lra_iterator);
-  cache_size_ -= entry->second->data.capacity();
-  block_map_.erase(entry);
+  shard->lru_list.erase(entry->second->lru_iterator);
+  shard->lra_list.erase(entry->second->lra_iterator);
+  shard->cache_size -= entry->second->data.capacity();
+  shard->block_map.erase(entry);
 }
 
 }  // namespace tf_gcs_filesystem
@@ -16,6 +16,8 @@ limitations under the License.
 #ifndef TENSORFLOW_C_EXPERIMENTAL_FILESYSTEM_PLUGINS_GCS_RAM_FILE_BLOCK_CACHE_H_
 #define TENSORFLOW_C_EXPERIMENTAL_FILESYSTEM_PLUGINS_GCS_RAM_FILE_BLOCK_CACHE_H_
 
+#include <atomic>
+#include <deque>
 #include <functional>
 #include <iostream>
 #include <list>
@@ -41,6 +43,12 @@ namespace tf_gcs_filesystem {
 ///
 /// This class should be shared by read-only random access files on a remote
 /// filesystem (e.g. GCS).
+///
+/// The blocks are spread over shards by a hash of their key, each shard with
+/// its own lock, LRU list and an equal part of `max_bytes`, so that readers of
+/// different blocks do not contend on a single lock. With `read_ahead_blocks`
+/// set, a read that continues the previous read of the same file prefetches
+/// the following blocks in the background.
 class RamFileBlockCache {
  public:
   /// The callback executed when a block is not found in the cache, and needs to
@@ -54,34 +62,24 @@ class RamFileBlockCache {
                                 TF_Status* status)>
       BlockFetcher;
 
+  /// Counters of the cache activity since its creation.
+  struct Stats {
+    /// Blocks read from the cache, including blocks that were being fetched
+    /// by another reader or by a prefetch.
+    uint64_t hits;
+    /// Blocks fetched for a read.
+    uint64_t misses;
+    /// Blocks evicted to stay within `max_bytes`.
+    uint64_t evictions;
+    /// Blocks fetched ahead of sequential reads.
+    uint64_t prefetches;
+  };
+
   RamFileBlockCache(size_t block_size, size_t max_bytes, uint64_t max_staleness,
-                    BlockFetcher block_fetcher,
-                    std::function<uint64_t()> timer_seconds = TF_NowSeconds)
-      : block_size_(block_size),
-        max_bytes_(max_bytes),
-        max_staleness_(max_staleness),
-        block_fetcher_(block_fetcher),
-        timer_seconds_(timer_seconds),
-        pruning_thread_(nullptr,
-                        [](TF_Thread* thread) { TF_JoinThread(thread); }) {
-    if (max_staleness_ > 0) {
-      TF_ThreadOptions thread_options;
-      TF_DefaultThreadOptions(&thread_options);
-      pruning_thread_.reset(
-          TF_StartThread(&thread_options, "TF_prune_FBC", PruneThread, this));
-    }
-    TF_VLog(1, "GCS file block cache is %s.\n",
-            (IsCacheEnabled() ? "enabled" : "disabled"));
-  }
+                    BlockFetcher block_fetcher, size_t read_ahead_blocks = 0,
+                    std::function<uint64_t()> timer_seconds = TF_NowSeconds);
 
-  ~RamFileBlockCache() {
-    if (pruning_thread_) {
-      stop_pruning_thread_.Notify();
-      // Destroying pruning_thread_ will block until Prune() receives the above
-      // notification and returns.
-      pruning_thread_.reset();
-    }
-  }
+  ~RamFileBlockCache();
 
   /// Read `n` bytes from `filename` starting at `offset` into `buffer`. It
   /// returns total bytes read ( -1 in case of errors ). This method will set
@@ -112,21 +110,25 @@ class RamFileBlockCache {
   // the new one and remove the file from cache.
   bool ValidateAndUpdateFileSignature(const std::string& filename,
                                       int64_t file_signature)
-      ABSL_LOCKS_EXCLUDED(mu_);
+      ABSL_LOCKS_EXCLUDED(signature_mu_);
 
   /// Remove all cached blocks for `filename`.
-  void RemoveFile(const std::string& filename) ABSL_LOCKS_EXCLUDED(mu_);
+  void RemoveFile(const std::string& filename);
 
   /// Remove all cached data.
-  void Flush() ABSL_LOCKS_EXCLUDED(mu_);
+  void Flush();
 
   /// Accessors for cache parameters.
   size_t block_size() const { return block_size_; }
   size_t max_bytes() const { return max_bytes_; }
   uint64_t max_staleness() const { return max_staleness_; }
+  size_t read_ahead_blocks() const { return read_ahead_blocks_; }
 
   /// The current size (in bytes) of the cache.
-  size_t CacheSize() const ABSL_LOCKS_EXCLUDED(mu_);
+  size_t CacheSize() const;
+
+  /// The hit, miss, eviction and prefetch counters of the cache.
+  Stats GetStats() const;
 
   // Returns true if the cache is enabled. If false, the BlockFetcher callback
   // is always executed during Read.
@@ -139,7 +141,23 @@ class RamFileBlockCache {
     ram_file_block_cache->Prune();
   }
 
+  // Same as `PruneThread`, for the threads running `Prefetch`.
+  static void PrefetchThread(void* param) {
+    auto ram_file_block_cache = static_cast<RamFileBlockCache*>(param);
+    ram_file_block_cache->Prefetch();
+  }
+
  private:
+  /// The maximum number of shards.
+  static constexpr size_t kMaxShards = 16;
+  /// The minimum number of blocks each shard can hold.
+  static constexpr size_t kMinBlocksPerShard = 4;
+  /// The number of threads fetching blocks ahead of sequential reads.
+  static constexpr size_t kPrefetchThreads = 4;
+  /// The maximum number of files whose read position is tracked for
+  /// prefetching.
+  static constexpr size_t kMaxPrefetchFiles = 4096;
+
   /// The size of the blocks stored in the LRU cache, as well as the size of the
   /// reads from the underlying filesystem.
   const size_t block_size_;
@@ -149,6 +167,8 @@ class RamFileBlockCache {
   const uint64_t max_staleness_;
   /// The callback to read a block from the underlying filesystem.
   const BlockFetcher block_fetcher_;
+  /// The number of blocks prefetched after a sequential read.
+  const size_t read_ahead_blocks_;
   /// The callback to read timestamps.
   const std::function<uint64_t()> timer_seconds_;
 
@@ -179,13 +199,13 @@ class RamFileBlockCache {
   ///
   /// Thread safety:
   /// The iterator and timestamp fields should only be accessed while holding
-  /// the block-cache-wide mu_ instance variable. The state variable should only
-  /// be accessed while holding the Block's mu lock. The data vector should only
-  /// be accessed after state == FINISHED, and it should never be modified.
+  /// the mu of the block's shard. The state variable should only be accessed
+  /// while holding the Block's mu lock. The data vector should only be
+  /// accessed after state == FINISHED, and it should never be modified.
   ///
-  /// In order to prevent deadlocks, never grab the block-cache-wide mu_ lock
-  /// AFTER grabbing any block's mu lock. It is safe to grab mu without locking
-  /// mu_.
+  /// In order to prevent deadlocks, never grab a shard's mu lock AFTER grabbing
+  /// any block's mu lock, and never hold the mu of two shards at once. It is
+  /// safe to grab mu without locking the shard's mu.
   struct Block {
     /// The block data.
     std::vector<char> data;
@@ -208,32 +228,97 @@ class RamFileBlockCache {
   /// The block map is an ordered map from Key to Block.
   typedef std::map<Key, std::shared_ptr<Block>> BlockMap;
 
+  /// \brief A part of the cache, holding the blocks whose key hashes to it.
+  struct Shard {
+    /// Guards access to the block map, LRU list, and cached byte count.
+    mutable absl::Mutex mu;
+
+    /// The block map (map from Key to Block).
+    BlockMap block_map ABSL_GUARDED_BY(mu);
+
+    /// The LRU list of block keys. The front of the list identifies the most
+    /// recently accessed block.
+    std::list<Key> lru_list ABSL_GUARDED_BY(mu);
+
+    /// The LRA (least recently added) list of block keys. The front of the
+    /// list identifies the most recently added block.
+    ///
+    /// Note: blocks are added to lra_list only after they have successfully
+    /// been fetched from the underlying block store.
+    std::list<Key> lra_list ABSL_GUARDED_BY(mu);
+
+    /// The combined number of bytes in all of the cached blocks.
+    size_t cache_size ABSL_GUARDED_BY(mu) = 0;
+  };
+
+  /// \brief A run of blocks of a file to prefetch, in order.
+  struct PrefetchRequest {
+    std::string filename;
+    size_t offset;
+    size_t num_blocks;
+  };
+
+  /// \brief The position of the sequential reads of a file.
+  struct ReadPosition {
+    /// The offset a read continuing the last read would start at.
+    size_t next_offset = 0;
+    /// The end of the blocks already requested for prefetching.
+    size_t prefetched_until = 0;
+  };
+
+  /// Returns the shard holding the block at `key`.
+  Shard* GetShard(const Key& key) const;
+
   /// Prune the cache by removing files with expired blocks.
-  void Prune() ABSL_LOCKS_EXCLUDED(mu_);
+  void Prune();
+
+  /// Fetch the requested blocks until the cache is destroyed.
+  void Prefetch() ABSL_LOCKS_EXCLUDED(prefetch_mu_);
+
+  /// Queue the blocks following [offset, end) of `filename` for prefetching
+  /// if the read continues the previous read of the file.
+  void MaybeReadAhead(const std::string& filename, size_t offset, size_t end)
+      ABSL_LOCKS_EXCLUDED(prefetch_mu_);
 
-  bool BlockNotStale(const std::shared_ptr<Block>& block)
-      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  /// Fetch the blocks of `request` that are not cached, stopping at the end
+  /// of the file or at the first error.
+  void PrefetchBlocks(const PrefetchRequest& request);
+
+  bool BlockNotStale(const std::shared_ptr<Block>& block);
 
   /// Look up a Key in the block cache.
-  std::shared_ptr<Block> Lookup(const Key& key) ABSL_LOCKS_EXCLUDED(mu_);
+  std::shared_ptr<Block> Lookup(const Key& key);
 
+  /// Fetch the block unless it is already fetched. Sets `downloaded_block` to
+  /// whether this call fetched the block.
   void MaybeFetch(const Key& key, const std::shared_ptr<Block>& block,
-                  TF_Status* status) ABSL_LOCKS_EXCLUDED(mu_);
+                  bool* downloaded_block, TF_Status* status);
 
-  /// Trim the block cache to make room for another entry.
-  void Trim() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  /// Trim the shard to make room for another entry.
+  void Trim(Shard* shard) ABSL_EXCLUSIVE_LOCKS_REQUIRED(shard->mu);
 
   /// Update the LRU iterator for the block at `key`.
   void UpdateLRU(const Key& key, const std::shared_ptr<Block>& block,
-                 TF_Status* status) ABSL_LOCKS_EXCLUDED(mu_);
+                 TF_Status* status);
+
+  /// Returns true if any shard holds a block of the file of `key` at a higher
+  /// offset.
+  bool HasLaterBlock(const Key& key) const;
+
+  /// Remove all blocks of a file in the shard, with its mu already held.
+  void RemoveFile_Locked(Shard* shard, const std::string& filename)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(shard->mu);
+
+  /// Remove the block `entry` from the block map and LRU list of the shard,
+  /// and update the shard size accordingly.
+  void RemoveBlock(Shard* shard, BlockMap::iterator entry)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(shard->mu);
 
-  /// Remove all blocks of a file, with mu_ already held.
-  void RemoveFile_Locked(const std::string& filename)
-      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  /// The shards of the cache, each holding an equal part of max_bytes_.
+  std::vector<std::unique_ptr<Shard>> shards_;
 
-  /// Remove the block `entry` from the block map and LRU list, and update the
-  /// cache size accordingly.
-  void RemoveBlock(BlockMap::iterator entry) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  /// The maximum number of bytes in each shard.
+  size_t shard_max_bytes_;
 
   /// The cache pruning thread that removes files with expired blocks.
   std::unique_ptr<TF_Thread, std::function<void(TF_Thread*)>> pruning_thread_;
@@ -241,28 +326,39 @@ class RamFileBlockCache {
   /// Notification for stopping the cache pruning thread.
   absl::Notification stop_pruning_thread_;
 
-  /// Guards access to the block map, LRU list, and cached byte count.
-  mutable absl::Mutex mu_;
+  /// The threads fetching blocks ahead of sequential reads.
+  std::vector<std::unique_ptr<TF_Thread, std::function<void(TF_Thread*)>>>
+      prefetch_threads_;
 
-  /// The block map (map from Key to Block).
-  BlockMap block_map_ ABSL_GUARDED_BY(mu_);
+  /// Guards the prefetch queue and the read positions.
+  absl::Mutex prefetch_mu_;
 
-  /// The LRU list of block keys. The front of the list identifies the most
-  /// recently accessed block.
-  std::list<Key> lru_list_ ABSL_GUARDED_BY(mu_);
+  /// Signals the prefetch threads that a request is queued or that they
+  /// should stop.
+  absl::CondVar prefetch_cond_var_;
 
-  /// The LRA (least recently added) list of block keys. The front of the list
-  /// identifies the most recently added block.
-  ///
-  /// Note: blocks are added to lra_list_ only after they have successfully been
-  /// fetched from the underlying block store.
-  std::list<Key> lra_list_ ABSL_GUARDED_BY(mu_);
+  /// Set when the prefetch threads should stop.
+  bool stop_prefetch_threads_ ABSL_GUARDED_BY(prefetch_mu_) = false;
+
+  /// The blocks waiting to be prefetched.
+  std::deque<PrefetchRequest> prefetch_queue_ ABSL_GUARDED_BY(prefetch_mu_);
+
+  /// The read position of the recently read files.
+  std::map<std::string, ReadPosition> read_positions_
+      ABSL_GUARDED_BY(prefetch_mu_);
 
-  /// The combined number of bytes in all of the cached blocks.
-  size_t cache_size_ ABSL_GUARDED_BY(mu_) = 0;
+  /// Guards the file signatures.
+  absl::Mutex signature_mu_;
 
   // A filename->file_signature map.
-  std::map<std::string, int64_t> file_signature_map_ ABSL_GUARDED_BY(mu_);
+  std::map<std::string, int64_t> file_signature_map_
+      ABSL_GUARDED_BY(signature_mu_);
+
+  /// Counters of the cache activity, see `Stats`.
+  std::atomic<uint64_t> hits_{0};
+  std::atomic<uint64_t> misses_{0};
+  std::atomic<uint64_t> evictions_{0};
+  std::atomic<uint64_t> prefetches_{0};
 };
 
 }  // namespace tf_gcs_filesystem
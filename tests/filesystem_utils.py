@@ -0,0 +1,33 @@
+# Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License"); you may not
+# use this file except in compliance with the License.  You may obtain a copy of
+# the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+# WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+# License for the specific language governing permissions and limitations under
+# the License.
+# ==============================================================================
+"""Helpers shared by the file system tests"""
+
+import os
+
+
+def random_body(size=3 * 1024 * 1024 + 123):
+    """Returns random bytes spanning several blocks of the read caches"""
+    return os.urandom(size)
+
+
+def read_in_chunks(f, chunk_size=100 * 1024):
+    """Reads an opened file in chunks until EOF and returns the joined bytes"""
+    chunks = []
+    while True:
+        chunk = f.read(chunk_size)
+        if not chunk:
+            break
+        chunks.append(chunk)
+    return b"".join(chunks)
@@ -136,5 +136,72 @@ def test_avro_dataset_partition():
         assert i == 100
 
 
+def test_avro_index(tmp_path):
+    """test_avro_index"""
+    # The test.bin was created from avro/lang/c++/examples/datafile.cc.
+    filename = os.path.join(
+        os.path.dirname(os.path.abspath(__file__)), "test_avro", "test.bin"
+    )
+    filename = "file://" + filename
+
+    schema_filename = os.path.join(
+        os.path.dirname(os.path.abspath(__file__)), "test_avro", "cpx.json"
+    )
+    with open(schema_filename) as f:
+        schema = f.read()
+
+    index = str(tmp_path / "test.bin.index")
+    # First open writes the index, second open reuses it.
+    for _ in range(2):
+        avro = tfio.IOTensor.from_avro(filename, schema, index=index)
+        assert os.path.exists(index)
+        assert avro("re").shape == [100]
+        assert np.all(avro("im").to_tensor().numpy() == [100.0 + i for i in range(100)])
+        assert np.all(avro("re").to_tensor().numpy() == [100.0 * i for i in range(100)])
+
+        dataset = tfio.IODataset.from_avro(filename, schema, index=index)
+        i = 0
+        for v in dataset:
+            re, im = v
+            assert re.numpy() == 100.0 * i
+            assert im.numpy() == 100.0 + i
+            i += 1
+        assert i == 100
+
+    # A corrupted index is detected and rebuilt.
+    with open(index, "wb") as f:
+        f.write(b"corrupted")
+    avro = tfio.IOTensor.from_avro(filename, schema, index=index)
+    assert np.all(avro("re").to_tensor().numpy() == [100.0 * i for i in range(100)])
+
+
+def test_write_avro_index(tmp_path):
+    """test_write_avro_index"""
+    filename = os.path.join(
+        os.path.dirname(os.path.abspath(__file__)), "test_avro", "test.bin"
+    )
+    filename = "file://" + filename
+
+    schema_filename = os.path.join(
+        os.path.dirname(os.path.abspath(__file__)), "test_avro", "cpx.json"
+    )
+    with open(schema_filename) as f:
+        schema = f.read()
+
+    index = str(tmp_path / "test.bin.index")
+    blocks = tfio.experimental.columnar.write_avro_index(filename, index)
+    assert blocks.numpy() > 0
+    assert os.path.exists(index)
+
+    # The index written ahead of time is used as is.
+    with open(index, "rb") as f:
+        content = f.read()
+    avro = tfio.IOTensor.from_avro(filename, schema, index=index)
+    assert np.all(avro("re").to_tensor().numpy() == [100.0 * i for i in range(100)])
+    assert np.all(avro("im").to_tensor().numpy() == [100.0 + i for i in range(100)])
+    with open(index, "rb") as f:
+        assert f.read() == content
+
+
 if __name__ == "__main__":
     test.main()
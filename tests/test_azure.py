@@ -22,10 +22,82 @@ import pytest
 import tensorflow as tf
 import tensorflow_io as tfio  # pylint: disable=unused-import
 
+from filesystem_utils import random_body, read_in_chunks
+
 # Note: export TF_AZURE_USE_DEV_STORAGE=1 to enable emulation
 
-if sys.platform in ("darwin", "linux"):
-    pytest.skip("TODO: flaky on macOS and Linux", allow_module_level=True)
+# The tests of the AZFSTestBase classes are flaky on macOS and Linux, unlike
+# the module level tests which run against azurite there.
+skip_flaky = pytest.mark.skipif(
+    sys.platform in ("darwin", "linux"), reason="TODO: flaky on macOS and Linux"
+)
+
+CONNECTION_STRING = (
+    "DefaultEndpointsProtocol=http;AccountName=devstoreaccount1;"
+    "AccountKey=Eby8vdM02xNOcqFlqUwJPLlmEtlCDXJ1OUzFT50uSRZ6IFsuFq2UVErCz4I6tq/K1SZFPTOtr/KBHBeksoGMGw==;"
+    "BlobEndpoint=http://127.0.0.1:10000/devstoreaccount1;"
+)
+
+# Writes the blob as staged blocks, reads it twice in chunks and once at an
+# offset through the block cache with read-ahead, then overwrites it and
+# reads it again through the same cache.
+READ_CACHED_SCRIPT = """
+import sys
+import tensorflow as tf
+import tensorflow_io as tfio
+from azure.storage.blob import BlobClient
+
+from filesystem_utils import random_body, read_in_chunks
+
+file_name, connection_string = sys.argv[1:]
+body = random_body()
+with tf.io.gfile.GFile(file_name, "wb") as w:
+    w.write(body)
+blob = BlobClient.from_connection_string(connection_string, "azcached", "cachedfile")
+committed, _ = blob.get_block_list("committed")
+assert len(committed) == 4
+for _ in range(2):
+    with tf.io.gfile.GFile(file_name, "rb") as r:
+        assert read_in_chunks(r) == body
+with tf.io.gfile.GFile(file_name, "rb") as r:
+    r.seek(2 * 1024 * 1024 - 10)
+    assert r.read(20) == body[2 * 1024 * 1024 - 10 : 2 * 1024 * 1024 + 10]
+
+with tf.io.gfile.GFile(file_name, "wb") as w:
+    w.write(b"1234567")
+with tf.io.gfile.GFile(file_name, "rb") as r:
+    assert r.read() == b"1234567"
+"""
+
+
+def test_read_cached():
+    """Test staged writes and reads through the block cache with read-ahead"""
+    from azure.storage.blob import BlobServiceClient
+
+    container = BlobServiceClient.from_connection_string(
+        CONNECTION_STRING
+    ).get_container_client("azcached")
+    if not container.exists():
+        container.create_container()
+    file_name = "az://devstoreaccount1/azcached/cachedfile"
+
+    # The block cache and the upload block size are configured when
+    # tensorflow_io is loaded, so the blob is written and read in a new process
+    env = os.environ.copy()
+    env["TF_AZURE_USE_DEV_STORAGE"] = "1"
+    env["TF_AZURE_STORAGE_UPLOAD_BLOCK_SIZE_MB"] = "1"
+    env["TF_AZURE_STORAGE_READ_CACHE_BLOCK_SIZE_MB"] = "1"
+    env["TF_AZURE_STORAGE_READ_CACHE_MAX_SIZE_MB"] = "16"
+    env["TF_AZURE_STORAGE_READ_AHEAD_BLOCKS"] = "2"
+    subprocess.check_call(
+        [sys.executable, "-c", READ_CACHED_SCRIPT, file_name, CONNECTION_STRING],
+        cwd=os.path.dirname(os.path.abspath(__file__)),
+        env=env,
+    )
+
+    blob = container.get_blob_client("cachedfile")
+    assert blob.download_blob().readall() == b"1234567"
+    blob.delete_blob()
 
 
 class AZFSTestBase:
@@ -89,6 +161,25 @@ class AZFSTestBase:
             file_read = r.read()
             self.assertEqual(file_read, "Hello\n, world!")
 
+    def test_write_read_large_file(self):
+        """Test write/read file of several staged blocks."""
+        file_name = self._path_to("largefile")
+        if tf.io.gfile.exists(file_name):
+            tf.io.gfile.remove(file_name)
+
+        body = random_body(20 * 1024 * 1024 + 123)
+        with tf.io.gfile.GFile(file_name, "wb") as w:
+            w.write(body[: 1024 * 1024])
+            w.flush()
+            self.assertEqual(tf.io.gfile.stat(file_name).length, 1024 * 1024)
+            w.write(body[1024 * 1024 :])
+            self.assertEqual(w.tell(), len(body))
+
+        with tf.io.gfile.GFile(file_name, "rb") as r:
+            self.assertEqual(read_in_chunks(r, 1024 * 1024), body)
+
+        tf.io.gfile.remove(file_name)
+
     def test_wildcard_matching(self):
         """Test glob patterns"""
         for ext in [".txt", ".md"]:
@@ -202,6 +293,7 @@ class AZFSTestBase:
         assert i == 2
 
 
+@skip_flaky
 class AZFSTest(tf.test.TestCase, AZFSTestBase):
     """Run tests for azfs backend using account key authentication."""
 
@@ -218,6 +310,7 @@ class AZFSTest(tf.test.TestCase, AZFSTestBase):
         os.environ["TF_AZURE_USE_DEV_STORAGE"] = "1"
 
 
+@skip_flaky
 class AZFSSASTest(tf.test.TestCase, AZFSTestBase):
     """Run tests for azfs backend using shared access signature authentication."""
 
@@ -15,6 +15,8 @@
 """Tests for GCS file system"""
 
 import os
+import re
+import subprocess
 import sys
 import time
 import requests
@@ -58,3 +60,164 @@ def test_read_file():
 
     content = tf.io.read_file(f"gs://{bucket_name}/{key_name}")
     assert content == body
+
+
+@pytest.mark.skipif(
+    sys.platform in ("win32", "darwin"),
+    reason="TODO GCS emulator not setup properly on macOS/Windows yet",
+)
+def test_write_file_parallel_composite_upload():
+    """Test case for writing GCS with parallel composite uploads"""
+
+    from google.cloud import storage
+    import tensorflow_io as tfio
+
+    client = storage.Client(
+        project="[PROJECT]",
+        _http=requests.Session(),
+        client_options={"api_endpoint": "http://localhost:9099"},
+    )
+
+    body = os.urandom(3 * 1024 * 1024 + 7)
+
+    key_name = "TEST_PARALLEL_UPLOAD"
+    bucket_name = f"gs{int(time.time())}p"
+    bucket = client.create_bucket(bucket_name)
+
+    os.environ["CLOUD_STORAGE_TESTBENCH_ENDPOINT"] = "http://localhost:9099"
+
+    tfio.experimental.filesystem.set_configuration(
+        "gs", "GCS_PARALLEL_UPLOAD_THRESHOLD_MB", "1"
+    )
+    tfio.experimental.filesystem.set_configuration(
+        "gs", "GCS_PARALLEL_UPLOAD_PARTS", "4"
+    )
+    try:
+        with tf.io.gfile.GFile(f"gs://{bucket_name}/{key_name}", "wb") as f:
+            f.write(body)
+    finally:
+        tfio.experimental.filesystem.set_configuration(
+            "gs", "GCS_PARALLEL_UPLOAD_THRESHOLD_MB", "0"
+        )
+        tfio.experimental.filesystem.set_configuration(
+            "gs", "GCS_PARALLEL_UPLOAD_PARTS", "8"
+        )
+
+    assert bucket.blob(key_name).download_as_bytes() == body
+    # A single stream upload would not be a composite object
+    assert bucket.get_blob(key_name).component_count == 4
+    # The temporary components are deleted once they are composed
+    assert [blob.name for blob in bucket.list_blobs()] == [key_name]
+
+
+# The block cache is configured when the file system is loaded, so the reads
+# run in a new process. Each argument after the file names is a read of
+# "offset:size" from a single file object.
+READ_SCRIPT = """
+import sys
+import time
+import tensorflow as tf
+import tensorflow_io_gcs_filesystem
+
+filename, local_path = sys.argv[1:3]
+with open(local_path, "rb") as f:
+    body = f.read()
+with tf.io.gfile.GFile(filename, "rb") as f:
+    for read in sys.argv[3:]:
+        offset, size = map(int, read.split(":"))
+        if f.tell() != offset:
+            f.seek(offset)
+        assert f.read(size) == body[offset : offset + size]
+        # Let the prefetches started by the read complete
+        time.sleep(1)
+"""
+
+
+def read_blob_with_cache(tmp_path, reads, max_size_mb, read_ahead_blocks):
+    """Reads a new 10MB+ blob through a cache of 1MB blocks, and returns the
+    offsets of the blocks fetched from GCS in order"""
+
+    from google.cloud import storage
+
+    client = storage.Client(
+        project="[PROJECT]",
+        _http=requests.Session(),
+        client_options={"api_endpoint": "http://localhost:9099"},
+    )
+
+    body = os.urandom(10 * 1024 * 1024 + 123)
+
+    key_name = "TEST_CACHE"
+    bucket_name = f"gs{int(time.time() * 1000)}c"
+    bucket = client.create_bucket(bucket_name)
+    bucket.blob(key_name).upload_from_string(body)
+
+    local_path = str(tmp_path / key_name)
+    with open(local_path, "wb") as f:
+        f.write(body)
+
+    filename = f"gs://{bucket_name}/{key_name}"
+    env = dict(os.environ)
+    env["CLOUD_STORAGE_TESTBENCH_ENDPOINT"] = "http://localhost:9099"
+    env["TF_CPP_MAX_VLOG_LEVEL"] = "1"
+    env["GCS_READ_CACHE_BLOCK_SIZE_MB"] = "1"
+    env["GCS_READ_CACHE_MAX_SIZE_MB"] = str(max_size_mb)
+    env["GCS_READ_CACHE_READ_AHEAD_BLOCKS"] = str(read_ahead_blocks)
+    args = [filename, local_path] + [f"{offset}:{size}" for offset, size in reads]
+    process = subprocess.run(
+        [sys.executable, "-c", READ_SCRIPT] + args,
+        env=env,
+        stderr=subprocess.PIPE,
+        check=True,
+    )
+    # Every block fetch is logged by the file system
+    pattern = r"Successful read of " + re.escape(filename) + r" @ (\d+) of size"
+    return [int(offset) for offset in re.findall(pattern, process.stderr.decode())]
+
+
+@pytest.mark.skipif(
+    sys.platform in ("win32", "darwin"),
+    reason="TODO GCS emulator not setup properly on macOS/Windows yet",
+)
+def test_read_file_read_ahead(tmp_path):
+    """Test case for prefetching the blocks after sequential reads of GCS"""
+
+    # The second half of the first 1MB read continues the first half, so the
+    # next two blocks are prefetched
+    mb = 1024 * 1024
+    fetched = read_blob_with_cache(tmp_path, [(0, mb)], 16, 2)
+    assert sorted(fetched) == [0, mb, 2 * mb]
+
+    # Without read-ahead only the block that is read is fetched
+    fetched = read_blob_with_cache(tmp_path, [(0, mb)], 16, 0)
+    assert fetched == [0]
+
+
+@pytest.mark.skipif(
+    sys.platform in ("win32", "darwin"),
+    reason="TODO GCS emulator not setup properly on macOS/Windows yet",
+)
+def test_read_file_read_ahead_seek(tmp_path):
+    """Test case for restarting the read-ahead of GCS after a seek"""
+
+    # The seek probes the byte before the new position, which fetches the 5MB
+    # block without read-ahead. The window then restarts from the new
+    # position, the blocks between the old window and the seek are skipped.
+    mb = 1024 * 1024
+    fetched = read_blob_with_cache(tmp_path, [(0, mb), (6 * mb, 100)], 16, 2)
+    assert sorted(fetched) == [0, mb, 2 * mb, 5 * mb, 6 * mb, 7 * mb, 8 * mb]
+
+
+@pytest.mark.skipif(
+    sys.platform in ("win32", "darwin"),
+    reason="TODO GCS emulator not setup properly on macOS/Windows yet",
+)
+def test_read_file_cache_eviction(tmp_path):
+    """Test case for evicting blocks of GCS from a single shard of the cache"""
+
+    # A cache of two blocks has a single shard, which evicts the blocks of the
+    # first pass before the second one reads them again
+    size = 10 * 1024 * 1024 + 123
+    fetched = read_blob_with_cache(tmp_path, [(0, size), (0, size)], 2, 0)
+    offsets = list(range(0, size, 1024 * 1024))
+    assert fetched == offsets + offsets
@@ -23,6 +23,8 @@ import tensorflow as tf
 import tensorflow_io as tfio
 import pytest
 
+from filesystem_utils import random_body, read_in_chunks
+
 
 @pytest.mark.skipif(
     sys.platform in ("win32", "darwin"),
@@ -91,3 +93,29 @@ def test_append_existing_file():
     print(f"CONTENT: {content}")
     assert content == body1 + body2
     f.close()
+
+
+@pytest.mark.skipif(
+    sys.platform in ("win32", "darwin"),
+    reason="TODO HDFS not setup properly on macOS/Windows yet",
+)
+def test_read_file_read_ahead():
+    """Test case for reading HDFS with read-ahead"""
+
+    address = socket.gethostbyname(socket.gethostname())
+    print(f"ADDRESS: {address}")
+
+    body = random_body()
+    filepath = f"hdfs://{address}:9000/read_ahead.bin"
+    tf.io.write_file(filepath, body)
+
+    os.environ["HDFS_READ_AHEAD_SIZE_MB"] = "1"
+    try:
+        with tf.io.gfile.GFile(filepath, "rb") as f:
+            assert read_in_chunks(f) == body
+
+            # a random read refills the buffer at the new offset
+            f.seek(1024 * 1024 + 3)
+            assert f.read(10) == body[1024 * 1024 + 3 : 1024 * 1024 + 13]
+    finally:
+        del os.environ["HDFS_READ_AHEAD_SIZE_MB"]
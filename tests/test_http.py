@@ -15,7 +15,12 @@
 """Tests for HTTP file system"""
 
 import os
+import re
+import subprocess
 import sys
+import threading
+from http import server
+
 import pytest
 
 import tensorflow as tf
@@ -106,5 +111,145 @@ def test_gfile_tell(local_content, remote_filename):
     assert remote_gfile.tell() == 100
 
 
+class RangeRequestHandler(server.BaseHTTPRequestHandler):
+    """Serves the body of the server with support for byte range requests"""
+
+    def do_GET(self):  # pylint: disable=invalid-name
+        body = self.server.body
+        match = re.match(r"bytes=(\d+)-(\d+)", self.headers.get("Range", ""))
+        if match is None:
+            self.send_response(200)
+            self.send_header("Content-Length", str(len(body)))
+            self.end_headers()
+            self.wfile.write(body)
+            return
+        start, stop = int(match.group(1)), int(match.group(2)) + 1
+        self.server.ranges.append((start, stop))
+        if start >= len(body):
+            self.send_response(416)
+            self.send_header("Content-Length", "0")
+            self.end_headers()
+            return
+        stop = min(stop, len(body))
+        self.send_response(206)
+        self.send_header(
+            "Content-Range", "bytes {}-{}/{}".format(start, stop - 1, len(body))
+        )
+        self.send_header("Content-Length", str(stop - start))
+        self.end_headers()
+        self.wfile.write(body[start:stop])
+
+    def log_message(self, *args):  # pylint: disable=arguments-differ
+        pass
+
+
+@pytest.fixture(name="range_server")
+def fixture_range_server(tmp_path):
+    """A local http server of a 3MB+ body that answers byte range requests"""
+    httpd = server.ThreadingHTTPServer(("localhost", 0), RangeRequestHandler)
+    httpd.body = os.urandom(3 * 1024 * 1024 + 123)
+    httpd.ranges = []
+    httpd.local_path = str(tmp_path / "body")
+    with open(httpd.local_path, "wb") as f:
+        f.write(httpd.body)
+    httpd.url = "http://localhost:{}/body".format(httpd.server_address[1])
+    thread = threading.Thread(target=httpd.serve_forever)
+    thread.start()
+    yield httpd
+    httpd.shutdown()
+    thread.join()
+    httpd.server_close()
+
+
+# The http file system reads its configuration once when tensorflow_io is
+# loaded, so each configuration is exercised in a new process.
+READ_SCRIPT = """
+import sys
+import tensorflow as tf
+import tensorflow_io as tfio
+
+url, local_path, mode = sys.argv[1:]
+with open(local_path, "rb") as f:
+    body = f.read()
+if mode == "whole":
+    assert tf.io.read_file(url).numpy() == body
+elif mode == "chunks":
+    for _ in range(2):
+        remote_gfile = tf.io.gfile.GFile(url, "rb")
+        chunks = []
+        while True:
+            chunk = remote_gfile.read(100 * 1024)
+            if not chunk:
+                break
+            chunks.append(chunk)
+        assert b"".join(chunks) == body
+elif mode == "eof":
+    remote_gfile = tf.io.gfile.GFile(url, "rb")
+    remote_gfile.seek(len(body) - 10)
+    assert remote_gfile.read(100) == body[-10:]
+    assert remote_gfile.read(100) == b""
+"""
+
+
+def run_read_script(range_server, mode, **env):
+    environ = dict(os.environ)
+    environ.update(env)
+    args = [range_server.url, range_server.local_path, mode]
+    subprocess.check_call([sys.executable, "-c", READ_SCRIPT] + args, env=environ)
+
+
+@pytest.mark.skipif(
+    sys.platform in ("darwin", "win32"), reason="macOS/Windows fails now"
+)
+def test_read_cached(range_server):
+    """Test case for reading the http file twice through the block cache"""
+
+    run_read_script(
+        range_server,
+        "chunks",
+        HTTP_READ_CACHE_BLOCK_SIZE_MB="1",
+        HTTP_READ_CACHE_MAX_SIZE_MB="8",
+    )
+    # Each block is fetched once, whole, and the second pass is served from
+    # the cache
+    block_size = 1024 * 1024
+    assert sorted(set(range_server.ranges)) == sorted(range_server.ranges)
+    assert all(start % block_size == 0 for (start, _) in range_server.ranges)
+    assert len(range_server.ranges) <= 5
+
+
+@pytest.mark.skipif(
+    sys.platform in ("darwin", "win32"), reason="macOS/Windows fails now"
+)
+def test_read_parallel(range_server):
+    """Test case for a read larger than the parallel chunk size"""
+
+    run_read_script(
+        range_server,
+        "whole",
+        HTTP_READ_PARALLEL_CHUNK_SIZE_MB="1",
+        HTTP_READ_PARALLEL_REQUESTS="3",
+    )
+    # The 3MB+ body is fetched as four concurrent range requests of up to 1MB
+    chunk_size = 1024 * 1024
+    assert len(range_server.ranges) == 4
+    assert all(stop - start <= chunk_size for (start, stop) in range_server.ranges)
+
+
+@pytest.mark.parametrize("cache_size", ["0", "8"])
+@pytest.mark.skipif(
+    sys.platform in ("darwin", "win32"), reason="macOS/Windows fails now"
+)
+def test_read_eof(range_server, cache_size):
+    """Test case for a short read at the end of the http file"""
+
+    run_read_script(
+        range_server,
+        "eof",
+        HTTP_READ_CACHE_BLOCK_SIZE_MB="1",
+        HTTP_READ_CACHE_MAX_SIZE_MB=cache_size,
+    )
+
+
 if __name__ == "__main__":
     tf.test.main()
@@ -146,9 +146,8 @@ def fixture_lmdb(request):
     return args, func, expected
 
 
-@pytest.fixture(name="pubsub")
-def fixture_pubsub(request):
-    """fixture_pubsub"""
+def pubsub_setup(request, **kwargs):
+    """Create a pubsub subscription with 10 messages on the emulator"""
     from google.cloud import pubsub_v1  # pylint: disable=import-outside-toplevel
 
     channel = f"e{int(time.time())}e"
@@ -194,7 +193,7 @@ def fixture_pubsub(request):
 
     def func(q):
         v = tfio.experimental.IODataset.stream().from_pubsub(
-            q, endpoint="http://localhost:8085", timeout=5000
+            q, endpoint="http://localhost:8085", timeout=5000, **kwargs
         )
         v = v.map(lambda e: e.data)
         return v
@@ -204,6 +203,18 @@ def fixture_pubsub(request):
     return args, func, expected
 
 
+@pytest.fixture(name="pubsub")
+def fixture_pubsub(request):
+    """fixture_pubsub"""
+    return pubsub_setup(request)
+
+
+@pytest.fixture(name="pubsub_streaming")
+def fixture_pubsub_streaming(request):
+    """fixture_pubsub_streaming"""
+    return pubsub_setup(request, streaming=True, max_outstanding_messages=4)
+
+
 @pytest.fixture(name="grpc")
 def fixture_grpc():
     """fixture_grpc"""
@@ -356,6 +367,55 @@ def fixture_kinesis(request):
     return args, func, expected
 
 
+@pytest.fixture(name="kinesis_shards")
+def fixture_kinesis_shards(request):
+    """fixture_kinesis_shards"""
+    import boto3  # pylint: disable=import-outside-toplevel
+
+    val = [("D" + str(i)) for i in range(10)]
+    key = [("TensorFlow" + str(i)) for i in range(10)]
+
+    os.environ["AWS_ACCESS_KEY_ID"] = "ACCESS_KEY"
+    os.environ["AWS_SECRET_ACCESS_KEY"] = "SECRET_KEY"
+    os.environ["KINESIS_USE_HTTPS"] = "0"
+    os.environ["KINESIS_ENDPOINT"] = "localhost:4566"
+
+    client = boto3.client(
+        "kinesis", region_name="us-east-1", endpoint_url="http://localhost:4566"
+    )
+
+    # Setup the Kinesis with 2 shards, the records alternate between the
+    # first (lowest hash key) and the second (highest hash key) shard.
+    stream_name = f"kinesis_s{time.time()}s"
+    client.create_stream(StreamName=stream_name, ShardCount=2)
+    client.get_waiter("stream_exists").wait(StreamName=stream_name)
+    for i, (v, k) in enumerate(zip(val, key)):
+        client.put_record(
+            StreamName=stream_name,
+            Data=v,
+            PartitionKey=k,
+            ExplicitHashKey=str(0 if i % 2 == 0 else (1 << 128) - 1),
+        )
+
+    def fin():
+        client.delete_stream(StreamName=stream_name)
+        client.get_waiter("stream_not_exists").wait(StreamName=stream_name)
+
+    request.addfinalizer(fin)
+
+    args = stream_name
+
+    def func(q):
+        dataset = tfio.experimental.IODataset.from_kinesis(q, parallel_shards=True)
+        dataset = dataset.map(lambda e: (e.data, e.partition))
+        dataset = dataset.take(10)
+        return dataset
+
+    expected = list(zip([v.encode() for v in val], [k.encode() for k in key]))
+
+    return args, func, expected
+
+
 # Source of audio are based on the following:
 #   https://commons.wikimedia.org/wiki/File:ZASFX_ADSR_no_sustain.ogg
 # OGG: ZASFX_ADSR_no_sustain.ogg.
@@ -1072,6 +1132,7 @@ def fixture_video_mp4():
             ],
         ),
         pytest.param("pubsub"),
+        pytest.param("pubsub_streaming"),
         pytest.param("hdf5"),
         pytest.param("grpc"),
         pytest.param("numpy"),
@@ -1122,6 +1183,7 @@ def fixture_video_mp4():
         "prometheus[scrape]",
         "kinesis",
         "pubsub",
+        "pubsub[streaming]",
         "hdf5",
         "grpc",
         "numpy",
@@ -1147,6 +1209,24 @@ def test_io_dataset_basic(fixture_lookup, io_dataset_fixture):
     assert all([element_equal(a, b) for (a, b) in zip(entries, expected)])
 
 
+@pytest.mark.skipif(
+    sys.platform in ("win32", "darwin"),
+    reason="TODO Localstack not setup properly on macOS/Windows yet",
+)
+def test_io_dataset_kinesis_shards(kinesis_shards):
+    """test_io_dataset_kinesis_shards"""
+    args, func, expected = kinesis_shards
+
+    dataset = func(args)
+    entries = [(data.numpy(), partition.numpy()) for (data, partition) in dataset]
+
+    # Records of different shards interleave, but each shard keeps its order
+    assert sorted(entries) == sorted(expected)
+    for shard in range(2):
+        records = expected[shard::2]
+        assert [e for e in entries if e in records] == records
+
+
 # This test makes sure basic dataset operations (take, batch) work.
 @pytest.mark.parametrize(
     ("io_dataset_fixture"),
@@ -23,6 +23,7 @@ import threading
 
 import tensorflow as tf
 import tensorflow_io as tfio
+from tensorflow_io.python.ops import core_ops
 
 
 def test_kafka_io_tensor():
@@ -35,6 +36,15 @@ def test_kafka_io_tensor():
     assert len(kafka.to_tensor()) == 10
 
 
+def test_kafka_io_tensor_slice():
+    kafka = tfio.IOTensor.from_kafka("test")
+    # Sequential reads continue without a seek, out of order reads seek
+    assert np.all(kafka[0:3].numpy() == [b"D0", b"D1", b"D2"])
+    assert np.all(kafka[3:5].numpy() == [b"D3", b"D4"])
+    assert kafka[5].numpy() == b"D5"
+    assert kafka[1].numpy() == b"D1"
+
+
 @pytest.mark.skip(reason="TODO")
 def test_kafka_output_sequence():
     """Test case based on fashion mnist tutorial"""
@@ -106,6 +116,35 @@ def test_kafka_output_sequence():
         assert entry.numpy() == prediction.encode()
 
 
+def test_kafka_output_sequence_metrics():
+    """Test the asynchronous producer of KafkaOutputSequence with batching
+    controls and a small in-flight bound.
+    """
+    import tensorflow_io.kafka as kafka_io
+
+    topic = f"output-metrics-test-{int(time.time())}"
+    sequence = kafka_io.KafkaOutputSequence(
+        topic=topic,
+        servers="localhost",
+        configuration=[
+            "linger.ms=5",
+            "batch.size=1024",
+            "compression.codec=gzip",
+            "conf.max.inflight.bytes=8",
+            "conf.flush.timeout.ms=-1",
+        ],
+    )
+    for i in range(10):
+        sequence.setitem(i, "D" + str(i))
+    sequence.flush()
+    assert sequence.metrics().numpy().tolist() == [10, 0, 0]
+
+    kafka = tfio.IOTensor.from_kafka(topic)
+    assert np.all(
+        kafka.to_tensor().numpy() == [("D" + str(i)).encode() for i in range(10)]
+    )
+
+
 def test_avro_kafka_dataset():
     """test_avro_kafka_dataset"""
     import tensorflow_io.kafka as kafka_io
@@ -131,6 +170,80 @@ def test_avro_kafka_dataset():
     assert np.all(entries == [("value1", 1, ""), ("value2", 2, "2"), ("value3", 3, "")])
 
 
+def test_kafka_decode_avro_wire():
+    """Test decoding avro messages in the wire format with schemas resolved
+    through a local schema registry stub.
+    """
+    import http.server
+    import json
+    import struct
+
+    schemas = {
+        1: (
+            '{"type":"record","name":"myrecord","fields":['
+            '{"name":"f1","type":"string"},'
+            '{"name":"f2","type":"long"}'
+            "]}"
+        ),
+        2: (
+            '{"type":"record","name":"myrecord","fields":['
+            '{"name":"f1","type":"string"},'
+            '{"name":"f2","type":"long"},'
+            '{"name":"f3","type":"string","default":"none"}'
+            "]}"
+        ),
+    }
+    requests = []
+
+    class RegistryHandler(http.server.BaseHTTPRequestHandler):
+        def do_GET(self):  # pylint: disable=invalid-name
+            requests.append(self.path)
+            schema_id = int(self.path.rsplit("/", 1)[-1])
+            body = json.dumps({"schema": schemas[schema_id]}).encode()
+            self.send_response(200)
+            self.send_header("Content-Type", "application/json")
+            self.send_header("Content-Length", str(len(body)))
+            self.end_headers()
+            self.wfile.write(body)
+
+        def log_message(self, *args):  # pylint: disable=arguments-differ
+            pass
+
+    server = http.server.HTTPServer(("localhost", 0), RegistryHandler)
+    thread = threading.Thread(target=server.serve_forever, daemon=True)
+    thread.start()
+    try:
+        v1 = core_ops.io_kafka_encode_avro(
+            [tf.constant(["a", "b"]), tf.constant([1, 2], tf.int64)],
+            schema=schemas[1],
+        )
+        v2 = core_ops.io_kafka_encode_avro(
+            [
+                tf.constant(["c"]),
+                tf.constant([3], tf.int64),
+                tf.constant(["three"]),
+            ],
+            schema=schemas[2],
+        )
+        messages = [struct.pack(">bI", 0, 1) + e for e in v1.numpy()]
+        messages += [struct.pack(">bI", 0, 2) + e for e in v2.numpy()]
+
+        registry = tfio.experimental.streaming.KafkaSchemaRegistry(
+            "http://localhost:{}".format(server.server_port)
+        )
+        for _ in range(2):
+            f1, f2, f3 = registry.decode_avro(
+                messages, schema=schemas[2], dtype=[tf.string, tf.int64, tf.string]
+            )
+            assert f1.numpy().tolist() == [b"a", b"b", b"c"]
+            assert f2.numpy().tolist() == [1, 2, 3]
+            assert f3.numpy().tolist() == [b"none", b"none", b"three"]
+        # Each schema is fetched once
+        assert sorted(requests) == ["/schemas/ids/1", "/schemas/ids/2"]
+    finally:
+        server.shutdown()
+
+
 def test_kafka_stream_dataset():
     dataset = tfio.IODataset.stream().from_kafka("test").batch(2)
     assert np.all(
@@ -151,6 +264,33 @@ def test_kafka_io_dataset():
         )
 
 
+def test_kafka_io_dataset_time_range():
+    """Test the KafkaIODataset with start and stop specified as timestamps."""
+    now = int(time.time() * 1000)
+    # All messages in the topic were produced before now
+    dataset = tfio.IODataset.from_kafka("test", start_time=0, stop_time=now)
+    assert np.all(
+        [k.numpy() for (k, _) in dataset]
+        == np.asarray([("D" + str(i)).encode() for i in range(10)])
+    )
+    dataset = tfio.IODataset.from_kafka("test", start_time=now)
+    assert len(list(dataset)) == 0
+
+
+def test_write_kafka_batch():
+    """Test writing a batch of messages with a shared producer."""
+    import tensorflow_io.kafka as kafka_io
+
+    topic = f"write-batch-test-{int(time.time())}"
+    messages = tf.constant([("D" + str(i)).encode() for i in range(10)])
+    kafka_io.write_kafka(message=messages[:5], topic=topic, sync=False)
+    content = kafka_io.write_kafka(message=messages[5:], topic=topic)
+    assert np.all(content.numpy() == messages[5:].numpy())
+
+    kafka = tfio.IOTensor.from_kafka(topic)
+    assert np.all(kafka.to_tensor().numpy() == messages.numpy())
+
+
 def test_avro_encode_decode():
     """test_avro_encode_decode"""
     schema = (
@@ -324,6 +464,30 @@ def test_kafka_group_io_dataset_tertiary_cg_multiple_topics():
     )
 
 
+@pytest.mark.parametrize("merge", ["arrival", "round_robin"])
+def test_kafka_group_io_dataset_parallel_partitions(merge):
+    """Test the functionality of the KafkaGroupIODataset when the partitions
+    are fetched in parallel and merged in arrival or round-robin order.
+    """
+
+    dataset = tfio.experimental.streaming.KafkaGroupIODataset(
+        topics=["key-partition-test"],
+        group_id="cgtestparallel" + merge,
+        servers="localhost:9092",
+        configuration=[
+            "session.timeout.ms=7000",
+            "max.poll.interval.ms=8000",
+            "auto.offset.reset=earliest",
+        ],
+        parallel_partitions=True,
+        partition_merge=merge,
+    )
+    assert np.all(
+        sorted(k.numpy() for (k, _) in dataset)
+        == sorted(("D" + str(i)).encode() for i in range(100))
+    )
+
+
 def test_kafka_group_io_dataset_auto_offset_reset():
     """Test the functionality of the `auto.offset.reset` configuration
     at global and topic level"""
@@ -434,6 +434,96 @@ class AvroRecordDatasetTest(AvroDatasetTestBase):
         )
 
 
+class AvroDatasetOutputTest(AvroDatasetTestBase):
+    """AvroDatasetOutputTest"""
+
+    schema = """{
+          "type": "record",
+          "name": "dataTypes",
+          "fields": [
+              {
+                 "name":"index",
+                 "type":"int"
+              },
+              {
+                 "name":"string_value",
+                 "type":"string"
+              }
+          ]}"""
+
+    record_data = [{"index": i, "string_value": "value" * i} for i in range(1000)]
+
+    def _write(self, filename, **kwargs):
+        serializer = AvroSerializer(self.schema)
+        serialized = [serializer.serialize(record) for record in self.record_data]
+        dataset = tf.data.Dataset.from_tensor_slices(serialized)
+        # Elements could be scalars or batches of records
+        dataset = dataset.batch(kwargs.pop("batch_size", 1))
+        return tfio.experimental.columnar.write_avro_dataset(
+            dataset, filename, self.schema, **kwargs
+        )
+
+    def test_codecs(self):
+        """test_codecs"""
+        for codec in ["null", "deflate"]:
+            filename = os.path.join(tempfile.mkdtemp(), "test.avro")
+            filenames = self._write(
+                filename, codec=codec, block_size=1024, batch_size=7
+            )
+            assert filenames.numpy().tolist() == [filename.encode()]
+            records = AvroFileToRecords(filename).get_records()
+            assert records == self.record_data
+
+    def test_snappy(self):
+        """test_snappy"""
+        filename = os.path.join(tempfile.mkdtemp(), "test.avro")
+        self._write(filename, codec="snappy", block_size=1024)
+        serializer = AvroSerializer(self.schema)
+        actual_dataset = tfio.experimental.columnar.AvroRecordDataset(
+            filenames=[filename]
+        )
+        data = iter(actual_dataset)
+        for record in self.record_data:
+            self.assert_values_equal(
+                expected=serializer.serialize(record), actual=next(data)
+            )
+
+    def test_zstandard(self):
+        """test_zstandard"""
+        fastavro = pytest.importorskip("fastavro")
+        pytest.importorskip("zstandard")
+        filename = os.path.join(tempfile.mkdtemp(), "test.avro")
+        self._write(filename, codec="zstandard", block_size=1024, batch_size=7)
+        with open(filename, "rb") as f:
+            reader = fastavro.reader(f)
+            assert reader.codec == "zstandard"
+            records = list(reader)
+        assert records == self.record_data
+
+    def test_file_size(self):
+        """test_file_size"""
+        filename = os.path.join(tempfile.mkdtemp(), "test.avro")
+        filenames = self._write(
+            filename, codec="deflate", block_size=1024, file_size=4096
+        )
+        filenames = [f.decode() for f in filenames.numpy().tolist()]
+        assert len(filenames) > 1
+        assert filenames[0] == os.path.join(
+            os.path.dirname(filename), "test-00000.avro"
+        )
+        records = []
+        for f in filenames:
+            records += AvroFileToRecords(f).get_records()
+        assert records == self.record_data
+
+    def test_empty(self):
+        """test_empty"""
+        filename = os.path.join(tempfile.mkdtemp(), "test.avro")
+        dataset = tf.data.Dataset.from_tensor_slices(tf.constant([], tf.string))
+        tfio.experimental.columnar.write_avro_dataset(dataset, filename, self.schema)
+        assert AvroFileToRecords(filename).get_records() == []
+
+
 class MakeAvroRecordDatasetTest(AvroDatasetTestBase):
     """MakeAvroRecordDatasetTest"""
 
@@ -239,5 +239,79 @@ def test_pulsar_write_keyed_messages():
     assert kv["2"] == [("msg-" + str(i)).encode() for i in range(2, 10, 3)]
 
 
+@pytest.mark.skipif(
+    sys.platform in ("win32",),
+    reason="TODO Pulsar not setup properly on Windows yet",
+)
+def test_pulsar_batch_multiple_topics():
+    """Test consuming multiple topics in small batches with PulsarIODataset"""
+
+    topics = ["test-batch-multiple-topics-0", "test-batch-multiple-topics-1"]
+    for topic in topics:
+        writer = tfio.experimental.streaming.PulsarWriter(
+            service_url="pulsar://localhost:6650", topic=topic
+        )
+        for i in range(10):
+            writer.write(value=topic + "-" + str(i), key=topic)
+        writer.flush()
+
+    dataset = tfio.experimental.streaming.PulsarIODataset(
+        service_url="pulsar://localhost:6650",
+        topic=topics,
+        subscription="subscription-0",
+        timeout=default_pulsar_timeout,
+        max_num_messages=3,
+    )
+    kv = dict()
+    for (msg, key) in dataset:
+        kv.setdefault(key.numpy().decode(), []).append(msg.numpy())
+    for topic in topics:
+        assert kv[topic] == [(topic + "-" + str(i)).encode() for i in range(10)]
+
+
+@pytest.mark.skipif(
+    sys.platform in ("win32",),
+    reason="TODO Pulsar not setup properly on Windows yet",
+)
+def test_pulsar_write_batch():
+    """Test writing a tensor of messages to a Pulsar topic with PulsarWriter"""
+
+    topic = "test-write-batch"
+    writer = tfio.experimental.streaming.PulsarWriter(
+        service_url="pulsar://localhost:6650", topic=topic, compression="lz4"
+    )
+    # 1. Write 10 messages in two batches, then the receipt of all of them.
+    # The sent count of each call covers the messages completed since the
+    # previous call, so the counts add up to 10.
+    stats = writer.write_batch(["msg-" + str(i) for i in range(5)])
+    assert stats.shape == [6]
+    sent = stats[0]
+    stats = writer.write_batch(
+        ["msg-" + str(i) for i in range(5, 10)], [str(i % 3) for i in range(5, 10)],
+    )
+    sent += stats[0]
+    writer.flush()
+    stats = writer.write_batch(tf.constant([], tf.string))
+    sent += stats[0]
+    assert sent == 10
+    assert stats[1] == 0 and stats[2] == 0 and stats[3] == 0
+
+    # 2. Consume messages and verify
+    dataset = tfio.experimental.streaming.PulsarIODataset(
+        service_url="pulsar://localhost:6650",
+        topic=topic,
+        subscription="subscription-0",
+        timeout=default_pulsar_timeout,
+    )
+    messages = [(msg.numpy(), key.numpy()) for (msg, key) in dataset]
+    assert len(messages) == 10
+    assert [msg for (msg, _) in messages] == [
+        ("msg-" + str(i)).encode() for i in range(10)
+    ]
+    assert [key for (_, key) in messages] == [b""] * 5 + [
+        str(i % 3).encode() for i in range(5, 10)
+    ]
+
+
 if __name__ == "__main__":
     test.main()
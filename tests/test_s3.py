@@ -15,6 +15,7 @@
 """Tests for S3 file system"""
 
 import os
+import subprocess
 import sys
 import time
 import tempfile
@@ -22,6 +23,8 @@ import tensorflow as tf
 import tensorflow_io as tfio
 import pytest
 
+from filesystem_utils import random_body, read_in_chunks
+
 
 @pytest.mark.skipif(
     sys.platform in ("win32", "darwin"),
@@ -55,3 +58,235 @@ def test_read_file():
 
     content = tf.io.read_file(f"s3://{bucket_name}/{key_name}")
     assert content == body
+
+
+@pytest.mark.skipif(
+    sys.platform in ("win32", "darwin"),
+    reason="TODO Localstack not setup properly on macOS/Windows yet",
+)
+def test_read_file_cached():
+    """Test case for reading S3 through the block cache with read-ahead"""
+    import boto3
+
+    os.environ["AWS_REGION"] = "us-east-1"
+    os.environ["AWS_ACCESS_KEY_ID"] = "ACCESS_KEY"
+    os.environ["AWS_SECRET_ACCESS_KEY"] = "SECRET_KEY"
+    os.environ["S3_ENDPOINT"] = "http://localhost:4566"
+
+    client = boto3.client(
+        "s3", region_name="us-east-1", endpoint_url="http://localhost:4566"
+    )
+
+    body = random_body()
+
+    key_name = "TEST_CACHED"
+    bucket_name = f"s3e{time.time()}e"
+
+    client.create_bucket(Bucket=bucket_name)
+    client.put_object(Bucket=bucket_name, Key=key_name, Body=body)
+
+    tfio.experimental.filesystem.set_configuration(
+        "s3", "S3_READ_CACHE_BLOCK_SIZE_MB", "1"
+    )
+    tfio.experimental.filesystem.set_configuration(
+        "s3", "S3_READ_CACHE_MAX_SIZE_MB", "16"
+    )
+    try:
+        with tf.io.gfile.GFile(f"s3://{bucket_name}/{key_name}", "rb") as f:
+            assert read_in_chunks(f) == body
+
+        with tf.io.gfile.GFile(f"s3://{bucket_name}/{key_name}", "rb") as f:
+            f.seek(2 * 1024 * 1024 - 10)
+            assert f.read(20) == body[2 * 1024 * 1024 - 10 : 2 * 1024 * 1024 + 10]
+
+        # Overwritten objects are not served from the cache
+        with tf.io.gfile.GFile(f"s3://{bucket_name}/{key_name}", "wb") as f:
+            f.write(b"1234567")
+        assert tf.io.read_file(f"s3://{bucket_name}/{key_name}") == b"1234567"
+    finally:
+        tfio.experimental.filesystem.set_configuration(
+            "s3", "S3_READ_CACHE_MAX_SIZE_MB", "0"
+        )
+
+
+LOCK_SCRIPT = """
+import fcntl
+import sys
+
+with open(sys.argv[1], "wb") as f:
+    fcntl.flock(f, fcntl.LOCK_EX)
+    print("locked", flush=True)
+    sys.stdin.read()
+"""
+
+
+@pytest.mark.skipif(
+    sys.platform in ("win32", "darwin"),
+    reason="TODO Localstack not setup properly on macOS/Windows yet",
+)
+def test_read_file_disk_cached():
+    """Test case for reading S3 through the block cache with a disk tier"""
+    import boto3
+
+    os.environ["AWS_REGION"] = "us-east-1"
+    os.environ["AWS_ACCESS_KEY_ID"] = "ACCESS_KEY"
+    os.environ["AWS_SECRET_ACCESS_KEY"] = "SECRET_KEY"
+    os.environ["S3_ENDPOINT"] = "http://localhost:4566"
+
+    client = boto3.client(
+        "s3", region_name="us-east-1", endpoint_url="http://localhost:4566"
+    )
+
+    body = random_body()
+
+    key_name = "TEST_DISK_CACHED"
+    bucket_name = f"s3e{time.time()}e"
+
+    client.create_bucket(Bucket=bucket_name)
+    client.put_object(Bucket=bucket_name, Key=key_name, Body=body)
+
+    disk_dir = tempfile.mkdtemp()
+    # The directory of a cache whose process is gone is not locked any more
+    # and removed on startup, the one of a live cache in another process is kept
+    stale_dir = os.path.join(disk_dir, "tfio-block-cache-stale")
+    os.mkdir(stale_dir)
+    for name in ["0", "lock"]:
+        with open(os.path.join(stale_dir, name), "wb") as f:
+            f.write(b"0")
+    live_dir = os.path.join(disk_dir, "tfio-block-cache-live")
+    os.mkdir(live_dir)
+    live_process = subprocess.Popen(
+        [sys.executable, "-c", LOCK_SCRIPT, os.path.join(live_dir, "lock")],
+        stdin=subprocess.PIPE,
+        stdout=subprocess.PIPE,
+    )
+    assert live_process.stdout.readline() == b"locked\n"
+    os.environ["S3_READ_CACHE_DISK_DIR"] = disk_dir
+    os.environ["S3_READ_CACHE_DISK_MAX_SIZE_MB"] = "16"
+    # The memory tier holds a single block, the others are read back from disk
+    tfio.experimental.filesystem.set_configuration(
+        "s3", "S3_READ_CACHE_BLOCK_SIZE_MB", "1"
+    )
+    tfio.experimental.filesystem.set_configuration(
+        "s3", "S3_READ_CACHE_MAX_SIZE_MB", "1"
+    )
+    try:
+        for _ in range(2):
+            with tf.io.gfile.GFile(f"s3://{bucket_name}/{key_name}", "rb") as f:
+                assert read_in_chunks(f) == body
+
+        entries = sorted(os.listdir(disk_dir))
+        assert len(entries) == 2 and entries[1] == "tfio-block-cache-live"
+        assert entries[0].startswith("tfio-block-cache-")
+        # The 4 blocks and the lock file
+        assert len(os.listdir(os.path.join(disk_dir, entries[0]))) == 5
+
+        # Overwritten objects are not served from the disk tier either
+        with tf.io.gfile.GFile(f"s3://{bucket_name}/{key_name}", "wb") as f:
+            f.write(b"1234567")
+        with tf.io.gfile.GFile(f"s3://{bucket_name}/{key_name}", "rb") as f:
+            assert f.read(5) == b"12345"
+    finally:
+        tfio.experimental.filesystem.set_configuration(
+            "s3", "S3_READ_CACHE_MAX_SIZE_MB", "0"
+        )
+        del os.environ["S3_READ_CACHE_DISK_DIR"]
+        del os.environ["S3_READ_CACHE_DISK_MAX_SIZE_MB"]
+        live_process.communicate()
+
+
+@pytest.mark.skipif(
+    sys.platform in ("win32", "darwin"),
+    reason="TODO Localstack not setup properly on macOS/Windows yet",
+)
+def test_rename_and_delete_recursively():
+    """Test case for renaming and deleting S3 directories"""
+    import boto3
+
+    os.environ["AWS_REGION"] = "us-east-1"
+    os.environ["AWS_ACCESS_KEY_ID"] = "ACCESS_KEY"
+    os.environ["AWS_SECRET_ACCESS_KEY"] = "SECRET_KEY"
+    os.environ["S3_ENDPOINT"] = "http://localhost:4566"
+
+    client = boto3.client(
+        "s3", region_name="us-east-1", endpoint_url="http://localhost:4566"
+    )
+
+    bucket_name = f"s3e{time.time()}e"
+    client.create_bucket(Bucket=bucket_name)
+    for i in range(25):
+        client.put_object(Bucket=bucket_name, Key=f"src/{i}", Body=f"{i}".encode())
+
+    tf.io.gfile.rename(f"s3://{bucket_name}/src/", f"s3://{bucket_name}/dst/")
+
+    response = client.list_objects_v2(Bucket=bucket_name)
+    keys = sorted(content["Key"] for content in response["Contents"])
+    assert keys == sorted(f"dst/{i}" for i in range(25))
+    assert tf.io.read_file(f"s3://{bucket_name}/dst/7") == b"7"
+
+    # An object is deleted together with the objects under its path
+    client.put_object(Bucket=bucket_name, Key="dst", Body=b"dst")
+    tf.io.gfile.rmtree(f"s3://{bucket_name}/dst")
+
+    response = client.list_objects_v2(Bucket=bucket_name)
+    assert response["KeyCount"] == 0
+
+
+# Streaming uploads are configured once, when the S3 client is created, so
+# the object is written from a new process.
+STREAMING_UPLOAD_SCRIPT = """
+import sys
+import tensorflow as tf
+import tensorflow_io as tfio
+
+filename, local_path = sys.argv[1:]
+with open(local_path, "rb") as f:
+    body = f.read()
+with tf.io.gfile.GFile(filename, "wb") as f:
+    for i in range(0, len(body), 1024 * 1024):
+        f.write(body[i : i + 1024 * 1024])
+"""
+
+
+@pytest.mark.skipif(
+    sys.platform in ("win32", "darwin"),
+    reason="TODO Localstack not setup properly on macOS/Windows yet",
+)
+def test_write_file_streaming_upload():
+    """Test case for writing S3 with streaming multipart uploads"""
+    import boto3
+
+    os.environ["AWS_REGION"] = "us-east-1"
+    os.environ["AWS_ACCESS_KEY_ID"] = "ACCESS_KEY"
+    os.environ["AWS_SECRET_ACCESS_KEY"] = "SECRET_KEY"
+    os.environ["S3_ENDPOINT"] = "http://localhost:4566"
+
+    client = boto3.client(
+        "s3", region_name="us-east-1", endpoint_url="http://localhost:4566"
+    )
+
+    key_name = "TEST_STREAMING_UPLOAD"
+    bucket_name = f"s3e{time.time()}e"
+    client.create_bucket(Bucket=bucket_name)
+
+    # Three parts of the minimum part size of 5MB
+    body = random_body(2 * 5 * 1024 * 1024 + 123)
+    fd, local_path = tempfile.mkstemp()
+    try:
+        with os.fdopen(fd, "wb") as f:
+            f.write(body)
+        env = dict(os.environ)
+        env["S3_STREAMING_UPLOAD"] = "1"
+        env["S3_MULTI_PART_UPLOAD_CHUNK_SIZE"] = str(5 * 1024 * 1024)
+        subprocess.check_call(
+            [sys.executable, "-c", STREAMING_UPLOAD_SCRIPT]
+            + [f"s3://{bucket_name}/{key_name}", local_path],
+            env=env,
+        )
+    finally:
+        os.remove(local_path)
+
+    response = client.get_object(Bucket=bucket_name, Key=key_name)
+    assert response["Body"].read() == body
+    # The ETag of a multipart upload ends with its number of parts
+    assert response["ETag"].strip('"').endswith("-3")
@@ -170,6 +170,25 @@ def test_serialization_encode(
     )
 
 
+def test_serialization_avro_batch(fixture_lookup):
+    """test_serialization_avro_batch"""
+    _, value, specs = fixture_lookup("avro")
+
+    # Large enough to be processed in multiple shards
+    batch = 4096
+    batched = tf.nest.map_structure(lambda v: tf.stack([v] * batch), value)
+    encoded = tfio.experimental.serialization.encode_avro(batched, specs)
+    assert encoded.shape == [batch]
+    returned = tfio.experimental.serialization.decode_avro(encoded, specs)
+    tf.nest.assert_same_structure(batched, returned)
+    assert all(
+        [
+            np.array_equal(v, r)
+            for v, r in zip(tf.nest.flatten(batched), tf.nest.flatten(returned))
+        ]
+    )
+
+
 @pytest.mark.parametrize(
     ("serialization_fixture", "decode_function"),
     [